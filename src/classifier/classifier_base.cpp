@@ -29,17 +29,40 @@ namespace jubatus{
 
 using namespace storage;
 
+namespace {
+const vector<float> no_dense;
+}
+
 classifier_base::classifier_base(storage::storage_base* storage) : storage_(storage), C_(1.f), use_covars_(false) {
 }
 
 classifier_base::~classifier_base(){
 }
 
+bool classifier_base::supports_dense() const {
+  return false;
+}
+
+void classifier_base::train(const sfv_t& sfv, const vector<float>& dense, const string& label){
+  if (!dense.empty()) {
+    throw JUBATUS_EXCEPTION(unsupported_method(name() + " with dense features"));
+  }
+  train(sfv, label);
+}
+
 void classifier_base::classify_with_scores(const sfv_t& sfv, classify_result& scores) const{
+  classify_with_scores(sfv, no_dense, scores);
+}
+
+void classifier_base::classify_with_scores(const sfv_t& sfv, const vector<float>& dense, classify_result& scores) const{
   scores.clear();
 
   map_feature_val1_t ret;
-  storage_->inp(sfv, ret);
+  if (dense.empty()) {
+    storage_->inp(sfv, ret);
+  } else {
+    storage_->inp_dense(sfv, dense, ret);
+  }
   for (map_feature_val1_t::const_iterator it = ret.begin(); it != ret.end(); ++it){
     scores.push_back(classify_result_elem(it->first, it->second));
   }
@@ -54,8 +77,12 @@ float classifier_base::C() const {
 }
  
 string classifier_base::classify(const sfv_t& fv) const {
+  return classify(fv, no_dense);
+}
+
+string classifier_base::classify(const sfv_t& fv, const vector<float>& dense) const {
   classify_result result;
-  classify_with_scores(fv, result);
+  classify_with_scores(fv, dense, result);
   float max_score = -FLT_MAX;
   string max_class;
   for (vector<classify_result_elem>::const_iterator it = result.begin(); it != result.end(); ++it){
@@ -72,8 +99,17 @@ void classifier_base::update_weight(const sfv_t& sfv, float step_width,
   storage_->bulk_update(sfv, step_width, pos_label, neg_label);
 }
 
-string classifier_base::get_largest_incorrect_label(const sfv_t& fv, const string& label, classify_result& scores) const {
-  classify_with_scores(fv, scores);
+void classifier_base::update_weight(const sfv_t& sfv, const vector<float>& dense, float step_width,
+				    const string& pos_label, const string& neg_label){
+  if (dense.empty()) {
+    storage_->bulk_update(sfv, step_width, pos_label, neg_label);
+  } else {
+    storage_->bulk_update_dense(sfv, dense, step_width, pos_label, neg_label);
+  }
+}
+
+string classifier_base::get_largest_incorrect_label(const sfv_t& fv, const vector<float>& dense, const string& label, classify_result& scores) const {
+  classify_with_scores(fv, dense, scores);
   float max_score = -FLT_MAX;
   string max_class;
   for (vector<classify_result_elem>::const_iterator it = scores.begin();
@@ -88,8 +124,12 @@ string classifier_base::get_largest_incorrect_label(const sfv_t& fv, const strin
 }
 
 float classifier_base::calc_margin(const sfv_t& fv, const string& label, string& incorrect_label) const{
+  return calc_margin(fv, no_dense, label, incorrect_label);
+}
+
+float classifier_base::calc_margin(const sfv_t& fv, const vector<float>& dense, const string& label, string& incorrect_label) const{
   classify_result scores;
-  incorrect_label = get_largest_incorrect_label(fv, label, scores);
+  incorrect_label = get_largest_incorrect_label(fv, dense, label, scores);
   float correct_score = 0.f; 
   float incorrect_score = 0.f; 
   for (vector<classify_result_elem>::const_iterator it = scores.begin();
@@ -134,4 +174,12 @@ float classifier_base::squared_norm(const sfv_t& fv) {
   return ret;
 }
 
+float classifier_base::squared_norm(const vector<float>& dense) {
+  float ret = 0.f;
+  for (size_t i = 0; i < dense.size(); ++i){
+    ret += dense[i] * dense[i];
+  }
+  return ret;
+}
+
 }
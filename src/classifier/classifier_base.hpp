@@ -34,9 +34,18 @@ public:
   classifier_base(storage::storage_base* storage_base);
   virtual ~classifier_base();
   virtual void train(const sfv_t& fv, const std::string& label) = 0;
+
+  // Variants taking values of dense features of the storage (see
+  // storage::storage_base::set_dense_features) in addition to sfv.
+  // Only algorithms which keep nothing but weights for each feature support
+  // them.
+  virtual bool supports_dense() const;
+  virtual void train(const sfv_t& fv, const std::vector<float>& dense, const std::string& label);
   
   std::string classify(const sfv_t& fv) const;
+  std::string classify(const sfv_t& fv, const std::vector<float>& dense) const;
   void classify_with_scores(const sfv_t& fv, classify_result& scores) const;
+  void classify_with_scores(const sfv_t& fv, const std::vector<float>& dense, classify_result& scores) const;
 
   void set_C(float C);
   float C() const;
@@ -46,11 +55,14 @@ public:
 protected:
 
   void update_weight(const sfv_t& sfv, float step_weigth, const std::string& pos_label, const std::string& neg_class);
+  void update_weight(const sfv_t& sfv, const std::vector<float>& dense, float step_weigth, const std::string& pos_label, const std::string& neg_class);
   float calc_margin(const sfv_t& sfv, const std::string& label, std::string& incorrect_label) const;
+  float calc_margin(const sfv_t& sfv, const std::vector<float>& dense, const std::string& label, std::string& incorrect_label) const;
   float calc_margin_and_variance(const sfv_t& sfv, const std::string& label, std::string& incorrect_label, float& variance) const;
-  std::string get_largest_incorrect_label(const sfv_t& sfv, const std::string& label, classify_result& scores) const;
+  std::string get_largest_incorrect_label(const sfv_t& sfv, const std::vector<float>& dense, const std::string& label, classify_result& scores) const;
 
   static float squared_norm(const sfv_t& sfv);
+  static float squared_norm(const std::vector<float>& dense);
 
   storage::storage_base* storage_;
   float C_;
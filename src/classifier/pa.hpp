@@ -26,6 +26,8 @@ public:
   PA(storage::storage_base* storage);
   void set_config(std::map<std::string, int>& config);
   void train(const sfv_t& fv, const std::string& label);
+  void train(const sfv_t& fv, const std::vector<float>& dense, const std::string& label);
+  bool supports_dense() const;
   std::string name() const;
 
 private:
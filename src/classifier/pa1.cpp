@@ -28,18 +28,26 @@ PA1::PA1(storage::storage_base* storage) : classifier_base(storage)
 }
 
 void PA1::train(const sfv_t& sfv, const string& label){
+  train(sfv, vector<float>(), label);
+}
+
+void PA1::train(const sfv_t& sfv, const vector<float>& dense, const string& label){
   string incorrect_label;
-  float margin = calc_margin(sfv, label, incorrect_label);
+  float margin = calc_margin(sfv, dense, label, incorrect_label);
   float loss = 1.f + margin;
   if (loss < 0.f){
     return;
   }
-  float sfv_norm = squared_norm(sfv);
+  float sfv_norm = squared_norm(sfv) + squared_norm(dense);
   if (sfv_norm == 0.f) {
     return;
   }
 
-  update_weight(sfv, min(C_, loss / sfv_norm), label, incorrect_label);
+  update_weight(sfv, dense, min(C_, loss / sfv_norm), label, incorrect_label);
+}
+
+bool PA1::supports_dense() const {
+  return true;
 }
 
 string PA1::name() const {
@@ -26,6 +26,8 @@ class PA1 : public classifier_base {
 public:
   PA1(storage::storage_base* storage);
   void train(const sfv_t& fv, const std::string& label);
+  void train(const sfv_t& fv, const std::vector<float>& dense, const std::string& label);
+  bool supports_dense() const;
   std::string name() const;
 private:
 };
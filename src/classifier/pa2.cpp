@@ -26,18 +26,26 @@ PA2::PA2(storage::storage_base* storage) : classifier_base(storage){
 }
 
 void PA2::train(const sfv_t& sfv, const string& label){
+  train(sfv, vector<float>(), label);
+}
+
+void PA2::train(const sfv_t& sfv, const vector<float>& dense, const string& label){
   string incorrect_label;
-  float margin = calc_margin(sfv, label, incorrect_label);
+  float margin = calc_margin(sfv, dense, label, incorrect_label);
   float loss = 1.f + margin;
 
   if (loss < 0.f){
     return;
   }
-  float sfv_norm = squared_norm(sfv);
+  float sfv_norm = squared_norm(sfv) + squared_norm(dense);
   if (sfv_norm == 0.f) {
     return;
   }
-  update_weight(sfv, loss / (sfv_norm + 1/(2 * C_)), label, incorrect_label);
+  update_weight(sfv, dense, loss / (sfv_norm + 1/(2 * C_)), label, incorrect_label);
+}
+
+bool PA2::supports_dense() const {
+  return true;
 }
 
 string PA2::name() const {
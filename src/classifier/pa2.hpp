@@ -26,6 +26,8 @@ public:
   PA2(storage::storage_base* storage);
 
   void train(const sfv_t& sfv, const std::string& label);
+  void train(const sfv_t& sfv, const std::vector<float>& dense, const std::string& label);
+  bool supports_dense() const;
   std::string name() const;
 private:
 };
@@ -28,11 +28,21 @@ perceptron::perceptron(storage::storage_base* storage): classifier_base(storage)
 
 void perceptron::train(const sfv_t& sfv, const std::string& label) 
 {
-  std::string predicted_label = classify(sfv);
+  train(sfv, std::vector<float>(), label);
+}
+
+void perceptron::train(const sfv_t& sfv, const std::vector<float>& dense, const std::string& label) 
+{
+  std::string predicted_label = classify(sfv, dense);
   if (label == predicted_label){
     return;
   }
-  update_weight(sfv, 1.f, label, predicted_label);
+  update_weight(sfv, dense, 1.f, label, predicted_label);
+}
+
+bool perceptron::supports_dense() const
+{
+  return true;
 }
 
 string perceptron::name() const 
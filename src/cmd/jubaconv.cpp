@@ -15,13 +15,16 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <iterator>
 #include <pficommon/text/json.h>
 #include "../common/exception.hpp"
 #include "../common/cmdline.h"
 #include "../fv_converter/datum_to_fv_converter.hpp"
 #include "../fv_converter/datum.hpp"
-#include "../fv_converter/json_converter.hpp"
+#include "../fv_converter/json_stream_converter.hpp"
+#include "../fv_converter/exception.hpp"
 #include "../fv_converter/converter_config.hpp"
+#include "jubaconv_stream.hpp"
 
 using namespace std;
 using namespace pfi::text::json;
@@ -81,6 +84,17 @@ void read_json(pfi::text::json::json& json) {
   }
 }
 
+void read_json_as_datum(datum& datum) {
+  string input((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+  try {
+    json_stream_converter conv;
+    conv.convert(input, datum);
+  } catch(const converter_exception& e) {
+    cerr << "invalid json format" << endl;
+    exit(-1);
+  }
+}
+
 void read_datum(datum& datum) {
   try {
     cin >> pfi::text::json::via_json(datum);
@@ -90,16 +104,57 @@ void read_datum(datum& datum) {
   }
 }
 
+int convert_stream(const cmdline::parser& p) {
+  jubatus::jubaconv::stream_options options;
+  options.input_format = p.get<string>("input-format");
+  options.output_format = p.get<string>("output-format");
+  options.threads = p.get<int>("threads");
+  options.batch_size = p.get<int>("batch-size");
+  options.summary = p.exist("summary");
+  options.top = p.get<int>("top");
+
+  if (options.output_format == "json" || options.output_format == "datum") {
+    show_invalid_type_error(options.input_format, options.output_format);
+    return -1;
+  }
+
+  string conf_file = p.get<string>("conf");
+  if (conf_file == "") {
+    cerr << "specify converter config with -c flag" << endl;
+    return -1;
+  }
+  converter_config conf;
+  if (read_config(conf_file, conf) != 0) {
+    return -1;
+  }
+
+  size_t errors = jubatus::jubaconv::run_stream(conf, options, p.rest());
+  return errors == 0 ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) try {
   cmdline::parser p;
-  p.add<string>("input-format", 'i', "input format (json/datum)", false, "json",
-                cmdline::oneof<string>("json", "datum"));
-  p.add<string>("output-format", 'o', "output format (json/datum/fv)", false, "fv",
-                cmdline::oneof<string>("json", "datum", "fv"));
+  p.add<string>("input-format", 'i', "input format (json/datum/libsvm)", false, "json",
+                cmdline::oneof<string>("json", "datum", "libsvm"));
+  p.add<string>("output-format", 'o', "output format (json/datum/fv/msgpack/libsvm)", false, "fv",
+                cmdline::oneof<string>("json", "datum", "fv", "msgpack", "libsvm"));
   p.add<string>("conf", 'c', "converter config file", false);
+  p.add("stream", 's', "convert newline-delimited records from files or stdin");
+  p.add<int>("threads", 't', "number of converter threads in stream mode", false, 1,
+             cmdline::range(1, 1024));
+  p.add<int>("batch-size", 'b', "records per batch in stream mode", false, 256,
+             cmdline::range(1, 1 << 20));
+  p.add("summary", '\0', "print feature counts per rule and top features to stderr in stream mode");
+  p.add<int>("top", '\0', "number of top features in the summary", false, 20,
+             cmdline::range(0, 1 << 20));
   p.set_program_name("jubaconv");
+  p.footer("[files...]");
   p.parse_check(argc, argv);
 
+  if (p.exist("stream")) {
+    return convert_stream(p);
+  }
+
   pfi::text::json::json json;
   datum datum;
   jubatus::sfv_t fv;
@@ -108,25 +163,30 @@ int main(int argc, char* argv[]) try {
   string input_format = p.get<string>("input-format");
   string output_format = p.get<string>("output-format");
 
-  if (input_format == "json") {
-    read_json(json);
-    proc = true;
+  if (input_format == "libsvm"
+      || output_format == "msgpack" || output_format == "libsvm") {
+    cerr << input_format << " -> " << output_format
+         << " is only supported in stream mode (-s)" << endl;
+    return -1;
   }
 
   if (output_format == "json") {
-    if (!proc) {
+    if (input_format != "json") {
       show_invalid_type_error(input_format, output_format);
       return -1;
     }
+    read_json(json);
     output_json(json);
     return 0;
   }
 
-  if (input_format == "datum") {
+  if (input_format == "json") {
+    // no need to build a json DOM when only the datum is used
+    read_json_as_datum(datum);
+    proc = true;
+  } else if (input_format == "datum") {
     read_datum(datum);
     proc = true;
-  } else if (proc) {
-    json_converter::convert(json, datum);
   }
 
   if (output_format == "datum") {
@@ -0,0 +1,468 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include "jubaconv_stream.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+
+#include <msgpack.hpp>
+#include <pficommon/concurrent/condition.h>
+#include <pficommon/concurrent/lock.h>
+#include <pficommon/concurrent/mutex.h>
+#include <pficommon/concurrent/thread.h>
+#include <pficommon/data/unordered_map.h>
+#include <pficommon/lang/bind.h>
+#include <pficommon/lang/shared_ptr.h>
+#include <pficommon/text/json.h>
+
+#include "../common/exception.hpp"
+#include "../common/hash.hpp"
+#include "../common/type.hpp"
+#include "../fv_converter/converter_config.hpp"
+#include "../fv_converter/datum.hpp"
+#include "../fv_converter/datum_to_fv_converter.hpp"
+#include "../fv_converter/json_stream_converter.hpp"
+#include "../fv_converter/libsvm_converter.hpp"
+
+using namespace std;
+using pfi::concurrent::scoped_lock;
+using jubatus::fv_converter::converter_config;
+using jubatus::fv_converter::datum;
+using jubatus::fv_converter::datum_to_fv_converter;
+
+namespace jubatus {
+namespace jubaconv {
+
+namespace {
+
+// libsvm indices are 1-origin positive 32bit integers
+const uint64_t LIBSVM_INDEX_SIZE = 2147483646LLU;
+
+typedef pfi::data::unordered_map<string, uint64_t> feature_count_t;
+
+string get_rule_name(const string& feature) {
+  // string features are "<KEY>$<VALUE>@<SPLITTER>#<SAMPLE>/<GLOBAL>",
+  // num features are "<KEY>@<TYPE>"; hashed features have no rule name
+  size_t sharp = feature.rfind('#');
+  size_t at = feature.rfind('@', sharp);
+  if (at == string::npos) {
+    return "(hashed)";
+  }
+  if (sharp == string::npos) {
+    return feature.substr(at + 1);
+  }
+  return feature.substr(at + 1, sharp - at - 1);
+}
+
+void write_json_string(const string& s, ostream& out) {
+  out << '"';
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    switch (c) {
+      case '"':  out << "\\\""; break;
+      case '\\': out << "\\\\"; break;
+      case '\n': out << "\\n"; break;
+      case '\r': out << "\\r"; break;
+      case '\t': out << "\\t"; break;
+      default:
+        if (c < 0x20) {
+          static const char hex[] = "0123456789abcdef";
+          out << "\\u00" << hex[c >> 4] << hex[c & 0xF];
+        } else {
+          out << c;
+        }
+    }
+  }
+  out << '"';
+}
+
+bool compare_count(const pair<string, uint64_t>& lhs,
+                   const pair<string, uint64_t>& rhs) {
+  if (lhs.second != rhs.second) {
+    return lhs.second > rhs.second;
+  }
+  return lhs.first < rhs.first;
+}
+
+class stream_converter {
+ public:
+  stream_converter(const converter_config& config,
+                   const stream_options& options);
+
+  size_t run(const vector<string>& files);
+
+ private:
+  struct batch {
+    size_t seq;
+    string source;
+    size_t first_line;
+    vector<string> lines;
+    string output;
+    string error_output;
+    size_t errors;
+  };
+  typedef pfi::lang::shared_ptr<batch> batch_ptr;
+
+  struct worker_state {
+    worker_state() : records(0) {}
+
+    datum d;
+    string label;
+    sfv_t fv;
+    vector<pair<uint64_t, float> > indexed;
+    fv_converter::json_stream_converter json_conv;
+    feature_count_t features;
+    uint64_t records;
+  };
+
+  void read(istream& in, const string& source);
+  void push(batch_ptr b);
+  void finish();
+  void write_ready();
+
+  void worker_loop(size_t id);
+  void convert_batch(datum_to_fv_converter& conv, worker_state& s, batch& b);
+  void parse_record(worker_state& s, const string& line, size_t line_number);
+  void write_record(worker_state& s, ostream& out);
+
+  void print_summary(ostream& out) const;
+
+  const converter_config& config_;
+  stream_options options_;
+  size_t max_in_flight_;
+
+  pfi::concurrent::mutex m_;
+  pfi::concurrent::condition c_;
+  deque<batch_ptr> input_;
+  map<size_t, batch_ptr> done_;
+  size_t next_seq_;
+  size_t next_write_;
+  bool eof_;
+
+  size_t errors_;
+  vector<worker_state> states_;
+};
+
+stream_converter::stream_converter(const converter_config& config,
+                                   const stream_options& options)
+    : config_(config),
+      options_(options),
+      max_in_flight_(options.threads * 4),
+      next_seq_(0),
+      next_write_(0),
+      eof_(false),
+      errors_(0),
+      states_(options.threads) {
+  // fail in the main thread if the config is broken
+  datum_to_fv_converter conv;
+  fv_converter::initialize_converter(config_, conv);
+}
+
+size_t stream_converter::run(const vector<string>& files) {
+  vector<pfi::lang::shared_ptr<pfi::concurrent::thread> > workers;
+  for (int i = 0; i < options_.threads; ++i) {
+    pfi::lang::shared_ptr<pfi::concurrent::thread> t(
+        new pfi::concurrent::thread(
+            pfi::lang::bind(&stream_converter::worker_loop, this, i)));
+    t->start();
+    workers.push_back(t);
+  }
+
+  if (files.empty()) {
+    read(cin, "stdin");
+  } else {
+    for (size_t i = 0; i < files.size(); ++i) {
+      ifstream ifs(files[i].c_str());
+      if (!ifs) {
+        cerr << "cannot open: " << files[i] << endl;
+        ++errors_;
+        continue;
+      }
+      read(ifs, files[i]);
+    }
+  }
+  finish();
+
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i]->join();
+  }
+  cout.flush();
+
+  if (options_.summary) {
+    print_summary(cerr);
+  }
+  return errors_;
+}
+
+void stream_converter::read(istream& in, const string& source) {
+  size_t line_number = 0;
+  batch_ptr b;
+  for (string line; getline(in, line); ) {
+    ++line_number;
+    if (!b) {
+      b.reset(new batch);
+      b->source = source;
+      b->first_line = line_number;
+      b->errors = 0;
+      b->lines.reserve(options_.batch_size);
+    }
+    b->lines.push_back(string());
+    b->lines.back().swap(line);
+    if (b->lines.size() >= options_.batch_size) {
+      push(b);
+      b.reset();
+    }
+  }
+  if (b) {
+    push(b);
+  }
+}
+
+void stream_converter::push(batch_ptr b) {
+  while (true) {
+    write_ready();
+    scoped_lock lk(m_);
+    if (next_seq_ - next_write_ < max_in_flight_) {
+      b->seq = next_seq_++;
+      input_.push_back(b);
+      c_.notify_all();
+      return;
+    }
+    if (done_.find(next_write_) == done_.end()) {
+      c_.wait(m_);
+    }
+  }
+}
+
+void stream_converter::finish() {
+  {
+    scoped_lock lk(m_);
+    eof_ = true;
+    c_.notify_all();
+  }
+  while (true) {
+    write_ready();
+    scoped_lock lk(m_);
+    if (next_write_ == next_seq_) {
+      return;
+    }
+    if (done_.find(next_write_) == done_.end()) {
+      c_.wait(m_);
+    }
+  }
+}
+
+void stream_converter::write_ready() {
+  while (true) {
+    batch_ptr b;
+    {
+      scoped_lock lk(m_);
+      map<size_t, batch_ptr>::iterator it = done_.find(next_write_);
+      if (it == done_.end()) {
+        return;
+      }
+      b = it->second;
+      done_.erase(it);
+      ++next_write_;
+    }
+    cout.write(b->output.data(), b->output.size());
+    cerr << b->error_output;
+    errors_ += b->errors;
+  }
+}
+
+void stream_converter::worker_loop(size_t id) {
+  datum_to_fv_converter conv;
+  fv_converter::initialize_converter(config_, conv);
+  worker_state& s = states_[id];
+
+  while (true) {
+    batch_ptr b;
+    {
+      scoped_lock lk(m_);
+      while (input_.empty() && !eof_) {
+        c_.wait(m_);
+      }
+      if (input_.empty()) {
+        return;
+      }
+      b = input_.front();
+      input_.pop_front();
+    }
+
+    convert_batch(conv, s, *b);
+
+    {
+      scoped_lock lk(m_);
+      done_[b->seq] = b;
+      c_.notify_all();
+    }
+  }
+}
+
+void stream_converter::convert_batch(datum_to_fv_converter& conv,
+                                     worker_state& s,
+                                     batch& b) {
+  ostringstream out;
+  ostringstream err;
+  for (size_t i = 0; i < b.lines.size(); ++i) {
+    size_t line_number = b.first_line + i;
+    try {
+      parse_record(s, b.lines[i], line_number);
+      conv.convert(s.d, s.fv);
+    } catch (const jubatus::exception::jubatus_exception& e) {
+      err << b.source << ":" << line_number << ": "
+          << e.diagnostic_information(true) << endl;
+      ++b.errors;
+      continue;
+    } catch (const std::exception& e) {
+      err << b.source << ":" << line_number << ": " << e.what() << endl;
+      ++b.errors;
+      continue;
+    }
+
+    write_record(s, out);
+
+    if (options_.summary) {
+      ++s.records;
+      for (size_t j = 0; j < s.fv.size(); ++j) {
+        ++s.features[s.fv[j].first];
+      }
+    }
+  }
+  b.lines.clear();
+  b.output = out.str();
+  b.error_output = err.str();
+}
+
+void stream_converter::parse_record(worker_state& s,
+                                    const string& line,
+                                    size_t line_number) {
+  s.label.clear();
+  if (options_.input_format == "libsvm") {
+    fv_converter::libsvm_converter::convert(
+        line.data(), line.data() + line.size(), s.d, s.label, line_number);
+  } else if (options_.input_format == "datum") {
+    s.d = datum();
+    istringstream iss(line);
+    iss >> pfi::text::json::via_json(s.d);
+  } else {
+    s.d.string_values_.clear();
+    s.d.num_values_.clear();
+    s.json_conv.convert(line, s.d);
+  }
+}
+
+void stream_converter::write_record(worker_state& s, ostream& out) {
+  const sfv_t& fv = s.fv;
+  if (options_.output_format == "msgpack") {
+    msgpack::sbuffer sbuf;
+    msgpack::pack(sbuf, fv);
+    out.write(sbuf.data(), sbuf.size());
+
+  } else if (options_.output_format == "libsvm") {
+    // feature names are hashed into indices so that workers need no
+    // shared dictionary; colliding features are summed up
+    s.indexed.clear();
+    for (size_t i = 0; i < fv.size(); ++i) {
+      uint64_t index = hash_util::calc_string_hash(fv[i].first)
+          % LIBSVM_INDEX_SIZE + 1;
+      s.indexed.push_back(make_pair(index, fv[i].second));
+    }
+    sort(s.indexed.begin(), s.indexed.end());
+    out << (s.label.empty() ? "0" : s.label);
+    for (size_t i = 0; i < s.indexed.size(); ++i) {
+      float v = s.indexed[i].second;
+      while (i + 1 < s.indexed.size()
+             && s.indexed[i + 1].first == s.indexed[i].first) {
+        v += s.indexed[++i].second;
+      }
+      out << ' ' << s.indexed[i].first << ':' << v;
+    }
+    out << '\n';
+
+  } else {
+    out << '{';
+    for (size_t i = 0; i < fv.size(); ++i) {
+      if (i > 0) {
+        out << ", ";
+      }
+      write_json_string(fv[i].first, out);
+      out << ": " << fv[i].second;
+    }
+    out << "}\n";
+  }
+}
+
+void stream_converter::print_summary(ostream& out) const {
+  feature_count_t features;
+  uint64_t records = 0;
+  for (size_t i = 0; i < states_.size(); ++i) {
+    records += states_[i].records;
+    for (feature_count_t::const_iterator it = states_[i].features.begin();
+         it != states_[i].features.end(); ++it) {
+      features[it->first] += it->second;
+    }
+  }
+
+  // rule name -> (occurrences, distinct features)
+  map<string, pair<uint64_t, uint64_t> > rules;
+  vector<pair<string, uint64_t> > ranking;
+  for (feature_count_t::const_iterator it = features.begin();
+       it != features.end(); ++it) {
+    pair<uint64_t, uint64_t>& r = rules[get_rule_name(it->first)];
+    r.first += it->second;
+    ++r.second;
+    ranking.push_back(*it);
+  }
+
+  out << "records: " << records << "\tskipped: " << errors_
+      << "\tdistinct features: " << features.size() << endl;
+  out << "rule\toccurrences\tdistinct" << endl;
+  for (map<string, pair<uint64_t, uint64_t> >::const_iterator it = rules.begin();
+       it != rules.end(); ++it) {
+    out << it->first << "\t" << it->second.first << "\t"
+        << it->second.second << endl;
+  }
+
+  size_t top = min(options_.top, ranking.size());
+  partial_sort(ranking.begin(), ranking.begin() + top, ranking.end(),
+               compare_count);
+  out << "top " << top << " features:" << endl;
+  for (size_t i = 0; i < top; ++i) {
+    out << ranking[i].second << "\t" << ranking[i].first << endl;
+  }
+}
+
+}
+
+size_t run_stream(const converter_config& config,
+                  const stream_options& options,
+                  const vector<string>& files) {
+  stream_converter conv(config, options);
+  return conv.run(files);
+}
+
+}
+}
@@ -0,0 +1,49 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace jubatus {
+namespace fv_converter {
+struct converter_config;
+}
+
+namespace jubaconv {
+
+struct stream_options {
+  std::string input_format;   // json, datum or libsvm; one record per line
+  std::string output_format;  // fv (json-lines), msgpack or libsvm
+  int threads;
+  size_t batch_size;
+  bool summary;
+  size_t top;
+};
+
+// Converts newline-delimited records read from files (stdin when empty)
+// with N worker threads, and writes results to stdout in input order.
+// Malformed records are reported to stderr and skipped.
+// Returns the number of skipped records.
+size_t run_stream(const fv_converter::converter_config& config,
+                  const stream_options& options,
+                  const std::vector<std::string>& files);
+
+}
+}
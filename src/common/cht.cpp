@@ -96,6 +96,45 @@ bool cht::find(const std::string& key, std::vector<std::pair<std::string,int> >&
   return !hlist.size();
 }
 
+bool cht::find(const std::vector<std::string>& keys,
+               std::vector<std::vector<std::pair<std::string,int> > >& out, size_t n)
+{
+  out.clear();
+  out.resize(keys.size());
+  if (keys.empty()) {
+    return false;
+  }
+  std::vector<std::string> hlist;
+  if (!get_hashlist_(keys[0], hlist)) {
+    throw JUBATUS_EXCEPTION(not_found(keys[0]));
+  }
+  std::string path;
+  build_actor_path(path, type_, name_);
+  path += "/cht";
+
+  std::vector<std::pair<std::string,int> > nodes(hlist.size());
+  std::vector<bool> read(hlist.size(), false);
+  for (size_t k = 0; k < keys.size(); ++k) {
+    std::string hash = make_hash(keys[k]);
+    std::vector<std::string>::iterator node0 = std::lower_bound(hlist.begin(), hlist.end(), hash);
+    size_t idx = int(node0 - hlist.begin()) % hlist.size();
+    for (size_t i = 0; i < n; ++i) {
+      if (!read[idx]) {
+        std::string loc;
+        if (!lock_service_->read(path + "/" + hlist[idx], loc)) {
+          throw JUBATUS_EXCEPTION(not_found(path));
+        }
+        revert(loc, nodes[idx].first, nodes[idx].second);
+        read[idx] = true;
+      }
+      out[k].push_back(nodes[idx]);
+      idx++;
+      idx %= hlist.size();
+    }
+  }
+  return !hlist.size();
+}
+
 std::pair<std::string,int> cht::find_predecessor(const std::string& host, int port)
 {
   return find_predecessor(build_loc_str(host, port));
@@ -53,6 +53,9 @@ public:
   // find(hash)    :: key -> [node] where  hash(node0) <= hash(key) < hash(node1) < hash(node2) < ...
   bool find(const std::string& host, int port, std::vector<std::pair<std::string,int> >&, size_t);
   bool find(const std::string&, std::vector<std::pair<std::string,int> >&, size_t);
+  // finds nodes of each key, reading the list of nodes and their locations once
+  bool find(const std::vector<std::string>& keys,
+            std::vector<std::vector<std::pair<std::string,int> > >&, size_t);
 
   std::pair<std::string,int> find_predecessor(const std::string& host, int port);
   std::pair<std::string,int> find_predecessor(const std::string&);
@@ -15,7 +15,9 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <map>
 #include <gtest/gtest.h>
+#include <pficommon/lang/cast.h>
 #include "cht.hpp"
 
 using namespace std;
@@ -23,6 +25,68 @@ using namespace std;
 namespace jubatus {
 namespace common {
 
+namespace {
+
+// keeps nodes in memory, and counts lists and reads of nodes
+class memory_lock_service : public lock_service {
+public:
+  memory_lock_service() : list_num(0), read_num(0) {}
+
+  void force_close() {}
+  void create(const string& path, const string& payload, bool) {
+    nodes_[path] = payload;
+  }
+  void remove(const string& path) {
+    nodes_.erase(path);
+  }
+  bool exists(const string& path) {
+    return nodes_.count(path) > 0;
+  }
+  bool bind_watcher(const string&, pfi::lang::function<void(int,int,string)>&) {
+    return false;
+  }
+  void create_seq(const string&, string&) {}
+  uint64_t create_id(const string&, uint32_t) {
+    return 0;
+  }
+  void list(const string& path, vector<string>& out) {
+    ++list_num;
+    out.clear();
+    const string prefix = path + "/";
+    for (map<string, string>::const_iterator it = nodes_.lower_bound(prefix);
+         it != nodes_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+      out.push_back(it->first.substr(prefix.size()));
+    }
+  }
+  void hd_list(const string&, string&) {}
+  bool read(const string& path, string& out) {
+    ++read_num;
+    map<string, string>::const_iterator it = nodes_.find(path);
+    if (it == nodes_.end()) {
+      return false;
+    }
+    out = it->second;
+    return true;
+  }
+  void push_cleanup(pfi::lang::function<void()>&) {}
+  void run_cleanup() {}
+  const string& get_hosts() const {
+    return hosts_;
+  }
+  const string type() const {
+    return "memory";
+  }
+
+  size_t list_num;
+  size_t read_num;
+
+private:
+  map<string, string> nodes_;
+  string hosts_;
+};
+
+}
+
 TEST(cht, make_hash) {
   string hash = make_hash("hage");
   string hash2 = make_hash("hage");
@@ -31,5 +95,30 @@ TEST(cht, make_hash) {
   ASSERT_NE(hash, hash3);
 }
 
+TEST(cht, find_keys) {
+  memory_lock_service* ls = new memory_lock_service;
+  cht ht(cshared_ptr<lock_service>(ls), "test", "name");
+  ht.register_node("192.168.0.1", 9199);
+  ht.register_node("192.168.0.2", 9199);
+  ht.register_node("192.168.0.3", 9199);
+
+  vector<string> keys;
+  for (size_t i = 0; i < 100; ++i) {
+    keys.push_back("key" + pfi::lang::lexical_cast<string>(i));
+  }
+  vector<vector<pair<string, int> > > nodes;
+  ht.find(keys, nodes, 2);
+  // the list and the locations of nodes are read once
+  EXPECT_EQ(1u, ls->list_num);
+  EXPECT_GE(3u * NUM_VSERV, ls->read_num);
+
+  ASSERT_EQ(keys.size(), nodes.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    vector<pair<string, int> > expected;
+    ht.find(keys[i], expected, 2);
+    EXPECT_TRUE(expected == nodes[i]);
+  }
+}
+
 } // common
 } // jubatus
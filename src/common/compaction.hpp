@@ -0,0 +1,37 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+
+namespace jubatus {
+
+// Structures that leave stale entries behind on updates (tombstones, garbage
+// or unsorted buffers) are rebuilt when the stale entries exceed both a fixed
+// number, so that small structures are not rebuilt on every update, and a
+// part of the live entries, so that each rebuild is paid by as many updates
+// as it costs.
+const uint64_t MIN_COMPACTION_SIZE = 1024;
+
+inline bool needs_compaction(uint64_t stale_num, uint64_t live_num,
+                             uint64_t divisor = 4) {
+  return stale_num > std::max(MIN_COMPACTION_SIZE, live_num / divisor);
+}
+
+} // jubatus
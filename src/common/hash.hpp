@@ -33,6 +33,16 @@ public:
     }
     return hash;
   }
+
+  // finalizer of SplitMix64
+  static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+  }
 };
 
 } // jubatus
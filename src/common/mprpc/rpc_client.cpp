@@ -118,6 +118,21 @@ void rpc_mclient::send_all(const msgpack::sbuffer& buf)
   event_base_dispatch(evbase_);
 }
 
+void rpc_mclient::send_each(const vector<shared_ptr<msgpack::sbuffer> >& bufs)
+{
+  struct timeval timeout;
+  timeout.tv_sec = timeout_sec_;
+  timeout.tv_usec = 0;
+
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    if (clients_[i]->is_closed())
+      continue;
+    clients_[i]->set_send_buffer(*bufs[i]);
+    clients_[i]->register_write(timeout);
+  }
+  event_base_dispatch(evbase_);
+}
+
 rpc_result_object rpc_mclient::wait(const std::string& method)
 {
   rpc_result_object result;
@@ -143,6 +143,11 @@ public:
   template <typename A0>
   rpc_result_object call(const std::string&, const A0& a0);
 
+  // Each host is sent its own arguments, given in the order of hosts, and
+  // results are returned in the same order. An error of any host is thrown.
+  template <typename Res, typename Arr>
+  std::vector<Res> call_each(const std::string&, const std::vector<Arr>& argvs);
+
 private:
   static void readable_callback(int fd, short int events, void* arg);
   static void writable_callback(int fd, short int events, void* arg);
@@ -154,6 +159,7 @@ private:
   void register_fd_writable_(const msgpack::sbuffer&);
 
   void send_all(const msgpack::sbuffer& buf);
+  void send_each(const std::vector<pfi::lang::shared_ptr<msgpack::sbuffer> >& bufs);
 
   rpc_result_object wait(const std::string& m);
 
@@ -310,6 +316,41 @@ rpc_result_object rpc_mclient::call(const std::string& m, const A0& a0)
   return wait(m);
 }
 
+template <typename Res, typename Arr>
+std::vector<Res> rpc_mclient::call_each(const std::string& m, const std::vector<Arr>& argvs)
+{
+  if (argvs.size() != clients_.size())
+    throw JUBATUS_EXCEPTION(rpc_call_error()
+        << error_method(m)
+        << jubatus::exception::error_message("arguments are not given for each host"));
+
+  std::vector<pfi::lang::shared_ptr<msgpack::sbuffer> > bufs;
+  for (size_t i = 0; i < argvs.size(); ++i) {
+    pfi::lang::shared_ptr<msgpack::sbuffer> sbuf(new msgpack::sbuffer);
+    msgpack::type::tuple<uint8_t,uint32_t,std::string,Arr> rpc_request(0, 0xDEADBEEF, m, argvs[i]);
+    msgpack::pack(sbuf.get(), rpc_request);
+    bufs.push_back(sbuf);
+  }
+  send_each(bufs);
+
+  rpc_result_object result = wait(m);
+  if (result.has_error())
+    throw JUBATUS_EXCEPTION(rpc_call_error()
+        << error_method(m)
+        << error_multi_rpc(result.error));
+
+  std::vector<Res> ret;
+  try {
+    for (size_t i = 0; i < result.response.size(); ++i)
+      ret.push_back(result.response[i].as<Res>());
+  } catch (const msgpack::type_error&) {
+    throw JUBATUS_EXCEPTION(rpc_type_error()
+        << error_method(m)
+        << jubatus::exception::error_message("recv object cannot convert"));
+  }
+  return ret;
+}
+
 } // mprpc
 } // common
 } // jubatus
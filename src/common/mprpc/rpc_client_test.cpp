@@ -237,6 +237,21 @@ TEST(rpc_mclient, small)
     EXPECT_EQ(200 * kServerSize, r.value->size());
   }
 
+  {
+    // each server is sent its own argument
+    vector<msgpack::type::tuple<int> > argvs;
+    for (size_t i = 0; i < kServerSize; i++)
+      argvs.push_back(msgpack::type::tuple<int>(i));
+    vector<int> r = cli.call_each<int>("test_twice", argvs);
+    ASSERT_EQ(kServerSize, r.size());
+    for (size_t i = 0; i < kServerSize; i++)
+      EXPECT_EQ(static_cast<int>(i * 2), r[i]);
+
+    argvs.pop_back();
+    EXPECT_THROW(cli.call_each<int>("test_twice", argvs),
+        jubatus::common::mprpc::rpc_call_error);
+  }
+
   { // server_error: method_not_found
     //ASSERT_THROW(cli.call("undefined_method", 1, function<int(int,int)>(&jubatus::framework::add<int>)),
     //  jubatus::common::mprpc::rpc_no_result);
@@ -0,0 +1,178 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include "thread_pool.hpp"
+
+#include <string>
+#include <unistd.h>
+#include <pficommon/concurrent/lock.h>
+#include <pficommon/lang/bind.h>
+#include "exception.hpp"
+
+using namespace std;
+using pfi::concurrent::scoped_lock;
+
+namespace jubatus {
+namespace common {
+
+struct thread_pool::batch {
+  size_t remaining;
+  bool failed;
+  string error;
+  pfi::concurrent::condition done;
+};
+
+thread_pool::thread_pool(size_t thread_num)
+    : stopping_(false) {
+  for (size_t i = 0; i < thread_num; ++i) {
+    pfi::lang::shared_ptr<pfi::concurrent::thread> t(
+        new pfi::concurrent::thread(
+            pfi::lang::bind(&thread_pool::worker_loop, this)));
+    t->start();
+    workers_.push_back(t);
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    scoped_lock lk(m_);
+    stopping_ = true;
+    c_.notify_all();
+  }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i]->join();
+  }
+}
+
+void thread_pool::run(const vector<task_t>& tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+
+  batch b;
+  b.remaining = tasks.size();
+  b.failed = false;
+  job first = { &tasks[0], &b };
+  if (!workers_.empty()) {
+    scoped_lock lk(m_);
+    for (size_t i = 1; i < tasks.size(); ++i) {
+      job j = { &tasks[i], &b };
+      queue_.push_back(j);
+    }
+    c_.notify_all();
+  }
+  execute(first);
+
+  if (workers_.empty()) {
+    for (size_t i = 1; i < tasks.size(); ++i) {
+      job j = { &tasks[i], &b };
+      execute(j);
+    }
+  }
+
+  // help the workers until all tasks of this batch are done
+  while (true) {
+    job j;
+    {
+      scoped_lock lk(m_);
+      if (b.remaining == 0) {
+        break;
+      }
+      if (queue_.empty()) {
+        b.done.wait(m_);
+        continue;
+      }
+      j = queue_.front();
+      queue_.pop_front();
+    }
+    execute(j);
+  }
+
+  if (b.failed) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "task in thread_pool failed: " + b.error));
+  }
+}
+
+void thread_pool::run_ranges(size_t size, size_t min_range_size,
+                             const range_task_t& task) {
+  size_t range_num = min(workers_.size() + 1,
+                         max<size_t>(1, size / max<size_t>(1, min_range_size)));
+  if (range_num == 1) {
+    if (size > 0) {
+      task(0, size);
+    }
+    return;
+  }
+
+  vector<task_t> tasks;
+  for (size_t i = 0; i < range_num; ++i) {
+    tasks.push_back(pfi::lang::bind(task, size * i / range_num,
+                                    size * (i + 1) / range_num));
+  }
+  run(tasks);
+}
+
+void thread_pool::worker_loop() {
+  while (true) {
+    job j;
+    {
+      scoped_lock lk(m_);
+      while (queue_.empty() && !stopping_) {
+        c_.wait(m_);
+      }
+      if (queue_.empty()) {
+        return;
+      }
+      j = queue_.front();
+      queue_.pop_front();
+    }
+    execute(j);
+  }
+}
+
+void thread_pool::execute(const job& j) {
+  string error;
+  bool failed = false;
+  try {
+    (*j.task)();
+  } catch (const std::exception& e) {
+    failed = true;
+    error = e.what();
+  } catch (...) {
+    failed = true;
+    error = "unknown exception";
+  }
+
+  scoped_lock lk(m_);
+  if (failed && !j.owner->failed) {
+    j.owner->failed = true;
+    j.owner->error = error;
+  }
+  if (--j.owner->remaining == 0) {
+    j.owner->done.notify_all();
+  }
+}
+
+thread_pool& thread_pool::get_shared() {
+  static thread_pool pool(max(1L, sysconf(_SC_NPROCESSORS_ONLN)) - 1);
+  return pool;
+}
+
+}
+}
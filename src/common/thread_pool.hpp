@@ -0,0 +1,79 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <pficommon/concurrent/condition.h>
+#include <pficommon/concurrent/mutex.h>
+#include <pficommon/concurrent/thread.h>
+#include <pficommon/lang/function.h>
+#include <pficommon/lang/noncopyable.h>
+#include <pficommon/lang/shared_ptr.h>
+
+namespace jubatus {
+namespace common {
+
+// A fixed set of worker threads shared by parallel queries.
+// run() executes tasks on the workers and on the calling thread, and returns
+// when all of them are done. Tasks of concurrent callers share the queue, so
+// a caller never waits for a busy pool without working itself.
+class thread_pool : pfi::lang::noncopyable {
+ public:
+  typedef pfi::lang::function<void()> task_t;
+  typedef pfi::lang::function<void(size_t, size_t)> range_task_t;
+
+  explicit thread_pool(size_t thread_num);
+  ~thread_pool();
+
+  size_t thread_num() const {
+    return workers_.size();
+  }
+
+  // An exception thrown by a task is rethrown as runtime_error after all
+  // tasks are done.
+  void run(const std::vector<task_t>& tasks);
+
+  // Splits [0, size) into ranges of at least min_range_size elements, at
+  // most one for each thread including the caller, and runs
+  // task(begin, end) for each of them.
+  void run_ranges(size_t size, size_t min_range_size, const range_task_t& task);
+
+  // pool of (number of online CPUs - 1) threads, created on first use
+  static thread_pool& get_shared();
+
+ private:
+  struct batch;
+  struct job {
+    const task_t* task;
+    batch* owner;
+  };
+
+  void worker_loop();
+  void execute(const job& j);
+
+  pfi::concurrent::mutex m_;
+  pfi::concurrent::condition c_;
+  std::deque<job> queue_;
+  bool stopping_;
+  std::vector<pfi::lang::shared_ptr<pfi::concurrent::thread> > workers_;
+};
+
+}
+}
@@ -0,0 +1,104 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+#include <pficommon/lang/bind.h>
+#include "exception.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace common {
+
+namespace {
+
+void fill(vector<int>* v, size_t begin, size_t end, int value) {
+  for (size_t i = begin; i < end; ++i) {
+    (*v)[i] = value;
+  }
+}
+
+void fail() {
+  throw std::runtime_error("error");
+}
+
+void run_tasks(thread_pool& pool) {
+  vector<int> v(1000);
+  vector<thread_pool::task_t> tasks;
+  for (size_t i = 0; i < 10; ++i) {
+    tasks.push_back(pfi::lang::bind(&fill, &v, i * 100, (i + 1) * 100,
+                                    static_cast<int>(i)));
+  }
+  pool.run(tasks);
+  for (size_t i = 0; i < v.size(); ++i) {
+    ASSERT_EQ(static_cast<int>(i / 100), v[i]);
+  }
+}
+
+void count_range(vector<int>* v, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    ++(*v)[i];
+  }
+}
+
+}
+
+TEST(thread_pool, run) {
+  thread_pool pool(3);
+  EXPECT_EQ(3u, pool.thread_num());
+  for (size_t i = 0; i < 100; ++i) {
+    run_tasks(pool);
+  }
+  pool.run(vector<thread_pool::task_t>());
+}
+
+TEST(thread_pool, no_thread) {
+  thread_pool pool(0);
+  run_tasks(pool);
+}
+
+TEST(thread_pool, shared) {
+  run_tasks(thread_pool::get_shared());
+}
+
+TEST(thread_pool, run_ranges) {
+  thread_pool pool(3);
+  for (size_t size = 0; size < 100; ++size) {
+    vector<int> v(size);
+    pool.run_ranges(size, 8, pfi::lang::bind(&count_range, &v,
+                                             pfi::lang::_1, pfi::lang::_2));
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(1, v[i]) << size;
+    }
+  }
+}
+
+TEST(thread_pool, exception) {
+  thread_pool pool(2);
+  vector<thread_pool::task_t> tasks;
+  for (size_t i = 0; i < 4; ++i) {
+    tasks.push_back(&fail);
+  }
+  EXPECT_THROW(pool.run(tasks), jubatus::exception::runtime_error);
+  run_tasks(pool);
+}
+
+}
+}
@@ -17,28 +17,100 @@
 
 #include "vector_util.hpp"
 #include <algorithm>
+#include <vector>
+#include "hash.hpp"
 
 namespace jubatus {
 
 using namespace std;
 
+namespace {
+
+// tables up to this size are kept on the stack
+const size_t LOCAL_TABLE_SIZE = 2048;
+
+const uint32_t EMPTY_SLOT = 0;
+
+size_t table_size_for(size_t n) {
+  // keep the load factor under 1/2
+  size_t size = 16;
+  while (size < n * 2) {
+    size <<= 1;
+  }
+  return size;
+}
+
+// Open addressing with linear probing. A slot keeps the 32 bit hash of the
+// feature and its position in sfv + 1, and strings are compared only when
+// the hashes are the same.
+void merge_with_table(sfv_t& sfv, uint32_t* slots, uint32_t* hashes,
+                      size_t table_size) {
+  const size_t mask = table_size - 1;
+  size_t num_unique = 0;
+  for (size_t i = 0; i < sfv.size(); ++i) {
+    const uint32_t hash =
+        static_cast<uint32_t>(hash_util::calc_string_hash(sfv[i].first));
+    size_t pos = hash & mask;
+    while (true) {
+      const uint32_t slot = slots[pos];
+      if (slot == EMPTY_SLOT) {
+        if (num_unique != i) {
+          sfv[num_unique].first.swap(sfv[i].first);
+          sfv[num_unique].second = sfv[i].second;
+        }
+        slots[pos] = static_cast<uint32_t>(num_unique + 1);
+        hashes[pos] = hash;
+        ++num_unique;
+        break;
+      }
+      if (hashes[pos] == hash && sfv[slot - 1].first == sfv[i].first) {
+        sfv[slot - 1].second += sfv[i].second;
+        break;
+      }
+      pos = (pos + 1) & mask;
+    }
+  }
+  sfv.resize(num_unique);
+}
+
+bool less_column_id(const pair<uint64_t, float>& lhs,
+                    const pair<uint64_t, float>& rhs) {
+  return lhs.first < rhs.first;
+}
+
+}
+
+void merge_duplicates(sfv_t& sfv){
+  if (sfv.size() < 2) return;
+  const size_t table_size = table_size_for(sfv.size());
+  if (table_size <= LOCAL_TABLE_SIZE) {
+    uint32_t slots[LOCAL_TABLE_SIZE];
+    uint32_t hashes[LOCAL_TABLE_SIZE];
+    fill(slots, slots + table_size, EMPTY_SLOT);
+    merge_with_table(sfv, slots, hashes, table_size);
+  } else {
+    vector<uint32_t> slots(table_size, EMPTY_SLOT);
+    vector<uint32_t> hashes(table_size);
+    merge_with_table(sfv, &slots[0], &hashes[0], table_size);
+  }
+}
+
 void sort_and_merge(sfv_t& sfv){
-  if (sfv.size() == 0) return;
+  merge_duplicates(sfv);
   sort(sfv.begin(), sfv.end());
-  sfv_t ret_sfv;
-  const string* prev = &sfv[0].first;
-  float val = sfv[0].second;
-  for (size_t i = 1; i < sfv.size(); ++i){
-    if (sfv[i].first == *prev){
-      val += sfv[i].second;
+}
+
+void sort_and_keep_last(sfvi_t& columns){
+  stable_sort(columns.begin(), columns.end(), less_column_id);
+  size_t num = 0;
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (num > 0 && columns[num - 1].first == columns[i].first) {
+      columns[num - 1].second = columns[i].second;
     } else {
-      ret_sfv.push_back(make_pair(*prev, val));
-      prev = &sfv[i].first;
-      val = sfv[i].second;
+      columns[num++] = columns[i];
     }
   }
-  ret_sfv.push_back(make_pair(*prev, val));
-  sfv.swap(ret_sfv);
+  columns.resize(num);
 }
 
 }
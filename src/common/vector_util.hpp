@@ -21,6 +21,16 @@
 
 namespace jubatus {
 
+// Merges values of duplicated features in place.
+// The first occurrence of each feature is kept, so the order of the
+// remaining features is the same as the input.
+void merge_duplicates(sfv_t& sfv);
+
+// Merges values of duplicated features and sorts the result by feature.
+// Use merge_duplicates when the order is not needed.
 void sort_and_merge(sfv_t& sfv);
 
+// Sorts columns by id and keeps the last value of duplicated columns.
+void sort_and_keep_last(sfvi_t& columns);
+
 }
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <pficommon/lang/cast.h>
 #include "vector_util.hpp"
 
 namespace jubatus {
@@ -25,4 +26,58 @@ TEST(sort_and_merge, trivial) {
 
 }
 
+TEST(sort_and_merge, many_features) {
+  sfv_t v;
+  for (int i = 0; i < 3000; ++i) {
+    v.push_back(make_pair(pfi::lang::lexical_cast<string>(i % 1500), 1.0));
+  }
+  sort_and_merge(v);
+  ASSERT_EQ(1500u, v.size());
+  for (size_t i = 0; i < v.size(); ++i) {
+    EXPECT_EQ(2.0, v[i].second);
+    if (i > 0) {
+      EXPECT_LT(v[i - 1].first, v[i].first);
+    }
+  }
+}
+
+TEST(merge_duplicates, empty) {
+  sfv_t v;
+  merge_duplicates(v);
+  EXPECT_TRUE(v.empty());
+}
+
+TEST(merge_duplicates, keep_order) {
+  sfv_t v;
+  v.push_back(make_pair("f4", 1.0));
+  v.push_back(make_pair("f2", 2.0));
+  v.push_back(make_pair("f4", 3.0));
+  v.push_back(make_pair("f1", 4.0));
+  v.push_back(make_pair("f2", 5.0));
+  merge_duplicates(v);
+  ASSERT_EQ(3u, v.size());
+  EXPECT_EQ("f4", v[0].first);
+  EXPECT_EQ(4.0,  v[0].second);
+  EXPECT_EQ("f2", v[1].first);
+  EXPECT_EQ(7.0,  v[1].second);
+  EXPECT_EQ("f1", v[2].first);
+  EXPECT_EQ(4.0,  v[2].second);
+}
+
+TEST(sort_and_keep_last, keep_last_value) {
+  sfvi_t v;
+  v.push_back(make_pair(4u, 1.0));
+  v.push_back(make_pair(2u, 2.0));
+  v.push_back(make_pair(4u, 3.0));
+  v.push_back(make_pair(1u, 4.0));
+  sort_and_keep_last(v);
+  ASSERT_EQ(3u, v.size());
+  EXPECT_EQ(1u,  v[0].first);
+  EXPECT_EQ(4.0, v[0].second);
+  EXPECT_EQ(2u,  v[1].first);
+  EXPECT_EQ(2.0, v[1].second);
+  EXPECT_EQ(4u,  v[2].first);
+  EXPECT_EQ(3.0, v[2].second);
+}
+
 }
@@ -0,0 +1,165 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2011,2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "../common/exception.hpp"
+#include "../fv_converter/datum.hpp"
+
+namespace jubatus {
+namespace framework {
+
+// Helpers for the datum messages defined in each engine's IDL.
+// Every engine generates its own jubatus::datum and jubatus::datum_batch, so
+// the helpers are templates over the generated types.
+//
+// datum_batch is a columnar encoding of a list of datums: feature keys are
+// stored once in `keys` and referred to by index, and the values of all rows
+// are concatenated into column arrays.  Row i owns the elements
+// [string_offsets[i], string_offsets[i + 1]) of string_keys/string_values and
+// likewise for the num columns.  Both offset arrays have (number of rows + 1)
+// elements, or are empty for an empty batch.
+
+// Copies an IDL datum into the internal datum and back.  Both have the same
+// layout, so the msgpack round-trip of convert<From, To> is not needed.
+template <class Datum>
+void convert_datum(const Datum& from, fv_converter::datum& to) {
+  to.string_values_.assign(from.string_values.begin(),
+                           from.string_values.end());
+  to.num_values_.assign(from.num_values.begin(), from.num_values.end());
+}
+
+template <class Datum>
+void convert_datum(const fv_converter::datum& from, Datum& to) {
+  to.string_values.assign(from.string_values_.begin(),
+                          from.string_values_.end());
+  to.num_values.assign(from.num_values_.begin(), from.num_values_.end());
+}
+
+namespace detail {
+
+inline void throw_invalid_datum_batch(const std::string& msg) {
+  throw JUBATUS_EXCEPTION(
+      jubatus::exception::runtime_error("invalid datum_batch: " + msg));
+}
+
+inline size_t check_datum_batch_column(const std::vector<uint32_t>& offsets,
+                                       size_t num_keys,
+                                       size_t num_values,
+                                       const char* column) {
+  if (offsets.empty()) {
+    if (num_keys != 0 || num_values != 0) {
+      throw_invalid_datum_batch(
+          std::string(column) + " values are given without offsets");
+    }
+    return 0;
+  }
+  if (num_keys != num_values) {
+    throw_invalid_datum_batch(
+        std::string(column) + " keys and values differ in size");
+  }
+  if (offsets.front() != 0 || offsets.back() != num_values) {
+    throw_invalid_datum_batch(
+        std::string(column) + " offsets do not cover the values");
+  }
+  for (size_t i = 1; i < offsets.size(); ++i) {
+    if (offsets[i] < offsets[i - 1]) {
+      throw_invalid_datum_batch(
+          std::string(column) + " offsets are not sorted");
+    }
+  }
+  return offsets.size() - 1;
+}
+
+template <class Index>
+void check_datum_batch_keys(const std::vector<Index>& keys,
+                            size_t num_dict_keys,
+                            const char* column) {
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i] >= num_dict_keys) {
+      std::ostringstream msg;
+      msg << column << " key index " << keys[i] << " is out of range";
+      throw_invalid_datum_batch(msg.str());
+    }
+  }
+}
+
+}
+
+// Validates a datum_batch and returns the number of rows in it.
+// Throws runtime_error when the columns are inconsistent, so that
+// decode_datum_batch can index them without further checks.
+template <class Batch>
+size_t datum_batch_size(const Batch& batch) {
+  size_t num_dict_keys = batch.keys.size();
+  size_t string_rows = detail::check_datum_batch_column(
+      batch.string_offsets, batch.string_keys.size(),
+      batch.string_values.size(), "string");
+  size_t num_rows = detail::check_datum_batch_column(
+      batch.num_offsets, batch.num_keys.size(),
+      batch.num_values.size(), "num");
+  detail::check_datum_batch_keys(batch.string_keys, num_dict_keys, "string");
+  detail::check_datum_batch_keys(batch.num_keys, num_dict_keys, "num");
+
+  if (batch.string_offsets.empty()) {
+    return num_rows;
+  } else if (batch.num_offsets.empty()) {
+    return string_rows;
+  } else if (string_rows != num_rows) {
+    detail::throw_invalid_datum_batch(
+        "string and num columns have different number of rows");
+  }
+  return string_rows;
+}
+
+// Decodes the row-th datum of a batch checked by datum_batch_size.
+// The datum is overwritten, so the same instance can be reused for all rows.
+template <class Batch>
+void decode_datum_batch(const Batch& batch,
+                        size_t row,
+                        fv_converter::datum& to) {
+  to.string_values_.clear();
+  if (!batch.string_offsets.empty()) {
+    size_t begin = batch.string_offsets[row];
+    size_t end = batch.string_offsets[row + 1];
+    to.string_values_.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      to.string_values_.push_back(
+          std::make_pair(batch.keys[batch.string_keys[i]],
+                         batch.string_values[i]));
+    }
+  }
+
+  to.num_values_.clear();
+  if (!batch.num_offsets.empty()) {
+    size_t begin = batch.num_offsets[row];
+    size_t end = batch.num_offsets[row + 1];
+    to.num_values_.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      to.num_values_.push_back(
+          std::make_pair(batch.keys[batch.num_keys[i]], batch.num_values[i]));
+    }
+  }
+}
+
+}
+}
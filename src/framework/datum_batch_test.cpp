@@ -0,0 +1,173 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <gtest/gtest.h>
+
+#include "datum_batch.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace jubatus {
+namespace framework {
+
+// Same layout as the datum and datum_batch messages generated from IDLs
+struct test_datum {
+  vector<pair<string, string> > string_values;
+  vector<pair<string, double> > num_values;
+};
+
+struct test_datum_batch {
+  vector<string> keys;
+  vector<uint32_t> string_offsets;
+  vector<uint32_t> string_keys;
+  vector<string> string_values;
+  vector<uint32_t> num_offsets;
+  vector<uint32_t> num_keys;
+  vector<double> num_values;
+};
+
+namespace {
+
+test_datum_batch make_batch() {
+  // row 0: {"name": "abc", "age": 10}
+  // row 1: {"age": 20}
+  // row 2: {"name": "def", "name": "ghi"}
+  test_datum_batch b;
+  b.keys.push_back("name");
+  b.keys.push_back("age");
+
+  b.string_offsets.push_back(0);
+  b.string_offsets.push_back(1);
+  b.string_offsets.push_back(1);
+  b.string_offsets.push_back(3);
+  b.string_keys.push_back(0);
+  b.string_keys.push_back(0);
+  b.string_keys.push_back(0);
+  b.string_values.push_back("abc");
+  b.string_values.push_back("def");
+  b.string_values.push_back("ghi");
+
+  b.num_offsets.push_back(0);
+  b.num_offsets.push_back(1);
+  b.num_offsets.push_back(2);
+  b.num_offsets.push_back(2);
+  b.num_keys.push_back(1);
+  b.num_keys.push_back(1);
+  b.num_values.push_back(10);
+  b.num_values.push_back(20);
+  return b;
+}
+
+}
+
+TEST(convert_datum, round_trip) {
+  test_datum d;
+  d.string_values.push_back(make_pair("name", "abc"));
+  d.num_values.push_back(make_pair("age", 10.));
+
+  fv_converter::datum internal;
+  internal.num_values_.push_back(make_pair("garbage", 1.));
+  convert_datum(d, internal);
+  ASSERT_EQ(1u, internal.string_values_.size());
+  EXPECT_EQ("name", internal.string_values_[0].first);
+  EXPECT_EQ("abc", internal.string_values_[0].second);
+  ASSERT_EQ(1u, internal.num_values_.size());
+  EXPECT_EQ("age", internal.num_values_[0].first);
+  EXPECT_EQ(10., internal.num_values_[0].second);
+
+  test_datum back;
+  convert_datum(internal, back);
+  EXPECT_EQ(d.string_values, back.string_values);
+  EXPECT_EQ(d.num_values, back.num_values);
+}
+
+TEST(datum_batch, decode) {
+  test_datum_batch b = make_batch();
+  ASSERT_EQ(3u, datum_batch_size(b));
+
+  fv_converter::datum d;
+  decode_datum_batch(b, 0, d);
+  ASSERT_EQ(1u, d.string_values_.size());
+  EXPECT_EQ(make_pair(string("name"), string("abc")), d.string_values_[0]);
+  ASSERT_EQ(1u, d.num_values_.size());
+  EXPECT_EQ(make_pair(string("age"), 10.), d.num_values_[0]);
+
+  decode_datum_batch(b, 1, d);
+  EXPECT_TRUE(d.string_values_.empty());
+  ASSERT_EQ(1u, d.num_values_.size());
+  EXPECT_EQ(make_pair(string("age"), 20.), d.num_values_[0]);
+
+  decode_datum_batch(b, 2, d);
+  ASSERT_EQ(2u, d.string_values_.size());
+  EXPECT_EQ(make_pair(string("name"), string("def")), d.string_values_[0]);
+  EXPECT_EQ(make_pair(string("name"), string("ghi")), d.string_values_[1]);
+  EXPECT_TRUE(d.num_values_.empty());
+}
+
+TEST(datum_batch, unused_column) {
+  test_datum_batch b = make_batch();
+  b.string_offsets.clear();
+  b.string_keys.clear();
+  b.string_values.clear();
+  ASSERT_EQ(3u, datum_batch_size(b));
+
+  fv_converter::datum d;
+  decode_datum_batch(b, 0, d);
+  EXPECT_TRUE(d.string_values_.empty());
+  EXPECT_EQ(1u, d.num_values_.size());
+}
+
+TEST(datum_batch, empty) {
+  test_datum_batch b;
+  EXPECT_EQ(0u, datum_batch_size(b));
+}
+
+TEST(datum_batch, invalid) {
+  {
+    test_datum_batch b = make_batch();
+    b.string_keys[2] = 2;
+    EXPECT_THROW(datum_batch_size(b), jubatus::exception::runtime_error);
+  }
+  {
+    test_datum_batch b = make_batch();
+    b.num_offsets.back() = 3;
+    EXPECT_THROW(datum_batch_size(b), jubatus::exception::runtime_error);
+  }
+  {
+    test_datum_batch b = make_batch();
+    b.string_offsets[1] = 2;
+    b.string_offsets[2] = 1;
+    EXPECT_THROW(datum_batch_size(b), jubatus::exception::runtime_error);
+  }
+  {
+    test_datum_batch b = make_batch();
+    b.num_offsets.pop_back();
+    b.num_offsets.back() = 2;
+    EXPECT_THROW(datum_batch_size(b), jubatus::exception::runtime_error);
+  }
+  {
+    test_datum_batch b = make_batch();
+    b.string_values.pop_back();
+    EXPECT_THROW(datum_batch_size(b), jubatus::exception::runtime_error);
+  }
+}
+
+}
+}
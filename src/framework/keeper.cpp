@@ -101,3 +101,18 @@ void keeper::get_members_from_cht_(const std::string& name, const std::string& i
     throw JUBATUS_EXCEPTION(no_worker(name));
   }
 }
+
+void keeper::get_members_from_cht_(const std::string& name, const std::vector<std::string>& ids,
+                                   std::vector<std::vector<std::pair<std::string, int> > >& ret, size_t n)
+{
+  ret.clear();
+  pfi::concurrent::scoped_lock lk(mutex_);
+  jubatus::common::cht ht(zk_, a_.type, name);
+  ht.find(ids, ret, n);
+
+  for (size_t i = 0; i < ret.size(); ++i) {
+    if (ret[i].empty()) {
+      throw JUBATUS_EXCEPTION(no_worker(name));
+    }
+  }
+}
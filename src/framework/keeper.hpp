@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -28,9 +30,11 @@
 #include <pficommon/concurrent/lock.h>
 #include <pficommon/concurrent/rwmutex.h>
 #include <pficommon/math/random.h>
+#include <pficommon/lang/cast.h>
 
 #include "../common/lock_service.hpp"
 #include "../common/cht.hpp"
+#include "../common/exception.hpp"
 #include "../common/mprpc/rpc_client.hpp"
 #include "../common/shared_ptr.hpp"
 
@@ -111,7 +115,24 @@ class keeper : public pfi::network::mprpc::rpc_server {
       pfi::lang::bind(&keeper::template cht_proxy2<N,R, A0, A1>, this, method_name, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, agg);
     add(method_name, f);
   }
-  
+
+  // rows are grouped by the servers of their ids, so that each server is
+  // called once with all of its rows, and the servers are called in parallel
+  template <int N, typename R, typename A0>
+  void register_cht_batch(std::string method_name, pfi::lang::function<R(R,R)> agg) {
+    pfi::lang::function<R(std::string, std::vector<std::pair<std::string, A0> >)> f =
+      pfi::lang::bind(&keeper::template cht_batch_proxy1<N,R,A0>, this, method_name, pfi::lang::_1, pfi::lang::_2, agg);
+    add(method_name, f);
+  }
+  // ids are sent to the first server of each id in parallel, and the results
+  // are returned in the order of ids
+  template <int N, typename R, typename A1>
+  void register_cht_scatter(std::string method_name) {
+    pfi::lang::function<std::vector<R>(std::string, std::vector<std::string>, A1)> f =
+      pfi::lang::bind(&keeper::template cht_scatter_proxy1<N,R,A1>, this, method_name, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3);
+    add(method_name, f);
+  }
+
  private:
   template <typename R>
   R random_proxy0(const std::string& method_name, const std::string& name){
@@ -250,9 +271,111 @@ class keeper : public pfi::network::mprpc::rpc_server {
     }
   }
 
+  template <int N, typename R, typename A0>
+  R cht_batch_proxy1(const std::string& method_name, const std::string& name,
+                     const std::vector<std::pair<std::string, A0> >& rows,
+                     pfi::lang::function<R(R,R)>& agg) {
+    typedef std::vector<std::pair<std::string, A0> > batch_t;
+    typedef msgpack::type::tuple<std::string, batch_t> argv_t;
+    if (rows.empty()) {
+      return random_proxy1<R, batch_t>(method_name, name, rows);
+    }
+
+    std::vector<std::string> ids(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+      ids[i] = rows[i].first;
+    }
+    std::vector<std::vector<std::pair<std::string, int> > > members;
+    get_members_from_cht_(name, ids, members, N);
+
+    // server -> its index in list and argvs
+    std::map<std::pair<std::string, int>, size_t> servers;
+    std::vector<std::pair<std::string, int> > list;
+    std::vector<argv_t> argvs;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      for (size_t j = 0; j < members[i].size(); ++j) {
+        std::pair<std::map<std::pair<std::string, int>, size_t>::iterator, bool> it =
+            servers.insert(std::make_pair(members[i][j], list.size()));
+        if (it.second) {
+          list.push_back(members[i][j]);
+          argvs.push_back(argv_t(name, batch_t()));
+        }
+        argvs[it.first->second].a1.push_back(rows[i]);
+      }
+    }
+
+    try{
+      jubatus::common::mprpc::rpc_mclient c(list, a_.timeout);
+      std::vector<R> r = c.call_each<R>(method_name, argvs);
+      R result = r[0];
+      for (size_t i = 1; i < r.size(); ++i) {
+        result = agg(result, r[i]);
+      }
+      return result;
+    }catch(const std::exception& e){
+      LOG(ERROR) << e.what();
+      throw;
+    }
+  }
+
+  template <int N, typename R, typename A1>
+  std::vector<R> cht_scatter_proxy1(const std::string& method_name, const std::string& name,
+                                    const std::vector<std::string>& ids, const A1& a1) {
+    typedef msgpack::type::tuple<std::string, std::vector<std::string>, A1> argv_t;
+    if (ids.empty()) {
+      return random_proxy2<std::vector<R>, std::vector<std::string>, A1>(method_name, name, ids, a1);
+    }
+
+    std::vector<std::vector<std::pair<std::string, int> > > members;
+    get_members_from_cht_(name, ids, members, N);
+
+    // server -> its index in list, argvs and positions
+    std::map<std::pair<std::string, int>, size_t> servers;
+    std::vector<std::pair<std::string, int> > list;
+    std::vector<argv_t> argvs;
+    // positions of ids of each server in the request
+    std::vector<std::vector<size_t> > positions;
+    for (size_t i = 0; i < ids.size(); ++i) {
+      std::pair<std::map<std::pair<std::string, int>, size_t>::iterator, bool> it =
+          servers.insert(std::make_pair(members[i][0], list.size()));
+      if (it.second) {
+        list.push_back(members[i][0]);
+        argvs.push_back(argv_t(name, std::vector<std::string>(), a1));
+        positions.push_back(std::vector<size_t>());
+      }
+      argvs[it.first->second].a1.push_back(ids[i]);
+      positions[it.first->second].push_back(i);
+    }
+
+    try{
+      jubatus::common::mprpc::rpc_mclient c(list, a_.timeout);
+      std::vector<std::vector<R> > r = c.call_each<std::vector<R> >(method_name, argvs);
+      std::vector<R> result(ids.size());
+      for (size_t k = 0; k < r.size(); ++k) {
+        const std::vector<size_t>& pos = positions[k];
+        if (r[k].size() != pos.size()) {
+          throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+              method_name + ": " + pfi::lang::lexical_cast<std::string>(r[k].size())
+              + " results for " + pfi::lang::lexical_cast<std::string>(pos.size()) + " ids"
+              + " from " + list[k].first + ":" + pfi::lang::lexical_cast<std::string>(list[k].second)));
+        }
+        for (size_t i = 0; i < pos.size(); ++i) {
+          result[pos[i]] = r[k][i];
+        }
+      }
+      return result;
+    }catch(const std::exception& e){
+      LOG(ERROR) << e.what();
+      throw;
+    }
+  }
+
   void get_members_(const std::string& name, std::vector<std::pair<std::string, int> >& ret);
   void get_members_from_cht_(const std::string& name,const std::string& id,
                              std::vector<std::pair<std::string, int> >& ret, size_t n);
+  // members of many ids are found with one cht
+  void get_members_from_cht_(const std::string& name, const std::vector<std::string>& ids,
+                             std::vector<std::vector<std::pair<std::string, int> > >& ret, size_t n);
 
   keeper_argv a_;
   pfi::math::random::mtrand rng_;
@@ -209,6 +209,13 @@ static void init_num_rules(const vector<num_rule>& num_rules,
   }
 }
 
+static void init_dense_rules(const vector<dense_rule>& dense_rules,
+                             datum_to_fv_converter& conv) {
+  for (size_t i = 0; i < dense_rules.size(); ++i) {
+    conv.register_dense_rule(dense_rules[i].keys);
+  }
+}
+
 void initialize_converter(const converter_config& config,
                           datum_to_fv_converter& conv) {
   if (config.hash_max_size.bool_test() && *config.hash_max_size.get() <= 0) {
@@ -231,6 +238,9 @@ void initialize_converter(const converter_config& config,
   init_num_filter_rules(config.num_filter_rules, num_filters, conv);
   init_string_rules(config.string_rules, splitters, conv);
   init_num_rules(config.num_rules, num_features, conv);
+  if (config.dense_rules.bool_test()) {
+    init_dense_rules(*config.dense_rules.get(), conv);
+  }
 
   if (config.hash_max_size.bool_test()) {
     conv.set_hash_max_size(*config.hash_max_size.get());
@@ -81,6 +81,18 @@ struct num_rule {
   }
 };
 
+struct dense_rule {
+  std::vector<std::string> keys;
+
+  MSGPACK_DEFINE(keys);
+
+  friend class pfi::data::serialization::access;
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar & MEMBER(keys);
+  }
+};
+
 struct converter_config {
   std::map<std::string, param_t> string_filter_types;
   std::vector<filter_rule> string_filter_rules;
@@ -94,6 +106,8 @@ struct converter_config {
   std::map<std::string, param_t> num_types;
   std::vector<num_rule> num_rules;
 
+  pfi::data::optional<std::vector<dense_rule> > dense_rules;
+
   pfi::data::optional<int64_t> hash_max_size;
 
   MSGPACK_DEFINE(string_filter_types, string_filter_rules,
@@ -112,6 +126,7 @@ struct converter_config {
         & MEMBER(string_rules)
         & MEMBER(num_types)
         & MEMBER(num_rules)
+        & MEMBER(dense_rules)
         & MEMBER(hash_max_size);
   }
 
@@ -113,6 +113,8 @@ class datum_to_fv_converter_impl {
   std::vector<num_filter_rule> num_filter_rules_;
   std::vector<string_feature_rule> string_rules_;
   std::vector<num_feature_rule> num_rules_;
+  std::vector<std::string> dense_keys_;
+  pfi::data::unordered_map<std::string, size_t> dense_index_;
   
   common::cshared_ptr<weight_manager> weights_;
 
@@ -128,6 +130,8 @@ class datum_to_fv_converter_impl {
     num_filter_rules_.clear();
     string_rules_.clear();
     num_rules_.clear();
+    dense_keys_.clear();
+    dense_index_.clear();
   }
 
   void register_string_filter(shared_ptr<key_matcher> matcher,
@@ -157,6 +161,35 @@ class datum_to_fv_converter_impl {
     num_rules_.push_back(num_feature_rule(name, matcher, feature_func));
   }
 
+  void register_dense_rule(const vector<string>& keys) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (dense_index_.count(keys[i])) {
+        throw JUBATUS_EXCEPTION(converter_exception("duplicated dense key: " + keys[i]));
+      }
+      dense_index_[keys[i]] = dense_keys_.size();
+      dense_keys_.push_back(keys[i]);
+    }
+  }
+
+  size_t dense_size() const {
+    return dense_keys_.size();
+  }
+
+  void get_dense_features(vector<string>& ret) const {
+    sfv_t fv;
+    for (size_t i = 0; i < dense_keys_.size(); ++i) {
+      fv.push_back(make_pair(make_dense_feature(dense_keys_[i]), 1.f));
+    }
+    if (hasher_) {
+      hasher_->hash_feature_keys(fv);
+    }
+
+    ret.clear();
+    for (size_t i = 0; i < fv.size(); ++i) {
+      ret.push_back(fv[i].first);
+    }
+  }
+
   void add_weight(const std::string& key,
                   float weight) {
     if (weights_)
@@ -164,9 +197,10 @@ class datum_to_fv_converter_impl {
   }
 
   void convert(const datum& datum,
-               sfv_t& ret_fv) const {
+               sfv_t& ret_fv,
+               vector<float>* ret_dense) const {
     sfv_t fv;
-    convert_unweighted(datum, fv);
+    convert_unweighted(datum, fv, ret_dense);
     if (weights_)
       (*weights_).get_weight(fv);
 
@@ -178,9 +212,15 @@ class datum_to_fv_converter_impl {
   }
 
   void convert_and_update_weight(const datum& datum,
-                                 sfv_t& ret_fv) {
+                                 sfv_t& ret_fv,
+                                 vector<float>* ret_dense) {
     sfv_t fv;
-    convert_unweighted(datum, fv);
+    convert_unweighted(datum, fv, ret_dense);
+    update_and_apply_weight(fv);
+    fv.swap(ret_fv);
+  }
+
+  void update_and_apply_weight(sfv_t& fv) {
     if (weights_) {
       (*weights_).update_weight(fv);
       (*weights_).get_weight(fv);
@@ -189,12 +229,14 @@ class datum_to_fv_converter_impl {
     if (hasher_) {
       hasher_->hash_feature_keys(fv);
     }
-    
-    fv.swap(ret_fv);
   }
 
-  void convert_unweighted(const datum& datum, sfv_t& ret_fv) const {
+  void convert_unweighted(const datum& datum, sfv_t& ret_fv,
+                          vector<float>* ret_dense) const {
     sfv_t fv;
+    if (ret_dense) {
+      ret_dense->assign(dense_keys_.size(), 0.f);
+    }
 
     vector<pair<string, string> > filtered_strings;
     filter_strings(datum.string_values_, filtered_strings);
@@ -203,8 +245,8 @@ class datum_to_fv_converter_impl {
 
     vector<pair<string, double> > filtered_nums;
     filter_nums(datum.num_values_, filtered_nums);
-    convert_nums(datum.num_values_, fv);
-    convert_nums(filtered_nums, fv);
+    convert_nums(datum.num_values_, fv, ret_dense);
+    convert_nums(filtered_nums, fv, ret_dense);
 
     fv.swap(ret_fv);
   }
@@ -383,10 +425,29 @@ class datum_to_fv_converter_impl {
     }
   }
 
+  static string make_dense_feature(const string& key) {
+    return key + "@dense";
+  }
+
   void convert_nums(const datum::nv_t& num_values, 
-                    sfv_t& ret_fv) const {
+                    sfv_t& ret_fv,
+                    vector<float>* ret_dense) const {
     for (size_t i = 0; i < num_values.size(); ++i) {
-      convert_num(num_values[i].first, num_values[i].second, ret_fv);
+      const string& key = num_values[i].first;
+      double value = num_values[i].second;
+      if (!dense_index_.empty()) {
+        pfi::data::unordered_map<string, size_t>::const_iterator it =
+            dense_index_.find(key);
+        if (it != dense_index_.end()) {
+          if (ret_dense) {
+            (*ret_dense)[it->second] = value;
+          } else if (value != 0.0) {
+            ret_fv.push_back(make_pair(make_dense_feature(key), value));
+          }
+          continue;
+        }
+      }
+      convert_num(key, value, ret_fv);
     }
   }
 
@@ -414,11 +475,29 @@ datum_to_fv_converter::~datum_to_fv_converter() {
 }
 
 void datum_to_fv_converter::convert(const datum& datum, sfv_t& ret_fv) const {
-  pimpl_->convert(datum, ret_fv);
+  pimpl_->convert(datum, ret_fv, NULL);
 }
 
 void datum_to_fv_converter::convert_and_update_weight(const datum& datum, sfv_t& ret_fv) {
-  pimpl_->convert_and_update_weight(datum, ret_fv);
+  pimpl_->convert_and_update_weight(datum, ret_fv, NULL);
+}
+
+void datum_to_fv_converter::convert_unweighted(const datum& datum, sfv_t& ret_fv) const {
+  pimpl_->convert_unweighted(datum, ret_fv, NULL);
+}
+
+void datum_to_fv_converter::update_and_apply_weight(sfv_t& fv) {
+  pimpl_->update_and_apply_weight(fv);
+}
+
+void datum_to_fv_converter::convert(const datum& datum, sfv_t& ret_fv,
+                                    vector<float>& ret_dense) const {
+  pimpl_->convert(datum, ret_fv, &ret_dense);
+}
+
+void datum_to_fv_converter::convert_and_update_weight(const datum& datum, sfv_t& ret_fv,
+                                                      vector<float>& ret_dense) {
+  pimpl_->convert_and_update_weight(datum, ret_fv, &ret_dense);
 }
 
 void datum_to_fv_converter::clear_rules() {
@@ -451,6 +530,18 @@ void datum_to_fv_converter::register_num_rule(const string& name,
   pimpl_->register_num_rule(name, matcher, feature_func);
 }
 
+void datum_to_fv_converter::register_dense_rule(const vector<string>& keys) {
+  pimpl_->register_dense_rule(keys);
+}
+
+size_t datum_to_fv_converter::dense_size() const {
+  return pimpl_->dense_size();
+}
+
+void datum_to_fv_converter::get_dense_features(vector<string>& ret) const {
+  pimpl_->get_dense_features(ret);
+}
+
 void datum_to_fv_converter::add_weight(const string& key,
                                        float weight) {
   pimpl_->add_weight(key, weight);
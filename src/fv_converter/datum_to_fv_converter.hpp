@@ -65,6 +65,22 @@ class datum_to_fv_converter {
 
   void convert_and_update_weight(const datum& datum, sfv_t& ret_fv);
 
+  // Values of keys registered by dense rules are stored in ret_dense in the
+  // order of the rules instead of ret_fv. Missing keys are filled with zero.
+  // Without ret_dense, they are converted to "<KEY>@dense" features.
+  void convert(const datum& datum, sfv_t& ret_fv,
+               std::vector<float>& ret_dense) const;
+
+  void convert_and_update_weight(const datum& datum, sfv_t& ret_fv,
+                                 std::vector<float>& ret_dense);
+
+  // convert_and_update_weight in two steps. convert_unweighted only reads
+  // the converter, so that many datums can be converted in parallel, and
+  // update_and_apply_weight updates weights by the features, weights and
+  // hashes them.
+  void convert_unweighted(const datum& datum, sfv_t& ret_fv) const;
+  void update_and_apply_weight(sfv_t& fv);
+
   void clear_rules();
 
   void register_string_filter(pfi::lang::shared_ptr<key_matcher> matcher,
@@ -84,6 +100,14 @@ class datum_to_fv_converter {
                          pfi::lang::shared_ptr<key_matcher> matcher,
                          pfi::lang::shared_ptr<num_feature> feature_func);
 
+  // Num values of the keys are not converted by num rules.
+  void register_dense_rule(const std::vector<std::string>& keys);
+
+  size_t dense_size() const;
+
+  // names of features that the dense values stand for
+  void get_dense_features(std::vector<std::string>& ret) const;
+
   void add_weight(const std::string& key,
                   float weight);
 
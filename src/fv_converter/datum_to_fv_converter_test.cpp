@@ -18,6 +18,9 @@
 #include <gtest/gtest.h>
 #include <pficommon/text/json.h>
 #include <pficommon/lang/shared_ptr.h>
+#include <pficommon/lang/bind.h>
+#include <pficommon/lang/cast.h>
+#include <pficommon/concurrent/thread.h>
 #include <cmath>
 
 #include "test_util.hpp"
@@ -183,6 +186,36 @@ TEST(datum_to_fv_converter, weight) {
   ASSERT_EQ(3., feature[0].second);
 }
 
+TEST(datum_to_fv_converter, convert_unweighted) {
+  // two steps are the same as convert_and_update_weight
+  datum_to_fv_converter conv1, conv2;
+  datum_to_fv_converter* convs[] = { &conv1, &conv2 };
+  for (size_t i = 0; i < 2; ++i) {
+    init_weight_manager(*convs[i]);
+    shared_ptr<key_matcher> match(new match_all());
+    shared_ptr<word_splitter> s(new space_splitter());
+    vector<splitter_weight_type> p;
+    p.push_back(splitter_weight_type(FREQ_BINARY, IDF));
+    convs[i]->register_string_rule("space", match, s, p);
+  }
+
+  datum d1, d2;
+  d1.string_values_.push_back(make_pair("/id", "a b"));
+  d2.string_values_.push_back(make_pair("/id", "a c"));
+  vector<pair<string, float> > expected, feature;
+  conv1.convert_and_update_weight(d1, expected);
+  conv1.convert_and_update_weight(d2, expected);
+
+  conv2.convert_unweighted(d1, feature);
+  conv2.update_and_apply_weight(feature);
+  conv2.convert_unweighted(d2, feature);
+  conv2.update_and_apply_weight(feature);
+
+  sort(feature.begin(), feature.end());
+  sort(expected.begin(), expected.end());
+  PairVectorEquals(expected, feature);
+}
+
 TEST(datum_to_fv_converter, register_string_rule) {
   datum_to_fv_converter conv;
   init_weight_manager(conv);
@@ -241,6 +274,63 @@ TEST(datum_to_fv_converter, register_num_rule) {
   }
 }
 
+TEST(datum_to_fv_converter, register_dense_rule) {
+  datum_to_fv_converter conv;
+  init_weight_manager(conv);
+
+  shared_ptr<num_feature> f(new num_value_feature());
+  shared_ptr<key_matcher> a(new match_all());
+  conv.register_num_rule("num", a, f);
+
+  vector<string> keys;
+  keys.push_back("/x");
+  keys.push_back("/y");
+  conv.register_dense_rule(keys);
+  EXPECT_EQ(2u, conv.dense_size());
+
+  vector<string> names;
+  conv.get_dense_features(names);
+  ASSERT_EQ(2u, names.size());
+  EXPECT_EQ("/x@dense", names[0]);
+  EXPECT_EQ("/y@dense", names[1]);
+
+  datum datum;
+  datum.num_values_.push_back(make_pair("/y", 2.));
+  datum.num_values_.push_back(make_pair("/age", 20.));
+
+  {
+    // dense values do not appear in the sparse features
+    vector<pair<string, float> > feature;
+    vector<float> dense;
+    conv.convert(datum, feature, dense);
+
+    ASSERT_EQ(2u, dense.size());
+    EXPECT_EQ(0.f, dense[0]);
+    EXPECT_EQ(2.f, dense[1]);
+
+    vector<pair<string, float> > exp;
+    exp.push_back(make_pair("/age@num", 20.));
+    PairVectorEquals(exp, feature);
+  }
+
+  {
+    // without a dense vector, non-zero values are given as sparse features
+    vector<pair<string, float> > feature;
+    conv.convert(datum, feature);
+
+    vector<pair<string, float> > exp;
+    exp.push_back(make_pair("/y@dense", 2.));
+    exp.push_back(make_pair("/age@num", 20.));
+    sort(feature.begin(), feature.end());
+    sort(exp.begin(), exp.end());
+    PairVectorEquals(exp, feature);
+  }
+
+  vector<string> duplicated;
+  duplicated.push_back("/x");
+  EXPECT_THROW(conv.register_dense_rule(duplicated), converter_exception);
+}
+
 TEST(datum_to_fv_converter, register_string_filter) {
   datum_to_fv_converter conv;
   init_weight_manager(conv);
@@ -342,3 +432,67 @@ TEST(datum_to_fv_converter, hasher) {
   for (size_t i = 0; i < feature.size(); ++i)
     EXPECT_EQ("0", feature[i].first);
 }
+
+namespace {
+
+void convert_repeatedly(const datum_to_fv_converter* conv,
+                        const vector<datum>* data,
+                        const vector<sfv_t>* expected,
+                        bool* ok) {
+  sfv_t fv;
+  for (int n = 0; n < 100; ++n) {
+    for (size_t i = 0; i < data->size(); ++i) {
+      conv->convert((*data)[i], fv);
+      if (fv != (*expected)[i]) {
+        *ok = false;
+        return;
+      }
+    }
+  }
+  *ok = true;
+}
+
+}
+
+TEST(datum_to_fv_converter, multi_thread) {
+  // convert is called concurrently from RPC threads; plugins must allow it
+  datum_to_fv_converter conv;
+  init_weight_manager(conv);
+  shared_ptr<key_matcher> match(new match_all());
+  vector<splitter_weight_type> p;
+  p.push_back(splitter_weight_type(TERM_FREQUENCY, TERM_BINARY));
+  conv.register_string_rule("space", match,
+                            shared_ptr<word_splitter>(new space_splitter()), p);
+  conv.register_string_rule("bigram", match,
+                            shared_ptr<word_splitter>(new character_ngram(2)), p);
+  conv.register_num_rule("num", match,
+                         shared_ptr<num_feature>(new num_value_feature()));
+
+  vector<datum> data;
+  vector<sfv_t> expected;
+  for (int i = 0; i < 20; ++i) {
+    datum d;
+    d.string_values_.push_back(make_pair("/text", "this is a pen number "
+                                         + pfi::lang::lexical_cast<string>(i)));
+    d.num_values_.push_back(make_pair("/num", i + 1));
+    data.push_back(d);
+    sfv_t fv;
+    conv.convert(d, fv);
+    expected.push_back(fv);
+  }
+
+  const size_t num_threads = 16;
+  vector<shared_ptr<pfi::concurrent::thread> > ts;
+  bool ok[num_threads];
+  for (size_t i = 0; i < num_threads; ++i) {
+    ok[i] = false;
+    ts.push_back(shared_ptr<pfi::concurrent::thread>(
+        new pfi::concurrent::thread(
+            pfi::lang::bind(&convert_repeatedly, &conv, &data, &expected, &ok[i]))));
+    ts[i]->start();
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    ts[i]->join();
+    EXPECT_TRUE(ok[i]);
+  }
+}
@@ -0,0 +1,151 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <time.h>
+#include <pficommon/text/json.h>
+#include "../common/exception.hpp"
+#include "../common/cmdline.h"
+#include "datum.hpp"
+#include "json_converter.hpp"
+#include "json_stream_converter.hpp"
+
+using namespace std;
+using namespace jubatus::fv_converter;
+
+void make_value(ostream& out, int depth, int width, int& seq) {
+  if (depth == 0) {
+    ++seq;
+    if (seq % 3 == 0) {
+      out << "\"value" << seq << "\"";
+    } else if (seq % 3 == 1) {
+      out << seq;
+    } else {
+      out << seq * 0.25;
+    }
+    return;
+  }
+  if (depth % 2 == 0) {
+    out << "[";
+    for (int i = 0; i < width; ++i) {
+      if (i) out << ", ";
+      make_value(out, depth - 1, width, seq);
+    }
+    out << "]";
+  } else {
+    out << "{";
+    for (int i = 0; i < width; ++i) {
+      if (i) out << ", ";
+      out << "\"key" << i << "\": ";
+      make_value(out, depth - 1, width, seq);
+    }
+    out << "}";
+  }
+}
+
+void make_documents(int num, int depth, int width, vector<string>& docs) {
+  int seq = 0;
+  for (int i = 0; i < num; ++i) {
+    ostringstream oss;
+    make_value(oss, depth, width, seq);
+    docs.push_back(oss.str());
+  }
+}
+
+void read_documents(const string& filename, vector<string>& docs) {
+  ifstream ifs(filename.c_str());
+  if (!ifs) {
+    cerr << "cannot open: " << filename << endl;
+    return;
+  }
+  for (string line; getline(ifs, line); ) {
+    if (!line.empty()) {
+      docs.push_back(line);
+    }
+  }
+}
+
+void run_test(const vector<string>& docs) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < docs.size(); ++i) {
+    bytes += docs[i].size();
+  }
+
+  size_t dom_values = 0;
+  clock_t begin = clock();
+  for (size_t i = 0; i < docs.size(); ++i) {
+    istringstream iss(docs[i]);
+    pfi::text::json::json json;
+    iss >> json;
+    datum d;
+    json_converter::convert(json, d);
+    dom_values += d.string_values_.size() + d.num_values_.size();
+  }
+  clock_t end = clock();
+  float dom_time = static_cast<float>(end - begin) / CLOCKS_PER_SEC;
+
+  size_t stream_values = 0;
+  json_stream_converter conv;
+  begin = clock();
+  for (size_t i = 0; i < docs.size(); ++i) {
+    datum d;
+    conv.convert(docs[i], d);
+    stream_values += d.string_values_.size() + d.num_values_.size();
+  }
+  end = clock();
+  float stream_time = static_cast<float>(end - begin) / CLOCKS_PER_SEC;
+
+  float mb = static_cast<float>(bytes) / (1024 * 1024);
+  cout << "documents: " << docs.size()
+       << "\tsize: " << mb << "MB"
+       << "\tvalues: " << stream_values << endl;
+  cout << "\tdom: " << dom_time << "sec (" << mb / dom_time << "MB/s)"
+       << "\tstream: " << stream_time << "sec (" << mb / stream_time << "MB/s)"
+       << endl;
+  if (dom_values != stream_values) {
+    cerr << "number of values differ: " << dom_values << " != "
+         << stream_values << endl;
+  }
+}
+
+int main(int argc, char* argv[]) try {
+  cmdline::parser p;
+  p.add<int>("num", 'n', "number of generated documents", false, 1000);
+  p.add<int>("depth", 'd', "depth of generated documents", false, 4);
+  p.add<int>("width", 'w', "members per object/array", false, 8);
+  p.set_program_name("json_converter_performance_test");
+  p.footer("[files...] (one json document per line)");
+
+  p.parse_check(argc, argv);
+
+  vector<string> docs;
+  if (p.rest().empty()) {
+    make_documents(p.get<int>("num"), p.get<int>("depth"), p.get<int>("width"),
+                   docs);
+  } else {
+    for (size_t i = 0; i < p.rest().size(); ++i) {
+      read_documents(p.rest()[i], docs);
+    }
+  }
+  run_test(docs);
+} catch (const jubatus::exception::jubatus_exception& e) {
+  std::cout << e.diagnostic_information(true) << std::endl;
+}
@@ -0,0 +1,379 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "json_stream_converter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <stdint.h>
+
+#include "datum.hpp"
+#include "exception.hpp"
+#include "json_converter.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace fv_converter {
+
+namespace {
+
+// integers with more digits may not fit in int64_t and are parsed as double
+const size_t MAX_INTEGER_DIGITS = 18;
+const size_t NUMBER_BUFFER_SIZE = 64;
+
+inline bool is_digit(char c) {
+  return '0' <= c && c <= '9';
+}
+
+int hex_value(char c) {
+  if ('0' <= c && c <= '9') {
+    return c - '0';
+  } else if ('a' <= c && c <= 'f') {
+    return c - 'a' + 10;
+  } else if ('A' <= c && c <= 'F') {
+    return c - 'A' + 10;
+  } else {
+    return -1;
+  }
+}
+
+void append_utf8(uint32_t code, string& out) {
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xC0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    out += static_cast<char>(0xE0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (code >> 18));
+    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+void append_index(size_t index, string& path) {
+  char buf[24];
+  char* p = buf + sizeof(buf);
+  do {
+    *--p = static_cast<char>('0' + index % 10);
+    index /= 10;
+  } while (index > 0);
+  path += '[';
+  path.append(p, buf + sizeof(buf));
+  path += ']';
+}
+
+}
+
+json_stream_converter::json_stream_converter()
+    : begin_(NULL), ptr_(NULL), end_(NULL) {
+}
+
+void json_stream_converter::convert(const string& json, datum& ret_datum) {
+  convert(json.data(), json.data() + json.size(), ret_datum);
+}
+
+void json_stream_converter::convert(const char* begin, const char* end,
+                                    datum& ret_datum) {
+  begin_ = begin;
+  ptr_ = begin;
+  end_ = end;
+  path_.clear();
+
+  skip_whitespace();
+  parse_value(ret_datum);
+  skip_whitespace();
+  if (ptr_ != end_) {
+    throw_error("unexpected trailing characters");
+  }
+}
+
+void json_stream_converter::parse_value(datum& ret_datum) {
+  if (ptr_ == end_) {
+    throw_error("unexpected end of input");
+  }
+
+  switch (*ptr_) {
+    case '{':
+      parse_object(ret_datum);
+      break;
+
+    case '[':
+      parse_array(ret_datum);
+      break;
+
+    case '"':
+      parse_string(value_);
+      ret_datum.string_values_.push_back(make_pair(path_, value_));
+      break;
+
+    case 't':
+      expect_literal("true");
+      ret_datum.num_values_.push_back(make_pair(path_, 1.));
+      break;
+
+    case 'f':
+      expect_literal("false");
+      ret_datum.num_values_.push_back(make_pair(path_, 0.));
+      break;
+
+    case 'n':
+      expect_literal("null");
+      ret_datum.string_values_.push_back(
+          make_pair(path_, string(json_converter::NULL_STRING)));
+      break;
+
+    default:
+      parse_number(ret_datum);
+      break;
+  }
+}
+
+void json_stream_converter::parse_object(datum& ret_datum) {
+  ++ptr_;  // '{'
+  skip_whitespace();
+  if (ptr_ != end_ && *ptr_ == '}') {
+    ++ptr_;
+    return;
+  }
+
+  size_t len = path_.size();
+  while (true) {
+    if (ptr_ == end_ || *ptr_ != '"') {
+      throw_error("object key is expected");
+    }
+    parse_string(key_);
+    skip_whitespace();
+    if (ptr_ == end_ || *ptr_ != ':') {
+      throw_error("':' is expected");
+    }
+    ++ptr_;
+    skip_whitespace();
+
+    path_ += '/';
+    path_ += key_;
+    parse_value(ret_datum);
+    path_.resize(len);
+
+    skip_whitespace();
+    if (ptr_ == end_) {
+      throw_error("unexpected end of input");
+    } else if (*ptr_ == ',') {
+      ++ptr_;
+      skip_whitespace();
+    } else if (*ptr_ == '}') {
+      ++ptr_;
+      return;
+    } else {
+      throw_error("',' or '}' is expected");
+    }
+  }
+}
+
+void json_stream_converter::parse_array(datum& ret_datum) {
+  ++ptr_;  // '['
+  skip_whitespace();
+  if (ptr_ != end_ && *ptr_ == ']') {
+    ++ptr_;
+    return;
+  }
+
+  size_t len = path_.size();
+  for (size_t i = 0; ; ++i) {
+    append_index(i, path_);
+    parse_value(ret_datum);
+    path_.resize(len);
+
+    skip_whitespace();
+    if (ptr_ == end_) {
+      throw_error("unexpected end of input");
+    } else if (*ptr_ == ',') {
+      ++ptr_;
+      skip_whitespace();
+    } else if (*ptr_ == ']') {
+      ++ptr_;
+      return;
+    } else {
+      throw_error("',' or ']' is expected");
+    }
+  }
+}
+
+void json_stream_converter::parse_string(string& ret) {
+  ++ptr_;  // '"'
+  ret.clear();
+  while (true) {
+    // copy the longest run without escapes at once
+    const char* run = ptr_;
+    while (ptr_ != end_ && *ptr_ != '"' && *ptr_ != '\\') {
+      ++ptr_;
+    }
+    ret.append(run, ptr_);
+
+    if (ptr_ == end_) {
+      throw_error("unterminated string");
+    }
+    if (*ptr_ == '"') {
+      ++ptr_;
+      return;
+    }
+
+    ++ptr_;  // '\\'
+    if (ptr_ == end_) {
+      throw_error("unterminated string");
+    }
+    char c = *ptr_++;
+    switch (c) {
+      case '"':  ret += '"'; break;
+      case '\\': ret += '\\'; break;
+      case '/':  ret += '/'; break;
+      case 'b':  ret += '\b'; break;
+      case 'f':  ret += '\f'; break;
+      case 'n':  ret += '\n'; break;
+      case 'r':  ret += '\r'; break;
+      case 't':  ret += '\t'; break;
+      case 'u': {
+        uint32_t code = 0;
+        for (int i = 0; i < 4; ++i) {
+          int h = ptr_ == end_ ? -1 : hex_value(*ptr_);
+          if (h < 0) {
+            throw_error("invalid unicode escape");
+          }
+          code = (code << 4) | h;
+          ++ptr_;
+        }
+        // combine a surrogate pair written as two escapes
+        if (0xD800 <= code && code < 0xDC00 && end_ - ptr_ >= 6
+            && ptr_[0] == '\\' && ptr_[1] == 'u') {
+          uint32_t low = 0;
+          bool valid = true;
+          for (int i = 2; i < 6; ++i) {
+            int h = hex_value(ptr_[i]);
+            if (h < 0) {
+              valid = false;
+              break;
+            }
+            low = (low << 4) | h;
+          }
+          if (valid && 0xDC00 <= low && low < 0xE000) {
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            ptr_ += 6;
+          }
+        }
+        append_utf8(code, ret);
+        break;
+      }
+      default:
+        --ptr_;
+        throw_error("invalid escape sequence");
+    }
+  }
+}
+
+void json_stream_converter::parse_number(datum& ret_datum) {
+  const char* start = ptr_;
+  bool negative = false;
+  if (ptr_ != end_ && *ptr_ == '-') {
+    negative = true;
+    ++ptr_;
+  }
+  if (ptr_ == end_ || !is_digit(*ptr_)) {
+    throw_error("unexpected character");
+  }
+
+  int64_t integer = 0;
+  const char* digits = ptr_;
+  for (; ptr_ != end_ && is_digit(*ptr_) &&
+           static_cast<size_t>(ptr_ - digits) < MAX_INTEGER_DIGITS; ++ptr_) {
+    integer = integer * 10 + (*ptr_ - '0');
+  }
+  while (ptr_ != end_ && is_digit(*ptr_)) {
+    ++ptr_;
+  }
+  bool is_integer = static_cast<size_t>(ptr_ - digits) <= MAX_INTEGER_DIGITS;
+
+  if (ptr_ != end_ && *ptr_ == '.') {
+    is_integer = false;
+    ++ptr_;
+    if (ptr_ == end_ || !is_digit(*ptr_)) {
+      throw_error("digit is expected after '.'");
+    }
+    while (ptr_ != end_ && is_digit(*ptr_)) {
+      ++ptr_;
+    }
+  }
+  if (ptr_ != end_ && (*ptr_ == 'e' || *ptr_ == 'E')) {
+    is_integer = false;
+    ++ptr_;
+    if (ptr_ != end_ && (*ptr_ == '+' || *ptr_ == '-')) {
+      ++ptr_;
+    }
+    if (ptr_ == end_ || !is_digit(*ptr_)) {
+      throw_error("digit is expected in exponent");
+    }
+    while (ptr_ != end_ && is_digit(*ptr_)) {
+      ++ptr_;
+    }
+  }
+
+  double value;
+  if (is_integer) {
+    value = static_cast<double>(negative ? -integer : integer);
+  } else {
+    // the input range may not be null-terminated
+    size_t len = ptr_ - start;
+    if (len < NUMBER_BUFFER_SIZE) {
+      char buf[NUMBER_BUFFER_SIZE];
+      std::copy(start, ptr_, buf);
+      buf[len] = '\0';
+      value = strtod(buf, NULL);
+    } else {
+      value = strtod(string(start, ptr_).c_str(), NULL);
+    }
+  }
+  ret_datum.num_values_.push_back(make_pair(path_, value));
+}
+
+void json_stream_converter::expect_literal(const char* literal) {
+  for (const char* p = literal; *p; ++p, ++ptr_) {
+    if (ptr_ == end_ || *ptr_ != *p) {
+      throw_error(string("invalid literal, expected ") + literal);
+    }
+  }
+}
+
+void json_stream_converter::skip_whitespace() {
+  while (ptr_ != end_
+         && (*ptr_ == ' ' || *ptr_ == '\t' || *ptr_ == '\n' || *ptr_ == '\r')) {
+    ++ptr_;
+  }
+}
+
+void json_stream_converter::throw_error(const string& msg) const {
+  ostringstream oss;
+  oss << "invalid json format: " << msg << " at offset " << (ptr_ - begin_);
+  throw JUBATUS_EXCEPTION(converter_exception(oss.str()));
+}
+
+}
+}
@@ -0,0 +1,59 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#pragma once
+
+#include <string>
+
+namespace jubatus {
+namespace fv_converter {
+
+struct datum;
+
+// Converts a JSON document to datum without building a JSON DOM.
+// Values are appended to the datum while the document is tokenized, and the
+// key path ("/key[0]/...") is kept in a buffer that is reused between calls.
+// The result is the same as json_converter::convert, except that members of
+// an object are emitted in document order.
+// An instance is not thread safe; use one converter per thread.
+class json_stream_converter {
+ public:
+  json_stream_converter();
+
+  void convert(const std::string& json, datum& ret_datum);
+  void convert(const char* begin, const char* end, datum& ret_datum);
+
+ private:
+  void parse_value(datum& ret_datum);
+  void parse_object(datum& ret_datum);
+  void parse_array(datum& ret_datum);
+  void parse_string(std::string& ret);
+  void parse_number(datum& ret_datum);
+  void expect_literal(const char* literal);
+  void skip_whitespace();
+  void throw_error(const std::string& msg) const;
+
+  const char* begin_;
+  const char* ptr_;
+  const char* end_;
+  std::string path_;
+  std::string key_;
+  std::string value_;
+};
+
+}
+}
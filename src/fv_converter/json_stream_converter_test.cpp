@@ -0,0 +1,213 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <pficommon/text/json.h>
+
+#include "test_util.hpp"
+
+#include "datum.hpp"
+#include "exception.hpp"
+#include "json_converter.hpp"
+#include "json_stream_converter.hpp"
+
+using namespace std;
+using namespace jubatus;
+using namespace jubatus::fv_converter;
+
+namespace {
+
+void TestEquals(const string& json_string,
+                const vector<pair<string, string> >& expected_strings,
+                const vector<pair<string, double> >& expected_nums) {
+  datum actual;
+  json_stream_converter conv;
+  conv.convert(json_string, actual);
+  PairVectorEquals(expected_strings, actual.string_values_);
+  PairVectorEquals(expected_nums, actual.num_values_);
+}
+
+void TestSameAsDom(const string& json_string) {
+  istringstream iss(json_string);
+  pfi::text::json::json json;
+  iss >> json;
+  datum expected;
+  json_converter::convert(json, expected);
+
+  datum actual;
+  json_stream_converter conv;
+  conv.convert(json_string, actual);
+
+  // members of objects may be visited in a different order
+  sort(expected.string_values_.begin(), expected.string_values_.end());
+  sort(expected.num_values_.begin(), expected.num_values_.end());
+  sort(actual.string_values_.begin(), actual.string_values_.end());
+  sort(actual.num_values_.begin(), actual.num_values_.end());
+  PairVectorEquals(expected.string_values_, actual.string_values_);
+  PairVectorEquals(expected.num_values_, actual.num_values_);
+}
+
+}
+
+TEST(json_stream_converter, empty) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  TestEquals("{}", strings, nums);
+  TestEquals("[]", strings, nums);
+  TestEquals(" { } ", strings, nums);
+}
+
+TEST(json_stream_converter, number) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  nums.push_back(make_pair("/val1", 10.));
+  nums.push_back(make_pair("/val2", 0.5));
+  nums.push_back(make_pair("/val3", -2.));
+  nums.push_back(make_pair("/val4", 1.5e3));
+
+  TestEquals("{ \"val1\": 10,  \"val2\": 0.5, \"val3\": -2, \"val4\": 1.5e3 }",
+             strings, nums);
+}
+
+TEST(json_stream_converter, long_integer) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  nums.push_back(make_pair("/val1", 123456789012345678.));
+  nums.push_back(make_pair("/val2", 12345678901234567890123.));
+  nums.push_back(make_pair("/val3", -99999999999999999999.));
+
+  TestEquals("{ \"val1\": 123456789012345678,"
+             " \"val2\": 12345678901234567890123,"
+             " \"val3\": -99999999999999999999 }",
+             strings, nums);
+}
+
+TEST(json_stream_converter, string) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  strings.push_back(make_pair("/val1", "hoge"));
+  strings.push_back(make_pair("/val2", ""));
+
+  TestEquals("{ \"val1\": \"hoge\",  \"val2\": \"\" }", strings, nums);
+}
+
+TEST(json_stream_converter, escape) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  strings.push_back(make_pair("/a\"b", "x\ny\\z/"));
+  strings.push_back(make_pair("/u", "\xE3\x81\x82"));
+  strings.push_back(make_pair("/s", "\xF0\x9F\x98\x80"));
+
+  TestEquals("{ \"a\\\"b\": \"x\\ny\\\\z\\/\", \"u\": \"\\u3042\","
+             " \"s\": \"\\ud83d\\ude00\" }",
+             strings, nums);
+}
+
+TEST(json_stream_converter, bool) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  nums.push_back(make_pair("/val1", 1));
+  nums.push_back(make_pair("/val2", 0));
+
+  TestEquals("{ \"val1\": true,  \"val2\": false }", strings, nums);
+}
+
+TEST(json_stream_converter, null) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  strings.push_back(make_pair("/val", "null"));
+
+  TestEquals("{ \"val\": null }", strings, nums);
+}
+
+TEST(json_stream_converter, array) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+
+  nums.push_back(make_pair("[0]", 1.));
+  nums.push_back(make_pair("[1]", 2.));
+  nums.push_back(make_pair("[2]", 3.));
+
+  TestEquals("[1, 2, 3]", strings, nums);
+
+  nums.clear();
+  nums.push_back(make_pair("/key[0]", 1));
+  nums.push_back(make_pair("/key[1]", 2));
+  nums.push_back(make_pair("/key[2]", 3));
+  TestEquals("{\"key\": [1, 2, 3]}", strings, nums);
+
+  nums.clear();
+  nums.push_back(make_pair("[0][0]", 1));
+  nums.push_back(make_pair("[0][1]", 2));
+  nums.push_back(make_pair("[1][0]", 3));
+  nums.push_back(make_pair("[10]", 4));
+  TestEquals("[[1, 2], [3], [], [], [], [], [], [], [], [], 4]", strings, nums);
+}
+
+TEST(json_stream_converter, object) {
+  vector<pair<string, string> > strings;
+  vector<pair<string, double> > nums;
+  strings.push_back(make_pair("/text", "Hello"));
+  strings.push_back(make_pair("/user/name", "Taro"));
+  nums.push_back(make_pair("/user/age", 20));
+
+  TestEquals("{ \"text\": \"Hello\", \"user\": { \"name\": \"Taro\", \"age\": 20 } }",
+             strings, nums);
+}
+
+TEST(json_stream_converter, same_as_dom) {
+  TestSameAsDom("{ \"val1\": 10,  \"val2\": 0.5 }");
+  TestSameAsDom("[1, 2.5, \"a\", true, false, null]");
+  TestSameAsDom("{ \"text\": \"Hello\", \"user\": { \"name\": \"Taro\", "
+                "\"age\": 20, \"tags\": [\"a\", \"b\", {\"c\": [1, [2, 3]]}] } }");
+}
+
+TEST(json_stream_converter, reuse) {
+  json_stream_converter conv;
+  datum d1;
+  conv.convert("{\"a\": {\"b\": 1}}", d1);
+  datum d2;
+  conv.convert("{\"c\": 2}", d2);
+
+  ASSERT_EQ(1u, d2.num_values_.size());
+  EXPECT_EQ("/c", d2.num_values_[0].first);
+  EXPECT_EQ(2., d2.num_values_[0].second);
+}
+
+TEST(json_stream_converter, illegal) {
+  json_stream_converter conv;
+  datum d;
+  EXPECT_THROW(conv.convert("", d), converter_exception);
+  EXPECT_THROW(conv.convert("{", d), converter_exception);
+  EXPECT_THROW(conv.convert("{\"a\" 1}", d), converter_exception);
+  EXPECT_THROW(conv.convert("{\"a\": 1,}", d), converter_exception);
+  EXPECT_THROW(conv.convert("[1 2]", d), converter_exception);
+  EXPECT_THROW(conv.convert("\"abc", d), converter_exception);
+  EXPECT_THROW(conv.convert("\"\\x\"", d), converter_exception);
+  EXPECT_THROW(conv.convert("tru", d), converter_exception);
+  EXPECT_THROW(conv.convert("1.", d), converter_exception);
+  EXPECT_THROW(conv.convert("{} {}", d), converter_exception);
+}
@@ -15,41 +15,206 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
+#include <cstdlib>
 #include <sstream>
-#include <pficommon/lang/cast.h>
+#include <stdint.h>
 
 #include "libsvm_converter.hpp"
 #include "exception.hpp"
 #include "datum.hpp"
 
 using namespace std;
-using namespace pfi::lang;
 
 namespace jubatus {
 namespace fv_converter {
 
+namespace {
+
+// longest mantissa that is accumulated exactly in uint64_t
+const int MAX_MANTISSA_DIGITS = 19;
+const size_t NUMBER_BUFFER_SIZE = 64;
+
+// powers of ten exactly representable in double
+const double POW10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const int MAX_EXACT_POW10 = 22;
+const uint64_t MAX_EXACT_MANTISSA = 1LLU << 53;
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+      || c == '\v' || c == '\f';
+}
+
+inline bool is_digit(char c) {
+  return '0' <= c && c <= '9';
+}
+
+void throw_format_error(const char* line_begin,
+                        const char* pos,
+                        size_t line_number,
+                        const string& msg) {
+  ostringstream oss;
+  oss << "invalid libsvm format at line " << line_number
+      << ", column " << (pos - line_begin + 1) << ": " << msg;
+  throw JUBATUS_EXCEPTION(converter_exception(oss.str()));
+}
+
+double parse_slow(const char* begin, const char* end) {
+  // the input range may not be null-terminated
+  size_t len = end - begin;
+  if (len < NUMBER_BUFFER_SIZE) {
+    char buf[NUMBER_BUFFER_SIZE];
+    std::copy(begin, end, buf);
+    buf[len] = '\0';
+    return strtod(buf, NULL);
+  } else {
+    return strtod(string(begin, end).c_str(), NULL);
+  }
+}
+
+// Parses a decimal number occupying the whole of [begin, end).
+// Returns false if the range is not a number.
+bool parse_number(const char* begin, const char* end, double& ret) {
+  const char* p = begin;
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool has_digit = false;
+
+  for (; p != end && is_digit(*p); ++p) {
+    has_digit = true;
+    if (digits < MAX_MANTISSA_DIGITS) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) {
+        ++digits;
+      }
+    } else {
+      ++exponent;
+    }
+  }
+  if (p != end && *p == '.') {
+    ++p;
+    for (; p != end && is_digit(*p); ++p) {
+      has_digit = true;
+      if (digits < MAX_MANTISSA_DIGITS) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) {
+          ++digits;
+        }
+        --exponent;
+      }
+    }
+  }
+  if (!has_digit) {
+    return false;
+  }
+
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negative_exp = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+      negative_exp = (*p == '-');
+      ++p;
+    }
+    if (p == end || !is_digit(*p)) {
+      return false;
+    }
+    int e = 0;
+    for (; p != end && is_digit(*p); ++p) {
+      if (e < 100000) {
+        e = e * 10 + (*p - '0');
+      }
+    }
+    exponent += negative_exp ? -e : e;
+  }
+  if (p != end) {
+    return false;
+  }
+
+  if (mantissa <= MAX_EXACT_MANTISSA
+      && -MAX_EXACT_POW10 <= exponent && exponent <= MAX_EXACT_POW10) {
+    // both operands are exact, so the result is correctly rounded
+    double v = static_cast<double>(mantissa);
+    v = exponent < 0 ? v / POW10[-exponent] : v * POW10[exponent];
+    ret = negative ? -v : v;
+  } else {
+    ret = parse_slow(begin, end);
+  }
+  return true;
+}
+
+}
+
 void libsvm_converter::convert(const string& line, datum& ret_datum, string& ret_label) {
-  string label;
-  istringstream in(line);
-  in >> label;
-  datum::nv_t num_values;
-
-  string s;
-  while (in) {
-    in >> s;
-    if (!in)
+  convert(line.data(), line.data() + line.size(), ret_datum, ret_label);
+}
+
+void libsvm_converter::convert(const char* begin,
+                               const char* end,
+                               datum& ret_datum,
+                               string& ret_label,
+                               size_t line_number) {
+  const char* p = begin;
+  while (p != end && is_space(*p)) {
+    ++p;
+  }
+  const char* label_begin = p;
+  while (p != end && !is_space(*p)) {
+    ++p;
+  }
+  ret_label.assign(label_begin, p);
+
+  datum::nv_t& num_values = ret_datum.num_values_;
+  size_t size = 0;
+  while (true) {
+    while (p != end && is_space(*p)) {
+      ++p;
+    }
+    if (p == end) {
       break;
-    size_t p = s.find(':');
-    if (p == string::npos)
-      throw JUBATUS_EXCEPTION(converter_exception("invalid libsvm format: " + s));
-    string id = s.substr(0, p);
-    float val = lexical_cast<float>(s.substr(p + 1));
-    num_values.push_back(make_pair(id, val));
+    }
+
+    const char* token = p;
+    const char* colon = NULL;
+    while (p != end && !is_space(*p)) {
+      if (*p == ':' && !colon) {
+        colon = p;
+      }
+      ++p;
+    }
+    if (!colon) {
+      throw_format_error(begin, token, line_number,
+                         "':' is not found in " + string(token, p));
+    }
+
+    double val;
+    if (!parse_number(colon + 1, p, val)) {
+      throw_format_error(begin, colon + 1, line_number,
+                         "invalid value: " + string(colon + 1, p));
+    }
+
+    // values have always been stored with float precision
+    val = static_cast<float>(val);
+    if (size < num_values.size()) {
+      num_values[size].first.assign(token, colon);
+      num_values[size].second = val;
+    } else {
+      num_values.push_back(make_pair(string(token, colon), val));
+    }
+    ++size;
   }
 
-  ret_label.swap(label);
+  num_values.resize(size);
   ret_datum.string_values_.clear();
-  ret_datum.num_values_.swap(num_values);
 }
 
 }
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace jubatus {
@@ -28,6 +29,15 @@ class libsvm_converter {
  public:
 
   static void convert(const std::string& line, datum& ret_datum, std::string& ret_label);
+
+  // Parses one line in [begin, end). Strings and vectors in ret_datum and
+  // ret_label are overwritten in place, so passing the same objects for every
+  // line avoids reallocation. line_number is only used in error messages.
+  static void convert(const char* begin,
+                      const char* end,
+                      datum& ret_datum,
+                      std::string& ret_label,
+                      size_t line_number = 1);
 };
 
 }
@@ -0,0 +1,151 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <time.h>
+#include <pficommon/lang/cast.h>
+#include "../common/exception.hpp"
+#include "../common/cmdline.h"
+#include "datum.hpp"
+#include "exception.hpp"
+#include "libsvm_converter.hpp"
+
+using namespace std;
+using namespace jubatus::fv_converter;
+
+// istringstream based parser used before the hand-written one, for comparison
+void convert_with_stream(const string& line, datum& ret_datum, string& ret_label) {
+  string label;
+  istringstream in(line);
+  in >> label;
+  datum::nv_t num_values;
+
+  string s;
+  while (in) {
+    in >> s;
+    if (!in)
+      break;
+    size_t p = s.find(':');
+    if (p == string::npos)
+      throw JUBATUS_EXCEPTION(converter_exception("invalid libsvm format: " + s));
+    string id = s.substr(0, p);
+    float val = pfi::lang::lexical_cast<float>(s.substr(p + 1));
+    num_values.push_back(make_pair(id, val));
+  }
+
+  ret_label.swap(label);
+  ret_datum.string_values_.clear();
+  ret_datum.num_values_.swap(num_values);
+}
+
+void make_input(int num, int features, string& input) {
+  ostringstream oss;
+  unsigned int seed = 1;
+  for (int i = 0; i < num; ++i) {
+    oss << (i % 2 ? "+1" : "-1");
+    int id = 0;
+    for (int j = 0; j < features; ++j) {
+      seed = seed * 1103515245 + 12345;
+      id += 1 + (seed >> 16) % 100;
+      oss << ' ' << id << ':' << ((seed >> 8) % 10000) / 1000.0;
+    }
+    oss << '\n';
+  }
+  input = oss.str();
+}
+
+void read_input(const string& filename, string& input) {
+  ifstream ifs(filename.c_str());
+  if (!ifs) {
+    cerr << "cannot open: " << filename << endl;
+    return;
+  }
+  input.append(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+}
+
+void run_test(const string& input) {
+  float mb = static_cast<float>(input.size()) / (1024 * 1024);
+
+  size_t lines = 0;
+  size_t values = 0;
+  datum d;
+  string label;
+  clock_t begin = clock();
+  const char* p = input.data();
+  const char* end = p + input.size();
+  while (p != end) {
+    const char* eol = p;
+    while (eol != end && *eol != '\n') {
+      ++eol;
+    }
+    ++lines;
+    libsvm_converter::convert(p, eol, d, label, lines);
+    values += d.num_values_.size();
+    p = eol == end ? end : eol + 1;
+  }
+  clock_t finish = clock();
+  float fast_time = static_cast<float>(finish - begin) / CLOCKS_PER_SEC;
+
+  size_t stream_values = 0;
+  begin = clock();
+  istringstream iss(input);
+  for (string line; getline(iss, line); ) {
+    convert_with_stream(line, d, label);
+    stream_values += d.num_values_.size();
+  }
+  finish = clock();
+  float stream_time = static_cast<float>(finish - begin) / CLOCKS_PER_SEC;
+
+  cout << "lines: " << lines
+       << "\tsize: " << mb << "MB"
+       << "\tvalues: " << values << endl;
+  cout << "\tlibsvm_converter: " << fast_time << "sec ("
+       << mb / fast_time << "MB/s)"
+       << "\tistringstream: " << stream_time << "sec ("
+       << mb / stream_time << "MB/s)" << endl;
+  if (values != stream_values) {
+    cerr << "number of values differ: " << values << " != "
+         << stream_values << endl;
+  }
+}
+
+int main(int argc, char* argv[]) try {
+  cmdline::parser p;
+  p.add<int>("num", 'n', "number of generated lines", false, 100000);
+  p.add<int>("features", 'f', "features per generated line", false, 50);
+  p.set_program_name("libsvm_converter_performance_test");
+  p.footer("[files...]");
+
+  p.parse_check(argc, argv);
+
+  string input;
+  if (p.rest().empty()) {
+    make_input(p.get<int>("num"), p.get<int>("features"), input);
+  } else {
+    for (size_t i = 0; i < p.rest().size(); ++i) {
+      read_input(p.rest()[i], input);
+    }
+  }
+  run_test(input);
+} catch (const jubatus::exception::jubatus_exception& e) {
+  std::cout << e.diagnostic_information(true) << std::endl;
+}
@@ -49,3 +49,75 @@ TEST(libsvm_converter, illegal) {
   ASSERT_THROW(libsvm_converter::convert(line, d, label), converter_exception);
 
 }
+
+TEST(libsvm_converter, illegal_value) {
+  string label;
+  datum d;
+
+  EXPECT_THROW(libsvm_converter::convert("1 1:", d, label), converter_exception);
+  EXPECT_THROW(libsvm_converter::convert("1 1:abc", d, label), converter_exception);
+  EXPECT_THROW(libsvm_converter::convert("1 1:1.5x", d, label), converter_exception);
+  EXPECT_THROW(libsvm_converter::convert("1 1:1e", d, label), converter_exception);
+}
+
+TEST(libsvm_converter, error_position) {
+  string line = "+1 1:0.5 2:x";
+  string label;
+  datum d;
+
+  try {
+    libsvm_converter::convert(line.data(), line.data() + line.size(), d, label, 12);
+    FAIL();
+  } catch (const converter_exception& e) {
+    string msg = e.diagnostic_information(true);
+    EXPECT_NE(string::npos, msg.find("line 12, column 12"));
+  }
+}
+
+TEST(libsvm_converter, number_format) {
+  string line = "  3\t1:1e2  2:-.25 3:+2.5E-1  4:0 5:007 ";
+  string label;
+  datum d;
+
+  libsvm_converter::convert(line, d, label);
+
+  EXPECT_EQ("3", label);
+  ASSERT_EQ(5u, d.num_values_.size());
+  EXPECT_EQ(100.0, d.num_values_[0].second);
+  EXPECT_EQ(-0.25, d.num_values_[1].second);
+  EXPECT_EQ(0.25, d.num_values_[2].second);
+  EXPECT_EQ(0.0, d.num_values_[3].second);
+  EXPECT_EQ(7.0, d.num_values_[4].second);
+}
+
+TEST(libsvm_converter, float_precision) {
+  string label;
+  datum d;
+
+  libsvm_converter::convert("1 1:0.1 2:123456789012345678901234", d, label);
+
+  ASSERT_EQ(2u, d.num_values_.size());
+  EXPECT_EQ(static_cast<float>(0.1), d.num_values_[0].second);
+  EXPECT_EQ(static_cast<float>(1.23456789012345678901234e23),
+            d.num_values_[1].second);
+}
+
+TEST(libsvm_converter, reuse) {
+  string label;
+  datum d;
+  d.string_values_.push_back(make_pair("key", "value"));
+
+  libsvm_converter::convert("1 1:1 2:2 3:3", d, label);
+  EXPECT_EQ(3u, d.num_values_.size());
+  EXPECT_TRUE(d.string_values_.empty());
+
+  libsvm_converter::convert("-1 4:4", d, label);
+  EXPECT_EQ("-1", label);
+  ASSERT_EQ(1u, d.num_values_.size());
+  EXPECT_EQ("4", d.num_values_[0].first);
+  EXPECT_EQ(4.0, d.num_values_[0].second);
+
+  libsvm_converter::convert("", d, label);
+  EXPECT_EQ("", label);
+  EXPECT_TRUE(d.num_values_.empty());
+}
@@ -0,0 +1,172 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <pficommon/concurrent/lock.h>
+#include <pficommon/concurrent/mutex.h>
+#include <pficommon/lang/function.h>
+
+#include "exception.hpp"
+
+namespace jubatus {
+namespace fv_converter {
+
+/**
+   Holds one object per thread, created on first use with the given factory.
+
+   Plugins whose tokenizers keep mutable state (e.g. a MeCab lattice) use
+   this to satisfy the thread safety contract of word_splitter::split etc.
+   without locking: read-only resources are shared by the plugin instance,
+   and per-thread state is taken from the pool.
+   Objects are deleted when their thread exits or when the pool is destroyed.
+ */
+template <class T>
+class thread_local_pool {
+ public:
+  explicit thread_local_pool(const pfi::lang::function<T*()>& factory)
+      : factory_(factory) {
+    if (pthread_key_create(&key_, NULL) != 0) {
+      throw JUBATUS_EXCEPTION(converter_exception("cannot create thread key"));
+    }
+    if (pthread_key_create(&exit_key_, &thread_local_pool::on_thread_exit) != 0) {
+      pthread_key_delete(key_);
+      throw JUBATUS_EXCEPTION(converter_exception("cannot create thread key"));
+    }
+  }
+
+  ~thread_local_pool() {
+    // pthread_key_delete does not wait for on_thread_exit running on other
+    // threads, so entries are released under the lock shared with them.
+    pthread_key_delete(key_);
+    pthread_key_delete(exit_key_);
+    pfi::concurrent::scoped_lock lk(m_);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      live_entries_.erase(entries_[i]->id);
+      delete entries_[i]->object;
+      delete entries_[i];
+    }
+    entries_.clear();
+  }
+
+  /**
+     Returns the object for the calling thread.
+     It must not be passed to other threads.
+   */
+  T& get() {
+    entry* e = static_cast<entry*>(pthread_getspecific(key_));
+    if (e) {
+      return *e->object;
+    }
+
+    e = new entry;
+    e->pool = this;
+    e->object = NULL;
+    try {
+      e->object = factory_();
+      if (!e->object) {
+        throw JUBATUS_EXCEPTION(converter_exception("cannot create thread local object"));
+      }
+      {
+        pfi::concurrent::scoped_lock lk(m_);
+        e->id = ++last_id_;
+        entries_.push_back(e);
+        live_entries_[e->id] = e;
+      }
+      pthread_setspecific(key_, e);
+      pthread_setspecific(exit_key_, reinterpret_cast<void*>(e->id));
+    } catch (...) {
+      delete e->object;
+      delete e;
+      throw;
+    }
+    return *e->object;
+  }
+
+  size_t size() const {
+    pfi::concurrent::scoped_lock lk(m_);
+    return entries_.size();
+  }
+
+ private:
+  thread_local_pool(const thread_local_pool&);
+  thread_local_pool& operator=(const thread_local_pool&);
+
+  struct entry {
+    thread_local_pool* pool;
+    T* object;
+    uintptr_t id;
+  };
+
+  static void on_thread_exit(void* p) {
+    entry* e = remove(reinterpret_cast<uintptr_t>(p));
+    if (e) {
+      delete e->object;
+      delete e;
+    }
+  }
+
+  // Returns NULL if the entry is already released by the destructor of its
+  // pool, which may be running concurrently or be finished.
+  static entry* remove(uintptr_t id) {
+    pfi::concurrent::scoped_lock lk(m_);
+    typename std::map<uintptr_t, entry*>::iterator it = live_entries_.find(id);
+    if (it == live_entries_.end()) {
+      return NULL;
+    }
+    entry* e = it->second;
+    live_entries_.erase(it);
+    std::vector<entry*>& entries = e->pool->entries_;
+    entries.erase(std::remove(entries.begin(), entries.end(), e),
+                  entries.end());
+    return e;
+  }
+
+  pfi::lang::function<T*()> factory_;
+  // holds the entry of each thread
+  pthread_key_t key_;
+  // holds the id of the entry, which is never reused unlike its address, so
+  // that an exiting thread cannot release an entry allocated at the same
+  // address after its own was released by the pool
+  pthread_key_t exit_key_;
+  std::vector<entry*> entries_;
+
+  // shared by all pools of T, so that exiting threads never touch a
+  // destroyed pool to find whether their entries are alive
+  static pfi::concurrent::mutex m_;
+  static uintptr_t last_id_;
+  static std::map<uintptr_t, entry*> live_entries_;
+};
+
+template <class T>
+pfi::concurrent::mutex thread_local_pool<T>::m_;
+
+template <class T>
+uintptr_t thread_local_pool<T>::last_id_ = 0;
+
+template <class T>
+std::map<uintptr_t, typename thread_local_pool<T>::entry*> thread_local_pool<T>::live_entries_;
+
+}
+}
@@ -0,0 +1,116 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include <pficommon/concurrent/lock.h>
+#include <pficommon/concurrent/mutex.h>
+#include <pficommon/concurrent/thread.h>
+#include <pficommon/lang/bind.h>
+#include <pficommon/lang/shared_ptr.h>
+
+#include "thread_local_pool.hpp"
+
+using namespace std;
+using namespace jubatus::fv_converter;
+using pfi::lang::shared_ptr;
+
+namespace {
+
+pfi::concurrent::mutex counter_mutex;
+int live_objects = 0;
+
+struct counted {
+  counted() : value(0) {
+    pfi::concurrent::scoped_lock lk(counter_mutex);
+    ++live_objects;
+  }
+  ~counted() {
+    pfi::concurrent::scoped_lock lk(counter_mutex);
+    --live_objects;
+  }
+  int value;
+};
+
+counted* create_counted() {
+  return new counted;
+}
+
+counted* create_null() {
+  return NULL;
+}
+
+void use_pool(thread_local_pool<counted>* pool, bool* ok) {
+  counted& c = pool->get();
+  for (int i = 0; i < 10000; ++i) {
+    // the object is never shared, so no other thread touches the value
+    if (&pool->get() != &c || c.value != i) {
+      *ok = false;
+      return;
+    }
+    ++c.value;
+  }
+  *ok = true;
+}
+
+}
+
+TEST(thread_local_pool, same_thread) {
+  thread_local_pool<counted> pool(&create_counted);
+  counted& c1 = pool.get();
+  counted& c2 = pool.get();
+  EXPECT_EQ(&c1, &c2);
+  EXPECT_EQ(1u, pool.size());
+}
+
+TEST(thread_local_pool, destroy) {
+  {
+    thread_local_pool<counted> pool(&create_counted);
+    pool.get();
+    EXPECT_EQ(1, live_objects);
+  }
+  EXPECT_EQ(0, live_objects);
+}
+
+TEST(thread_local_pool, factory_failure) {
+  thread_local_pool<counted> pool(&create_null);
+  EXPECT_THROW(pool.get(), converter_exception);
+  EXPECT_EQ(0u, pool.size());
+}
+
+TEST(thread_local_pool, multi_thread) {
+  thread_local_pool<counted> pool(&create_counted);
+  const size_t num_threads = 32;
+  vector<shared_ptr<pfi::concurrent::thread> > ts;
+  bool ok[num_threads];
+  for (size_t i = 0; i < num_threads; ++i) {
+    ok[i] = false;
+    ts.push_back(shared_ptr<pfi::concurrent::thread>(
+        new pfi::concurrent::thread(
+            pfi::lang::bind(&use_pool, &pool, &ok[i]))));
+    ts[i]->start();
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    ts[i]->join();
+    EXPECT_TRUE(ok[i]);
+  }
+  // objects are released when their threads exit
+  EXPECT_EQ(0u, pool.size());
+  EXPECT_EQ(0, live_objects);
+}
@@ -31,6 +31,10 @@ class word_splitter {
   /**
      Returns all word boundaries this splitter found.
      Each baoudary is represented as a pair of a beginning position and its length.
+
+     This method is called concurrently from multiple threads on the same
+     instance. Share read-only resources (dictionaries, models) and keep
+     per-thread working state in a thread_local_pool instead of locking.
    */
   virtual void split(const std::string& string,
                      std::vector<std::pair<size_t, size_t> >& ret_boundaries) const = 0;
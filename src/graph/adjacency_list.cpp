@@ -0,0 +1,137 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "adjacency_list.hpp"
+
+#include <algorithm>
+#include "../common/compaction.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace graph {
+
+namespace {
+
+bool remove_by_swap(uint64_t* edges, uint64_t& size, uint64_t edge) {
+  for (uint64_t i = 0; i < size; ++i) {
+    if (edges[i] == edge) {
+      edges[i] = edges[size - 1];
+      --size;
+      return true;
+    }
+  }
+  return false;
+}
+
+}
+
+adjacency_list::adjacency_list() : appended_num_(0), removed_num_(0) {
+}
+
+void adjacency_list::add(uint64_t node, uint64_t edge) {
+  appended_[node].push_back(edge);
+  ++appended_num_;
+  if (needs_compaction(appended_num_, edges_.size())) {
+    build();
+  }
+}
+
+void adjacency_list::remove(uint64_t node, uint64_t edge) {
+  appended_map_t::iterator it = appended_.find(node);
+  if (it != appended_.end()) {
+    vector<uint64_t>& edges = it->second;
+    vector<uint64_t>::iterator e = find(edges.begin(), edges.end(), edge);
+    if (e != edges.end()) {
+      *e = edges.back();
+      edges.pop_back();
+      --appended_num_;
+      if (edges.empty()) {
+        appended_.erase(it);
+      }
+      return;
+    }
+  }
+  if (node < sizes_.size() && sizes_[node] > 0 &&
+      remove_by_swap(&edges_[offsets_[node]], sizes_[node], edge)) {
+    ++removed_num_;
+    if (needs_compaction(removed_num_, edges_.size() - removed_num_)) {
+      build();
+    }
+  }
+}
+
+adjacency_list::edges_view adjacency_list::get(uint64_t node) const {
+  const uint64_t* packed = NULL;
+  size_t packed_size = 0;
+  if (node < sizes_.size() && sizes_[node] > 0) {
+    packed = &edges_[offsets_[node]];
+    packed_size = sizes_[node];
+  }
+  appended_map_t::const_iterator it = appended_.find(node);
+  return edges_view(packed, packed_size,
+                    it == appended_.end() ? NULL : &it->second);
+}
+
+void adjacency_list::clear() {
+  offsets_.clear();
+  sizes_.clear();
+  edges_.clear();
+  appended_.clear();
+  appended_num_ = 0;
+  removed_num_ = 0;
+}
+
+void adjacency_list::build() {
+  uint64_t node_num = sizes_.size();
+  uint64_t edge_num = appended_num_;
+  for (size_t i = 0; i < sizes_.size(); ++i) {
+    edge_num += sizes_[i];
+  }
+  for (appended_map_t::const_iterator it = appended_.begin();
+       it != appended_.end(); ++it) {
+    node_num = max(node_num, it->first + 1);
+  }
+
+  vector<uint64_t> offsets(node_num + 1);
+  vector<uint64_t> sizes(node_num);
+  vector<uint64_t> edges;
+  edges.reserve(edge_num);
+  for (uint64_t i = 0; i < node_num; ++i) {
+    offsets[i] = edges.size();
+    if (i < sizes_.size()) {
+      edges.insert(edges.end(), edges_.begin() + offsets_[i],
+                   edges_.begin() + offsets_[i] + sizes_[i]);
+    }
+    appended_map_t::const_iterator it = appended_.find(i);
+    if (it != appended_.end()) {
+      edges.insert(edges.end(), it->second.begin(), it->second.end());
+    }
+    sizes[i] = edges.size() - offsets[i];
+  }
+  offsets[node_num] = edges.size();
+
+  offsets_.swap(offsets);
+  sizes_.swap(sizes);
+  edges_.swap(edges);
+  appended_map_t().swap(appended_);
+  appended_num_ = 0;
+  removed_num_ = 0;
+}
+
+}
+}
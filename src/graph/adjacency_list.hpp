@@ -0,0 +1,104 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <pficommon/data/serialization.h>
+#include <pficommon/data/serialization/unordered_map.h>
+#include <pficommon/data/unordered_map.h>
+
+namespace jubatus {
+namespace graph {
+
+// Lists of edges of nodes, both given by indexes. Edges are packed in CSR
+// layout, and edges added after the last build are kept in an append buffer
+// of each node. The buffer is packed when it grows large.
+// A removed edge is swapped with the last edge of the same part of its node,
+// so that edges of a node are not kept in order, and leaves a hole in the
+// packed edges. The list is also built when the holes grow large.
+class adjacency_list {
+public:
+  // A view of edges of a node, which is valid until the list is updated.
+  class edges_view {
+  public:
+    edges_view() : packed_(NULL), packed_size_(0), appended_(NULL) {}
+    edges_view(const uint64_t* packed, size_t packed_size,
+               const std::vector<uint64_t>* appended)
+        : packed_(packed), packed_size_(packed_size), appended_(appended) {}
+
+    size_t size() const {
+      return packed_size_ + (appended_ ? appended_->size() : 0);
+    }
+    bool empty() const {
+      return size() == 0;
+    }
+    uint64_t operator[](size_t i) const {
+      return i < packed_size_ ? packed_[i] : (*appended_)[i - packed_size_];
+    }
+
+  private:
+    const uint64_t* packed_;
+    size_t packed_size_;
+    const std::vector<uint64_t>* appended_;
+  };
+
+  adjacency_list();
+
+  void add(uint64_t node, uint64_t edge);
+  // Does nothing if the node does not have the edge.
+  void remove(uint64_t node, uint64_t edge);
+  edges_view get(uint64_t node) const;
+  void clear();
+
+  // Packs the append buffer and drops holes left by removed edges.
+  void build();
+  size_t appended_size() const {
+    return appended_num_;
+  }
+  size_t removed_size() const {
+    return removed_num_;
+  }
+
+private:
+  friend class pfi::data::serialization::access;
+  template <class Ar>
+  void serialize(Ar& ar) {
+    ar
+        & MEMBER(offsets_)
+        & MEMBER(sizes_)
+        & MEMBER(edges_)
+        & MEMBER(appended_)
+        & MEMBER(appended_num_)
+        & MEMBER(removed_num_);
+  }
+
+  typedef pfi::data::unordered_map<uint64_t, std::vector<uint64_t> > appended_map_t;
+
+  // edges of the i-th node are edges_[offsets_[i], offsets_[i] + sizes_[i])
+  std::vector<uint64_t> offsets_;
+  std::vector<uint64_t> sizes_;
+  std::vector<uint64_t> edges_;
+  appended_map_t appended_;
+  uint64_t appended_num_;
+  // holes left in edges_ by removed edges
+  uint64_t removed_num_;
+};
+
+}
+}
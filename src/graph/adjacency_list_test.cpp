@@ -0,0 +1,147 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+#include "adjacency_list.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace graph {
+
+namespace {
+
+vector<uint64_t> get_sorted(const adjacency_list& a, uint64_t node) {
+  adjacency_list::edges_view v = a.get(node);
+  vector<uint64_t> ret;
+  for (size_t i = 0; i < v.size(); ++i) {
+    ret.push_back(v[i]);
+  }
+  sort(ret.begin(), ret.end());
+  return ret;
+}
+
+}
+
+TEST(adjacency_list, empty) {
+  adjacency_list a;
+  EXPECT_TRUE(a.get(0).empty());
+  EXPECT_TRUE(a.get(100).empty());
+  a.remove(0, 1);
+  a.build();
+  EXPECT_TRUE(a.get(0).empty());
+}
+
+TEST(adjacency_list, add_remove) {
+  adjacency_list a;
+  a.add(0, 10);
+  a.add(0, 11);
+  a.add(2, 12);
+  ASSERT_EQ(2u, a.get(0).size());
+  EXPECT_EQ(10u, a.get(0)[0]);
+  EXPECT_EQ(11u, a.get(0)[1]);
+  EXPECT_TRUE(a.get(1).empty());
+  EXPECT_EQ(3u, a.appended_size());
+
+  // edges are kept through a build
+  a.build();
+  EXPECT_EQ(0u, a.appended_size());
+  ASSERT_EQ(2u, a.get(0).size());
+  EXPECT_EQ(10u, a.get(0)[0]);
+  EXPECT_EQ(11u, a.get(0)[1]);
+  ASSERT_EQ(1u, a.get(2).size());
+
+  // packed and appended edges of the same node
+  a.add(0, 13);
+  a.add(3, 14);
+  a.remove(0, 10);
+  a.remove(2, 12);
+  vector<uint64_t> e0;
+  e0.push_back(11);
+  e0.push_back(13);
+  EXPECT_TRUE(e0 == get_sorted(a, 0));
+  EXPECT_TRUE(a.get(2).empty());
+  ASSERT_EQ(1u, a.get(3).size());
+
+  a.build();
+  EXPECT_TRUE(e0 == get_sorted(a, 0));
+  EXPECT_TRUE(a.get(2).empty());
+  EXPECT_EQ(14u, a.get(3)[0]);
+
+  a.clear();
+  EXPECT_TRUE(a.get(0).empty());
+}
+
+TEST(adjacency_list, build_on_remove) {
+  const uint64_t node_num = 4000;
+  adjacency_list a;
+  for (uint64_t n = 0; n < node_num; ++n) {
+    a.add(n, n + 1);
+  }
+  a.build();
+  for (uint64_t n = 0; n < node_num; ++n) {
+    a.remove(n, n + 1);
+    // holes are dropped when they exceed a quarter of the remaining edges
+    EXPECT_LE(a.removed_size(), max<uint64_t>(1024, (node_num - n - 1) / 4));
+  }
+  for (uint64_t n = 0; n < node_num; ++n) {
+    EXPECT_TRUE(a.get(n).empty());
+  }
+}
+
+TEST(adjacency_list, random) {
+  adjacency_list a;
+  vector<vector<uint64_t> > expected(100);
+  srand(0);
+  for (uint64_t e = 0; e < 10000; ++e) {
+    uint64_t node = rand() % expected.size();
+    a.add(node, e);
+    expected[node].push_back(e);
+    if (rand() % 3 == 0) {
+      uint64_t n = rand() % expected.size();
+      if (!expected[n].empty()) {
+        size_t i = rand() % expected[n].size();
+        a.remove(n, expected[n][i]);
+        expected[n].erase(expected[n].begin() + i);
+      }
+    }
+  }
+  for (uint64_t n = 0; n < expected.size(); ++n) {
+    EXPECT_TRUE(expected[n] == get_sorted(a, n));
+  }
+
+  stringstream ss;
+  {
+    pfi::data::serialization::binary_oarchive oa(ss);
+    oa << a;
+  }
+  adjacency_list b;
+  {
+    pfi::data::serialization::binary_iarchive ia(ss);
+    ia >> b;
+  }
+  for (uint64_t n = 0; n < expected.size(); ++n) {
+    EXPECT_TRUE(expected[n] == get_sorted(b, n));
+  }
+}
+
+}
+}
@@ -15,13 +15,14 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <pficommon/lang/cast.h>
 #include <pficommon/data/serialization/unordered_map.h>
 #include <pficommon/data/serialization.h>
-#include <pficommon/data/unordered_set.h>
 #include "graph_wo_index.hpp"
+#include "../common/compaction.hpp"
 
 using namespace std;
 using namespace pfi::data;
@@ -32,6 +33,14 @@ namespace graph {
 
 namespace {
 
+void renumber(const vector<uint64_t>& new_ids,
+              graph_wo_index::interned_property& p) {
+  for (size_t i = 0; i < p.size(); ++i) {
+    p[i].first = new_ids[p[i].first];
+    p[i].second = new_ids[p[i].second];
+  }
+}
+
 // Debug print
 void print_tree(const shortest_path_tree& spt, ostream& out) {
   out << "landmark = " << spt.landmark << endl;
@@ -61,15 +70,25 @@ bool is_empty_query(const preset_query& query) {
   return query.node_query.empty() && query.edge_query.empty();
 }
 
-bool is_matched_to_query(const vector<pair<string, string> >& query,
-                         const property& prop) {
-  for (size_t i = 0; i < query.size(); ++i) {
-    property::const_iterator it = prop.find(query[i].first);
-    if (it == prop.end() || it->second != query[i].second) {
-      return false;
+void set_bit(vector<uint64_t>& bits, uint64_t i, bool value) {
+  const uint64_t word = i / 64;
+  if (word >= bits.size()) {
+    if (!value) {
+      return;
     }
+    bits.resize(word + 1);
+  }
+  const uint64_t mask = uint64_t(1) << (i % 64);
+  if (value) {
+    bits[word] |= mask;
+  } else {
+    bits[word] &= ~mask;
   }
-  return true;
+}
+
+bool test_bit(const vector<uint64_t>& bits, uint64_t i) {
+  const uint64_t word = i / 64;
+  return word < bits.size() && (bits[word] >> (i % 64)) & 1;
 }
 
 void normalize(eigen_vector_mixed& v) {
@@ -85,7 +104,9 @@ void normalize(eigen_vector_mixed& v) {
 
 }
 
-graph_wo_index::graph_wo_index() : alpha_(0.9){
+const uint64_t graph_wo_index::NOT_LOCAL;
+
+graph_wo_index::graph_wo_index() : unused_property_num_(0), alpha_(0.9){
   clear();
 }
 
@@ -97,18 +118,39 @@ void graph_wo_index::alpha(double a) {
 }
 
 void graph_wo_index::clear(){
-  local_nodes_.clear();
-  local_edges_.clear();
+  properties_.clear();
+  property_refs_.clear();
+  unused_property_num_ = 0;
+  nodes_.clear();
+  edges_.clear();
+  node_slots_.clear();
+  edge_slots_.clear();
+  free_nodes_.clear();
+  free_edges_.clear();
+  in_edges_.clear();
+  out_edges_.clear();
   global_nodes_.clear();
   eigen_scores_.clear();
   spts_.clear();
+  matchers_.clear();
 }
 
 void graph_wo_index::create_node(node_id_t id){
-  if (local_nodes_.count(id) > 0){
+  if (node_slots_.count(id) > 0){
     throw JUBATUS_EXCEPTION(local_node_exists(id));
   }
-  local_nodes_[id] = node_info();
+  uint64_t slot;
+  if (free_nodes_.empty()){
+    slot = nodes_.size();
+    nodes_.push_back(node_entry());
+  } else {
+    slot = free_nodes_.back();
+    free_nodes_.pop_back();
+    nodes_[slot] = node_entry();
+  }
+  nodes_[slot].id = id;
+  node_slots_[id] = slot;
+  update_node_matches(slot);
   may_set_landmark(id);
 }
 
@@ -118,7 +160,7 @@ void graph_wo_index::may_set_landmark(node_id_t id){
   for (spt_query_mixed::iterator it = spts_.begin(); it != spts_.end(); ++it) {
     spt_mixed& mixed = it->second;
     if (mixed.size() == LANDMARK_NUM ||
-        !is_node_matched_to_query(it->first, id)) return;
+        !is_node_matched_to_query(get_matcher(it->first), id)) return;
 
     shortest_path_tree spt;
     spt.landmark = id;
@@ -141,90 +183,120 @@ void graph_wo_index::remove_global_node(node_id_t id){
 }
 
 void graph_wo_index::update_node(node_id_t id, const property& p){
-  node_info_map::iterator it = local_nodes_.find(id);
-  if (it == local_nodes_.end()){
+  uint64_t slot = find_node(id);
+  if (slot == NOT_LOCAL){
     throw JUBATUS_EXCEPTION(unknown_id("update_node", id));
   }
-  it->second.p = p;
+  intern_property(p, nodes_[slot].p);
+  update_node_matches(slot);
   may_set_landmark(id);
+  compact_properties_if_needed();
 }
 
 void graph_wo_index::remove_node(node_id_t id){
-  node_info ni;
-  try {
-    get_node(id, ni);
-  } catch (jubatus::exception::runtime_error&){
+  uint64_t slot = find_node(id);
+  if (slot == NOT_LOCAL){
     throw JUBATUS_EXCEPTION(unknown_id("remove_node", id));
   }
-  if (ni.in_edges.size() > 0 || ni.out_edges.size() > 0){
+  if (!in_edges_.get(slot).empty() || !out_edges_.get(slot).empty()){
     throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(string("graph_wo_index::remove_node unknown id=") + lexical_cast<string>(id)));
   }
-  local_nodes_.erase(id);
+  nodes_[slot].removed = true;
+  release(nodes_[slot].p);
+  interned_property().swap(nodes_[slot].p);
+  update_node_matches(slot);
+  node_slots_.erase(id);
+  free_nodes_.push_back(slot);
+  compact_properties_if_needed();
 }
 
 void graph_wo_index::create_edge(edge_id_t eid, node_id_t src, node_id_t tgt){
-  if (local_nodes_.find(src) == local_nodes_.end() &&
-      local_nodes_.find(tgt) == local_nodes_.end()){
+  uint64_t src_slot = find_node(src);
+  uint64_t tgt_slot = find_node(tgt);
+  if (src_slot == NOT_LOCAL && tgt_slot == NOT_LOCAL){
     throw JUBATUS_EXCEPTION(unknown_id(string("graph_wo_index::create_edge unknown src id=")
                      + lexical_cast<string>(src) + " tgt id=" + lexical_cast<string>(tgt),
                      src));
   }
-  if (local_edges_.count(eid) > 0){
+  if (edge_slots_.count(eid) > 0){
     throw JUBATUS_EXCEPTION(edge_exists(eid));
   }
-  
-  edge_info ei;
-  ei.src = src;
-  ei.tgt = tgt;
-  local_edges_[eid] = ei;
-  if (local_nodes_.count(src) > 0){
-    local_nodes_[src].out_edges.push_back(eid);
+
+  uint64_t slot;
+  if (free_edges_.empty()){
+    slot = edges_.size();
+    edges_.push_back(edge_entry());
+  } else {
+    slot = free_edges_.back();
+    free_edges_.pop_back();
+    edges_[slot] = edge_entry();
   }
-  if (local_nodes_.count(tgt) > 0){
-    local_nodes_[tgt].in_edges.push_back(eid);
+  edge_entry& e = edges_[slot];
+  e.id = eid;
+  e.src = src;
+  e.tgt = tgt;
+  edge_slots_[eid] = slot;
+  update_edge_matches(slot);
+  if (src_slot != NOT_LOCAL){
+    out_edges_.add(src_slot, slot);
+  }
+  if (tgt_slot != NOT_LOCAL){
+    in_edges_.add(tgt_slot, slot);
   }
 }
 
 void graph_wo_index::update_edge(edge_id_t eid, const property& p){
-  edge_info_map::iterator it = local_edges_.find(eid);
-  if (it == local_edges_.end()){
+  uint64_t slot = find_edge(eid);
+  if (slot == NOT_LOCAL){
     throw JUBATUS_EXCEPTION(unknown_id("update_edge:eid", eid));
   }
-  it->second.p = p;
+  intern_property(p, edges_[slot].p);
+  update_edge_matches(slot);
+  compact_properties_if_needed();
 }
 
 void graph_wo_index::remove_edge(edge_id_t eid){
-  edge_info_map::iterator it = local_edges_.find(eid);
-  if (it == local_edges_.end()){
+  uint64_t slot = find_edge(eid);
+  if (slot == NOT_LOCAL){
     throw JUBATUS_EXCEPTION(unknown_id("remove_edge:eid", eid));
   }
-  node_id_t src = it->second.src;
-  node_id_t tgt = it->second.tgt;
-
-  if (local_nodes_.count(src) > 0){
-    remove_by_swap(local_nodes_[src].out_edges, eid);
+  edge_entry& e = edges_[slot];
+  uint64_t src_slot = find_node(e.src);
+  uint64_t tgt_slot = find_node(e.tgt);
+  if (src_slot != NOT_LOCAL){
+    out_edges_.remove(src_slot, slot);
   }
-  if (local_nodes_.count(tgt) > 0){
-    remove_by_swap(local_nodes_[tgt].in_edges, eid);
+  if (tgt_slot != NOT_LOCAL){
+    in_edges_.remove(tgt_slot, slot);
   }
-  
-  local_edges_.erase(it);
+
+  e.removed = true;
+  release(e.p);
+  interned_property().swap(e.p);
+  update_edge_matches(slot);
+  edge_slots_.erase(eid);
+  free_edges_.push_back(slot);
+  compact_properties_if_needed();
 }
-  
+
 void graph_wo_index::add_centrality_query(const preset_query& query) {
   eigen_scores_.insert(make_pair(query, eigen_vector_mixed()));
+  update_matchers();
 }
 
 void graph_wo_index::add_shortest_path_query(const preset_query& query) {
   spts_.insert(make_pair(query, spt_mixed()));
+  update_matchers();
 }
 
 void graph_wo_index::remove_centrality_query(const preset_query& query) {
   eigen_scores_.erase(query);
+  update_matchers();
 }
 
 void graph_wo_index::remove_shortest_path_query(const preset_query& query) {
   spts_.erase(query);
+  update_matchers();
 }
 
 double graph_wo_index::centrality(node_id_t id, centrality_type ct, const preset_query& query) const{
@@ -319,19 +391,282 @@ void graph_wo_index::shortest_path(node_id_t src, node_id_t tgt,
 }
   
 void graph_wo_index::get_node(node_id_t id, node_info& ret) const{
-  node_info_map::const_iterator it = local_nodes_.find(id);
-  if (it == local_nodes_.end()){
+  node_view v = get_node(id);
+  v.p.get(ret.p);
+  v.in_edges.get(ret.in_edges);
+  v.out_edges.get(ret.out_edges);
+}
+
+void graph_wo_index::get_edge(edge_id_t eid, edge_info& ret) const{
+  edge_view v = get_edge(eid);
+  v.p.get(ret.p);
+  ret.src = v.src;
+  ret.tgt = v.tgt;
+}
+
+graph_wo_index::node_view graph_wo_index::get_node(node_id_t id) const{
+  uint64_t slot = find_node(id);
+  if (slot == NOT_LOCAL){
     throw JUBATUS_EXCEPTION(unknown_id("get_node", id));
   }
-  ret = it->second;
+  node_view ret;
+  ret.p = property_view(&properties_, &nodes_[slot].p);
+  ret.in_edges = edge_list_view(in_edges_.get(slot), &edges_);
+  ret.out_edges = edge_list_view(out_edges_.get(slot), &edges_);
+  return ret;
 }
 
-void graph_wo_index::get_edge(edge_id_t eid, edge_info& ret) const{
-  edge_info_map::const_iterator it = local_edges_.find(eid);
-  if (it == local_edges_.end()){
+graph_wo_index::edge_view graph_wo_index::get_edge(edge_id_t eid) const{
+  uint64_t slot = find_edge(eid);
+  if (slot == NOT_LOCAL){
     throw JUBATUS_EXCEPTION(unknown_id("get_edge", eid));
   }
-  ret = it->second;
+  const edge_entry& e = edges_[slot];
+  edge_view ret;
+  ret.p = property_view(&properties_, &e.p);
+  ret.src = e.src;
+  ret.tgt = e.tgt;
+  return ret;
+}
+
+const string* graph_wo_index::property_view::find(const string& key) const{
+  uint64_t key_id = dict_->get_id_const(key);
+  if (key_id == key_manager::NOTFOUND){
+    return NULL;
+  }
+  interned_property::const_iterator it =
+      lower_bound(p_->begin(), p_->end(), make_pair(key_id, uint64_t(0)));
+  if (it == p_->end() || it->first != key_id){
+    return NULL;
+  }
+  return &dict_->get_key(it->second);
+}
+
+void graph_wo_index::property_view::get(property& ret) const{
+  ret.clear();
+  for (size_t i = 0; i < size(); ++i){
+    ret.insert(make_pair(key(i), value(i)));
+  }
+}
+
+edge_id_t graph_wo_index::edge_list_view::operator[](size_t i) const{
+  return (*entries_)[edges_[i]].id;
+}
+
+void graph_wo_index::edge_list_view::get(vector<edge_id_t>& ret) const{
+  ret.resize(size());
+  for (size_t i = 0; i < ret.size(); ++i){
+    ret[i] = (*this)[i];
+  }
+}
+
+uint64_t graph_wo_index::find_node(node_id_t id) const{
+  slot_map::const_iterator it = node_slots_.find(id);
+  return it == node_slots_.end() ? NOT_LOCAL : it->second;
+}
+
+uint64_t graph_wo_index::find_edge(edge_id_t eid) const{
+  slot_map::const_iterator it = edge_slots_.find(eid);
+  return it == edge_slots_.end() ? NOT_LOCAL : it->second;
+}
+
+// The new property is interned before the old one is released, so that
+// strings kept by the update are not counted as unused.
+void graph_wo_index::intern_property(const property& p, interned_property& ret){
+  interned_property interned;
+  interned.reserve(p.size());
+  for (property::const_iterator it = p.begin(); it != p.end(); ++it){
+    interned.push_back(make_pair(intern(it->first), intern(it->second)));
+  }
+  sort(interned.begin(), interned.end());
+  release(ret);
+  ret.swap(interned);
+}
+
+void graph_wo_index::intern_conditions(const vector<pair<string, string> >& query,
+                                       interned_property& ret){
+  interned_property interned;
+  for (size_t i = 0; i < query.size(); ++i){
+    interned.push_back(make_pair(intern(query[i].first), intern(query[i].second)));
+  }
+  release(ret);
+  ret.swap(interned);
+}
+
+uint64_t graph_wo_index::intern(const string& s){
+  uint64_t id = properties_.get_id(s);
+  if (id == property_refs_.size()){
+    property_refs_.push_back(0);
+  } else if (property_refs_[id] == 0){
+    --unused_property_num_;
+  }
+  ++property_refs_[id];
+  return id;
+}
+
+void graph_wo_index::release(const interned_property& p){
+  for (size_t i = 0; i < p.size(); ++i){
+    if (--property_refs_[p[i].first] == 0){
+      ++unused_property_num_;
+    }
+    if (--property_refs_[p[i].second] == 0){
+      ++unused_property_num_;
+    }
+  }
+}
+
+void graph_wo_index::count_property_refs(){
+  property_refs_.assign(properties_.size(), 0);
+  for (uint64_t slot = 0; slot < nodes_.size(); ++slot){
+    const interned_property& p = nodes_[slot].p;
+    for (size_t i = 0; i < p.size(); ++i){
+      ++property_refs_[p[i].first];
+      ++property_refs_[p[i].second];
+    }
+  }
+  for (uint64_t slot = 0; slot < edges_.size(); ++slot){
+    const interned_property& p = edges_[slot].p;
+    for (size_t i = 0; i < p.size(); ++i){
+      ++property_refs_[p[i].first];
+      ++property_refs_[p[i].second];
+    }
+  }
+  for (query_matcher_map::const_iterator it = matchers_.begin(); it != matchers_.end(); ++it){
+    const interned_property* conditions[] = {
+      &it->second.node_conditions, &it->second.edge_conditions
+    };
+    for (size_t j = 0; j < 2; ++j){
+      for (size_t i = 0; i < conditions[j]->size(); ++i){
+        ++property_refs_[(*conditions[j])[i].first];
+        ++property_refs_[(*conditions[j])[i].second];
+      }
+    }
+  }
+  unused_property_num_ = count(property_refs_.begin(), property_refs_.end(), 0u);
+}
+
+void graph_wo_index::compact_properties_if_needed(){
+  if (needs_compaction(unused_property_num_, properties_.size(), 2)){
+    compact_properties();
+  }
+}
+
+// Referenced strings are interned again in the order of their ids, and
+// properties and conditions are renumbered.
+void graph_wo_index::compact_properties(){
+  vector<uint64_t> new_ids(properties_.size(), key_manager::NOTFOUND);
+  key_manager properties;
+  for (uint64_t id = 0; id < properties_.size(); ++id){
+    if (property_refs_[id] > 0){
+      new_ids[id] = properties.get_id(properties_.get_key(id));
+    }
+  }
+
+  for (uint64_t slot = 0; slot < nodes_.size(); ++slot){
+    renumber(new_ids, nodes_[slot].p);
+    sort(nodes_[slot].p.begin(), nodes_[slot].p.end());
+  }
+  for (uint64_t slot = 0; slot < edges_.size(); ++slot){
+    renumber(new_ids, edges_[slot].p);
+    sort(edges_[slot].p.begin(), edges_[slot].p.end());
+  }
+  for (query_matcher_map::iterator it = matchers_.begin(); it != matchers_.end(); ++it){
+    renumber(new_ids, it->second.node_conditions);
+    renumber(new_ids, it->second.edge_conditions);
+  }
+
+  properties_.swap(properties);
+  count_property_refs();
+}
+
+bool graph_wo_index::is_matched(const interned_property& conditions,
+                                const interned_property& p){
+  for (size_t i = 0; i < conditions.size(); ++i){
+    uint64_t key_id = conditions[i].first;
+    interned_property::const_iterator it =
+        lower_bound(p.begin(), p.end(), make_pair(key_id, uint64_t(0)));
+    if (it == p.end() || it->first != key_id ||
+        it->second != conditions[i].second){
+      return false;
+    }
+  }
+  return true;
+}
+
+bool graph_wo_index::query_matcher::is_node_matched(uint64_t slot) const{
+  return test_bit(node_bits, slot);
+}
+
+bool graph_wo_index::query_matcher::is_edge_matched(uint64_t slot) const{
+  return test_bit(edge_bits, slot);
+}
+
+void graph_wo_index::update_matchers(){
+  // drop matchers of removed queries
+  for (query_matcher_map::iterator it = matchers_.begin(); it != matchers_.end(); ){
+    if (eigen_scores_.count(it->first) == 0 && spts_.count(it->first) == 0){
+      release(it->second.node_conditions);
+      release(it->second.edge_conditions);
+      matchers_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+
+  vector<preset_query> queries;
+  for (eigen_vector_query_mixed::const_iterator it = eigen_scores_.begin();
+       it != eigen_scores_.end(); ++it){
+    queries.push_back(it->first);
+  }
+  for (spt_query_mixed::const_iterator it = spts_.begin(); it != spts_.end(); ++it){
+    queries.push_back(it->first);
+  }
+
+  for (size_t i = 0; i < queries.size(); ++i){
+    if (matchers_.count(queries[i]) > 0){
+      continue;
+    }
+    // strings of conditions are interned even if no property has them yet,
+    // so that conditions are not changed by later updates
+    query_matcher& m = matchers_[queries[i]];
+    intern_conditions(queries[i].node_query, m.node_conditions);
+    intern_conditions(queries[i].edge_query, m.edge_conditions);
+
+    for (uint64_t slot = 0; slot < nodes_.size(); ++slot){
+      if (!nodes_[slot].removed && is_matched(m.node_conditions, nodes_[slot].p)){
+        set_bit(m.node_bits, slot, true);
+      }
+    }
+    for (uint64_t slot = 0; slot < edges_.size(); ++slot){
+      if (!edges_[slot].removed && is_matched(m.edge_conditions, edges_[slot].p)){
+        set_bit(m.edge_bits, slot, true);
+      }
+    }
+  }
+}
+
+const graph_wo_index::query_matcher& graph_wo_index::get_matcher(const preset_query& query) const{
+  query_matcher_map::const_iterator it = matchers_.find(query);
+  if (it == matchers_.end()){
+    throw JUBATUS_EXCEPTION(unknown_query(query));
+  }
+  return it->second;
+}
+
+void graph_wo_index::update_node_matches(uint64_t slot){
+  const node_entry& node = nodes_[slot];
+  for (query_matcher_map::iterator it = matchers_.begin(); it != matchers_.end(); ++it){
+    query_matcher& m = it->second;
+    set_bit(m.node_bits, slot, !node.removed && is_matched(m.node_conditions, node.p));
+  }
+}
+
+void graph_wo_index::update_edge_matches(uint64_t slot){
+  const edge_entry& edge = edges_[slot];
+  for (query_matcher_map::iterator it = matchers_.begin(); it != matchers_.end(); ++it){
+    query_matcher& m = it->second;
+    set_bit(m.edge_bits, slot, !edge.removed && is_matched(m.edge_conditions, edge.p));
+  }
 }
 
 string graph_wo_index::type() const {
@@ -339,9 +674,12 @@ string graph_wo_index::type() const {
 }
 
 bool graph_wo_index::save_imp(ostream& os){
+  node_info_map local_nodes;
+  edge_info_map local_edges;
+  get_tables(local_nodes, local_edges);
   pfi::data::serialization::binary_oarchive oa(os);
-  oa << local_nodes_
-     << local_edges_
+  oa << local_nodes
+     << local_edges
      << global_nodes_
      << eigen_scores_
      << spts_;
@@ -349,15 +687,105 @@ bool graph_wo_index::save_imp(ostream& os){
 }
 
 bool graph_wo_index::load_imp(istream& is){
+  node_info_map local_nodes;
+  edge_info_map local_edges;
   pfi::data::serialization::binary_iarchive ia(is);
-  ia >> local_nodes_
-     >> local_edges_
+  ia >> local_nodes
+     >> local_edges
      >> global_nodes_
      >> eigen_scores_
      >> spts_;
+  set_tables(local_nodes, local_edges);
   return true;
 }
 
+void graph_wo_index::get_tables(node_info_map& local_nodes,
+                                edge_info_map& local_edges) const{
+  local_nodes.clear();
+  for (slot_map::const_iterator it = node_slots_.begin(); it != node_slots_.end(); ++it){
+    get_node(it->first, local_nodes[it->first]);
+  }
+  local_edges.clear();
+  for (slot_map::const_iterator it = edge_slots_.begin(); it != edge_slots_.end(); ++it){
+    get_edge(it->first, local_edges[it->first]);
+  }
+}
+
+// Nodes and edges are given slots in the order of the tables, and edges of
+// each node are added in the order of its lists.
+void graph_wo_index::set_tables(const node_info_map& local_nodes,
+                                const edge_info_map& local_edges){
+  properties_.clear();
+  property_refs_.clear();
+  unused_property_num_ = 0;
+  matchers_.clear();
+  in_edges_.clear();
+  out_edges_.clear();
+
+  nodes_.clear();
+  nodes_.resize(local_nodes.size());
+  uint64_t slot = 0;
+  for (node_info_map::const_iterator it = local_nodes.begin();
+       it != local_nodes.end(); ++it, ++slot){
+    nodes_[slot].id = it->first;
+    intern_property(it->second.p, nodes_[slot].p);
+  }
+  edges_.clear();
+  edges_.resize(local_edges.size());
+  slot = 0;
+  for (edge_info_map::const_iterator it = local_edges.begin();
+       it != local_edges.end(); ++it, ++slot){
+    edge_entry& e = edges_[slot];
+    e.id = it->first;
+    e.src = it->second.src;
+    e.tgt = it->second.tgt;
+    intern_property(it->second.p, e.p);
+  }
+  rebuild_slots();
+
+  slot = 0;
+  for (node_info_map::const_iterator it = local_nodes.begin();
+       it != local_nodes.end(); ++it, ++slot){
+    const node_info& info = it->second;
+    for (size_t i = 0; i < info.in_edges.size(); ++i){
+      uint64_t edge_slot = find_edge(info.in_edges[i]);
+      if (edge_slot != NOT_LOCAL){
+        in_edges_.add(slot, edge_slot);
+      }
+    }
+    for (size_t i = 0; i < info.out_edges.size(); ++i){
+      uint64_t edge_slot = find_edge(info.out_edges[i]);
+      if (edge_slot != NOT_LOCAL){
+        out_edges_.add(slot, edge_slot);
+      }
+    }
+  }
+  in_edges_.build();
+  out_edges_.build();
+  update_matchers();
+}
+
+void graph_wo_index::rebuild_slots(){
+  node_slots_.clear();
+  free_nodes_.clear();
+  for (uint64_t i = 0; i < nodes_.size(); ++i){
+    if (nodes_[i].removed){
+      free_nodes_.push_back(i);
+    } else {
+      node_slots_[nodes_[i].id] = i;
+    }
+  }
+  edge_slots_.clear();
+  free_edges_.clear();
+  for (uint64_t i = 0; i < edges_.size(); ++i){
+    if (edges_[i].removed){
+      free_edges_.push_back(i);
+    } else {
+      edge_slots_[edges_[i].id] = i;
+    }
+  }
+}
+
 void graph_wo_index::update_index(){
   update_spt();
 }
@@ -369,6 +797,7 @@ void graph_wo_index::get_diff_eigen_score(eigen_vector_query_diff& diff) const {
        query_it != eigen_scores_.end(); ++query_it) {
     const preset_query& query = query_it->first;
     const eigen_vector_mixed& model = query_it->second;
+    const query_matcher& matcher = get_matcher(query);
 
     double dist = 0;
     for (eigen_vector_mixed::const_iterator it = model.begin();
@@ -378,17 +807,13 @@ void graph_wo_index::get_diff_eigen_score(eigen_vector_query_diff& diff) const {
       }
     }
 
-    unordered_set<node_id_t> unmatched_nodes;
-
     uint64_t new_node_num = 0;
     double dist_from_new_node = 0;
-    for (node_info_map::const_iterator node_it = local_nodes_.begin();
-         node_it != local_nodes_.end(); ++node_it) {
-      if (model.count(node_it->first) == 0) {
-        if (!is_matched_to_query(query.node_query, node_it->second.p)) {
-          unmatched_nodes.insert(node_it->first);
-          continue;
-        }
+    for (size_t slot = 0; slot < nodes_.size(); ++slot) {
+      if (!matcher.is_node_matched(slot)) {
+        continue;
+      }
+      if (model.count(nodes_[slot].id) == 0) {
         dist_from_new_node += 1.0;
         ++new_node_num;
       }
@@ -401,36 +826,25 @@ void graph_wo_index::get_diff_eigen_score(eigen_vector_query_diff& diff) const {
 
     eigen_vector_diff& qdiff = diff[query];
 
-    for (node_info_map::const_iterator node_it = local_nodes_.begin();
-         node_it != local_nodes_.end(); ++node_it) {
-      if (unmatched_nodes.count(node_it->first)) {
-        continue;
-      }
-      if (!is_matched_to_query(query.node_query, node_it->second.p)) {
-        unmatched_nodes.insert(node_it->first);
+    for (size_t slot = 0; slot < nodes_.size(); ++slot) {
+      // removed nodes are never matched
+      if (!matcher.is_node_matched(slot)) {
         continue;
       }
+      const node_entry& node = nodes_[slot];
 
-      const vector<edge_id_t>& in_edges = node_it->second.in_edges;
+      const adjacency_list::edges_view in_edges = in_edges_.get(slot);
       double score = 0;
       for (size_t i = 0; i < in_edges.size(); ++i) {
-        if (unmatched_nodes.count(in_edges[i])) {
-          continue;
-        }
-        edge_info_map::const_iterator edge_it = local_edges_.find(in_edges[i]);
-        if (edge_it == local_edges_.end()) {
+        if (!matcher.is_edge_matched(in_edges[i])) {
           continue;
         }
-
-        const node_id_t src = edge_it->second.src;
-        if (unmatched_nodes.count(src)) {
-          continue;
-        }
-        if (!is_matched_to_query(query.edge_query, edge_it->second.p)) {
+        const edge_entry& edge = edges_[in_edges[i]];
+        if (!is_node_matched_to_query(matcher, edge.src)) {
           continue;
         }
 
-        eigen_vector_mixed::const_iterator it = model.find(edge_it->second.src);
+        eigen_vector_mixed::const_iterator it = model.find(edge.src);
         if (it == model.end()) {
           continue;
         }
@@ -443,36 +857,28 @@ void graph_wo_index::get_diff_eigen_score(eigen_vector_query_diff& diff) const {
       eigen_vector_info ei;
       ei.score = alpha_ * score + 1 - alpha_ + alpha_ * dist;
 
+      const adjacency_list::edges_view out_edges = out_edges_.get(slot);
       if (is_empty_query(query)) {
-        ei.out_degree_num = node_it->second.out_edges.size();
+        ei.out_degree_num = out_edges.size();
       } else {
         uint64_t out_degree = 0;
-        for (size_t i = 0; i < node_it->second.out_edges.size(); ++i) {
-          const edge_info_map::const_iterator edge_it =
-              local_edges_.find(node_it->second.out_edges[i]);
-          const edge_info& edge = edge_it->second;
-          if (unmatched_nodes.count(edge.tgt)) {
-            continue;
-          }
-          if (!is_node_matched_to_query(query, edge.tgt)) {
-            unmatched_nodes.insert(edge.tgt);
-            continue;
-          }
-          if (!is_matched_to_query(query.edge_query, edge.p)) {
-            continue;
+        for (size_t i = 0; i < out_edges.size(); ++i) {
+          if (matcher.is_edge_matched(out_edges[i]) &&
+              is_node_matched_to_query(matcher, edges_[out_edges[i]].tgt)) {
+            ++out_degree;
           }
-          ++out_degree;
         }
         ei.out_degree_num = out_degree;
       }
 
-      qdiff[node_it->first] = ei;
+      qdiff[node.id] = ei;
     }
   }
 }
 
 void graph_wo_index::set_mixed_and_clear_diff_eigen_score(eigen_vector_query_mixed& mixed){
   eigen_scores_ = mixed;
+  update_matchers();
   if (eigen_scores_.size() == 0){
     return;
   }
@@ -486,29 +892,34 @@ void graph_wo_index::set_mixed_and_clear_diff_eigen_score(eigen_vector_query_mix
 
 void graph_wo_index::update_spt_edges(const preset_query& query,
                                       spt_edges& se, node_id_t landmark, bool is_out) {
+  const query_matcher& matcher = get_matcher(query);
   se[landmark] = make_pair(0, landmark);
-  for (node_info_map::const_iterator it = local_nodes_.begin();
-       it != local_nodes_.end(); ++it){
+  for (size_t slot = 0; slot < nodes_.size(); ++slot){
+    if (nodes_[slot].removed) {
+      continue;
+    }
     if (!is_out) {
-      update_spt_node(query, it->second.out_edges, se, is_out);
+      update_spt_node(matcher, out_edges_.get(slot), se, is_out);
     } else {
-      update_spt_node(query, it->second.in_edges, se, is_out);
+      update_spt_node(matcher, in_edges_.get(slot), se, is_out);
     }
   }
 }
 
-void graph_wo_index::update_spt_node(const preset_query& query,
-                                     const vector<edge_id_t>& edges,
+void graph_wo_index::update_spt_node(const query_matcher& matcher,
+                                     const adjacency_list::edges_view& edges,
                                      spt_edges& se,
                                      bool is_out) {
   for (size_t i = 0; i < edges.size(); ++i) {
-    edge_info& edge = local_edges_[edges[i]];
+    if (!matcher.is_edge_matched(edges[i])) {
+      continue;
+    }
+    const edge_entry& edge = edges_[edges[i]];
     const node_id_t from = is_out ? edge.src : edge.tgt;
     const node_id_t to = is_out ? edge.tgt : edge.src;
 
-    if (!is_matched_to_query(query.edge_query, edge.p) ||
-        !is_node_matched_to_query(query, from) ||
-        !is_node_matched_to_query(query, to)) {
+    if (!is_node_matched_to_query(matcher, from) ||
+        !is_node_matched_to_query(matcher, to)) {
       continue;
     }
 
@@ -529,13 +940,13 @@ void graph_wo_index::update_spt_node(const preset_query& query,
   }
 }
 
-bool graph_wo_index::is_node_matched_to_query(const preset_query& query,
+bool graph_wo_index::is_node_matched_to_query(const query_matcher& matcher,
                                               node_id_t id) const {
-  node_info_map::const_iterator it = local_nodes_.find(id);
-  if (it == local_nodes_.end()) {
+  uint64_t slot = find_node(id);
+  if (slot == NOT_LOCAL) {
     return true;
   }
-  return is_matched_to_query(query.node_query, it->second.p);
+  return matcher.is_node_matched(slot);
 }
 
 void graph_wo_index::update_spt(){
@@ -562,9 +973,9 @@ void graph_wo_index::get_diff_shortest_path_tree(spt_query_diff& all_diff)const{
       if (spt.landmark == LONG_LONG_MAX) continue;
       diff[i].landmark = spt.landmark;
 
-      for (node_info_map::const_iterator it = local_nodes_.begin();
-           it != local_nodes_.end(); ++it){
-        const node_id_t id = it->first;
+      for (size_t slot = 0; slot < nodes_.size(); ++slot){
+        if (nodes_[slot].removed) continue;
+        const node_id_t id = nodes_[slot].id;
 
         spt_edges::const_iterator from_it = spt.from_root.find(id);
         if (from_it != spt.from_root.end()){
@@ -582,6 +993,7 @@ void graph_wo_index::get_diff_shortest_path_tree(spt_query_diff& all_diff)const{
 
 void graph_wo_index::set_mixed_and_clear_diff_shortest_path_tree(const spt_query_mixed& mixed){
   spts_ = mixed;
+  update_matchers();
 }
 
 void graph_wo_index::get_diff(string& diff)const{
@@ -614,9 +1026,10 @@ void graph_wo_index::set_mixed_and_clear_diff(const string& mixed){
 }
 
 void graph_wo_index::get_status(map<string, string>& status) const {
-  status["local_node_num"] = lexical_cast<string>(local_nodes_.size());
+  status["local_node_num"] = lexical_cast<string>(node_slots_.size());
   status["global_node_num"] = lexical_cast<string>(global_nodes_.size());
-  status["local_edge_num"] = lexical_cast<string>(local_edges_.size());
+  status["local_edge_num"] = lexical_cast<string>(edge_slots_.size());
+  status["property_num"] = lexical_cast<string>(properties_.size());
 }
 
 void graph_wo_index::mix(const string& diff, string& mixed){
@@ -702,17 +1115,5 @@ void graph_wo_index::mix(const spt_query_diff& all_diff, spt_query_mixed& all_mi
   }
 }
 
-void graph_wo_index::remove_by_swap(std::vector<edge_id_t>& edges, edge_id_t eid){
-  for (size_t i = 0; i < edges.size(); ++i){
-    if (edges[i] == eid){ 
-      if (i+1 < edges.size()){
-        swap(edges[i], edges.back());
-      }
-      edges.resize(edges.size()-1);
-      return;
-    }
-  }
-}
-
 }
 }
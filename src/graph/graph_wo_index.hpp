@@ -19,13 +19,82 @@
 
 #include <pficommon/data/unordered_map.h>
 #include <pficommon/data/unordered_set.h>
+#include "../common/key_manager.hpp"
+#include "adjacency_list.hpp"
 #include "graph_base.hpp"
 
 namespace jubatus{
 namespace graph {
 
+// Nodes and edges are kept in arrays indexed by slots, which are reused
+// after removal, and edges of nodes are kept in adjacency_list by slots.
+// Keys and values of properties are interned through a dictionary shared by
+// nodes and edges. Strings are counted by references from nodes, edges and
+// queries, and the dictionary is rebuilt without unreferenced strings when
+// they grow large.
 class graph_wo_index : public graph_base {
+  struct edge_entry;
+
 public:
+  // (key, value) ids of properties_, sorted by keys
+  typedef std::vector<std::pair<uint64_t, uint64_t> > interned_property;
+
+  // Views of a node and an edge, which refer to the graph and are valid
+  // until it is updated.
+  class property_view {
+  public:
+    property_view() : dict_(NULL), p_(NULL) {}
+    property_view(const key_manager* dict, const interned_property* p)
+        : dict_(dict), p_(p) {}
+
+    size_t size() const {
+      return p_->size();
+    }
+    const std::string& key(size_t i) const {
+      return dict_->get_key((*p_)[i].first);
+    }
+    const std::string& value(size_t i) const {
+      return dict_->get_key((*p_)[i].second);
+    }
+    // Returns NULL if the key is not found.
+    const std::string* find(const std::string& key) const;
+    void get(property& ret) const;
+
+  private:
+    const key_manager* dict_;
+    const interned_property* p_;
+  };
+
+  class edge_list_view {
+  public:
+    edge_list_view() : entries_(NULL) {}
+    edge_list_view(const adjacency_list::edges_view& edges,
+                   const std::vector<edge_entry>* entries)
+        : edges_(edges), entries_(entries) {}
+
+    size_t size() const {
+      return edges_.size();
+    }
+    edge_id_t operator[](size_t i) const;
+    void get(std::vector<edge_id_t>& ret) const;
+
+  private:
+    adjacency_list::edges_view edges_;
+    const std::vector<edge_entry>* entries_;
+  };
+
+  struct node_view {
+    property_view p;
+    edge_list_view in_edges;
+    edge_list_view out_edges;
+  };
+
+  struct edge_view {
+    property_view p;
+    node_id_t src;
+    node_id_t tgt;
+  };
+
   graph_wo_index();
   ~graph_wo_index();
 
@@ -54,6 +123,8 @@ public:
   
   void get_node(node_id_t id, node_info& ret) const;
   void get_edge(edge_id_t eid, edge_info& ret) const;
+  node_view get_node(node_id_t id) const;
+  edge_view get_edge(edge_id_t eid) const;
 
   void get_diff(std::string& diff)const;
   void set_mixed_and_clear_diff(const std::string& mixed);
@@ -66,16 +137,85 @@ public:
   static void mix(const std::string& diff, std::string& mixed);
 
 private:
+  struct node_entry {
+    node_entry() : id(0), removed(false) {}
+
+    node_id_t id;
+    bool removed;
+    interned_property p;
+  };
+
+  struct edge_entry {
+    edge_entry() : id(0), src(0), tgt(0), removed(false) {}
+
+    edge_id_t id;
+    node_id_t src;
+    node_id_t tgt;
+    bool removed;
+    interned_property p;
+  };
+
+  // A preset query compiled into conditions in ids of properties_, with
+  // bits of nodes and edges by slots which match the conditions.
+  // Bits are updated when nodes and edges are created or updated, so that
+  // centralities and shortest path trees only test bits.
+  struct query_matcher {
+    interned_property node_conditions;
+    interned_property edge_conditions;
+    std::vector<uint64_t> node_bits;
+    std::vector<uint64_t> edge_bits;
+
+    bool is_node_matched(uint64_t slot) const;
+    bool is_edge_matched(uint64_t slot) const;
+  };
+
+  typedef pfi::data::unordered_map<node_id_t, uint64_t> slot_map;
+  typedef pfi::data::unordered_map<preset_query, query_matcher> query_matcher_map;
   typedef pfi::data::unordered_map<node_id_t, node_info> node_info_map;
   typedef pfi::data::unordered_map<edge_id_t, edge_info> edge_info_map;
 
   bool save_imp(std::ostream& os);
   bool load_imp(std::istream& is);
-
-  static void remove_by_swap(std::vector<edge_id_t>& edges, edge_id_t eid);
-
-  node_info_map local_nodes_;
-  edge_info_map local_edges_;
+  // The model file keeps the tables of nodes and edges as before.
+  void get_tables(node_info_map& local_nodes, edge_info_map& local_edges) const;
+  void set_tables(const node_info_map& local_nodes, const edge_info_map& local_edges);
+
+  static const uint64_t NOT_LOCAL = ~uint64_t(0);
+  // Returns NOT_LOCAL for unknown ids.
+  uint64_t find_node(node_id_t id) const;
+  uint64_t find_edge(edge_id_t eid) const;
+  void intern_property(const property& p, interned_property& ret);
+  void intern_conditions(const std::vector<std::pair<std::string, std::string> >& query,
+                         interned_property& ret);
+  uint64_t intern(const std::string& s);
+  // Drops references of p, which is left as it is.
+  void release(const interned_property& p);
+  void count_property_refs();
+  void compact_properties_if_needed();
+  void compact_properties();
+  static bool is_matched(const interned_property& conditions, const interned_property& p);
+
+  // Matchers are kept for queries of eigen_scores_ and spts_.
+  void update_matchers();
+  const query_matcher& get_matcher(const preset_query& query) const;
+  void update_node_matches(uint64_t slot);
+  void update_edge_matches(uint64_t slot);
+  void rebuild_slots();
+
+  key_manager properties_;
+  // references to strings of properties_ by their ids
+  std::vector<uint64_t> property_refs_;
+  uint64_t unused_property_num_;
+  std::vector<node_entry> nodes_;
+  std::vector<edge_entry> edges_;
+  slot_map node_slots_;
+  slot_map edge_slots_;
+  std::vector<uint64_t> free_nodes_;
+  std::vector<uint64_t> free_edges_;
+  // edges by their slots for nodes by their slots
+  adjacency_list in_edges_;
+  adjacency_list out_edges_;
+  query_matcher_map matchers_;
   pfi::data::unordered_map<node_id_t, uint8_t> global_nodes_; // value is dummy for serialization
 
   // centeralities
@@ -94,9 +234,10 @@ private:
   void update_spt();
   void update_spt_edges(const preset_query& query,
                         spt_edges& se, node_id_t landmark, bool is_out);
-  void update_spt_node(const preset_query& query,
-                       const std::vector<edge_id_t>& edges, spt_edges& se, bool is_out);
-  bool is_node_matched_to_query(const preset_query& query, node_id_t id) const;
+  void update_spt_node(const query_matcher& matcher,
+                       const adjacency_list::edges_view& edges, spt_edges& se, bool is_out);
+  // Nodes out of this server are matched to any query.
+  bool is_node_matched_to_query(const query_matcher& matcher, node_id_t id) const;
   static void mix_spt(const shortest_path_tree& diff,
                       shortest_path_tree& mixed);
   static void mix(const spt_query_diff& diff, spt_query_mixed& mixed);
@@ -16,6 +16,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <gtest/gtest.h>
+#include <sstream>
 #include <stdexcept>
 #include <pficommon/lang/cast.h>
 #include "graph_wo_index.hpp"
@@ -149,6 +150,187 @@ TEST(graph_wo_index, none){
   g.update_index();
 }
 
+TEST(graph_wo_index, views){
+  graph_wo_index g;
+  g.create_node(1);
+  g.create_node(2);
+  g.create_edge(10, 1, 2);
+  g.create_edge(11, 2, 1);
+  g.create_edge(12, 1, 3);
+
+  property p;
+  p["color"] = "red";
+  p["size"] = "large";
+  g.update_node(1, p);
+  property q;
+  q["color"] = "large";
+  g.update_edge(10, q);
+
+  graph_wo_index::node_view n = g.get_node(1);
+  ASSERT_EQ(2u, n.p.size());
+  ASSERT_TRUE(n.p.find("color") != NULL);
+  EXPECT_EQ("red", *n.p.find("color"));
+  EXPECT_TRUE(n.p.find("large") == NULL);
+  EXPECT_TRUE(n.p.find("weight") == NULL);
+  ASSERT_EQ(1u, n.in_edges.size());
+  EXPECT_EQ(11u, n.in_edges[0]);
+  ASSERT_EQ(2u, n.out_edges.size());
+
+  graph_wo_index::edge_view e = g.get_edge(10);
+  EXPECT_EQ(1u, e.src);
+  EXPECT_EQ(2u, e.tgt);
+  property ep;
+  e.p.get(ep);
+  EXPECT_TRUE(q == ep);
+
+  node_info ni;
+  g.get_node(1, ni);
+  EXPECT_TRUE(p == ni.p);
+  EXPECT_EQ(1u, ni.in_edges.size());
+  EXPECT_EQ(2u, ni.out_edges.size());
+
+  EXPECT_THROW(g.get_node(3), jubatus::exception::runtime_error);
+  EXPECT_THROW(g.get_edge(13), jubatus::exception::runtime_error);
+}
+
+TEST(graph_wo_index, reuse_slots){
+  graph_wo_index g;
+  g.create_node(1);
+  g.create_node(2);
+  g.create_edge(10, 1, 2);
+  g.remove_edge(10);
+  g.remove_node(2);
+
+  // removed slots are reused by new ids
+  g.create_node(3);
+  g.create_edge(11, 3, 1);
+  EXPECT_THROW(g.get_node(2), jubatus::exception::runtime_error);
+  EXPECT_THROW(g.get_edge(10), jubatus::exception::runtime_error);
+  EXPECT_EQ(0u, g.get_node(1).out_edges.size());
+  ASSERT_EQ(1u, g.get_node(1).in_edges.size());
+  EXPECT_EQ(11u, g.get_node(1).in_edges[0]);
+  ASSERT_EQ(1u, g.get_node(3).out_edges.size());
+  EXPECT_EQ(1u, g.get_edge(11).tgt);
+
+  map<string, string> status;
+  g.get_status(status);
+  EXPECT_EQ("2", status["local_node_num"]);
+  EXPECT_EQ("1", status["local_edge_num"]);
+}
+
+TEST(graph_wo_index, compact_properties){
+  preset_query query;
+  query.node_query.push_back(make_pair("kind", "kept"));
+  graph_wo_index g;
+  g.add_centrality_query(query);
+  g.create_node(1);
+  g.create_node(2);
+  property kept;
+  kept["kind"] = "kept";
+  g.update_node(1, kept);
+
+  // values replaced by updates are dropped from the dictionary
+  property p;
+  for (size_t i = 0; i < 10000; ++i) {
+    p["kind"] = "value" + pfi::lang::lexical_cast<string>(i);
+    g.update_node(2, p);
+  }
+  map<string, string> status;
+  g.get_status(status);
+  EXPECT_GT(3000u, pfi::lang::lexical_cast<size_t>(status["property_num"]));
+
+  node_info ni;
+  g.get_node(2, ni);
+  EXPECT_TRUE(p == ni.p);
+  g.get_node(1, ni);
+  EXPECT_TRUE(kept == ni.p);
+
+  // the query still matches after the dictionary is rebuilt
+  g.update_node(2, kept);
+  mix_graph(3, g);
+  EXPECT_NO_THROW(g.centrality(2, EIGENSCORE, query));
+
+  // unused strings are not loaded
+  stringstream ss;
+  g.save(ss);
+  graph_wo_index h;
+  h.load(ss);
+  h.get_status(status);
+  EXPECT_EQ("2", status["property_num"]);
+  h.get_node(2, ni);
+  EXPECT_TRUE(kept == ni.p);
+  EXPECT_NO_THROW(h.centrality(2, EIGENSCORE, query));
+}
+
+TEST(graph_wo_index, save_load){
+  graph_wo_index g;
+  g.create_node(1);
+  g.create_node(2);
+  g.create_node(3);
+  g.create_edge(10, 1, 2);
+  g.create_edge(11, 2, 3);
+  g.remove_edge(10);
+  property p;
+  p["name"] = "two";
+  g.update_node(2, p);
+  g.update_edge(11, p);
+
+  stringstream ss;
+  g.save(ss);
+  graph_wo_index h;
+  h.load(ss);
+
+  node_info ni;
+  h.get_node(2, ni);
+  EXPECT_TRUE(p == ni.p);
+  EXPECT_EQ(0u, ni.in_edges.size());
+  ASSERT_EQ(1u, ni.out_edges.size());
+  EXPECT_EQ(11u, ni.out_edges[0]);
+  EXPECT_THROW(h.get_edge(10), jubatus::exception::runtime_error);
+
+  h.create_edge(12, 3, 1);
+  EXPECT_EQ(1u, h.get_node(1).in_edges.size());
+  EXPECT_EQ(12u, h.get_node(3).out_edges[0]);
+}
+
+TEST(graph_wo_index, load_tables){
+  // models keep the tables of nodes and edges of earlier versions
+  pfi::data::unordered_map<node_id_t, node_info> local_nodes;
+  pfi::data::unordered_map<edge_id_t, edge_info> local_edges;
+  local_nodes[1].out_edges.push_back(10);
+  local_nodes[1].out_edges.push_back(11);
+  local_nodes[2].p["name"] = "two";
+  local_nodes[2].in_edges.push_back(10);
+  local_edges[10].src = 1;
+  local_edges[10].tgt = 2;
+  local_edges[11].src = 1;
+  local_edges[11].tgt = 3;
+  local_edges[11].p["weight"] = "1";
+  pfi::data::unordered_map<node_id_t, uint8_t> global_nodes;
+  eigen_vector_query_mixed eigen_scores;
+  spt_query_mixed spts;
+
+  stringstream ss;
+  {
+    pfi::data::serialization::binary_oarchive oa(ss);
+    oa << local_nodes << local_edges << global_nodes << eigen_scores << spts;
+  }
+  graph_wo_index g;
+  g.load(ss);
+
+  node_info ni;
+  g.get_node(1, ni);
+  EXPECT_TRUE(local_nodes[1].out_edges == ni.out_edges);
+  g.get_node(2, ni);
+  EXPECT_TRUE(local_nodes[2].p == ni.p);
+  EXPECT_TRUE(local_nodes[2].in_edges == ni.in_edges);
+  edge_info ei;
+  g.get_edge(11, ei);
+  EXPECT_TRUE(local_edges[11].p == ei.p);
+  EXPECT_EQ(1u, ei.src);
+  EXPECT_EQ(3u, ei.tgt);
+}
+
 TEST(graph, random){
   graph_wo_index g;
 
@@ -820,5 +1002,79 @@ TEST(graph, eigen_value_edge_query_failure) {
   }
 }
 
+
+void make_query_graph(graph_wo_index& g) {
+  map<string, string> match, unmatch;
+  match["aaa"] = "bbb";
+  unmatch["aaa"] = "ccc";
+
+  for (node_id_t i = 1; i <= 4; ++i) {
+    g.create_node(i);
+    g.create_global_node(i);
+  }
+  g.update_node(4, unmatch);
+  g.create_edge(12, 1, 2);
+  g.update_edge(12, match);
+  g.create_edge(23, 2, 3);
+  g.update_edge(23, match);
+  g.create_edge(31, 3, 1);
+  g.update_edge(31, match);
+  g.create_edge(34, 3, 4);
+  g.update_edge(34, match);
+  g.create_edge(41, 4, 1);
+  g.update_edge(41, unmatch);
+  // matched edges are unmatched by updates, and removed edges are unmatched
+  g.update_edge(31, unmatch);
+  g.remove_edge(23);
+  g.create_edge(32, 2, 3);
+  g.update_edge(32, match);
+}
+
+TEST(graph, query_added_before_and_after_updates) {
+  preset_query query;
+  query.node_query.push_back(make_pair("aaa", "bbb"));
+  query.edge_query.push_back(make_pair("aaa", "bbb"));
+  map<string, string> match;
+  match["aaa"] = "bbb";
+
+  graph_wo_index before, after;
+  before.add_centrality_query(query);
+  before.add_shortest_path_query(query);
+  make_query_graph(before);
+  before.update_node(1, match);
+  before.update_node(2, match);
+  before.update_node(3, match);
+
+  make_query_graph(after);
+  after.update_node(1, match);
+  after.update_node(2, match);
+  after.update_node(3, match);
+  after.add_centrality_query(query);
+  after.add_shortest_path_query(query);
+
+  mix_graph(3, before);
+  mix_graph(3, after);
+
+  for (node_id_t i = 1; i <= 3; ++i) {
+    EXPECT_EQ(before.centrality(i, EIGENSCORE, query),
+              after.centrality(i, EIGENSCORE, query));
+  }
+  EXPECT_THROW(before.centrality(4, EIGENSCORE, query), unknown_id);
+  EXPECT_THROW(after.centrality(4, EIGENSCORE, query), unknown_id);
+
+  vector<node_id_t> path;
+  before.shortest_path(1, 3, 10, path, query);
+  ASSERT_EQ(3u, path.size());
+  EXPECT_EQ(1u, path[0]);
+  EXPECT_EQ(2u, path[1]);
+  EXPECT_EQ(3u, path[2]);
+
+  // edge (3, 1) is unmatched, and node 4 is unmatched
+  before.shortest_path(3, 1, 10, path, query);
+  EXPECT_TRUE(path.empty());
+  before.shortest_path(1, 4, 10, path, query);
+  EXPECT_TRUE(path.empty());
+}
+
 }
 }
@@ -0,0 +1,130 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include "dictionary_splitter.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../fv_converter/exception.hpp"
+#include "../../fv_converter/util.hpp"
+
+using namespace std;
+
+namespace jubatus {
+
+using fv_converter::converter_exception;
+
+namespace {
+
+inline bool is_continuation_byte(char c) {
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+inline size_t next_code_point(const string& s, size_t pos) {
+  ++pos;
+  while (pos < s.size() && is_continuation_byte(s[pos])) {
+    ++pos;
+  }
+  return pos;
+}
+
+dictionary_splitter::match_mode parse_mode(const string& mode) {
+  if (mode == "longest") {
+    return dictionary_splitter::LONGEST;
+  } else if (mode == "all") {
+    return dictionary_splitter::ALL;
+  } else if (mode == "leftmost_longest") {
+    return dictionary_splitter::LEFTMOST_LONGEST;
+  } else {
+    throw JUBATUS_EXCEPTION(converter_exception("unknown mode: " + mode));
+  }
+}
+
+}
+
+dictionary_splitter::dictionary_splitter(const string& dict_path,
+                                         match_mode mode)
+    : mode_(mode) {
+  trie_.load(dict_path);
+}
+
+dictionary_splitter::dictionary_splitter(const vector<string>& keywords,
+                                         match_mode mode)
+    : mode_(mode) {
+  trie_.build(keywords);
+}
+
+void dictionary_splitter::split(const string& string,
+                                vector<pair<size_t, size_t> >& ret_boundaries) const {
+  ret_boundaries.clear();
+  const char* data = string.data();
+  const char* end = data + string.size();
+
+  switch (mode_) {
+    case LONGEST:
+      for (size_t i = 0; i < string.size(); i = next_code_point(string, i)) {
+        size_t len = trie_.longest_prefix_length(data + i, end);
+        if (len > 0) {
+          ret_boundaries.push_back(make_pair(i, len));
+        }
+      }
+      break;
+
+    case ALL: {
+      vector<size_t> lengths;
+      for (size_t i = 0; i < string.size(); i = next_code_point(string, i)) {
+        lengths.clear();
+        trie_.prefix_lengths(data + i, end, lengths);
+        for (size_t j = 0; j < lengths.size(); ++j) {
+          ret_boundaries.push_back(make_pair(i, lengths[j]));
+        }
+      }
+      break;
+    }
+
+    case LEFTMOST_LONGEST: {
+      size_t i = 0;
+      while (i < string.size()) {
+        size_t len = trie_.longest_prefix_length(data + i, end);
+        if (len > 0) {
+          ret_boundaries.push_back(make_pair(i, len));
+          i += len;
+        } else {
+          i = next_code_point(string, i);
+        }
+      }
+      break;
+    }
+  }
+}
+
+}
+
+extern "C" {
+
+jubatus::dictionary_splitter*
+create(const map<string, string>& params) {
+  const string& path = jubatus::fv_converter::get_or_die(params, "dict_path");
+  string mode = jubatus::fv_converter::get_with_default(
+      params, "mode", "leftmost_longest");
+  return new jubatus::dictionary_splitter(path, jubatus::parse_mode(mode));
+}
+
+}
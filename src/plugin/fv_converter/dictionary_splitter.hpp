@@ -0,0 +1,60 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../fv_converter/word_splitter.hpp"
+#include "double_array_trie.hpp"
+
+namespace jubatus {
+
+// Finds dictionary words in UTF-8 text. Matches start only at code point
+// boundaries.
+class dictionary_splitter : public fv_converter::word_splitter {
+ public:
+  enum match_mode {
+    // the longest word at every position; words may overlap
+    LONGEST,
+    // every word at every position
+    ALL,
+    // the longest word from the left, then continue after it
+    LEFTMOST_LONGEST
+  };
+
+  dictionary_splitter(const std::string& dict_path, match_mode mode);
+  dictionary_splitter(const std::vector<std::string>& keywords, match_mode mode);
+
+  void split(const std::string& string,
+             std::vector<std::pair<size_t, size_t> >& ret_boundaries) const;
+
+ private:
+  // read only after construction; split needs no lock
+  double_array_trie trie_;
+  match_mode mode_;
+};
+
+}
+
+extern "C" {
+  jubatus::dictionary_splitter*
+  create(const std::map<std::string, std::string>& params);
+}
@@ -0,0 +1,135 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <pficommon/lang/scoped_ptr.h>
+#include "dictionary_splitter.hpp"
+#include "../../fv_converter/exception.hpp"
+#include "../../fv_converter/test_util.hpp"
+
+using namespace std;
+
+namespace jubatus {
+
+using fv_converter::word_splitter;
+using fv_converter::converter_exception;
+
+namespace {
+
+vector<string> make_keywords() {
+  vector<string> ks;
+  ks.push_back("\xE6\x9D\xB1\xE4\xBA\xAC");  // tokyo
+  ks.push_back("\xE4\xBA\xAC\xE9\x83\xBD");  // kyoto
+  ks.push_back("\xE6\x9D\xB1\xE4\xBA\xAC\xE9\x83\xBD");  // tokyo-to
+  ks.push_back("\xE9\x83\xBD");  // to
+  // the tail bytes of "tokyo"; it must not match inside a character
+  ks.push_back("\x9D\xB1");
+  return ks;
+}
+
+// "tokyo-to kyoto" in Japanese without spaces
+const char* DOC = "\xE6\x9D\xB1\xE4\xBA\xAC\xE9\x83\xBD\xE4\xBA\xAC\xE9\x83\xBD";
+
+}
+
+TEST(dictionary_splitter, leftmost_longest) {
+  dictionary_splitter s(make_keywords(), dictionary_splitter::LEFTMOST_LONGEST);
+  vector<pair<size_t, size_t> > bs;
+  s.split(DOC, bs);
+
+  vector<pair<size_t, size_t> > exp;
+  exp.push_back(make_pair(0, 9));
+  exp.push_back(make_pair(9, 6));
+  PairVectorEquals(exp, bs);
+}
+
+TEST(dictionary_splitter, longest) {
+  dictionary_splitter s(make_keywords(), dictionary_splitter::LONGEST);
+  vector<pair<size_t, size_t> > bs;
+  s.split(DOC, bs);
+
+  vector<pair<size_t, size_t> > exp;
+  exp.push_back(make_pair(0, 9));
+  exp.push_back(make_pair(3, 6));
+  exp.push_back(make_pair(6, 3));
+  exp.push_back(make_pair(9, 6));
+  exp.push_back(make_pair(12, 3));
+  PairVectorEquals(exp, bs);
+}
+
+TEST(dictionary_splitter, all) {
+  dictionary_splitter s(make_keywords(), dictionary_splitter::ALL);
+  vector<pair<size_t, size_t> > bs;
+  s.split(DOC, bs);
+
+  vector<pair<size_t, size_t> > exp;
+  exp.push_back(make_pair(0, 6));
+  exp.push_back(make_pair(0, 9));
+  exp.push_back(make_pair(3, 6));
+  exp.push_back(make_pair(6, 3));
+  exp.push_back(make_pair(9, 6));
+  exp.push_back(make_pair(12, 3));
+  PairVectorEquals(exp, bs);
+}
+
+TEST(dictionary_splitter, ascii) {
+  vector<string> ks;
+  ks.push_back("ueno");
+  ks.push_back("tokyo");
+  dictionary_splitter s(ks, dictionary_splitter::LEFTMOST_LONGEST);
+  vector<pair<size_t, size_t> > bs;
+  s.split("ueno tokyo shinjuku", bs);
+
+  vector<pair<size_t, size_t> > exp;
+  exp.push_back(make_pair(0, 4));
+  exp.push_back(make_pair(5, 5));
+  PairVectorEquals(exp, bs);
+
+  s.split("", bs);
+  EXPECT_TRUE(bs.empty());
+}
+
+TEST(dictionary_splitter, create) {
+  map<string, string> param;
+  ASSERT_THROW(create(param), converter_exception);
+
+  param["dict_path"] = "unknown_file_name";
+  ASSERT_THROW(create(param), converter_exception);
+
+  param["dict_path"] = "../../fv_converter/test_input/keywords";
+  param["mode"] = "unknown_mode";
+  ASSERT_THROW(create(param), converter_exception);
+
+  param["mode"] = "all";
+  pfi::lang::scoped_ptr<word_splitter> s(create(param));
+
+  string d("hoge fuga");
+  vector<pair<size_t, size_t> > bs;
+  s->split(d, bs);
+  ASSERT_EQ(2u, bs.size());
+  ASSERT_EQ(0u, bs[0].first);
+  ASSERT_EQ(4u, bs[0].second);
+  ASSERT_EQ(5u, bs[1].first);
+  ASSERT_EQ(4u, bs[1].second);
+}
+
+}
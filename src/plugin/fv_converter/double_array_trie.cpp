@@ -0,0 +1,372 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include "double_array_trie.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "../../fv_converter/exception.hpp"
+
+using namespace std;
+
+namespace jubatus {
+
+using fv_converter::converter_exception;
+
+namespace {
+
+const char MAGIC[8] = { 'J', 'U', 'B', 'A', 'D', 'A', 'T', '1' };
+
+struct file_header {
+  char magic[8];
+  uint64_t num_units;
+  uint64_t num_keys;
+};
+
+const int32_t FREE = -1;
+const int32_t ROOT_CHECK = -2;
+const int32_t TERMINAL = -1;
+
+// a label 0 marks the end of a key, so bytes are shifted by one
+inline size_t label_of(char c) {
+  return static_cast<unsigned char>(c) + 1;
+}
+
+class builder {
+ public:
+  builder(vector<double_array_trie::unit>& units)
+      : units_(units), next_check_pos_(1) {
+    units_.clear();
+    double_array_trie::unit root = { 0, ROOT_CHECK };
+    units_.push_back(root);
+  }
+
+  template <class Key>
+  void build(size_t node, const Key* begin, const Key* end, size_t depth) {
+    vector<pair<size_t, const Key*> > children;
+    for (const Key* k = begin; k != end; ++k) {
+      size_t label = k->size == depth ? 0 : label_of(k->ptr[depth]);
+      if (children.empty() || children.back().first != label) {
+        children.push_back(make_pair(label, k));
+      }
+    }
+
+    size_t base = find_base(children);
+    units_[node].base = static_cast<int32_t>(base);
+    for (size_t i = 0; i < children.size(); ++i) {
+      units_[base + children[i].first].check = static_cast<int32_t>(node);
+    }
+
+    for (size_t i = 0; i < children.size(); ++i) {
+      size_t child = base + children[i].first;
+      if (children[i].first == 0) {
+        units_[child].base = TERMINAL;
+      } else {
+        const Key* child_end = i + 1 < children.size() ? children[i + 1].second : end;
+        build(child, children[i].second, child_end, depth + 1);
+      }
+    }
+  }
+
+  void shrink() {
+    size_t size = units_.size();
+    while (size > 1 && units_[size - 1].check == FREE) {
+      --size;
+    }
+    units_.resize(size);
+  }
+
+ private:
+  void ensure(size_t index) {
+    if (index >= units_.size()) {
+      double_array_trie::unit free_unit = { 0, FREE };
+      units_.resize(max(index + 1, units_.size() * 2), free_unit);
+    }
+  }
+
+  template <class Child>
+  size_t find_base(const vector<Child>& children) {
+    // same heuristic as darts: skip the dense head of the array
+    size_t first_label = children.front().first;
+    size_t pos = max(first_label + 1, next_check_pos_) - 1;
+    size_t nonzero = 0;
+    bool first = true;
+    size_t base;
+    while (true) {
+      ++pos;
+      ensure(pos);
+      if (units_[pos].check != FREE) {
+        ++nonzero;
+        continue;
+      } else if (first) {
+        next_check_pos_ = pos;
+        first = false;
+      }
+
+      base = pos - first_label;
+      ensure(base + children.back().first);
+      bool ok = true;
+      for (size_t i = 1; i < children.size(); ++i) {
+        if (units_[base + children[i].first].check != FREE) {
+          ok = false;
+          break;
+        }
+      }
+      if (ok) {
+        break;
+      }
+    }
+
+    if (static_cast<double>(nonzero) / (pos - next_check_pos_ + 1) >= 0.95) {
+      next_check_pos_ = pos;
+    }
+    return base;
+  }
+
+  vector<double_array_trie::unit>& units_;
+  size_t next_check_pos_;
+};
+
+struct key_less {
+  template <class Key>
+  bool operator()(const Key& lhs, const Key& rhs) const {
+    int c = memcmp(lhs.ptr, rhs.ptr, min(lhs.size, rhs.size));
+    return c != 0 ? c < 0 : lhs.size < rhs.size;
+  }
+};
+
+struct key_equal {
+  template <class Key>
+  bool operator()(const Key& lhs, const Key& rhs) const {
+    return lhs.size == rhs.size && memcmp(lhs.ptr, rhs.ptr, lhs.size) == 0;
+  }
+};
+
+void throw_file_error(const string& msg, const string& path) {
+  throw JUBATUS_EXCEPTION(converter_exception(msg + path)
+      << jubatus::exception::error_file_name(path)
+      << jubatus::exception::error_errno(errno));
+}
+
+}
+
+double_array_trie::double_array_trie()
+    : units_(NULL), size_(0), num_keys_(0), map_(NULL), map_size_(0) {
+}
+
+double_array_trie::~double_array_trie() {
+  clear();
+}
+
+void double_array_trie::clear() {
+  if (map_) {
+    munmap(map_, map_size_);
+    map_ = NULL;
+    map_size_ = 0;
+  }
+  vector<unit>().swap(buffer_);
+  units_ = NULL;
+  size_ = 0;
+  num_keys_ = 0;
+}
+
+void double_array_trie::build(const vector<string>& keys) {
+  vector<key_ref> refs;
+  refs.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    key_ref r = { keys[i].data(), keys[i].size() };
+    refs.push_back(r);
+  }
+  clear();
+  build_from_refs(refs);
+}
+
+void double_array_trie::build_from_refs(vector<key_ref>& keys) {
+  vector<key_ref> valid;
+  valid.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i].size > 0 && !memchr(keys[i].ptr, '\0', keys[i].size)) {
+      valid.push_back(keys[i]);
+    }
+  }
+  sort(valid.begin(), valid.end(), key_less());
+  valid.erase(unique(valid.begin(), valid.end(), key_equal()), valid.end());
+
+  builder b(buffer_);
+  if (!valid.empty()) {
+    b.build(0, &valid[0], &valid[0] + valid.size(), 0);
+  }
+  b.shrink();
+
+  units_ = &buffer_[0];
+  size_ = buffer_.size();
+  num_keys_ = valid.size();
+}
+
+void double_array_trie::build_text(const char* begin, const char* end) {
+  vector<key_ref> keys;
+  const char* p = begin;
+  while (p != end) {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!eol) {
+      eol = end;
+    }
+    const char* key_end = eol;
+    if (key_end != p && key_end[-1] == '\r') {
+      --key_end;
+    }
+    key_ref r = { p, static_cast<size_t>(key_end - p) };
+    keys.push_back(r);
+    p = eol == end ? end : eol + 1;
+  }
+  build_from_refs(keys);
+}
+
+void double_array_trie::load(const string& path) {
+  clear();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw_file_error("cannot open: ", path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw_file_error("cannot stat: ", path);
+  }
+  size_t size = st.st_size;
+  if (size == 0) {
+    close(fd);
+    vector<key_ref> no_keys;
+    build_from_refs(no_keys);
+    return;
+  }
+
+  void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    throw_file_error("cannot mmap: ", path);
+  }
+
+  const char* data = static_cast<const char*>(map);
+  if (size >= sizeof(file_header) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0) {
+    const file_header* header = reinterpret_cast<const file_header*>(data);
+    // num_units is compared before multiplied, which may overflow
+    const size_t body_size = size - sizeof(file_header);
+    if (header->num_units == 0
+        || body_size % sizeof(unit) != 0
+        || header->num_units != body_size / sizeof(unit)) {
+      munmap(map, size);
+      throw JUBATUS_EXCEPTION(converter_exception("broken dictionary: " + path)
+          << jubatus::exception::error_file_name(path));
+    }
+    // compiled trie is used in place
+    map_ = map;
+    map_size_ = size;
+    units_ = reinterpret_cast<const unit*>(data + sizeof(file_header));
+    size_ = header->num_units;
+    num_keys_ = header->num_keys;
+  } else {
+    try {
+      build_text(data, data + size);
+    } catch (...) {
+      munmap(map, size);
+      throw;
+    }
+    munmap(map, size);
+  }
+}
+
+void double_array_trie::save(const string& path) const {
+  ofstream ofs(path.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!ofs) {
+    throw_file_error("cannot open: ", path);
+  }
+  file_header header;
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.num_units = size_;
+  header.num_keys = num_keys_;
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(units_), size_ * sizeof(unit));
+  if (!ofs) {
+    throw_file_error("cannot write: ", path);
+  }
+}
+
+void double_array_trie::prefix_lengths(const char* begin,
+                                       const char* end,
+                                       vector<size_t>& ret_lengths) const {
+  if (size_ == 0) {
+    return;
+  }
+  size_t node = 0;
+  for (const char* p = begin; ; ++p) {
+    size_t base = units_[node].base;
+    if (p != begin && base < size_
+        && units_[base].check == static_cast<int32_t>(node)) {
+      ret_lengths.push_back(p - begin);
+    }
+    if (p == end) {
+      return;
+    }
+    size_t next = base + label_of(*p);
+    if (next >= size_ || units_[next].check != static_cast<int32_t>(node)) {
+      return;
+    }
+    node = next;
+  }
+}
+
+size_t double_array_trie::longest_prefix_length(const char* begin,
+                                               const char* end) const {
+  if (size_ == 0) {
+    return 0;
+  }
+  size_t longest = 0;
+  size_t node = 0;
+  for (const char* p = begin; ; ++p) {
+    size_t base = units_[node].base;
+    if (p != begin && base < size_
+        && units_[base].check == static_cast<int32_t>(node)) {
+      longest = p - begin;
+    }
+    if (p == end) {
+      return longest;
+    }
+    size_t next = base + label_of(*p);
+    if (next >= size_ || units_[next].check != static_cast<int32_t>(node)) {
+      return longest;
+    }
+    node = next;
+  }
+}
+
+bool double_array_trie::exact_match(const string& key) const {
+  return !key.empty()
+      && longest_prefix_length(key.data(), key.data() + key.size()) == key.size();
+}
+
+}
@@ -0,0 +1,104 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace jubatus {
+
+/**
+   A static byte-wise double-array trie.
+
+   The trie is immutable after build or load, so lookups need no lock.
+   A compiled trie can be saved to a file and loaded with mmap, in which
+   case the array is used directly from the mapping without copying.
+ */
+class double_array_trie {
+ public:
+  struct unit {
+    int32_t base;
+    int32_t check;
+  };
+
+  double_array_trie();
+  ~double_array_trie();
+
+  /**
+     Builds the trie from keys. Empty keys and keys containing '\0' are
+     ignored, and duplicates are allowed.
+   */
+  void build(const std::vector<std::string>& keys);
+
+  /**
+     Loads a dictionary file. A file written by save() is mapped directly;
+     any other file is read as text with one key per line.
+   */
+  void load(const std::string& path);
+
+  void save(const std::string& path) const;
+
+  /**
+     Appends lengths of all keys that are prefixes of [begin, end) to
+     ret_lengths, in ascending order.
+   */
+  void prefix_lengths(const char* begin,
+                      const char* end,
+                      std::vector<size_t>& ret_lengths) const;
+
+  /**
+     Returns the length of the longest key that is a prefix of [begin, end),
+     or 0 when no key matches.
+   */
+  size_t longest_prefix_length(const char* begin, const char* end) const;
+
+  bool exact_match(const std::string& key) const;
+
+  size_t num_units() const {
+    return size_;
+  }
+
+  size_t num_keys() const {
+    return num_keys_;
+  }
+
+ private:
+  double_array_trie(const double_array_trie&);
+  double_array_trie& operator=(const double_array_trie&);
+
+  struct key_ref {
+    const char* ptr;
+    size_t size;
+  };
+
+  void build_from_refs(std::vector<key_ref>& keys);
+  void build_text(const char* begin, const char* end);
+  void clear();
+
+  const unit* units_;
+  size_t size_;
+  size_t num_keys_;
+  std::vector<unit> buffer_;
+
+  void* map_;
+  size_t map_size_;
+};
+
+}
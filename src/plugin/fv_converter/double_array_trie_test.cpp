@@ -0,0 +1,183 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "double_array_trie.hpp"
+#include "../../fv_converter/exception.hpp"
+
+using namespace std;
+
+namespace jubatus {
+
+using fv_converter::converter_exception;
+
+namespace {
+
+vector<size_t> prefix_lengths(const double_array_trie& trie, const string& s) {
+  vector<size_t> lengths;
+  trie.prefix_lengths(s.data(), s.data() + s.size(), lengths);
+  return lengths;
+}
+
+}
+
+TEST(double_array_trie, empty) {
+  double_array_trie trie;
+  EXPECT_EQ(0u, prefix_lengths(trie, "abc").size());
+
+  trie.build(vector<string>());
+  EXPECT_EQ(0u, trie.num_keys());
+  EXPECT_EQ(0u, prefix_lengths(trie, "abc").size());
+  EXPECT_FALSE(trie.exact_match("abc"));
+}
+
+TEST(double_array_trie, prefix) {
+  vector<string> keys;
+  keys.push_back("to");
+  keys.push_back("tokyo");
+  keys.push_back("tok");
+  keys.push_back("kyoto");
+  keys.push_back("tok");
+  keys.push_back("");
+  double_array_trie trie;
+  trie.build(keys);
+
+  EXPECT_EQ(4u, trie.num_keys());
+  vector<size_t> lengths = prefix_lengths(trie, "tokyo tower");
+  ASSERT_EQ(3u, lengths.size());
+  EXPECT_EQ(2u, lengths[0]);
+  EXPECT_EQ(3u, lengths[1]);
+  EXPECT_EQ(5u, lengths[2]);
+
+  string s = "tokyo tower";
+  EXPECT_EQ(5u, trie.longest_prefix_length(s.data(), s.data() + s.size()));
+  EXPECT_EQ(3u, trie.longest_prefix_length(s.data(), s.data() + 4));
+  EXPECT_EQ(0u, trie.longest_prefix_length(s.data() + 1, s.data() + s.size()));
+
+  EXPECT_TRUE(trie.exact_match("kyoto"));
+  EXPECT_FALSE(trie.exact_match("kyot"));
+  EXPECT_FALSE(trie.exact_match("kyotoo"));
+  EXPECT_FALSE(trie.exact_match(""));
+}
+
+TEST(double_array_trie, random) {
+  srand(1);
+  set<string> keys;
+  for (int i = 0; i < 3000; ++i) {
+    string k;
+    size_t len = 1 + rand() % 8;
+    for (size_t j = 0; j < len; ++j) {
+      // include bytes with the highest bit set
+      k += static_cast<char>(j % 2 ? 'a' + rand() % 4 : 0xE0 + rand() % 3);
+    }
+    keys.insert(k);
+  }
+  double_array_trie trie;
+  trie.build(vector<string>(keys.begin(), keys.end()));
+  EXPECT_EQ(keys.size(), trie.num_keys());
+
+  for (set<string>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+    EXPECT_TRUE(trie.exact_match(*it));
+    EXPECT_FALSE(trie.exact_match(*it + "z"));
+    string query = *it + "xyz";
+    vector<size_t> lengths = prefix_lengths(trie, query);
+    vector<size_t> expected;
+    for (size_t len = 1; len <= it->size(); ++len) {
+      if (keys.count(query.substr(0, len))) {
+        expected.push_back(len);
+      }
+    }
+    EXPECT_TRUE(expected == lengths);
+  }
+}
+
+TEST(double_array_trie, load_text) {
+  double_array_trie trie;
+  trie.load("../../fv_converter/test_input/keywords");
+  EXPECT_EQ(2u, trie.num_keys());
+  EXPECT_TRUE(trie.exact_match("hoge"));
+  EXPECT_TRUE(trie.exact_match("fuga"));
+
+  EXPECT_THROW(trie.load("unknown_file_name"), converter_exception);
+}
+
+TEST(double_array_trie, save_and_load) {
+  vector<string> keys;
+  keys.push_back("ueno");
+  keys.push_back("tokyo");
+  keys.push_back("\xE6\x9D\xB1\xE4\xBA\xAC");
+  double_array_trie trie;
+  trie.build(keys);
+
+  const char* path = "./double_array_trie_test.dic";
+  trie.save(path);
+
+  double_array_trie loaded;
+  loaded.load(path);
+  EXPECT_EQ(3u, loaded.num_keys());
+  EXPECT_EQ(trie.num_units(), loaded.num_units());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    EXPECT_TRUE(loaded.exact_match(keys[i]));
+  }
+  EXPECT_FALSE(loaded.exact_match("shinjuku"));
+
+  {
+    // truncated file
+    ofstream ofs(path, ios::out | ios::binary | ios::app);
+    ofs << "x";
+  }
+  EXPECT_THROW(loaded.load(path), converter_exception);
+  remove(path);
+}
+
+TEST(double_array_trie, overflowed_header) {
+  vector<string> keys;
+  keys.push_back("tokyo");
+  double_array_trie trie;
+  trie.build(keys);
+
+  const char* path = "./double_array_trie_test.dic";
+  trie.save(path);
+  uint64_t file_size;
+  {
+    ifstream ifs(path, ios::in | ios::binary);
+    ifs.seekg(0, ios::end);
+    file_size = ifs.tellg();
+  }
+  {
+    // num_units * sizeof(unit) wraps around to the actual size
+    // the header has the magic, num_units and num_keys in 24 bytes
+    const uint64_t unit_size = (file_size - 24) / trie.num_units();
+    uint64_t num_units = trie.num_units() + (~0ULL / unit_size + 1);
+    fstream fs(path, ios::in | ios::out | ios::binary);
+    fs.seekp(8);
+    fs.write(reinterpret_cast<const char*>(&num_units), sizeof(num_units));
+  }
+  double_array_trie loaded;
+  EXPECT_THROW(loaded.load(path), converter_exception);
+  remove(path);
+}
+
+}
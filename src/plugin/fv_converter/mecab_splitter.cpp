@@ -16,6 +16,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <map>
+#include <pficommon/lang/bind.h>
 #include "mecab_splitter.hpp"
 #include "../../fv_converter/exception.hpp"
 #include "../../fv_converter/util.hpp"
@@ -39,27 +40,38 @@ static MeCab::Model* create_mecab_model(const char* arg) {
 }
 
 mecab_splitter::mecab_splitter()
-    : model_(create_mecab_model("")) {
+    : model_(create_mecab_model("")),
+      contexts_(bind(&mecab_splitter::create_context, this)) {
 }
 
 mecab_splitter::mecab_splitter(const char* arg)
-    : model_(create_mecab_model(arg)) {
+    : model_(create_mecab_model(arg)),
+      contexts_(bind(&mecab_splitter::create_context, this)) {
 }
 
-void mecab_splitter::split(const string& string,
-                           vector<pair<size_t, size_t> >& ret_boundaries) const {
-  scoped_ptr<MeCab::Tagger> tagger(model_->createTagger());
+mecab_splitter::tagger_context* mecab_splitter::create_context() const {
+  MeCab::Tagger* tagger = model_->createTagger();
   if (!tagger) {
-    // cannot create tagger
-    return;
+    throw JUBATUS_EXCEPTION(converter_exception("cannot create mecab tagger"));
   }
-  scoped_ptr<MeCab::Lattice> lattice(model_->createLattice());
+  tagger_context* context = new tagger_context;
+  context->tagger.reset(tagger);
+
+  MeCab::Lattice* lattice = model_->createLattice();
   if (!lattice) {
-    // cannot create lattice
-    return;
+    delete context;
+    throw JUBATUS_EXCEPTION(converter_exception("cannot create mecab lattice"));
   }
+  context->lattice.reset(lattice);
+  return context;
+}
+
+void mecab_splitter::split(const string& string,
+                           vector<pair<size_t, size_t> >& ret_boundaries) const {
+  tagger_context& context = contexts_.get();
+  MeCab::Lattice* lattice = context.lattice.get();
   lattice->set_sentence(string.c_str());
-  if (!tagger->parse(lattice.get())) {
+  if (!context.tagger->parse(lattice)) {
     // parse error
     return;
   }
@@ -67,17 +79,15 @@ void mecab_splitter::split(const string& string,
   const MeCab::Node* node = lattice->bos_node();
   size_t p = 0;
 
-  vector<pair<size_t, size_t> > bounds;
+  ret_boundaries.clear();
   for (; node; node = node->next) {
     if (node->stat == MECAB_BOS_NODE || node->stat == MECAB_EOS_NODE)
       continue;
 
     p += node->rlength - node->length;
-    bounds.push_back(make_pair(p, node->length));
+    ret_boundaries.push_back(make_pair(p, node->length));
     p += node->length;
   }
-
-  bounds.swap(ret_boundaries);
 }
 
 }
@@ -21,6 +21,7 @@
 #include <map>
 #include <pficommon/lang/scoped_ptr.h>
 
+#include "../../fv_converter/thread_local_pool.hpp"
 #include "../../fv_converter/word_splitter.hpp"
 
 namespace jubatus {
@@ -34,7 +35,17 @@ class mecab_splitter : public fv_converter::word_splitter {
              std::vector<std::pair<size_t, size_t> >& ret_boundaries) const;
 
  private:
+  // a tagger and a lattice are not thread safe; they are made per thread
+  // from the shared model and reused for every call
+  struct tagger_context {
+    pfi::lang::scoped_ptr<MeCab::Tagger> tagger;
+    pfi::lang::scoped_ptr<MeCab::Lattice> lattice;
+  };
+
+  tagger_context* create_context() const;
+
   pfi::lang::scoped_ptr<MeCab::Model> model_;
+  mutable fv_converter::thread_local_pool<tagger_context> contexts_;
 };
 
 }
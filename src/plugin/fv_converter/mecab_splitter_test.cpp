@@ -25,6 +25,9 @@
 #include <pficommon/concurrent/thread.h>
 
 #include "mecab_splitter.hpp"
+#include "../../fv_converter/datum.hpp"
+#include "../../fv_converter/datum_to_fv_converter.hpp"
+#include "../../fv_converter/match_all.hpp"
 #include "../../fv_converter/test_util.hpp"
 #include "../../fv_converter/exception.hpp"
 
@@ -116,4 +119,52 @@ TEST(mecab_spltter, multi_thread) {
   }
 }
 
+void convert(const fv_converter::datum_to_fv_converter* conv,
+             const sfv_t* expected,
+             bool* ok) {
+  fv_converter::datum d;
+  d.string_values_.push_back(make_pair("/text", "本日は晴天なり"));
+  for (int i = 0; i < 1000; ++i) {
+    sfv_t fv;
+    conv->convert(d, fv);
+    if (fv != *expected) {
+      *ok = false;
+      return;
+    }
+  }
+  *ok = true;
+}
+
+TEST(mecab_splitter, multi_thread_conversion) {
+  fv_converter::datum_to_fv_converter conv;
+  vector<fv_converter::splitter_weight_type> p;
+  p.push_back(fv_converter::splitter_weight_type(
+      fv_converter::FREQ_BINARY, fv_converter::TERM_BINARY));
+  conv.register_string_rule(
+      "mecab",
+      shared_ptr<fv_converter::key_matcher>(new fv_converter::match_all()),
+      shared_ptr<word_splitter>(new mecab_splitter()),
+      p);
+
+  fv_converter::datum d;
+  d.string_values_.push_back(make_pair("/text", "本日は晴天なり"));
+  sfv_t expected;
+  conv.convert(d, expected);
+  ASSERT_EQ(4u, expected.size());
+
+  const size_t num_threads = 32;
+  vector<shared_ptr<thread> > ts;
+  bool ok[num_threads];
+  for (size_t i = 0; i < num_threads; ++i) {
+    ok[i] = false;
+    ts.push_back(shared_ptr<thread>(new thread(
+        pfi::lang::bind(&convert, &conv, &expected, &ok[i]))));
+    ts[i]->start();
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    ts[i]->join();
+    EXPECT_TRUE(ok[i]);
+  }
+}
+
 }
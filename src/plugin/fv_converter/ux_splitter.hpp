@@ -31,6 +31,8 @@ class ux_splitter : public fv_converter::word_splitter {
              std::vector<std::pair<size_t, size_t> >& ret_boundaries) const;
 
  private:
+  // built once in the constructor and never modified, so concurrent
+  // prefixSearch calls in split need no lock
   ux::Trie trie_;
 };
 
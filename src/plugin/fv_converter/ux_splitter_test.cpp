@@ -18,6 +18,9 @@
 #include <gtest/gtest.h>
 
 #include <pficommon/lang/scoped_ptr.h>
+#include <pficommon/lang/shared_ptr.h>
+#include <pficommon/lang/bind.h>
+#include <pficommon/concurrent/thread.h>
 #include "ux_splitter.hpp"
 #include "../../fv_converter/exception.hpp"
 
@@ -77,4 +80,41 @@ TEST(ux_splitter, create) {
   ASSERT_EQ(4u, bs[1].second);
 }
 
+void split_repeatedly(const ux_splitter* splitter, bool* ok) {
+  string doc = "ueno tokyo shinjuku ikebukuro";
+  for (int i = 0; i < 10000; ++i) {
+    vector<pair<size_t, size_t> > bounds;
+    splitter->split(doc, bounds);
+    if (bounds.size() != 4u || bounds[1].first != 5u || bounds[1].second != 5u) {
+      *ok = false;
+      return;
+    }
+  }
+  *ok = true;
+}
+
+TEST(ux_splitter, multi_thread) {
+  vector<string> ks;
+  ks.push_back("ueno");
+  ks.push_back("tokyo");
+  ks.push_back("shinjuku");
+  ks.push_back("ikebukuro");
+  ux_splitter splitter(ks);
+
+  const size_t num_threads = 32;
+  vector<pfi::lang::shared_ptr<pfi::concurrent::thread> > ts;
+  bool ok[num_threads];
+  for (size_t i = 0; i < num_threads; ++i) {
+    ok[i] = false;
+    ts.push_back(pfi::lang::shared_ptr<pfi::concurrent::thread>(
+        new pfi::concurrent::thread(
+            pfi::lang::bind(&split_repeatedly, &splitter, &ok[i]))));
+    ts[i]->start();
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    ts[i]->join();
+    EXPECT_TRUE(ok[i]);
+  }
+}
+
 }
@@ -0,0 +1,116 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <pficommon/lang/bind.h>
+#include "hnsw.hpp"
+#include "../common/exception.hpp"
+#include "../common/thread_pool.hpp"
+
+using namespace std;
+using namespace pfi::lang;
+using namespace jubatus::storage;
+
+namespace jubatus {
+namespace recommender {
+
+// queries answered by a task at least
+static const size_t MIN_QUERY_RANGE_SIZE = 4;
+
+hnsw::hnsw() {
+}
+
+hnsw::hnsw(hnsw_index_storage::metric_type metric, uint64_t m,
+           uint64_t ef_construction, uint64_t ef)
+    : graph_(metric, m, ef_construction, ef) {
+}
+
+hnsw::~hnsw(){
+}
+
+void hnsw::similar_row(const sfv_t& query, vector<pair<string, float> > & ids, size_t ret_num) const{
+  ids.clear();
+  if (ret_num == 0) return;
+  graph_.similar_row(query, ids, ret_num);
+}
+
+void hnsw::clear(){
+  orig_.clear();
+  graph_.clear();
+  rows_changed();
+}
+
+void hnsw::clear_row(const string& id){
+  orig_.remove_row(id);
+  graph_.remove_row(id);
+  row_changed(id);
+}
+
+void hnsw::update_row(const string& id, const sfv_diff_t& diff){
+  orig_.set_row(id, diff);
+  sfv_t row;
+  orig_.get_row(id, row);
+  graph_.set_row(id, row);
+  row_changed(id);
+}
+
+void hnsw::similar_rows(const vector<sfv_t>& queries,
+                        vector<vector<pair<string, float> > >& ids,
+                        size_t ret_num) const{
+  ids.clear();
+  ids.resize(queries.size());
+  if (ret_num == 0) return;
+  common::thread_pool::get_shared().run_ranges(
+      queries.size(), MIN_QUERY_RANGE_SIZE,
+      pfi::lang::bind(&hnsw::similar_rows_range, this, &queries, &ids, ret_num,
+                      pfi::lang::_1, pfi::lang::_2));
+}
+
+void hnsw::similar_rows_range(const vector<sfv_t>* queries,
+                              vector<vector<pair<string, float> > >* ids,
+                              size_t ret_num, size_t begin, size_t end) const{
+  for (size_t i = begin; i < end; ++i){
+    graph_.similar_row((*queries)[i], (*ids)[i], ret_num);
+  }
+}
+
+void hnsw::get_all_row_ids(vector<string>& ids) const{
+  graph_.get_all_row_ids(ids);
+}
+
+string hnsw::type() const{
+  return string("hnsw");
+}
+bool hnsw::save_impl(ostream& os){
+  pfi::data::serialization::binary_oarchive oa(os);
+  oa << graph_;
+  return true;
+}
+bool hnsw::load_impl(istream& is){
+  pfi::data::serialization::binary_iarchive ia(is);
+  ia >> graph_;
+  return true;
+}
+storage::recommender_storage_base* hnsw::get_storage(){
+  return &graph_;
+}
+const storage::recommender_storage_base* hnsw::get_const_storage()const{
+  return &graph_;
+}
+
+} // namespace recommender
+} // namespace jubatus
@@ -0,0 +1,64 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include "recommender_base.hpp"
+#include "../storage/hnsw_index_storage.hpp"
+
+namespace jubatus {
+namespace recommender {
+
+// Rows are searched in a navigable small world graph of them, which scales
+// sublinearly in the number of rows at the cost of exactness.
+//
+// Rows are kept twice. orig_ keeps the raw values of rows updated on this
+// server for decode_row and complete_row, while the graph keeps all mixed
+// rows, normalized for the cosine metric, packed by node for the search.
+class hnsw : public recommender_base {
+public:
+  hnsw();
+  hnsw(storage::hnsw_index_storage::metric_type metric, uint64_t m,
+       uint64_t ef_construction, uint64_t ef);
+  ~hnsw();
+
+  void similar_row(const sfv_t& query, std::vector<std::pair<std::string, float> > & ids, size_t ret_num) const;
+  void clear();
+  void clear_row(const std::string& id);
+  void update_row(const std::string& id, const sfv_diff_t& diff);
+  void similar_rows(const std::vector<sfv_t>& queries,
+                    std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                    size_t ret_num) const;
+  void get_all_row_ids(std::vector<std::string>& ids) const;
+  std::string type() const;
+  storage::recommender_storage_base* get_storage();
+  const storage::recommender_storage_base* get_const_storage() const;
+
+private:
+  bool save_impl(std::ostream&);
+  bool load_impl(std::istream&);
+
+  void similar_rows_range(const std::vector<sfv_t>* queries,
+                          std::vector<std::vector<std::pair<std::string, float> > >* ids,
+                          size_t ret_num, size_t begin, size_t end) const;
+
+  storage::hnsw_index_storage graph_;
+};
+
+} // namespace recommender
+} // namespace jubatus
@@ -0,0 +1,160 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <pficommon/lang/cast.h>
+#include <pficommon/lang/scoped_ptr.h>
+#include "../common/exception.hpp"
+#include "../common/cmdline.h"
+#include "../common/type.hpp"
+#include "recommender_base.hpp"
+#include "recommender_factory.hpp"
+
+using namespace std;
+using namespace jubatus;
+using jubatus::recommender::recommender_base;
+using pfi::lang::lexical_cast;
+
+// Makes dense rows whose components are uniformly distributed in
+// [-0.5, 0.5].
+void make_rows(int num, int dim, vector<vector<float> >& rows) {
+  rows.resize(num);
+  for (int i = 0; i < num; ++i) {
+    rows[i].resize(dim);
+    for (int j = 0; j < dim; ++j) {
+      rows[i][j] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+    }
+  }
+}
+
+sfv_t make_sfv(const vector<float>& v) {
+  sfv_t ret;
+  for (size_t i = 0; i < v.size(); ++i) {
+    ret.push_back(make_pair("c" + lexical_cast<string>(i), v[i]));
+  }
+  return ret;
+}
+
+float calc_score(const string& metric, const vector<float>& x, const vector<float>& y) {
+  float dot = 0, x2 = 0, y2 = 0, d2 = 0;
+  for (size_t i = 0; i < x.size(); ++i) {
+    dot += x[i] * y[i];
+    x2 += x[i] * x[i];
+    y2 += y[i] * y[i];
+    d2 += (x[i] - y[i]) * (x[i] - y[i]);
+  }
+  return metric == "euclid" ? -sqrt(d2) : dot / sqrt(x2 * y2);
+}
+
+// Returns the ids of the top k rows by brute force.
+void search_exactly(const string& metric, const vector<vector<float> >& rows,
+                    const vector<float>& query, int k, vector<string>& ids) {
+  vector<pair<float, int> > scores(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    scores[i] = make_pair(calc_score(metric, query, rows[i]), static_cast<int>(i));
+  }
+  partial_sort(scores.begin(), scores.begin() + k, scores.end(),
+               greater<pair<float, int> >());
+  ids.clear();
+  for (int i = 0; i < k; ++i) {
+    ids.push_back("r" + lexical_cast<string>(scores[i].second));
+  }
+}
+
+int main(int argc, char* argv[]) try {
+  cmdline::parser p;
+  p.add<int>("num", 'n', "number of rows", false, 10000);
+  p.add<int>("dim", 'd', "number of dimensions", false, 32);
+  p.add<int>("query", 'q', "number of queries", false, 100);
+  p.add<int>("k", 'k', "number of similar rows to find", false, 10);
+  p.add<string>("metric", 'm', "cosine or euclid", false, "cosine");
+  p.add<int>("M", 'M', "number of links of a row", false, 16);
+  p.add<int>("ef_construction", 'c', "number of candidates on update", false, 100);
+  p.set_program_name("hnsw_performance_test");
+
+  p.parse_check(argc, argv);
+
+  int k = p.get<int>("k");
+  string metric = p.get<string>("metric");
+  srand(0);
+  vector<vector<float> > rows, queries;
+  make_rows(p.get<int>("num"), p.get<int>("dim"), rows);
+  make_rows(p.get<int>("query"), p.get<int>("dim"), queries);
+  cout << "rows: " << rows.size()
+       << "\tdim: " << p.get<int>("dim")
+       << "\tqueries: " << queries.size()
+       << "\tk: " << k
+       << "\tmetric: " << metric << endl;
+
+  clock_t begin = clock();
+  vector<vector<string> > exact(queries.size());
+  for (size_t i = 0; i < queries.size(); ++i) {
+    search_exactly(metric, rows, queries[i], k, exact[i]);
+  }
+  clock_t end = clock();
+  cout << "brute force: "
+       << static_cast<float>(end - begin) / CLOCKS_PER_SEC / queries.size() * 1000
+       << "msec/query" << endl;
+
+  const int efs[] = { 10, 20, 50, 100, 200 };
+  for (size_t e = 0; e < sizeof(efs) / sizeof(efs[0]); ++e) {
+    map<string, string> param;
+    param["metric"] = metric;
+    param["M"] = lexical_cast<string>(p.get<int>("M"));
+    param["ef_construction"] = lexical_cast<string>(p.get<int>("ef_construction"));
+    param["ef"] = lexical_cast<string>(efs[e]);
+    pfi::lang::scoped_ptr<recommender_base>
+        r(recommender::create_recommender("hnsw", param));
+
+    begin = clock();
+    for (size_t i = 0; i < rows.size(); ++i) {
+      r->update_row("r" + lexical_cast<string>(i), make_sfv(rows[i]));
+    }
+    end = clock();
+    float update_time = static_cast<float>(end - begin) / CLOCKS_PER_SEC;
+
+    size_t found = 0;
+    begin = clock();
+    for (size_t i = 0; i < queries.size(); ++i) {
+      vector<pair<string, float> > ids;
+      r->similar_row(make_sfv(queries[i]), ids, k);
+      for (size_t j = 0; j < ids.size(); ++j) {
+        if (find(exact[i].begin(), exact[i].end(), ids[j].first) != exact[i].end()) {
+          ++found;
+        }
+      }
+    }
+    end = clock();
+    float query_time = static_cast<float>(end - begin) / CLOCKS_PER_SEC;
+
+    cout << "\tef: " << efs[e]
+         << "\trecall: " << static_cast<float>(found) / (queries.size() * k)
+         << "\tupdate: " << update_time << "sec"
+         << "\tquery: " << query_time / queries.size() * 1000 << "msec/query"
+         << endl;
+  }
+} catch (const jubatus::exception::jubatus_exception& e) {
+  std::cout << e.diagnostic_information(true) << std::endl;
+}
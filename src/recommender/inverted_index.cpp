@@ -31,6 +31,10 @@ namespace recommender {
 inverted_index::inverted_index() { 
 }
 
+inverted_index::inverted_index(uint64_t partition_num)
+    : inv_(partition_num) {
+}
+
 inverted_index::~inverted_index() {
 }
 
@@ -43,6 +47,7 @@ void inverted_index::similar_row(const sfv_t& query, std::vector<std::pair<std::
 void inverted_index::clear(){
   orig_.clear();
   inv_.clear();
+  rows_changed();
 }
 
 void inverted_index::clear_row(const std::string& id){
@@ -52,6 +57,7 @@ void inverted_index::clear_row(const std::string& id){
     inv_.remove(columns[i].first, id);
   }
   orig_.remove_row(id);
+  row_changed(id);
 }
 
 void inverted_index::update_row(const std::string& id, const sfv_diff_t& diff){
@@ -59,6 +65,7 @@ void inverted_index::update_row(const std::string& id, const sfv_diff_t& diff){
   for (size_t i = 0; i < diff.size(); ++i){
     inv_.set(diff[i].first, id, diff[i].second);
   }
+  row_changed(id);
 }
 
 void inverted_index::get_all_row_ids(std::vector<std::string>& ids) const{
@@ -26,6 +26,7 @@ namespace recommender {
 class inverted_index : public recommender_base {
 public:
   inverted_index();
+  explicit inverted_index(uint64_t partition_num);
   ~inverted_index();
 
   void similar_row(const sfv_t& query, std::vector<std::pair<std::string, float> > & ids, size_t ret_num) const;
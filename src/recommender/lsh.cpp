@@ -17,9 +17,10 @@
 
 #include <algorithm>
 #include <cmath>
+#include <pficommon/lang/bind.h>
 #include "lsh.hpp"
 #include "../common/exception.hpp"
-#include "../common/hash.hpp"
+#include "../common/thread_pool.hpp"
 #include "lsh_util.hpp"
 
 using namespace std;
@@ -31,6 +32,11 @@ namespace jubatus {
 namespace recommender {
 
 static const uint64_t DEFAULT_BASE_NUM = 64; // should be in config
+// rows (or queries) whose signatures are calculated by a task at least
+static const size_t MIN_SIGNATURE_RANGE_SIZE = 16;
+// saved before signatures, to tell models from those saved before the
+// directions were derived from column hashes, which had no version
+static const uint64_t MODEL_VERSION = 0x6c73680000000002ULL; // "lsh", 2
 
 lsh::lsh(uint64_t base_num)
     : base_num_(base_num) {
@@ -39,6 +45,14 @@ lsh::lsh(uint64_t base_num)
   }
 }
 
+lsh::lsh(uint64_t base_num, uint64_t band_num, uint64_t probe_num,
+         uint64_t partition_num)
+    : row2lshvals_(band_num, probe_num, partition_num), base_num_(base_num) {
+  if (base_num == 0) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error("base_num == 0"));
+  }
+}
+
 lsh::lsh() : base_num_(DEFAULT_BASE_NUM){
 }
 
@@ -56,45 +70,126 @@ void lsh::similar_row(const sfv_t& query, vector<pair<string, float> > & ids, si
 
 void lsh::clear(){
   orig_.clear();
-  column2baseval_.clear();
   row2lshvals_.clear();
+  rows_changed();
 }
 
 void lsh::clear_row(const string& id){
   orig_.remove_row(id);
   row2lshvals_.remove_row(id);
+  row_changed(id);
 }
 
 void lsh::calc_lsh_values(const sfv_t& sfv, bit_vector& bv) const{
-  const_cast<lsh*>(this)->generate_column_bases(sfv);
-
   vector<float> lsh_vals;
-  prod_invert_and_vector(column2baseval_, sfv, base_num_, lsh_vals);
+  calc_projection(sfv, base_num_, lsh_vals);
   set_bit_vector(lsh_vals, bv);
 }
 
-void lsh::generate_column_bases(const sfv_t& sfv){
-  for (size_t i = 0; i < sfv.size(); ++i){
-    generate_column_base(sfv[i].first);
-  }
-}
-
-void lsh::generate_column_base(const string& column){
-  if (column2baseval_.count(column) != 0){
-    return;
-  }
-  const uint32_t seed = hash_util::calc_string_hash(column);
-  generate_random_vector(base_num_, seed, column2baseval_[column]);
-}
-
 void lsh::update_row(const string& id, const sfv_diff_t& diff){
-  generate_column_bases(diff);
   orig_.set_row(id, diff);
   sfv_t row;
   orig_.get_row(id, row);
   bit_vector bv;
   calc_lsh_values(row, bv);
   row2lshvals_.set_row(id, bv);
+  row_changed(id);
+}
+
+void lsh::update_rows(const vector<pair<string, sfv_diff_t> >& rows){
+  // signatures are calculated from the whole rows after all of them are updated
+  for (size_t i = 0; i < rows.size(); ++i){
+    orig_.set_row(rows[i].first, rows[i].second);
+  }
+  vector<sfv_t> sfvs(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i){
+    orig_.get_row(rows[i].first, sfvs[i]);
+  }
+  vector<bit_vector> bvs;
+  calc_lsh_values(sfvs, bvs);
+  for (size_t i = 0; i < rows.size(); ++i){
+    row2lshvals_.set_row(rows[i].first, bvs[i]);
+    row_changed(rows[i].first);
+  }
+}
+
+void lsh::prepare_rows(const vector<pair<string, sfv_diff_t> >& diffs,
+                       prepared_rows& prepared) const{
+  prepared.diffs = diffs;
+  calc_updated_rows(diffs, prepared.rows);
+  calc_lsh_values(prepared.rows, prepared.signatures);
+}
+
+void lsh::apply_rows(const prepared_rows& prepared){
+  const vector<pair<string, sfv_diff_t> >& diffs = prepared.diffs;
+  for (size_t i = 0; i < diffs.size(); ++i){
+    orig_.set_row(diffs[i].first, diffs[i].second);
+  }
+  // signatures of rows updated after prepare_rows are calculated again
+  vector<size_t> changed;
+  vector<sfv_t> rows;
+  find_changed_rows(prepared, changed, rows);
+  vector<bit_vector> bvs;
+  calc_lsh_values(rows, bvs);
+  for (size_t i = 0, j = 0; i < diffs.size(); ++i){
+    if (j < changed.size() && changed[j] == i){
+      row2lshvals_.set_row(diffs[i].first, bvs[j++]);
+    } else {
+      row2lshvals_.set_row(diffs[i].first, prepared.signatures[i]);
+    }
+    row_changed(diffs[i].first);
+  }
+}
+
+void lsh::similar_rows(const vector<sfv_t>& queries,
+                  vector<vector<pair<string, float> > >& ids,
+                  size_t ret_num) const{
+  ids.clear();
+  if (ret_num == 0){
+    ids.resize(queries.size());
+    return;
+  }
+  vector<bit_vector> bvs;
+  calc_lsh_values(queries, bvs);
+  row2lshvals_.similar_rows(bvs, ids, ret_num);
+}
+
+void lsh::similar_rows_impl(const vector<string>& row_ids,
+                            vector<vector<pair<string, float> > >& ids,
+                            size_t ret_num) const{
+  ids.clear();
+  if (ret_num == 0){
+    ids.resize(row_ids.size());
+    return;
+  }
+  vector<bit_vector> bvs(row_ids.size());
+  for (size_t i = 0; i < row_ids.size(); ++i){
+    row2lshvals_.get_row(row_ids[i], bvs[i]);
+    if (bvs[i].bit_num() == 0){
+      // rows without signatures are queried by their decoded rows as
+      // similar_row(id) does
+      sfv_t row;
+      orig_.get_row(row_ids[i], row);
+      calc_lsh_values(row, bvs[i]);
+    }
+  }
+  row2lshvals_.similar_rows(bvs, ids, ret_num);
+}
+
+void lsh::calc_lsh_values(const vector<sfv_t>& sfvs, vector<bit_vector>& bvs) const{
+  bvs.clear();
+  bvs.resize(sfvs.size());
+  common::thread_pool::get_shared().run_ranges(
+      sfvs.size(), MIN_SIGNATURE_RANGE_SIZE,
+      pfi::lang::bind(&lsh::calc_lsh_values_range, this, &sfvs, &bvs,
+                      pfi::lang::_1, pfi::lang::_2));
+}
+
+void lsh::calc_lsh_values_range(const vector<sfv_t>* sfvs, vector<bit_vector>* bvs,
+                                size_t begin, size_t end) const{
+  for (size_t i = begin; i < end; ++i){
+    calc_lsh_values((*sfvs)[i], (*bvs)[i]);
+  }
 }
 
 void lsh::get_all_row_ids(std::vector<std::string>& ids) const{
@@ -106,16 +201,54 @@ string lsh::type() const{
 }
 bool lsh::save_impl(std::ostream& os){
   pfi::data::serialization::binary_oarchive oa(os);
-  oa << column2baseval_;
+  uint64_t version = MODEL_VERSION;
+  oa << version;
   oa << row2lshvals_;
   return true;
 }
 bool lsh::load_impl(std::istream& is){
+  const streampos pos = is.tellg();
+  uint64_t version = 0;
+  {
+    pfi::data::serialization::binary_iarchive ia(is);
+    ia >> version;
+  }
+  if (version == MODEL_VERSION){
+    pfi::data::serialization::binary_iarchive ia(is);
+    ia >> row2lshvals_;
+    return true;
+  }
+  if (pos == streampos(-1)){
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "unsupported lsh model: cannot read a model without a version again"));
+  }
+
+  // Earlier models start with the table of random vectors of columns, and
+  // their signatures were calculated with those vectors.
+  is.clear();
+  is.seekg(pos);
   pfi::data::serialization::binary_iarchive ia(is);
-  ia >> column2baseval_;
+  pfi::data::unordered_map<string, vector<float> > column2baseval;
+  ia >> column2baseval;
   ia >> row2lshvals_;
+  load_old_signatures();
   return true;
 }
+
+void lsh::load_old_signatures(){
+  // Signatures of rows in orig_ are calculated again, and are sent to the
+  // other servers at the next mix. Other rows are replaced when the servers
+  // updating them do the same.
+  vector<string> ids;
+  orig_.get_all_row_ids(ids);
+  for (size_t i = 0; i < ids.size(); ++i){
+    sfv_t row;
+    orig_.get_row(ids[i], row);
+    bit_vector bv;
+    calc_lsh_values(row, bv);
+    row2lshvals_.set_row(ids[i], bv);
+  }
+}
 storage::recommender_storage_base* lsh::get_storage(){
   return &row2lshvals_;
 }
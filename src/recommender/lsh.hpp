@@ -26,6 +26,8 @@ namespace recommender {
 class lsh : public recommender_base {
 public:
   lsh(uint64_t base_num);
+  lsh(uint64_t base_num, uint64_t band_num, uint64_t probe_num,
+      uint64_t partition_num);
   lsh();
   ~lsh();
 
@@ -33,6 +35,13 @@ public:
   void clear();
   void clear_row(const std::string& id);
   void update_row(const std::string& id, const sfv_diff_t& diff);
+  void update_rows(const std::vector<std::pair<std::string, sfv_diff_t> >& rows);
+  void prepare_rows(const std::vector<std::pair<std::string, sfv_diff_t> >& diffs,
+                    prepared_rows& prepared) const;
+  void apply_rows(const prepared_rows& prepared);
+  void similar_rows(const std::vector<sfv_t>& queries,
+                    std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                    size_t ret_num) const;
   void get_all_row_ids(std::vector<std::string>& ids) const;
   std::string type() const;
   storage::recommender_storage_base* get_storage();
@@ -41,12 +50,18 @@ public:
 private:
   bool save_impl(std::ostream&);
   bool load_impl(std::istream&);
+  void load_old_signatures();
+  // stored signatures are used as queries, without calculating them again
+  void similar_rows_impl(const std::vector<std::string>& row_ids,
+                         std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                         size_t ret_num) const;
 
   void calc_lsh_values(const sfv_t& sfv, storage::bit_vector& bv) const;
-  void generate_column_base(const std::string& column);
-  void generate_column_bases(const sfv_t& v);
-  
-  pfi::data::unordered_map<std::string, std::vector<float> > column2baseval_; // bases for lsh
+  // signatures of many vectors are calculated on the shared thread pool
+  void calc_lsh_values(const std::vector<sfv_t>& sfvs, std::vector<storage::bit_vector>& bvs) const;
+  void calc_lsh_values_range(const std::vector<sfv_t>* sfvs, std::vector<storage::bit_vector>* bvs,
+                             size_t begin, size_t end) const;
+
   storage::bit_index_storage row2lshvals_;
 
   const uint64_t base_num_;
@@ -15,9 +15,9 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
-#include <cmath>
-#include <pficommon/math/random.h>
+#include <algorithm>
 #include "lsh_util.hpp"
+#include "../common/hash.hpp"
 #include "../storage/bit_vector.hpp"
 
 namespace jubatus {
@@ -25,16 +25,6 @@ namespace recommender {
 
 using namespace std;
 using jubatus::storage::bit_vector;
-using pfi::data::unordered_map;
-
-void generate_random_vector(size_t dim, uint32_t seed, vector<float>& ret) {
-  pfi::math::random::mtrand rnd(seed);
-  vector<float> v(dim);
-  for (uint64_t i = 0; i < dim; ++i){
-    v[i] = rnd.next_gaussian();
-  }
-  ret.swap(v);
-}
 
 void set_bit_vector(const std::vector<float>& vec,
                     bit_vector& bit_vec) {
@@ -48,25 +38,21 @@ void set_bit_vector(const std::vector<float>& vec,
   bit_vec.swap(bv);
 }
 
-void prod_invert_and_vector(
-    const unordered_map<string, vector<float> >& matrix,
-    const sfv_t& vec,
-    size_t dim,
-    vector<float>& ret) {
+void calc_projection(const sfv_t& vec, size_t dim, vector<float>& ret) {
   vector<float> r(dim);
   for (size_t i = 0; i < vec.size(); ++i){
-    const string& column = vec[i].first;
+    uint64_t column_hash = hash_util::calc_string_hash(vec[i].first);
     float val = vec[i].second;
-    unordered_map<string, vector<float> >::const_iterator it = matrix.find(column);
-    if (it == matrix.end()){
-      continue;
-    }
-    const vector<float>& v = it->second;
 
-    // assert(v.size() == base_num_);
-    for (size_t j = 0; j < v.size(); ++j){
-      r[j] += v[j] * val;
-    }  
+    // each bit of a 64-bit hash gives a +1 or -1 component of a direction
+    const float signed_val[2] = { -val, val };
+    for (size_t j = 0; j < dim; j += 64){
+      const uint64_t h = hash_util::mix64(column_hash + (j / 64 + 1) * 0x9e3779b97f4a7c15ULL);
+      const size_t end = min(dim, j + 64);
+      for (size_t k = j; k < end; ++k){
+        r[k] += signed_val[(h >> (k - j)) & 1];
+      }
+    }
   }
 
   ret.swap(r);
@@ -19,7 +19,6 @@
 
 #include <vector>
 #include <string>
-#include <pficommon/data/unordered_map.h>
 #include "../common/type.hpp"
 
 namespace jubatus {
@@ -31,16 +30,13 @@ class bit_vector;
 namespace recommender {
 
 
-void generate_random_vector(size_t dim, uint32_t seed, std::vector<float>& v);
-
 void set_bit_vector(const std::vector<float>& vec,
                     storage::bit_vector& bit_vec);
 
-void prod_invert_and_vector(
-    const pfi::data::unordered_map<std::string, std::vector<float> >& matrix,
-    const sfv_t& vec,
-    size_t dim,
-    std::vector<float>& ret);
+// Projects vec onto dim random directions. Components of the directions
+// are +1 or -1, taken from bits of the hash of the column and the index of
+// the direction, so that no random vector has to be stored.
+void calc_projection(const sfv_t& vec, size_t dim, std::vector<float>& ret);
 
 }
 }
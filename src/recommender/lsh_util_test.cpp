@@ -2,28 +2,13 @@
 
 #include "lsh_util.hpp"
 #include "../storage/bit_vector.hpp"
-#include <pficommon/data/unordered_map.h>
+#include <pficommon/lang/cast.h>
 
 namespace jubatus {
 namespace recommender {
 
 using namespace std;
 using jubatus::storage::bit_vector;
-using pfi::data::unordered_map;
-
-TEST(generate_random_vector, empty) {
-  vector<float> v;
-  generate_random_vector(0, 0, v);
-  EXPECT_TRUE(v.empty());
-}
-
-TEST(generate_random_vector, trivial) {
-  vector<float> v1, v2;
-  generate_random_vector(10, 0, v1);
-  generate_random_vector(10, 1, v2);
-  EXPECT_EQ(10u, v1.size());
-  EXPECT_NE(v1, v2);
-}
 
 TEST(set_bit_vector, trivial) {
   vector<float> v;
@@ -42,26 +27,53 @@ TEST(set_bit_vector, trivial) {
   EXPECT_TRUE(bv == expect);
 }
 
-TEST(prod_invert_and_vector, trivial) {
-  unordered_map<string, vector<float> > m;
-  m["c1"].push_back(1.0);
-  m["c1"].push_back(0.0);
-  m["c1"].push_back(2.0);
-
-  m["c2"].push_back(0.0);
-  m["c2"].push_back(1.0);
-  m["c2"].push_back(0.0);
+TEST(calc_projection, trivial) {
+  sfv_t v1;
+  v1.push_back(make_pair("c1", 1.0));
+  sfv_t v2;
+  v2.push_back(make_pair("c2", 2.0));
+  sfv_t v3(v1);
+  v3.push_back(make_pair("c2", 2.0));
 
-  sfv_t v;
-  v.push_back(make_pair("c1", 2.0));
+  vector<float> r1, r2, r3;
+  calc_projection(v1, 65, r1);
+  calc_projection(v2, 65, r2);
+  calc_projection(v3, 65, r3);
+  ASSERT_EQ(65u, r1.size());
+  ASSERT_EQ(65u, r3.size());
+  EXPECT_NE(r1, r2);
 
+  // the projection is linear, and the same for the same column
+  for (size_t i = 0; i < r3.size(); ++i) {
+    EXPECT_NEAR(r1[i] + r2[i], r3[i], 1e-5);
+  }
   vector<float> r;
-  prod_invert_and_vector(m, v, 3, r);
+  calc_projection(v1, 10, r);
+  ASSERT_EQ(10u, r.size());
+  for (size_t i = 0; i < r.size(); ++i) {
+    EXPECT_EQ(r1[i], r[i]);
+  }
+
+  calc_projection(sfv_t(), 10, r);
+  EXPECT_EQ(vector<float>(10), r);
+}
 
-  ASSERT_EQ(3u, r.size());
-  EXPECT_FLOAT_EQ(2.0, r[0]);
-  EXPECT_FLOAT_EQ(0.0, r[1]);
-  EXPECT_FLOAT_EQ(4.0, r[2]);
+TEST(calc_projection, sign_distribution) {
+  size_t positive = 0;
+  const size_t n = 1000, dim = 100;
+  for (size_t i = 0; i < n; ++i) {
+    sfv_t v;
+    v.push_back(make_pair("c" + pfi::lang::lexical_cast<string>(i), 2.0));
+    vector<float> r;
+    calc_projection(v, dim, r);
+    for (size_t j = 0; j < dim; ++j) {
+      ASSERT_TRUE(r[j] == 2.f || r[j] == -2.f);
+      if (r[j] > 0) {
+        ++positive;
+      }
+    }
+  }
+  EXPECT_NEAR(0.5, static_cast<double>(positive) / (n * dim), 0.01);
 }
 
 }
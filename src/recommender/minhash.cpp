@@ -18,9 +18,11 @@
 #include <algorithm>
 #include <cmath>
 #include <float.h>
+#include <pficommon/lang/bind.h>
 #include "minhash.hpp"
 #include "../common/exception.hpp"
 #include "../common/hash.hpp"
+#include "../common/thread_pool.hpp"
 
 using namespace std;
 using namespace pfi::data;
@@ -32,7 +34,26 @@ namespace recommender {
 
 const uint64_t minhash::hash_prime = 0xc3a5c85c97cb3127ULL;
 
-minhash::minhash() : hash_num_ (64){
+namespace {
+
+// densification gives up and leaves a bin empty after this many tries per bin
+const uint64_t MAX_DENSIFICATION_TRIES = 1024;
+
+// rows (or queries) whose signatures are calculated by a task at least
+const size_t MIN_SIGNATURE_RANGE_SIZE = 16;
+
+}
+
+minhash::minhash() : hash_num_ (64), hash_type_(INDEPENDENT), bit_width_(1){
+}
+
+minhash::minhash(uint64_t hash_num, hash_type type, uint64_t bit_width,
+                 uint64_t band_num, uint64_t probe_num, uint64_t partition_num)
+    : hash_num_(hash_num), hash_type_(type), bit_width_(bit_width),
+      row2minhashvals_(band_num, probe_num, partition_num, bit_width) {
+  if (hash_num == 0) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error("hash_num == 0"));
+  }
 }
 
 minhash::~minhash(){
@@ -45,19 +66,42 @@ void minhash::similar_row(const sfv_t& query, vector<pair<string, float> > & ids
   bit_vector query_bv;
   calc_minhash_values(query, query_bv);
   row2minhashvals_.similar_row(query_bv, ids, ret_num);
+  correct_scores(ids);
 }
 
 void minhash::clear(){
   orig_.clear();
   row2minhashvals_.clear();
+  rows_changed();
 }
 
 void minhash::clear_row(const string& id){
   orig_.remove_row(id);
   row2minhashvals_.remove_row(id);
+  row_changed(id);
 }
 
+// The lowest bit_width_ bits of the key hash of the feature which gives the
+// minimum value are kept for each hash.
 void minhash::calc_minhash_values(const sfv_t& sfv, bit_vector& bv) const{
+  vector<uint64_t> hash_buffer;
+  if (hash_type_ == ONE_PERMUTATION){
+    calc_one_permutation_minhash(sfv, hash_buffer);
+  } else {
+    calc_independent_minhash(sfv, hash_buffer);
+  }
+
+  bv.resize_and_clear(hash_num_ * bit_width_);
+  for (size_t i = 0; i < hash_buffer.size(); ++i){
+    for (uint64_t j = 0; j < bit_width_; ++j){
+      if ((hash_buffer[i] >> j) & 1LLU){
+        bv.set_bit(i * bit_width_ + j);
+      }
+    }
+  }
+}
+
+void minhash::calc_independent_minhash(const sfv_t& sfv, vector<uint64_t>& min_keys) const{
   vector<float> min_values_buffer(hash_num_, FLT_MAX);
   vector<uint64_t> hash_buffer(hash_num_);
   for (size_t i = 0; i < sfv.size(); ++i){
@@ -71,13 +115,49 @@ void minhash::calc_minhash_values(const sfv_t& sfv, bit_vector& bv) const{
       }
     }
   }
+  min_keys.swap(hash_buffer);
+}
 
-  bv.resize_and_clear(hash_num_);
-  for (size_t i = 0; i < hash_buffer.size(); ++i){
-    if ((hash_buffer[i] & 1LLU) == 1){
-      bv.set_bit(i);
+void minhash::calc_one_permutation_minhash(const sfv_t& sfv, vector<uint64_t>& min_keys) const{
+  vector<float> min_values_buffer(hash_num_, FLT_MAX);
+  vector<uint64_t> hash_buffer(hash_num_);
+  vector<bool> filled(hash_num_);
+  for (size_t i = 0; i < sfv.size(); ++i){
+    uint64_t key_hash = hash_util::calc_string_hash(sfv[i].first);
+    uint64_t a = key_hash, b = 0, c = hash_prime;
+    hash_mix64(a, b, c);
+    hash_mix64(a, b, c);
+    uint64_t bin = c % hash_num_;
+    float r = static_cast<float>(a) / static_cast<float>(0xFFFFFFFFFFFFFFFFLLU);
+    float hashval = - log(r) / sfv[i].second;
+    if (hashval < min_values_buffer[bin]){
+      min_values_buffer[bin] = hashval;
+      hash_buffer[bin] = key_hash;
+      filled[bin] = true;
     }
   }
+
+  // An empty bin takes the value of the first non-empty bin in a sequence of
+  // bins given by the hash of the empty bin, so that two vectors take the
+  // same bin as long as it is non-empty in both.
+  vector<uint64_t> densified(hash_buffer);
+  if (find(filled.begin(), filled.end(), true) != filled.end()){
+    for (uint64_t bin = 0; bin < hash_num_; ++bin){
+      if (filled[bin]){
+        continue;
+      }
+      for (uint64_t t = 0; t < MAX_DENSIFICATION_TRIES; ++t){
+        uint64_t a = bin, b = t, c = hash_prime;
+        hash_mix64(a, b, c);
+        uint64_t donor = a % hash_num_;
+        if (filled[donor]){
+          densified[bin] = hash_buffer[donor];
+          break;
+        }
+      }
+    }
+  }
+  min_keys.swap(densified);
 }
 
 void minhash::update_row(const string& id, const sfv_diff_t& diff){
@@ -88,6 +168,123 @@ void minhash::update_row(const string& id, const sfv_diff_t& diff){
   bit_vector bv;
   calc_minhash_values(row, bv);
   row2minhashvals_.set_row(id, bv);
+  row_changed(id);
+}
+
+void minhash::update_rows(const vector<pair<string, sfv_diff_t> >& rows){
+  // signatures are calculated from the whole rows after all of them are updated
+  for (size_t i = 0; i < rows.size(); ++i){
+    orig_.set_row(rows[i].first, rows[i].second);
+  }
+  vector<sfv_t> sfvs(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i){
+    orig_.get_row(rows[i].first, sfvs[i]);
+  }
+  vector<bit_vector> bvs;
+  calc_minhash_values(sfvs, bvs);
+  for (size_t i = 0; i < rows.size(); ++i){
+    row2minhashvals_.set_row(rows[i].first, bvs[i]);
+    row_changed(rows[i].first);
+  }
+}
+
+void minhash::prepare_rows(const vector<pair<string, sfv_diff_t> >& diffs,
+                           prepared_rows& prepared) const{
+  prepared.diffs = diffs;
+  calc_updated_rows(diffs, prepared.rows);
+  calc_minhash_values(prepared.rows, prepared.signatures);
+}
+
+void minhash::apply_rows(const prepared_rows& prepared){
+  const vector<pair<string, sfv_diff_t> >& diffs = prepared.diffs;
+  for (size_t i = 0; i < diffs.size(); ++i){
+    orig_.set_row(diffs[i].first, diffs[i].second);
+  }
+  // signatures of rows updated after prepare_rows are calculated again
+  vector<size_t> changed;
+  vector<sfv_t> rows;
+  find_changed_rows(prepared, changed, rows);
+  vector<bit_vector> bvs;
+  calc_minhash_values(rows, bvs);
+  for (size_t i = 0, j = 0; i < diffs.size(); ++i){
+    if (j < changed.size() && changed[j] == i){
+      row2minhashvals_.set_row(diffs[i].first, bvs[j++]);
+    } else {
+      row2minhashvals_.set_row(diffs[i].first, prepared.signatures[i]);
+    }
+    row_changed(diffs[i].first);
+  }
+}
+
+void minhash::similar_rows(const vector<sfv_t>& queries,
+                      vector<vector<pair<string, float> > >& ids,
+                      size_t ret_num) const{
+  ids.clear();
+  if (ret_num == 0){
+    ids.resize(queries.size());
+    return;
+  }
+  vector<bit_vector> bvs;
+  calc_minhash_values(queries, bvs);
+  row2minhashvals_.similar_rows(bvs, ids, ret_num);
+  for (size_t i = 0; i < ids.size(); ++i){
+    correct_scores(ids[i]);
+  }
+}
+
+void minhash::similar_rows_impl(const vector<string>& row_ids,
+                                vector<vector<pair<string, float> > >& ids,
+                                size_t ret_num) const{
+  ids.clear();
+  if (ret_num == 0){
+    ids.resize(row_ids.size());
+    return;
+  }
+  vector<bit_vector> bvs(row_ids.size());
+  for (size_t i = 0; i < row_ids.size(); ++i){
+    row2minhashvals_.get_row(row_ids[i], bvs[i]);
+    if (bvs[i].bit_num() == 0){
+      // rows without signatures are queried by their decoded rows as
+      // similar_row(id) does
+      sfv_t row;
+      orig_.get_row(row_ids[i], row);
+      calc_minhash_values(row, bvs[i]);
+    }
+  }
+  row2minhashvals_.similar_rows(bvs, ids, ret_num);
+  for (size_t i = 0; i < ids.size(); ++i){
+    correct_scores(ids[i]);
+  }
+}
+
+// Two different minimum values have the same lowest b bits with probability
+// 2^-b, so that the ratio P of the same b-bit values is J + (1 - J) / 2^b
+// for Jaccard similarity J. Scores of b > 1 are the estimates of J.
+// Scores of b = 1 are kept to be P as before.
+void minhash::correct_scores(vector<pair<string, float> >& ids) const{
+  if (bit_width_ == 1){
+    return;
+  }
+  const float collision = bit_width_ >= 64 ? 0.f : 1.f / (1LLU << bit_width_);
+  for (size_t i = 0; i < ids.size(); ++i){
+    ids[i].second = max(0.f, (ids[i].second - collision) / (1.f - collision));
+  }
+}
+
+void minhash::calc_minhash_values(const vector<sfv_t>& sfvs, vector<bit_vector>& bvs) const{
+  bvs.clear();
+  bvs.resize(sfvs.size());
+  common::thread_pool::get_shared().run_ranges(
+      sfvs.size(), MIN_SIGNATURE_RANGE_SIZE,
+      pfi::lang::bind(&minhash::calc_minhash_values_range, this, &sfvs, &bvs,
+                      pfi::lang::_1, pfi::lang::_2));
+}
+
+void minhash::calc_minhash_values_range(const vector<sfv_t>* sfvs, vector<bit_vector>* bvs,
+                                        size_t begin, size_t end) const{
+  for (size_t i = begin; i < end; ++i){
+    calc_minhash_values((*sfvs)[i], (*bvs)[i]);
+  }
 }
 
 void minhash::get_all_row_ids(std::vector<std::string>& ids) const{
@@ -25,13 +25,33 @@ namespace recommender {
 
 class minhash : public recommender_base {
 public:
+  enum hash_type {
+    // hash_num hashes of each feature
+    INDEPENDENT,
+    // one hash of each feature chooses one of hash_num bins, and empty bins
+    // are filled from other bins (optimal densification)
+    ONE_PERMUTATION
+  };
+
   minhash();
+  // Signatures keep bit_width bits of each of hash_num minimum values, and
+  // are compared by the groups of bit_width bits. bit_width must be a power
+  // of 2 up to 64.
+  minhash(uint64_t hash_num, hash_type type, uint64_t bit_width,
+          uint64_t band_num, uint64_t probe_num, uint64_t partition_num);
   ~minhash();
 
   void similar_row(const sfv_t& query, std::vector<std::pair<std::string, float> > & ids, size_t ret_num) const;
   void clear();
   void clear_row(const std::string& id);
   void update_row(const std::string& id, const sfv_diff_t& diff);
+  void update_rows(const std::vector<std::pair<std::string, sfv_diff_t> >& rows);
+  void prepare_rows(const std::vector<std::pair<std::string, sfv_diff_t> >& diffs,
+                    prepared_rows& prepared) const;
+  void apply_rows(const prepared_rows& prepared);
+  void similar_rows(const std::vector<sfv_t>& queries,
+                    std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                    size_t ret_num) const;
   void get_all_row_ids(std::vector<std::string>& ids) const;
   std::string type() const;
   storage::recommender_storage_base* get_storage();
@@ -40,14 +60,27 @@ public:
 private:
   bool save_impl(std::ostream&);
   bool load_impl(std::istream&);
+  // stored signatures are used as queries, without calculating them again
+  void similar_rows_impl(const std::vector<std::string>& row_ids,
+                         std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                         size_t ret_num) const;
 
   void calc_minhash_values(const sfv_t& sfv, storage::bit_vector& bv) const;
+  // signatures of many vectors are calculated on the shared thread pool
+  void calc_minhash_values(const std::vector<sfv_t>& sfvs, std::vector<storage::bit_vector>& bvs) const;
+  void calc_minhash_values_range(const std::vector<sfv_t>* sfvs, std::vector<storage::bit_vector>* bvs,
+                                 size_t begin, size_t end) const;
+  void calc_independent_minhash(const sfv_t& sfv, std::vector<uint64_t>& min_keys) const;
+  void calc_one_permutation_minhash(const sfv_t& sfv, std::vector<uint64_t>& min_keys) const;
+  void correct_scores(std::vector<std::pair<std::string, float> >& ids) const;
 
   static float calc_hash(uint64_t a, uint64_t b, float val);
   static void hash_mix64(uint64_t& a, uint64_t& b, uint64_t& c);
 
   static const uint64_t hash_prime;
   uint64_t hash_num_;
+  hash_type hash_type_;
+  uint64_t bit_width_;
   storage::bit_index_storage row2minhashvals_;
 };
 
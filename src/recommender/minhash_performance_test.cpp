@@ -0,0 +1,137 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <pficommon/lang/cast.h>
+#include <pficommon/lang/scoped_ptr.h>
+#include "../common/exception.hpp"
+#include "../common/cmdline.h"
+#include "../common/type.hpp"
+#include "../storage/bit_index_storage.hpp"
+#include "../storage/bit_vector.hpp"
+#include "recommender_base.hpp"
+#include "recommender_factory.hpp"
+
+using namespace std;
+using namespace jubatus;
+using jubatus::recommender::recommender_base;
+using jubatus::storage::bit_index_storage;
+using jubatus::storage::bit_vector;
+using pfi::lang::lexical_cast;
+
+struct set_pair {
+  sfv_t x;
+  sfv_t y;
+  float jaccard;
+};
+
+// Makes pairs of sets of the given size whose Jaccard similarities are
+// uniformly distributed.
+void make_pairs(int num, int features, vector<set_pair>& pairs) {
+  srand(0);
+  int id = 0;
+  for (int i = 0; i < num; ++i) {
+    int common = rand() % (features + 1);
+    set_pair p;
+    for (int j = 0; j < common; ++j) {
+      string key = "f" + lexical_cast<string>(id++);
+      p.x.push_back(make_pair(key, 1.0));
+      p.y.push_back(make_pair(key, 1.0));
+    }
+    for (int j = common; j < features; ++j) {
+      p.x.push_back(make_pair("f" + lexical_cast<string>(id++), 1.0));
+      p.y.push_back(make_pair("f" + lexical_cast<string>(id++), 1.0));
+    }
+    p.jaccard = static_cast<float>(common) / (2 * features - common);
+    pairs.push_back(p);
+  }
+}
+
+void run_test(const vector<set_pair>& pairs, int hash_num,
+              const string& hash, int bit_width) {
+  map<string, string> param;
+  param["hash_num"] = lexical_cast<string>(hash_num);
+  param["hash"] = hash;
+  param["bit_width"] = lexical_cast<string>(bit_width);
+  pfi::lang::scoped_ptr<recommender_base>
+      r(recommender::create_recommender("minhash", param));
+
+  clock_t begin = clock();
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    string id = lexical_cast<string>(i);
+    r->update_row("x" + id, pairs[i].x);
+    r->update_row("y" + id, pairs[i].y);
+  }
+  clock_t end = clock();
+  float update_time = static_cast<float>(end - begin) / CLOCKS_PER_SEC;
+
+  // a pair of different minimum values has the same b-bit value with
+  // probability 2^-b, so that J is estimated by (P - 2^-b) / (1 - 2^-b) for
+  // the ratio P of the same b-bit values
+  const float collision = 1.f / (1 << bit_width);
+  const bit_index_storage* storage =
+      dynamic_cast<const bit_index_storage*>(r->get_const_storage());
+  float error = 0;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    string id = lexical_cast<string>(i);
+    bit_vector x, y;
+    storage->get_row("x" + id, x);
+    storage->get_row("y" + id, y);
+    float ratio = static_cast<float>(x.calc_group_similarity(y, bit_width)) / hash_num;
+    error += fabs((ratio - collision) / (1 - collision) - pairs[i].jaccard);
+  }
+
+  cout << "\thash: " << hash
+       << "\tbit_width: " << bit_width
+       << "\tbits: " << hash_num * bit_width
+       << "\tmean abs error: " << error / pairs.size()
+       << "\tupdate: " << update_time << "sec"
+       << endl;
+}
+
+int main(int argc, char* argv[]) try {
+  cmdline::parser p;
+  p.add<int>("num", 'n', "number of generated pairs of sets", false, 1000);
+  p.add<int>("features", 'f', "number of features of a set", false, 100);
+  p.add<int>("hash_num", 'k', "number of hashes", false, 256);
+  p.set_program_name("minhash_performance_test");
+
+  p.parse_check(argc, argv);
+
+  vector<set_pair> pairs;
+  make_pairs(p.get<int>("num"), p.get<int>("features"), pairs);
+  int hash_num = p.get<int>("hash_num");
+  cout << "pairs: " << pairs.size()
+       << "\tfeatures: " << p.get<int>("features")
+       << "\thash_num: " << hash_num << endl;
+
+  const char* hashes[] = { "independent", "one_permutation" };
+  const int widths[] = { 1, 2, 4 };
+  for (size_t h = 0; h < 2; ++h) {
+    for (size_t w = 0; w < 3; ++w) {
+      run_test(pairs, hash_num, hashes[h], widths[w]);
+    }
+  }
+} catch (const jubatus::exception::jubatus_exception& e) {
+  std::cout << e.diagnostic_information(true) << std::endl;
+}
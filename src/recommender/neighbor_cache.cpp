@@ -0,0 +1,100 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "neighbor_cache.hpp"
+#include <pficommon/concurrent/lock.h>
+
+using namespace std;
+using pfi::concurrent::scoped_lock;
+
+namespace jubatus {
+namespace recommender {
+
+neighbor_cache::neighbor_cache(size_t capacity)
+    : capacity_(capacity) {
+}
+
+void neighbor_cache::set_capacity(size_t capacity) {
+  scoped_lock lk(m_);
+  capacity_ = capacity;
+  shrink();
+}
+
+size_t neighbor_cache::capacity() const {
+  scoped_lock lk(m_);
+  return capacity_;
+}
+
+size_t neighbor_cache::size() const {
+  scoped_lock lk(m_);
+  return entries_.size();
+}
+
+bool neighbor_cache::get(const string& id, neighbors_t& neighbors) {
+  scoped_lock lk(m_);
+  entry_map_t::iterator it = entries_.find(id);
+  if (it == entries_.end()) {
+    return false;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second.pos);
+  neighbors = it->second.neighbors;
+  return true;
+}
+
+void neighbor_cache::put(const string& id, const neighbors_t& neighbors) {
+  scoped_lock lk(m_);
+  if (capacity_ == 0) {
+    return;
+  }
+  entry_map_t::iterator it = entries_.find(id);
+  if (it != entries_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second.pos);
+    it->second.neighbors = neighbors;
+    return;
+  }
+  lru_.push_front(id);
+  entry& e = entries_[id];
+  e.neighbors = neighbors;
+  e.pos = lru_.begin();
+  shrink();
+}
+
+void neighbor_cache::remove(const string& id) {
+  scoped_lock lk(m_);
+  entry_map_t::iterator it = entries_.find(id);
+  if (it == entries_.end()) {
+    return;
+  }
+  lru_.erase(it->second.pos);
+  entries_.erase(it);
+}
+
+void neighbor_cache::clear() {
+  scoped_lock lk(m_);
+  lru_.clear();
+  entries_.clear();
+}
+
+void neighbor_cache::shrink() {
+  while (entries_.size() > capacity_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+}
+
+} // namespace recommender
+} // namespace jubatus
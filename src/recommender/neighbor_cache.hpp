@@ -0,0 +1,70 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pficommon/concurrent/mutex.h>
+#include <pficommon/data/unordered_map.h>
+
+namespace jubatus {
+namespace recommender {
+
+// Keeps similar rows of recently completed rows, so that repeated
+// completions of the same row skip the similarity search.
+// The least recently used entry is evicted when more than capacity rows are
+// kept, and nothing is kept when capacity is 0.
+// An entry is invalidated only when its own row is updated, so that entries
+// do not reflect updates of other rows until the cache is cleared.
+// All methods are thread safe.
+class neighbor_cache {
+public:
+  typedef std::vector<std::pair<std::string, float> > neighbors_t;
+
+  explicit neighbor_cache(size_t capacity = 0);
+
+  void set_capacity(size_t capacity);
+  size_t capacity() const;
+  size_t size() const;
+
+  bool get(const std::string& id, neighbors_t& neighbors);
+  void put(const std::string& id, const neighbors_t& neighbors);
+  void remove(const std::string& id);
+  void clear();
+
+private:
+  typedef std::list<std::string> lru_list_t;
+  struct entry {
+    neighbors_t neighbors;
+    lru_list_t::iterator pos;
+  };
+  typedef pfi::data::unordered_map<std::string, entry> entry_map_t;
+
+  void shrink();
+
+  size_t capacity_;
+  // the most recently used row comes first
+  lru_list_t lru_;
+  entry_map_t entries_;
+  mutable pfi::concurrent::mutex m_;
+};
+
+} // namespace recommender
+} // namespace jubatus
@@ -0,0 +1,87 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <gtest/gtest.h>
+#include "neighbor_cache.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace recommender {
+
+namespace {
+
+neighbor_cache::neighbors_t make_neighbors(const string& id, float score) {
+  neighbor_cache::neighbors_t ret;
+  ret.push_back(make_pair(id, score));
+  return ret;
+}
+
+}
+
+TEST(neighbor_cache, disabled) {
+  neighbor_cache c;
+  c.put("r1", make_neighbors("r2", 1.0));
+  neighbor_cache::neighbors_t n;
+  EXPECT_FALSE(c.get("r1", n));
+  EXPECT_EQ(0u, c.size());
+}
+
+TEST(neighbor_cache, get_and_remove) {
+  neighbor_cache c(2);
+  c.put("r1", make_neighbors("r2", 1.0));
+  neighbor_cache::neighbors_t n;
+  ASSERT_TRUE(c.get("r1", n));
+  ASSERT_EQ(1u, n.size());
+  EXPECT_EQ("r2", n[0].first);
+  EXPECT_FLOAT_EQ(1.0, n[0].second);
+
+  c.put("r1", make_neighbors("r3", 0.5));
+  ASSERT_TRUE(c.get("r1", n));
+  EXPECT_EQ("r3", n[0].first);
+  EXPECT_EQ(1u, c.size());
+
+  c.remove("r1");
+  EXPECT_FALSE(c.get("r1", n));
+  c.remove("r1");
+  EXPECT_EQ(0u, c.size());
+}
+
+TEST(neighbor_cache, evict_least_recently_used) {
+  neighbor_cache c(2);
+  neighbor_cache::neighbors_t n;
+  c.put("r1", make_neighbors("a", 1.0));
+  c.put("r2", make_neighbors("b", 1.0));
+  ASSERT_TRUE(c.get("r1", n));
+  c.put("r3", make_neighbors("c", 1.0));
+
+  EXPECT_EQ(2u, c.size());
+  EXPECT_TRUE(c.get("r1", n));
+  EXPECT_FALSE(c.get("r2", n));
+  EXPECT_TRUE(c.get("r3", n));
+
+  c.set_capacity(1);
+  EXPECT_EQ(1u, c.size());
+  EXPECT_TRUE(c.get("r3", n));
+
+  c.clear();
+  EXPECT_EQ(0u, c.size());
+  EXPECT_EQ(1u, c.capacity());
+}
+
+} // namespace recommender
+} // namespace jubatus
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "hnsw.hpp"
 #include "inverted_index.hpp"
 #include "lsh.hpp"
 #include "minhash.hpp"
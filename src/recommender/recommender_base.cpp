@@ -17,8 +17,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <pficommon/concurrent/lock.h>
 #include "recommender_base.hpp"
-#include "../common/vector_util.hpp"
 
 using namespace std;
 using namespace pfi::data;
@@ -28,7 +28,35 @@ namespace recommender {
 
 const uint64_t recommender_base::complete_row_similar_num_ = 128;
 
-recommender_base::recommender_base() { 
+namespace {
+// rows answered at once by similar_all, which bounds memory for queries
+const size_t SIMILAR_ALL_BLOCK_SIZE = 256;
+
+struct less_column {
+  bool operator()(const pair<string, float>& lhs,
+                  const pair<string, float>& rhs) const {
+    return lhs.first < rhs.first;
+  }
+};
+
+// Sorts a row by column, and keeps the last value of each column as
+// sparse_matrix_storage::set_row does.
+void normalize_row(sfv_t& row){
+  stable_sort(row.begin(), row.end(), less_column());
+  size_t size = 0;
+  for (size_t i = 0; i < row.size(); ++i){
+    if (size > 0 && row[size - 1].first == row[i].first){
+      row[size - 1].second = row[i].second;
+    } else {
+      row[size++] = row[i];
+    }
+  }
+  row.resize(size);
+}
+}
+
+recommender_base::recommender_base()
+    : sorted_row_ids_valid_(false) {
 }
 
 recommender_base::~recommender_base(){
@@ -41,6 +69,121 @@ void recommender_base::similar_row(const std::string& id, std::vector<std::pair<
   similar_row(sfv, ids, ret_num);
 }
 
+void recommender_base::update_rows(const vector<pair<string, sfv_diff_t> >& rows){
+  for (size_t i = 0; i < rows.size(); ++i){
+    update_row(rows[i].first, rows[i].second);
+  }
+}
+
+void recommender_base::prepare_rows(const vector<pair<string, sfv_diff_t> >& diffs,
+                                    prepared_rows& prepared) const{
+  prepared.diffs = diffs;
+  prepared.rows.clear();
+  prepared.signatures.clear();
+}
+
+void recommender_base::apply_rows(const prepared_rows& prepared){
+  update_rows(prepared.diffs);
+}
+
+void recommender_base::calc_updated_rows(const vector<pair<string, sfv_diff_t> >& diffs,
+                                         vector<sfv_t>& rows) const{
+  rows.clear();
+  rows.resize(diffs.size());
+  // a row updated twice is based on its earlier update
+  unordered_map<string, size_t> last;
+  for (size_t i = 0; i < diffs.size(); ++i){
+    unordered_map<string, size_t>::const_iterator it = last.find(diffs[i].first);
+    if (it == last.end()){
+      orig_.get_row(diffs[i].first, rows[i]);
+    } else {
+      rows[i] = rows[it->second];
+    }
+    rows[i].insert(rows[i].end(), diffs[i].second.begin(), diffs[i].second.end());
+    normalize_row(rows[i]);
+    last[diffs[i].first] = i;
+  }
+}
+
+void recommender_base::find_changed_rows(const prepared_rows& prepared,
+                                         vector<size_t>& changed,
+                                         vector<sfv_t>& rows) const{
+  changed.clear();
+  rows.clear();
+  sfv_t row;
+  for (size_t i = 0; i < prepared.diffs.size(); ++i){
+    orig_.get_row(prepared.diffs[i].first, row);
+    normalize_row(row);
+    if (i >= prepared.rows.size() || row != prepared.rows[i]){
+      changed.push_back(i);
+      rows.push_back(sfv_t());
+      rows.back().swap(row);
+    }
+  }
+}
+
+void recommender_base::similar_rows(const vector<sfv_t>& queries,
+                                    vector<vector<pair<string, float> > >& ids,
+                                    size_t ret_num) const{
+  ids.clear();
+  ids.resize(queries.size());
+  for (size_t i = 0; i < queries.size(); ++i){
+    similar_row(queries[i], ids[i], ret_num);
+  }
+}
+
+void recommender_base::similar_rows(const vector<string>& row_ids,
+                                    vector<vector<pair<string, float> > >& ids,
+                                    size_t ret_num) const{
+  similar_rows_impl(row_ids, ids, ret_num);
+}
+
+void recommender_base::get_sorted_row_ids(size_t offset, size_t size,
+                                          vector<string>& ids) const{
+  ids.clear();
+  pfi::concurrent::scoped_lock lk(sorted_row_ids_m_);
+  if (!sorted_row_ids_valid_){
+    get_all_row_ids(sorted_row_ids_);
+    sort(sorted_row_ids_.begin(), sorted_row_ids_.end());
+    sorted_row_ids_.erase(unique(sorted_row_ids_.begin(), sorted_row_ids_.end()),
+                          sorted_row_ids_.end());
+    sorted_row_ids_valid_ = true;
+  }
+  if (offset >= sorted_row_ids_.size()) return;
+  size_t end = offset + min(size, sorted_row_ids_.size() - offset);
+  ids.assign(sorted_row_ids_.begin() + offset, sorted_row_ids_.begin() + end);
+}
+
+void recommender_base::similar_all(size_t offset, size_t page_size, size_t ret_num,
+                                   vector<pair<string, vector<pair<string, float> > > >& ret) const{
+  ret.clear();
+  vector<string> row_ids;
+  get_sorted_row_ids(offset, page_size, row_ids);
+
+  ret.reserve(row_ids.size());
+  vector<string> block;
+  vector<vector<pair<string, float> > > ids;
+  for (size_t begin = 0; begin < row_ids.size(); begin += SIMILAR_ALL_BLOCK_SIZE){
+    size_t block_end = min(begin + SIMILAR_ALL_BLOCK_SIZE, row_ids.size());
+    block.assign(row_ids.begin() + begin, row_ids.begin() + block_end);
+    similar_rows(block, ids, ret_num);
+    for (size_t i = 0; i < block.size(); ++i){
+      ret.push_back(make_pair(block[i], vector<pair<string, float> >()));
+      ret.back().second.swap(ids[i]);
+    }
+  }
+}
+
+void recommender_base::similar_rows_impl(const vector<string>& row_ids,
+                                         vector<vector<pair<string, float> > >& ids,
+                                         size_t ret_num) const{
+  vector<sfv_t> queries(row_ids.size());
+  for (size_t i = 0; i < row_ids.size(); ++i){
+    orig_.get_row(row_ids[i], queries[i]);
+  }
+  similar_rows(queries, ids, ret_num);
+}
+
 void recommender_base::decode_row(const std::string& id, sfv_t& ret) const{
   ret.clear();
   orig_.get_row(id, ret);
@@ -48,37 +191,68 @@ void recommender_base::decode_row(const std::string& id, sfv_t& ret) const{
 
 void recommender_base::complete_row(const std::string& id, sfv_t& ret) const{
   ret.clear();
-  sfv_t sfv;
-  orig_.get_row(id, sfv);
-  complete_row(sfv, ret);
+  vector<pair<string, float> > ids;
+  if (!neighbor_cache_.get(id, ids)){
+    sfv_t sfv;
+    orig_.get_row(id, sfv);
+    similar_row(sfv, ids, complete_row_similar_num_);
+    neighbor_cache_.put(id, ids);
+  }
+  complete_row_from_neighbors(ids, ret);
 }
 
 void recommender_base::complete_row(const sfv_t& query, sfv_t& ret) const{
   ret.clear();
   vector<pair<string, float> > ids;
   similar_row(query, ids, complete_row_similar_num_);
-  if (ids.size() == 0) return;
+  complete_row_from_neighbors(ids, ret);
+}
 
+// Rows are accumulated by column id, and column keys are looked up only for
+// the merged result.
+void recommender_base::complete_row_from_neighbors(const vector<pair<string, float> >& ids,
+                                                   sfv_t& ret) const{
+  ret.clear();
+  vector<pair<uint64_t, float> > columns;
   size_t exist_row_num = 0;
   for (size_t i = 0; i < ids.size(); ++i){
-    sfv_t row;
-    orig_.get_row(ids[i].first, row);
-    if (row.size() == 0){
-      continue;
-    } else {
+    if (orig_.add_scaled_row(ids[i].first, ids[i].second, columns)){
       ++exist_row_num;
     }
-    float ratio = ids[i].second;
-    for (size_t j = 0; j < row.size(); ++j){
-      ret.push_back(make_pair(row[j].first, row[j].second * ratio));
-    }
   }
-
   if (exist_row_num == 0) return;
-    sort_and_merge(ret);
-  for (size_t i = 0; i < ret.size(); ++i){
-    ret[i].second /= exist_row_num;
+
+  sort(columns.begin(), columns.end());
+  for (size_t i = 0; i < columns.size(); ){
+    uint64_t id = columns[i].first;
+    float sum = 0.f;
+    for (; i < columns.size() && columns[i].first == id; ++i){
+      sum += columns[i].second;
+    }
+    ret.push_back(make_pair(orig_.get_column_key(id), sum / exist_row_num));
   }
+  sort(ret.begin(), ret.end());
+}
+
+void recommender_base::set_neighbor_cache_size(size_t size){
+  neighbor_cache_.set_capacity(size);
+}
+
+void recommender_base::clear_neighbor_cache(){
+  rows_changed();
+}
+
+void recommender_base::row_changed(const string& id){
+  neighbor_cache_.remove(id);
+  pfi::concurrent::scoped_lock lk(sorted_row_ids_m_);
+  sorted_row_ids_valid_ = false;
+}
+
+void recommender_base::rows_changed(){
+  neighbor_cache_.clear();
+  pfi::concurrent::scoped_lock lk(sorted_row_ids_m_);
+  sorted_row_ids_valid_ = false;
+  sorted_row_ids_.clear();
 }
 
 void recommender_base::save(std::ostream& os) {
@@ -89,6 +263,7 @@ void recommender_base::save(std::ostream& os) {
 void recommender_base::load(std::istream& is) {
   pfi::data::serialization::binary_iarchive ia(is);
   ia >> orig_;
+  rows_changed();
   load_impl(is);
 }
 
@@ -18,11 +18,14 @@
 #pragma once
 
 #include <vector>
+#include <pficommon/concurrent/mutex.h>
 #include <pficommon/data/unordered_map.h>
 #include <pficommon/lang/shared_ptr.h>
 #include "../common/type.hpp"
 #include "../storage/sparse_matrix_storage.hpp"
+#include "../storage/bit_vector.hpp"
 #include "recommender_type.hpp"
+#include "neighbor_cache.hpp"
 #include "../storage/recommender_storage_base.hpp"
 
 namespace jubatus {
@@ -30,6 +33,14 @@ namespace recommender {
 
 class recommender_base{
 public:
+  // Rows to be put by apply_rows, and the values calculated from them.
+  struct prepared_rows {
+    std::vector<std::pair<std::string, sfv_diff_t> > diffs;
+    // rows after each diff is applied, sorted by column
+    std::vector<sfv_t> rows;
+    std::vector<storage::bit_vector> signatures;
+  };
+
   recommender_base();
   virtual ~recommender_base();
 
@@ -43,11 +54,49 @@ public:
   virtual storage::recommender_storage_base* get_storage() = 0;
   virtual const storage::recommender_storage_base* get_const_storage() const = 0;
 
+  // Updates rows at once. The default updates them one by one.
+  virtual void update_rows(const std::vector<std::pair<std::string, sfv_diff_t> >& rows);
+  // Finds similar rows for queries at once. The default answers them one by one.
+  virtual void similar_rows(const std::vector<sfv_t>& queries,
+                            std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                            size_t ret_num) const;
+  // update_rows in two steps. prepare_rows only reads the model, so that
+  // expensive work can be done under a read lock, and apply_rows puts the
+  // prepared rows. Rows updated between them are calculated again.
+  // The default prepares nothing and calls update_rows.
+  virtual void prepare_rows(const std::vector<std::pair<std::string, sfv_diff_t> >& diffs,
+                            prepared_rows& prepared) const;
+  virtual void apply_rows(const prepared_rows& prepared);
+
   void similar_row(const std::string& id, std::vector<std::pair<std::string, float> > & ids, size_t ret_num) const;
+  void similar_rows(const std::vector<std::string>& row_ids,
+                    std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                    size_t ret_num) const;
+  // Returns ids of all rows, sorted and without duplicates, in
+  // [offset, offset + size). The sorted ids are kept until rows change, so
+  // that paging through them does not sort them again.
+  void get_sorted_row_ids(size_t offset, size_t size, std::vector<std::string>& ids) const;
+  // Finds similar rows of all rows, which are sorted by id, in
+  // [offset, offset + page_size). Rows are answered in blocks by similar_rows.
+  void similar_all(size_t offset, size_t page_size, size_t ret_num,
+                   std::vector<std::pair<std::string, std::vector<std::pair<std::string, float> > > >& ret) const;
   void complete_row(const std::string& id, sfv_t& ret) const;
   void complete_row(const sfv_t& query, sfv_t& ret) const;
+  // Completes a row from similar rows found by a caller, e.g. with scores
+  // scaled. complete_row uses complete_row_similar_num() rows.
+  void complete_row_from_neighbors(const std::vector<std::pair<std::string, float> >& ids,
+                                   sfv_t& ret) const;
+  static uint64_t complete_row_similar_num() {
+    return complete_row_similar_num_;
+  }
   void decode_row(const std::string& id, sfv_t& ret) const;
 
+  // Similar rows found by complete_row(id) are kept for up to size rows.
+  // The cache is disabled by default (size 0).
+  void set_neighbor_cache_size(size_t size);
+  // Call this after rows are changed out of update_row, e.g. by mix.
+  // Sorted row ids are also dropped.
+  void clear_neighbor_cache();
 
   void save(std::ostream&);
   void load(std::istream&);
@@ -58,9 +107,35 @@ public:
 protected:
   virtual bool save_impl(std::ostream&) = 0;
   virtual bool load_impl(std::istream&) = 0;
+  // Finds similar rows of stored rows. The default decodes the rows and
+  // calls similar_rows for them.
+  virtual void similar_rows_impl(const std::vector<std::string>& row_ids,
+                                 std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                                 size_t ret_num) const;
+
+  // Rows which diffs are applied to, as update_rows would store them.
+  void calc_updated_rows(const std::vector<std::pair<std::string, sfv_diff_t> >& diffs,
+                         std::vector<sfv_t>& rows) const;
+  // Finds prepared rows which differ from the stored rows, and returns the
+  // stored rows for them. Call this after the diffs are applied to orig_.
+  void find_changed_rows(const prepared_rows& prepared,
+                         std::vector<size_t>& changed,
+                         std::vector<sfv_t>& rows) const;
+
+  // Call these when a row or all rows are changed, to drop the neighbor
+  // cache entries and the sorted row ids derived from them.
+  void row_changed(const std::string& id);
+  void rows_changed();
 
   static const uint64_t complete_row_similar_num_;
   storage::sparse_matrix_storage orig_;
+  // entries must be removed when rows are updated
+  mutable neighbor_cache neighbor_cache_;
+
+private:
+  mutable std::vector<std::string> sorted_row_ids_;
+  mutable bool sorted_row_ids_valid_;
+  mutable pfi::concurrent::mutex sorted_row_ids_m_;
 };
 
 } // namespace recommender
@@ -15,8 +15,12 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
+#include <cstdlib>
+#include <pficommon/lang/cast.h>
 #include "recommender_factory.hpp"
 #include "recommender.hpp"
+#include "row_timestamps.hpp"
 #include "../common/exception.hpp"
 #include "../storage/norm_factory.hpp"
 
@@ -25,6 +29,108 @@ using namespace std;
 namespace jubatus {
 namespace recommender {
 
+namespace {
+
+// bound of buckets probed in each band of a query
+const uint64_t MAX_PROBED_BUCKETS = 4096;
+
+uint64_t get_uint_with_default(const map<string, string>& param,
+                               const string& key,
+                               uint64_t default_value){
+  map<string, string>::const_iterator it = param.find(key);
+  if (it == param.end()){
+    return default_value;
+  }
+  const char* str = it->second.c_str();
+  char* end;
+  uint64_t ret = strtoull(str, &end, 10);
+  if (it->second.empty() || *end != '\0' || it->second[0] == '-'){
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "invalid parameter: " + key + " = " + it->second));
+  }
+  return ret;
+}
+
+// A query probes the buckets of keys which differ in up to probe_num bits in
+// each band, that is the sum of C(band_width, i) for i <= probe_num.
+void check_probe_num(uint64_t bit_num, uint64_t band_num, uint64_t probe_num){
+  if (band_num == 0){
+    return;
+  }
+  // the same width as bit_index_storage gives to bands
+  const uint64_t band_width = max<uint64_t>(1, min<uint64_t>(64, bit_num / band_num));
+  uint64_t buckets = 0;
+  uint64_t c = 1;
+  for (uint64_t i = 0; i <= probe_num && i <= band_width; ++i){
+    buckets += c;
+    if (buckets > MAX_PROBED_BUCKETS){
+      throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+          "invalid parameter: probe_num = " + pfi::lang::lexical_cast<string>(probe_num)
+          + " probes more than " + pfi::lang::lexical_cast<string>(MAX_PROBED_BUCKETS)
+          + " buckets in a band"));
+    }
+    c = c * (band_width - i) / (i + 1);
+  }
+}
+
+minhash::hash_type get_hash_type(const map<string, string>& param){
+  map<string, string>::const_iterator it = param.find("hash");
+  if (it == param.end() || it->second == "independent"){
+    return minhash::INDEPENDENT;
+  } else if (it->second == "one_permutation"){
+    return minhash::ONE_PERMUTATION;
+  }
+  throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+      "invalid parameter: hash = " + it->second));
+}
+
+storage::hnsw_index_storage::metric_type get_metric(const map<string, string>& param){
+  map<string, string>::const_iterator it = param.find("metric");
+  if (it == param.end() || it->second == "cosine"){
+    return storage::hnsw_index_storage::COSINE;
+  } else if (it->second == "euclid"){
+    return storage::hnsw_index_storage::EUCLID;
+  }
+  throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+      "invalid parameter: metric = " + it->second));
+}
+
+recommender_base* create_method(const string& name,
+                                const map<string, string>& param){
+  uint64_t partition_num = get_uint_with_default(param, "partition_num", 1);
+  if (name == "inverted_index"){
+    return new inverted_index(partition_num);
+  } else if (name == "minhash" || name == "lsh"){
+    uint64_t hash_num = get_uint_with_default(param, "hash_num", 64);
+    uint64_t band_num = get_uint_with_default(param, "band_num", 0);
+    uint64_t probe_num = get_uint_with_default(param, "probe_num", 0);
+    if (name == "minhash"){
+      minhash::hash_type type = get_hash_type(param);
+      uint64_t bit_width = get_uint_with_default(param, "bit_width", 1);
+      check_probe_num(hash_num * min<uint64_t>(64, bit_width), band_num, probe_num);
+      return new minhash(hash_num, type, bit_width,
+                         band_num, probe_num, partition_num);
+    } else {
+      check_probe_num(hash_num, band_num, probe_num);
+      return new lsh(hash_num, band_num, probe_num, partition_num);
+    }
+  } else if (name == "hnsw"){
+    // a graph search cannot be split, and similar_rows answers queries in
+    // parallel instead
+    if (partition_num != 1){
+      throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+          "invalid parameter: partition_num is not supported by hnsw"));
+    }
+    uint64_t m = get_uint_with_default(param, "M", 16);
+    uint64_t ef_construction = get_uint_with_default(param, "ef_construction", 100);
+    uint64_t ef = get_uint_with_default(param, "ef", 50);
+    return new hnsw(get_metric(param), m, ef_construction, ef);
+  }
+  return create_recommender(name);
+}
+
+}
+
 recommender_base* create_recommender(const string& name){
   if (name == "inverted_index"){
     return new inverted_index;
@@ -32,11 +138,27 @@ recommender_base* create_recommender(const string& name){
     return new minhash;
   } else if (name == "lsh"){
     return new lsh;
+  } else if (name == "hnsw"){
+    return new hnsw;
   } else {
     throw JUBATUS_EXCEPTION(unsupported_method(name));
   }
 }
 
+recommender_base* create_recommender(const string& name,
+                                     const map<string, string>& param){
+  uint64_t neighbor_cache_size = get_uint_with_default(param, "neighbor_cache_size", 0);
+  recommender_base* ret = create_method(name, param);
+  ret->set_neighbor_cache_size(neighbor_cache_size);
+  return ret;
+}
+
+row_timestamps* create_row_timestamps(const map<string, string>& param){
+  uint64_t ttl = get_uint_with_default(param, "ttl", 0);
+  uint64_t half_life = get_uint_with_default(param, "decay_half_life", 0);
+  return new row_timestamps(ttl, half_life);
+}
+
 }
 }
 
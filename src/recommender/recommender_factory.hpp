@@ -17,14 +17,47 @@
 
 #pragma once
 
+#include <map>
 #include <string>
 
 namespace jubatus {
 namespace recommender {
 
 class recommender_base;
+class row_timestamps;
 
 recommender_base* create_recommender(const std::string& name);
 
+// Parameters:
+//   partition_num: number of tasks to split a query into (default: 1)
+//   neighbor_cache_size: number of rows to keep similar rows for
+//                        complete_row, 0 to disable (default: 0)
+// and of lsh and minhash:
+//   hash_num:  number of bits of a signature (default: 64)
+//   band_num:  number of bands to index signatures, 0 for a full scan (default: 0)
+//   probe_num: number of different bits allowed in a band, up to 4096
+//              buckets to probe in a band, e.g. 2 for bands of 64 bits
+//              (default: 0)
+// and of minhash:
+//   hash:      "independent" or "one_permutation" (default: "independent")
+//   bit_width: number of bits kept from each hash, a power of 2 up to 64, so
+//              that a signature has hash_num * bit_width bits (default: 1)
+// and of hnsw:
+//   metric:    "cosine" or "euclid", where the score is the negative
+//              euclidean distance (default: "cosine")
+//   M:         number of links of a row on each level but level 0, where
+//              rows have up to 2 * M links (default: 16)
+//   ef_construction: number of candidates kept in a search on update (default: 100)
+//   ef:        number of candidates kept in a search on query (default: 50)
+recommender_base* create_recommender(const std::string& name,
+                                     const std::map<std::string, std::string>& param);
+
+// Parameters:
+//   ttl:             seconds after the last update of a row until it is
+//                    removed at mix, 0 to disable (default: 0)
+//   decay_half_life: seconds in which weights of a row decay by half,
+//                    0 to disable (default: 0)
+row_timestamps* create_row_timestamps(const std::map<std::string, std::string>& param);
+
 }
 }
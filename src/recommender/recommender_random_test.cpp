@@ -1,8 +1,14 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <sstream>
+#include <pficommon/data/serialization.h>
+#include <pficommon/data/serialization/unordered_map.h>
 #include <pficommon/lang/cast.h>
+#include <pficommon/lang/scoped_ptr.h>
 #include "recommender.hpp"
+#include "recommender_factory.hpp"
+#include "../common/exception.hpp"
 #include "../classifier/classifier_test_util.hpp"
 
 namespace jubatus {
@@ -99,6 +105,191 @@ TYPED_TEST_P(recommender_random_test, random) {
   EXPECT_GT(correct, 5u);
 }
 
+TEST(recommender_factory, banded_index) {
+  map<string, string> param;
+  param["hash_num"] = "128";
+  param["band_num"] = "16";
+  param["probe_num"] = "1";
+  const char* methods[] = { "lsh", "minhash" };
+  for (size_t m = 0; m < 2; ++m) {
+    pfi::lang::scoped_ptr<recommender_base> r(create_recommender(methods[m], param));
+    for (size_t i = 0; i < 100; ++i) {
+      string c = lexical_cast<string>(i);
+      r->update_row("r" + c, make_vec("a" + c, "b" + c, "c" + c));
+    }
+    string diff;
+    r->get_storage()->get_diff(diff);
+    r->get_storage()->set_mixed_and_clear_diff(diff);
+
+    vector<pair<string, float> > ids;
+    r->similar_row(make_vec("a7", "b7", "c7"), ids, 10);
+    ASSERT_LE(1u, ids.size());
+    EXPECT_EQ("r7", ids[0].first);
+    EXPECT_FLOAT_EQ(1.0, ids[0].second);
+  }
+
+  param["hash_num"] = "x";
+  EXPECT_THROW(create_recommender("lsh", param), jubatus::exception::runtime_error);
+
+  // 1 + 64 + 2016 buckets in a band of 64 bits, and 43680 more for 3 bits
+  param["hash_num"] = "64";
+  param["band_num"] = "1";
+  param["probe_num"] = "2";
+  pfi::lang::scoped_ptr<recommender_base> l(create_recommender("lsh", param));
+  pfi::lang::scoped_ptr<recommender_base> m(create_recommender("minhash", param));
+  param["probe_num"] = "3";
+  EXPECT_THROW(create_recommender("lsh", param), jubatus::exception::runtime_error);
+  EXPECT_THROW(create_recommender("minhash", param), jubatus::exception::runtime_error);
+  // probe_num is not used by a full scan
+  param["band_num"] = "0";
+  param["probe_num"] = "100";
+  pfi::lang::scoped_ptr<recommender_base> scan(create_recommender("lsh", param));
+}
+
+TEST(recommender_factory, lsh_old_model) {
+  // models saved before lsh had a version kept random vectors of columns
+  // between the original rows and the signatures
+  stringstream ss;
+  {
+    pfi::data::serialization::binary_oarchive oa(ss);
+    storage::sparse_matrix_storage orig;
+    sfv_t row;
+    row.push_back(make_pair("c1", 1.0));
+    orig.set_row("r1", row);
+    pfi::data::unordered_map<string, vector<float> > column2baseval;
+    column2baseval["c1"] = vector<float>(64, 1.f);
+    storage::bit_index_storage row2lshvals;
+    storage::bit_vector bv;
+    bv.resize_and_clear(64);
+    bv.set_bit(0);
+    row2lshvals.set_row("r1", bv);
+    oa << orig << column2baseval << row2lshvals;
+  }
+  pfi::lang::scoped_ptr<recommender_base> r(create_recommender("lsh", map<string, string>()));
+  r->load(ss);
+
+  // the signature is calculated again from the original row
+  sfv_t query;
+  query.push_back(make_pair("c1", 2.0));
+  vector<pair<string, float> > ids;
+  r->similar_row(query, ids, 1);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ("r1", ids[0].first);
+  EXPECT_FLOAT_EQ(1.0, ids[0].second);
+
+  // and the model is saved with a version
+  stringstream ss2;
+  r->save(ss2);
+  pfi::lang::scoped_ptr<recommender_base> r2(create_recommender("lsh", map<string, string>()));
+  r2->load(ss2);
+  r2->similar_row(query, ids, 1);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_FLOAT_EQ(1.0, ids[0].second);
+}
+
+TEST(recommender_factory, hnsw) {
+  map<string, string> param;
+  param["metric"] = "euclid";
+  param["M"] = "4";
+  param["ef_construction"] = "32";
+  param["ef"] = "16";
+  pfi::lang::scoped_ptr<recommender_base> r(create_recommender("hnsw", param));
+  EXPECT_EQ("hnsw", r->type());
+  for (size_t i = 0; i < 100; ++i) {
+    r->update_row("r" + lexical_cast<string>(i), make_vec(i, 0, 0));
+  }
+
+  vector<pair<string, float> > ids;
+  r->similar_row(make_vec(7.25, 0, 0), ids, 2);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_EQ("r7", ids[0].first);
+  EXPECT_FLOAT_EQ(-0.25, ids[0].second);
+  EXPECT_EQ("r8", ids[1].first);
+
+  param["metric"] = "manhattan";
+  EXPECT_THROW(create_recommender("hnsw", param), jubatus::exception::runtime_error);
+  param["metric"] = "cosine";
+  param["M"] = "1";
+  EXPECT_ANY_THROW(create_recommender("hnsw", param));
+  param["M"] = "4";
+  param["partition_num"] = "4";
+  EXPECT_THROW(create_recommender("hnsw", param), jubatus::exception::runtime_error);
+}
+
+TEST(recommender_factory, minhash_variants) {
+  sfv_t x, y;
+  for (size_t i = 0; i < 100; ++i) {
+    x.push_back(make_pair("f" + lexical_cast<string>(i), 1.0));
+    y.push_back(make_pair("f" + lexical_cast<string>(i + 50), 1.0));
+  }
+  // Jaccard similarity of x and y is 1/3. The score is the ratio of the same
+  // b-bit values, J + (1 - J) / 2^b, for bit_width 1, and the estimate of J
+  // otherwise
+  const char* types[] = { "independent", "one_permutation" };
+  const char* widths[] = { "1", "4" };
+  for (size_t t = 0; t < 2; ++t) {
+    for (size_t w = 0; w < 2; ++w) {
+      map<string, string> param;
+      param["hash_num"] = "512";
+      param["hash"] = types[t];
+      param["bit_width"] = widths[w];
+      pfi::lang::scoped_ptr<recommender_base> r(create_recommender("minhash", param));
+      r->update_row("x", x);
+
+      vector<pair<string, float> > ids;
+      r->similar_row(x, ids, 1);
+      ASSERT_EQ(1u, ids.size());
+      EXPECT_FLOAT_EQ(1.0, ids[0].second);
+
+      r->similar_row(y, ids, 1);
+      ASSERT_EQ(1u, ids.size());
+      EXPECT_NEAR(w == 0 ? 2.0 / 3 : 1.0 / 3, ids[0].second, 0.08)
+          << types[t] << " " << widths[w];
+    }
+  }
+
+  map<string, string> param;
+  param["hash"] = "unknown";
+  EXPECT_THROW(create_recommender("minhash", param), jubatus::exception::runtime_error);
+  param["hash"] = "one_permutation";
+  param["bit_width"] = "0";
+  EXPECT_THROW(create_recommender("minhash", param), jubatus::exception::runtime_error);
+  param["bit_width"] = "65";
+  EXPECT_THROW(create_recommender("minhash", param), jubatus::exception::runtime_error);
+  param["bit_width"] = "3";
+  EXPECT_THROW(create_recommender("minhash", param), jubatus::exception::runtime_error);
+}
+
+TEST(recommender_factory, neighbor_cache) {
+  map<string, string> param;
+  pfi::lang::scoped_ptr<recommender_base> r1(create_recommender("inverted_index", param));
+  param["neighbor_cache_size"] = "16";
+  pfi::lang::scoped_ptr<recommender_base> r2(create_recommender("inverted_index", param));
+  for (size_t i = 0; i < 10; ++i) {
+    string c = lexical_cast<string>(i);
+    r1->update_row("r" + c, make_vec("a" + c, "b", "c"));
+    r2->update_row("r" + c, make_vec("a" + c, "b", "c"));
+  }
+
+  for (size_t n = 0; n < 2; ++n) {
+    sfv_t comp1, comp2;
+    r1->complete_row("r1", comp1);
+    r2->complete_row("r1", comp2);
+    EXPECT_TRUE(comp1 == comp2);
+  }
+
+  // the cached neighbors of r1 are dropped when r1 is updated
+  r1->update_row("r1", make_vec("a2", "b", "d"));
+  r2->update_row("r1", make_vec("a2", "b", "d"));
+  sfv_t comp1, comp2;
+  r1->complete_row("r1", comp1);
+  r2->complete_row("r1", comp2);
+  EXPECT_TRUE(comp1 == comp2);
+
+  param["neighbor_cache_size"] = "-1";
+  EXPECT_THROW(create_recommender("inverted_index", param), jubatus::exception::runtime_error);
+}
+
 void update_random(recommender_base& r) {
   vector<float> mu(3);
   for (size_t i = 0; i < 100; ++i) {
@@ -231,11 +422,136 @@ TYPED_TEST_P(recommender_random_test, mix) {
   compare_recommenders(expect, mixed, false);
 }
 
+TYPED_TEST_P(recommender_random_test, batch) {
+  TypeParam r1, r2;
+  vector<pair<string, sfv_diff_t> > rows;
+  vector<float> mu(3);
+  for (size_t i = 0; i < 100; ++i) {
+    vector<double> v;
+    make_random(mu, 1.0, 3, v);
+    rows.push_back(make_pair("r" + lexical_cast<string>(i % 80),
+                             make_vec(v[0], v[1], v[2])));
+  }
+  for (size_t i = 0; i < rows.size(); ++i) {
+    r1.update_row(rows[i].first, rows[i].second);
+  }
+  r2.update_rows(rows);
+
+  vector<sfv_t> queries;
+  vector<string> ids;
+  for (size_t i = 0; i < 10; ++i) {
+    vector<double> v;
+    make_random(mu, 1.0, 3, v);
+    queries.push_back(make_vec(v[0], v[1], v[2]));
+    ids.push_back("r" + lexical_cast<string>(i * 7));
+  }
+
+  recommender_base& b1 = r1;
+  recommender_base& b2 = r2;
+  vector<vector<pair<string, float> > > from_queries, from_ids;
+  b2.similar_rows(queries, from_queries, 5);
+  b2.similar_rows(ids, from_ids, 5);
+  ASSERT_EQ(queries.size(), from_queries.size());
+  ASSERT_EQ(ids.size(), from_ids.size());
+  for (size_t i = 0; i < queries.size(); ++i) {
+    vector<pair<string, float> > expected;
+    b1.similar_row(queries[i], expected, 5);
+    EXPECT_TRUE(expected == from_queries[i]);
+    b1.similar_row(ids[i], expected, 5);
+    EXPECT_TRUE(expected == from_ids[i]);
+  }
+}
+
+TYPED_TEST_P(recommender_random_test, prepare_and_apply_rows) {
+  TypeParam r1, r2;
+  vector<pair<string, sfv_diff_t> > rows;
+  vector<float> mu(3);
+  for (size_t i = 0; i < 100; ++i) {
+    vector<double> v;
+    make_random(mu, 1.0, 3, v);
+    rows.push_back(make_pair("r" + lexical_cast<string>(i % 80),
+                             make_vec(v[0], v[1], v[2])));
+  }
+  sfv_t between = make_vec("c4", "c5", "c6");
+
+  recommender_base& b1 = r1;
+  recommender_base& b2 = r2;
+  b1.update_row("r3", between);
+  b1.update_rows(rows);
+
+  // r3 is updated after its signature is prepared
+  recommender_base::prepared_rows prepared;
+  b2.prepare_rows(rows, prepared);
+  b2.update_row("r3", between);
+  b2.apply_rows(prepared);
+
+  for (size_t i = 0; i < 10; ++i) {
+    string id = "r" + lexical_cast<string>(i * 7);
+    sfv_t row1, row2;
+    b1.decode_row(id, row1);
+    b2.decode_row(id, row2);
+    EXPECT_TRUE(row1 == row2);
+    vector<pair<string, float> > expected, actual;
+    b1.similar_row(id, expected, 5);
+    b2.similar_row(id, actual, 5);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      EXPECT_FLOAT_EQ(expected[j].second, actual[j].second);
+    }
+  }
+  vector<pair<string, float> > expected, actual;
+  b1.similar_row("r3", expected, 5);
+  b2.similar_row("r3", actual, 5);
+  EXPECT_TRUE(expected == actual);
+}
+
+TYPED_TEST_P(recommender_random_test, similar_all) {
+  TypeParam r;
+  vector<float> mu(3);
+  for (size_t i = 0; i < 300; ++i) {
+    vector<double> v;
+    make_random(mu, 1.0, 3, v);
+    r.update_row("r" + lexical_cast<string>(i), make_vec(v[0], v[1], v[2]));
+  }
+
+  recommender_base& b = r;
+  vector<string> ids;
+  b.get_all_row_ids(ids);
+  sort(ids.begin(), ids.end());
+
+  vector<pair<string, vector<pair<string, float> > > > all;
+  for (size_t offset = 0; ; offset += 120) {
+    vector<pair<string, vector<pair<string, float> > > > page;
+    b.similar_all(offset, 120, 5, page);
+    if (page.empty()) {
+      break;
+    }
+    EXPECT_GE(120u, page.size());
+    all.insert(all.end(), page.begin(), page.end());
+  }
+
+  ASSERT_EQ(ids.size(), all.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(ids[i], all[i].first);
+    vector<pair<string, float> > expected;
+    b.similar_row(ids[i], expected, 5);
+    EXPECT_TRUE(expected == all[i].second);
+  }
+
+  // sorted ids are dropped when rows change
+  b.update_row("r", make_vec(1.0, 0.5, 0.25));
+  vector<pair<string, vector<pair<string, float> > > > first;
+  b.similar_all(0, 1, 5, first);
+  ASSERT_EQ(1u, first.size());
+  EXPECT_EQ("r", first[0].first);
+}
+
 REGISTER_TYPED_TEST_CASE_P(recommender_random_test,
                            trivial, random, save_load, get_all_row_ids,
-                           diff, mix);
+                           diff, mix, batch, prepare_and_apply_rows,
+                           similar_all);
 
-typedef testing::Types<inverted_index, lsh, minhash> recommender_types;
+typedef testing::Types<inverted_index, lsh, minhash, hnsw> recommender_types;
 
 INSTANTIATE_TYPED_TEST_CASE_P(rt, recommender_random_test, recommender_types);
 
@@ -0,0 +1,156 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "row_timestamps.hpp"
+
+#include <cmath>
+
+using namespace std;
+
+namespace jubatus {
+namespace recommender {
+
+row_timestamps::row_timestamps()
+    : ttl_(0), half_life_(0) {
+}
+
+row_timestamps::row_timestamps(uint64_t ttl, uint64_t half_life)
+    : ttl_(ttl), half_life_(half_life) {
+}
+
+void row_timestamps::touch(const string& row, uint64_t time) {
+  if (!enabled()) return;
+  uint64_t& t = diff_[row];
+  t = max(t, time);
+}
+
+void row_timestamps::remove(const string& row) {
+  diff_.erase(row);
+  time_map_t::iterator it = mixed_.find(row);
+  if (it != mixed_.end()) {
+    order_.erase(make_pair(it->second, row));
+    mixed_.erase(it);
+  }
+}
+
+void row_timestamps::clear() {
+  diff_.clear();
+  mixed_.clear();
+  order_.clear();
+}
+
+size_t row_timestamps::size() const {
+  size_t ret = mixed_.size();
+  for (time_map_t::const_iterator it = diff_.begin(); it != diff_.end(); ++it) {
+    if (mixed_.count(it->first) == 0) {
+      ++ret;
+    }
+  }
+  return ret;
+}
+
+uint64_t row_timestamps::get(const string& row) const {
+  uint64_t ret = 0;
+  time_map_t::const_iterator it = diff_.find(row);
+  if (it != diff_.end()) {
+    ret = it->second;
+  }
+  it = mixed_.find(row);
+  if (it != mixed_.end()) {
+    ret = max(ret, it->second);
+  }
+  return ret;
+}
+
+float row_timestamps::decay(const string& row, uint64_t now) const {
+  if (half_life_ == 0) return 1.f;
+  uint64_t time = get(row);
+  if (time == 0 || now <= time) return 1.f;
+  return static_cast<float>(
+      pow(0.5, static_cast<double>(now - time) / half_life_));
+}
+
+void row_timestamps::get_diff(uint64_t now, row_timestamps_diff& diff) const {
+  diff.time = now;
+  diff.rows.clear();
+  diff.rows.insert(diff_.begin(), diff_.end());
+}
+
+void row_timestamps::mix(const row_timestamps_diff& lhs, row_timestamps_diff& acc) {
+  acc.time = max(acc.time, lhs.time);
+  for (map<string, uint64_t>::const_iterator it = lhs.rows.begin();
+       it != lhs.rows.end(); ++it) {
+    uint64_t& t = acc.rows[it->first];
+    t = max(t, it->second);
+  }
+}
+
+void row_timestamps::put_diff(const row_timestamps_diff& diff,
+                              vector<string>& expired) {
+  expired.clear();
+  for (map<string, uint64_t>::const_iterator it = diff.rows.begin();
+       it != diff.rows.end(); ++it) {
+    set_mixed(it->first, it->second);
+    // rows updated after get_diff are left for the next mix
+    time_map_t::iterator d = diff_.find(it->first);
+    if (d != diff_.end() && d->second <= it->second) {
+      diff_.erase(d);
+    }
+  }
+
+  if (ttl_ == 0 || diff.time < ttl_) return;
+  uint64_t limit = diff.time - ttl_;
+  while (!order_.empty() && order_.begin()->first < limit) {
+    const string& row = order_.begin()->second;
+    expired.push_back(row);
+    diff_.erase(row);
+    mixed_.erase(row);
+    order_.erase(order_.begin());
+  }
+}
+
+void row_timestamps::set_mixed(const string& row, uint64_t time) {
+  time_map_t::iterator it = mixed_.find(row);
+  if (it == mixed_.end()) {
+    mixed_[row] = time;
+    order_.insert(make_pair(time, row));
+  } else if (it->second < time) {
+    order_.erase(make_pair(it->second, row));
+    it->second = time;
+    order_.insert(make_pair(time, row));
+  }
+}
+
+void row_timestamps::save(std::ostream& os) {
+  if (!enabled()) return;
+  pfi::data::serialization::binary_oarchive oa(os);
+  oa << *this;
+}
+
+void row_timestamps::load(std::istream& is) {
+  clear();
+  if (!enabled()) return;
+  if (is.peek() == std::istream::traits_type::eof()) {
+    is.clear();
+    return;
+  }
+  pfi::data::serialization::binary_iarchive ia(is);
+  ia >> *this;
+}
+
+} // namespace recommender
+} // namespace jubatus
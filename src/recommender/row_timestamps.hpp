@@ -0,0 +1,114 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#pragma once
+
+#include <stdint.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <msgpack.hpp>
+#include <pficommon/data/serialization.h>
+#include <pficommon/data/serialization/unordered_map.h>
+#include <pficommon/data/unordered_map.h>
+
+namespace jubatus {
+namespace recommender {
+
+struct row_timestamps_diff {
+  row_timestamps_diff() : time(0) {}
+
+  // the latest clock of the servers at get_diff
+  uint64_t time;
+  // last update times of rows updated since the last mix
+  std::map<std::string, uint64_t> rows;
+
+  MSGPACK_DEFINE(time, rows);
+};
+
+// Keeps the last update time of rows in seconds, to expire rows which are
+// not updated for ttl seconds and to decay weights of rows by their age.
+// Rows are expired only when a mixed diff is put, by comparing mixed times
+// with the time of the mix, so that every server expires the same rows.
+// Nothing is kept or saved when both ttl and half_life are 0.
+// ttl and half_life are taken from the config, and are not saved.
+class row_timestamps {
+public:
+  row_timestamps();
+  row_timestamps(uint64_t ttl, uint64_t half_life);
+
+  uint64_t ttl() const { return ttl_; }
+  uint64_t half_life() const { return half_life_; }
+  bool enabled() const { return ttl_ != 0 || half_life_ != 0; }
+
+  void touch(const std::string& row, uint64_t time);
+  void remove(const std::string& row);
+  void clear();
+  size_t size() const;
+
+  // Returns 0 for unknown rows.
+  uint64_t get(const std::string& row) const;
+  // Returns 0.5 ^ (age / half_life) of the row at now, or 1 when the decay is
+  // disabled or the row is unknown.
+  float decay(const std::string& row, uint64_t now) const;
+
+  void get_diff(uint64_t now, row_timestamps_diff& diff) const;
+  // Merges lhs into acc, taking the later times.
+  static void mix(const row_timestamps_diff& lhs, row_timestamps_diff& acc);
+  // Rows whose mixed times are expired at diff.time are removed and returned
+  // in expired, in the order of their times, even if they are updated on
+  // this server after get_diff.
+  void put_diff(const row_timestamps_diff& diff, std::vector<std::string>& expired);
+
+  // Models saved without timestamps, which end before them, are loaded as
+  // ones without times.
+  void save(std::ostream& os);
+  void load(std::istream& is);
+
+private:
+  friend class pfi::data::serialization::access;
+  template <class Ar>
+  void serialize(Ar& ar) {
+    ar
+        & MEMBER(diff_)
+        & MEMBER(mixed_);
+    if (ar.is_read) {
+      order_.clear();
+      for (time_map_t::const_iterator it = mixed_.begin(); it != mixed_.end(); ++it) {
+        order_.insert(std::make_pair(it->second, it->first));
+      }
+    }
+  }
+
+  typedef pfi::data::unordered_map<std::string, uint64_t> time_map_t;
+
+  void set_mixed(const std::string& row, uint64_t time);
+
+  uint64_t ttl_;
+  uint64_t half_life_;
+  // rows updated since the last mix
+  time_map_t diff_;
+  time_map_t mixed_;
+  // mixed rows in the order of times, to find expired rows without a scan
+  std::set<std::pair<uint64_t, std::string> > order_;
+};
+
+} // namespace recommender
+} // namespace jubatus
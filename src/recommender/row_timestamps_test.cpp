@@ -0,0 +1,173 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include "row_timestamps.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace recommender {
+
+TEST(row_timestamps, disabled) {
+  row_timestamps t;
+  EXPECT_FALSE(t.enabled());
+  t.touch("r1", 10);
+  EXPECT_EQ(0u, t.size());
+  EXPECT_EQ(0u, t.get("r1"));
+  EXPECT_FLOAT_EQ(1.f, t.decay("r1", 100));
+}
+
+TEST(row_timestamps, touch) {
+  row_timestamps t(100, 0);
+  t.touch("r1", 10);
+  t.touch("r1", 5);
+  EXPECT_EQ(10u, t.get("r1"));
+  EXPECT_EQ(1u, t.size());
+
+  t.remove("r1");
+  EXPECT_EQ(0u, t.get("r1"));
+  EXPECT_EQ(0u, t.size());
+}
+
+TEST(row_timestamps, decay) {
+  row_timestamps t(0, 10);
+  t.touch("r1", 100);
+  EXPECT_FLOAT_EQ(1.f, t.decay("r1", 100));
+  EXPECT_FLOAT_EQ(0.5f, t.decay("r1", 110));
+  EXPECT_FLOAT_EQ(0.25f, t.decay("r1", 120));
+  EXPECT_FLOAT_EQ(1.f, t.decay("r2", 120));
+}
+
+TEST(row_timestamps, mix) {
+  row_timestamps t1(100, 0), t2(100, 0);
+  t1.touch("r1", 10);
+  t1.touch("r2", 20);
+  t2.touch("r2", 30);
+  t2.touch("r3", 40);
+
+  row_timestamps_diff d1, d2;
+  t1.get_diff(50, d1);
+  t2.get_diff(60, d2);
+  row_timestamps::mix(d1, d2);
+  EXPECT_EQ(60u, d2.time);
+  ASSERT_EQ(3u, d2.rows.size());
+  EXPECT_EQ(10u, d2.rows["r1"]);
+  EXPECT_EQ(30u, d2.rows["r2"]);
+  EXPECT_EQ(40u, d2.rows["r3"]);
+
+  vector<string> expired;
+  t1.put_diff(d2, expired);
+  EXPECT_TRUE(expired.empty());
+  EXPECT_EQ(3u, t1.size());
+  EXPECT_EQ(30u, t1.get("r2"));
+}
+
+TEST(row_timestamps, expire) {
+  row_timestamps t1(100, 0), t2(100, 0);
+  t1.touch("r1", 10);
+  t1.touch("r2", 50);
+  t2.touch("r3", 30);
+
+  row_timestamps_diff d1, d2;
+  t1.get_diff(60, d1);
+  t2.get_diff(60, d2);
+  row_timestamps::mix(d1, d2);
+  vector<string> expired;
+  t1.put_diff(d2, expired);
+  t2.put_diff(d2, expired);
+
+  // both servers expire the same rows at the same mix
+  t1.touch("r2", 140);
+  t1.get_diff(140, d1);
+  t2.get_diff(135, d2);
+  // an update after get_diff does not keep a row on one server only
+  t2.touch("r3", 136);
+  row_timestamps::mix(d1, d2);
+  vector<string> expired1, expired2;
+  t1.put_diff(d2, expired1);
+  t2.put_diff(d2, expired2);
+  ASSERT_EQ(2u, expired1.size());
+  EXPECT_EQ("r1", expired1[0]);
+  EXPECT_EQ("r3", expired1[1]);
+  EXPECT_TRUE(expired1 == expired2);
+  EXPECT_EQ(140u, t1.get("r2"));
+  EXPECT_EQ(140u, t2.get("r2"));
+  EXPECT_EQ(0u, t2.get("r1"));
+  EXPECT_EQ(0u, t2.get("r3"));
+}
+
+TEST(row_timestamps, updated_after_get_diff) {
+  row_timestamps t(100, 0);
+  t.touch("r1", 10);
+  row_timestamps_diff d;
+  t.get_diff(20, d);
+  t.touch("r1", 30);
+
+  vector<string> expired;
+  t.put_diff(d, expired);
+  EXPECT_EQ(30u, t.get("r1"));
+
+  // the later update is sent at the next mix
+  t.get_diff(40, d);
+  EXPECT_EQ(30u, d.rows["r1"]);
+}
+
+TEST(row_timestamps, save_load) {
+  row_timestamps t(100, 10);
+  t.touch("r1", 10);
+  row_timestamps_diff d;
+  t.get_diff(20, d);
+  vector<string> expired;
+  t.put_diff(d, expired);
+  t.touch("r2", 30);
+
+  stringstream ss;
+  t.save(ss);
+  // ttl and half_life are taken from the config
+  row_timestamps u(150, 10);
+  u.load(ss);
+  EXPECT_EQ(150u, u.ttl());
+  EXPECT_EQ(10u, u.half_life());
+  EXPECT_EQ(10u, u.get("r1"));
+  EXPECT_EQ(30u, u.get("r2"));
+
+  u.get_diff(200, d);
+  u.put_diff(d, expired);
+  ASSERT_EQ(2u, expired.size());
+  EXPECT_EQ("r1", expired[0]);
+  EXPECT_EQ("r2", expired[1]);
+}
+
+TEST(row_timestamps, save_load_disabled) {
+  row_timestamps t;
+  stringstream ss;
+  t.save(ss);
+  EXPECT_TRUE(ss.str().empty());
+
+  // a model saved without timestamps is loaded with them enabled
+  row_timestamps u(100, 0);
+  u.touch("r1", 10);
+  u.load(ss);
+  EXPECT_TRUE(ss.good());
+  EXPECT_EQ(0u, u.size());
+}
+
+}
+}
@@ -39,7 +39,19 @@ static float calc_norm(const sfv_t& fv) {
   return norm;
 }
 
+static float calc_norm(const vector<float>& dense) {
+  float norm = 0;
+  for (size_t i = 0; i < dense.size(); ++i) {
+    norm += dense[i] * dense[i];
+  }
+  return norm;
+}
+
 void PA::train(const sfv_t& fv, float value) {
+  train(fv, vector<float>(), value);
+}
+
+void PA::train(const sfv_t& fv, const vector<float>& dense, float value) {
   sum_ += value;
   sq_sum_ += value * value;
   count_ += 1;
@@ -47,9 +59,9 @@ void PA::train(const sfv_t& fv, float value) {
   float std_dev = sqrt(sq_sum_ / count_
                        - 2 * avg * sum_ / count_
                        + avg * avg);
-  float fv_norm = sqrt(calc_norm(fv));
+  float fv_norm = sqrt(calc_norm(fv) + calc_norm(dense));
 
-  float predict = estimate(fv);
+  float predict = estimate(fv, dense);
   float error = value - predict;
   float sign_error = error > 0 ? 1.0f : -1.0f;
   float loss = sign_error * error - epsilon_ * std_dev;
@@ -57,10 +69,14 @@ void PA::train(const sfv_t& fv, float value) {
   if (loss > 0) {
     float coeff = sign_error * std::min(C_, loss) / (fv_norm * fv_norm);
     if (!isinf(coeff)) {
-      update(fv, coeff);
+      update(fv, dense, coeff);
     }
   }
 }
 
+bool PA::supports_dense() const {
+  return true;
+}
+
 }
 }
@@ -27,6 +27,8 @@ class PA : public regression_base {
   PA(storage::storage_base* storage);
 
   void train(const sfv_t& fv, float value);
+  void train(const sfv_t& fv, const std::vector<float>& dense, float value);
+  bool supports_dense() const;
 
  private:
   float epsilon_;
@@ -16,6 +16,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "regression_base.hpp"
+#include "../common/exception.hpp"
 #include "../storage/storage_base.hpp"
 
 namespace jubatus {
@@ -33,5 +34,33 @@ void regression_base::update(const sfv_t& fv, float coeff) {
   storage_->bulk_update(fv, coeff, "+", "");
 }
 
+bool regression_base::supports_dense() const {
+  return false;
+}
+
+void regression_base::train(const sfv_t& fv, const std::vector<float>& dense, const float value) {
+  if (!dense.empty()) {
+    throw JUBATUS_EXCEPTION(unsupported_method("regression with dense features"));
+  }
+  train(fv, value);
+}
+
+float regression_base::estimate(const sfv_t& fv, const std::vector<float>& dense) const {
+  if (dense.empty()) {
+    return estimate(fv);
+  }
+  storage::map_feature_val1_t ret;
+  get_storage()->inp_dense(fv, dense, ret);
+  return ret["+"];
+}
+
+void regression_base::update(const sfv_t& fv, const std::vector<float>& dense, float coeff) {
+  if (dense.empty()) {
+    update(fv, coeff);
+  } else {
+    storage_->bulk_update_dense(fv, dense, coeff, "+", "");
+  }
+}
+
 
 }
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <vector>
 #include "../common/type.hpp"
 
 namespace jubatus {
@@ -35,12 +36,19 @@ class regression_base {
   virtual void train(const sfv_t& fv, const float value) = 0;
   float estimate(const sfv_t& fv) const;
 
+  // Variants taking values of dense features of the storage (see
+  // storage::storage_base::set_dense_features) in addition to sfv.
+  virtual bool supports_dense() const;
+  virtual void train(const sfv_t& fv, const std::vector<float>& dense, const float value);
+  float estimate(const sfv_t& fv, const std::vector<float>& dense) const;
+
  protected:
   storage::storage_base* get_storage() const {
     return storage_;
   }
 
   void update(const sfv_t& fv, float coeff);
+  void update(const sfv_t& fv, const std::vector<float>& dense, float coeff);
 
  private:
   storage::storage_base* storage_;
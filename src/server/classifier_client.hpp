@@ -35,6 +35,14 @@ public:
       return call<std::vector<std::vector<estimate_result > >(std::string, std::vector<datum >)>("classify")(name, data);
     }
 
+    int32_t train_batch(std::string name, std::vector<std::string > labels, datum_batch data) {
+      return call<int32_t(std::string, std::vector<std::string >, datum_batch)>("train_batch")(name, labels, data);
+    }
+
+    std::vector<std::vector<estimate_result > > classify_batch(std::string name, datum_batch data) {
+      return call<std::vector<std::vector<estimate_result > >(std::string, datum_batch)>("classify_batch")(name, data);
+    }
+
     bool save(std::string name, std::string id) {
       return call<bool(std::string, std::string)>("save")(name, id);
     }
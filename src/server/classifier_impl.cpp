@@ -25,6 +25,12 @@ public:
   std::vector<std::vector<estimate_result > > classify(std::string name, std::vector<datum > data) //analysis random
   { JRLOCK__(p_); return get_p()->classify(data); }
 
+  int train_batch(std::string name, std::vector<std::string > labels, datum_batch data) //update random
+  { JWLOCK__(p_); return get_p()->train_batch(labels, data); }
+
+  std::vector<std::vector<estimate_result > > classify_batch(std::string name, datum_batch data) //analysis random
+  { JRLOCK__(p_); return get_p()->classify_batch(data); }
+
   bool save(std::string name, std::string id) //update broadcast
   { JWLOCK__(p_); return get_p()->save(id); }
 
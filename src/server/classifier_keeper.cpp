@@ -12,6 +12,8 @@ int main(int args, char** argv){
     k.register_random<config_data >("get_config"); //pass analysis
     k.register_random<int, std::vector<std::pair<std::string,datum > > >("train"); //pass update
     k.register_random<std::vector<std::vector<estimate_result > >, std::vector<datum > >("classify"); //pass analysis
+    k.register_random<int, std::vector<std::string >, datum_batch >("train_batch"); //pass update
+    k.register_random<std::vector<std::vector<estimate_result > >, datum_batch >("classify_batch"); //pass analysis
     k.register_broadcast<bool, std::string >("save", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
     k.register_broadcast<bool, std::string >("load", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
     k.register_broadcast<std::map<std::string,std::map<std::string,std::string > > >("get_status", pfi::lang::function<std::map<std::string,std::map<std::string,std::string > >(std::map<std::string,std::map<std::string,std::string > >,std::map<std::string,std::map<std::string,std::string > >)>(&merge<std::string,std::map<std::string,std::string > >)); //analysis
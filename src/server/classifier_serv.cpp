@@ -20,6 +20,7 @@
 #include "../classifier/classifier_factory.hpp"
 #include "../common/util.hpp"
 #include "../common/vector_util.hpp"
+#include "../framework/datum_batch.hpp"
 #include "../framework/mixer/mixer_factory.hpp"
 #include "../fv_converter/datum.hpp"
 #include "../fv_converter/datum_to_fv_converter.hpp"
@@ -44,7 +45,7 @@ linear_function_mixer::model_ptr make_model(const framework::server_argv& arg) {
 
 classifier_serv::classifier_serv(const framework::server_argv& a,
                                  const cshared_ptr<lock_service>& zk)
-    : server_base(a) {
+    : server_base(a), use_dense_(false) {
   clsfer_.set_model(make_model(a));
   wm_.set_model(mixable_weight_manager::model_ptr(new weight_manager));
 
@@ -77,6 +78,13 @@ int classifier_serv::set_config(const config_data& config) {
 
   classifier_.reset(classifier_factory::create_classifier(config.method, clsfer_.get_model().get()));
 
+  // algorithms without dense support get values of dense rules as ordinary
+  // features from the converter
+  vector<string> dense_features;
+  converter_->get_dense_features(dense_features);
+  use_dense_ = !dense_features.empty() && classifier_->supports_dense();
+  clsfer_.get_model()->set_dense_features(use_dense_ ? dense_features : vector<string>());
+
   // FIXME: switch the function when set_config is done
   // because mixing method differs btwn PA, CW, etc...
   return 0;
@@ -93,14 +101,40 @@ int classifier_serv::train(const vector<pair<string, jubatus::datum> >& data) {
 
   int count = 0;
   sfv_t v;
+  vector<float> dense;
   fv_converter::datum d;
   
   for (size_t i = 0; i < data.size(); ++i) {
-    convert<jubatus::datum, fv_converter::datum>(data[i].second, d);
-    converter_->convert_and_update_weight(d, v);
-    sort_and_merge(v);
+    convert_datum(data[i].second, d);
+    convert_and_update_weight(d, v, dense);
 
-    classifier_->train(v, data[i].first);
+    classifier_->train(v, dense, data[i].first);
+    count++;
+  }
+  // FIXME: send count incrementation to mixer
+  return count;
+}
+
+int classifier_serv::train_batch(const vector<string>& labels,
+                                 const datum_batch& data) {
+  check_set_config();
+
+  size_t size = datum_batch_size(data);
+  if (labels.size() != size) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "the number of labels does not match the number of datum"));
+  }
+
+  int count = 0;
+  sfv_t v;
+  vector<float> dense;
+  fv_converter::datum d;
+
+  for (size_t i = 0; i < size; ++i) {
+    decode_datum_batch(data, i, d);
+    convert_and_update_weight(d, v, dense);
+
+    classifier_->train(v, dense, labels[i]);
     count++;
   }
   // FIXME: send count incrementation to mixer
@@ -114,28 +148,72 @@ classifier_serv::classify(const vector<jubatus::datum>& data) const {
   check_set_config();
 
   sfv_t v;
+  vector<float> dense;
   fv_converter::datum d;
   for (size_t i = 0; i < data.size(); ++i) {
-    convert<datum, fv_converter::datum>(data[i], d);
+    convert_datum(data[i], d);
+    convert(d, v, dense);
+    ret.push_back(vector<estimate_result>());
+    classify_sfv(v, dense, ret.back());
+  }
+  return ret; //vector<estimate_results> >::ok(ret);
+}
+
+vector<vector<estimate_result> >
+classifier_serv::classify_batch(const datum_batch& data) const {
+  check_set_config();
+
+  size_t size = datum_batch_size(data);
+  vector<vector<estimate_result> > ret(size);
+
+  sfv_t v;
+  vector<float> dense;
+  fv_converter::datum d;
+  for (size_t i = 0; i < size; ++i) {
+    decode_datum_batch(data, i, d);
+    convert(d, v, dense);
+    classify_sfv(v, dense, ret[i]);
+  }
+  return ret;
+}
+
+void classifier_serv::convert(const fv_converter::datum& d, sfv_t& v,
+                              vector<float>& dense) const {
+  if (use_dense_) {
+    converter_->convert(d, v, dense);
+  } else {
     converter_->convert(d, v);
+  }
+}
 
-    classify_result scores;
-    classifier_->classify_with_scores(v, scores);
-    
-    vector<estimate_result> r;
-    for (vector<classify_result_elem>::const_iterator p = scores.begin();
-         p != scores.end(); ++p) {
-      estimate_result e;
-      e.label = p->label;
-      e.prob = p->score;
-      r.push_back(e);
-      if (!isfinite(p->score)) {
-        LOG(WARNING) << p->label << ":" << p->score;
-      }
+void classifier_serv::convert_and_update_weight(const fv_converter::datum& d,
+                                                sfv_t& v,
+                                                vector<float>& dense) {
+  if (use_dense_) {
+    converter_->convert_and_update_weight(d, v, dense);
+  } else {
+    converter_->convert_and_update_weight(d, v);
+  }
+  merge_duplicates(v);
+}
+
+void classifier_serv::classify_sfv(const sfv_t& v,
+                                   const vector<float>& dense,
+                                   vector<estimate_result>& ret) const {
+  classify_result scores;
+  classifier_->classify_with_scores(v, dense, scores);
+
+  ret.clear();
+  for (vector<classify_result_elem>::const_iterator p = scores.begin();
+       p != scores.end(); ++p) {
+    estimate_result e;
+    e.label = p->label;
+    e.prob = p->score;
+    ret.push_back(e);
+    if (!isfinite(p->score)) {
+      LOG(WARNING) << p->label << ":" << p->score;
     }
-    ret.push_back(r);
   }
-  return ret; //vector<estimate_results> >::ok(ret);
 }
 
 void classifier_serv::check_set_config()const {
@@ -25,6 +25,7 @@
 #include "../framework/mixable.hpp"
 #include "../framework/mixer/mixer.hpp"
 #include "../framework/server_base.hpp"
+#include "../fv_converter/datum.hpp"
 #include "classifier_types.hpp"
 #include "diffv.hpp"
 #include "linear_function_mixer.hpp"
@@ -49,15 +50,26 @@ public:
   config_data get_config();
   int train(const std::vector<std::pair<std::string, datum> >& data);
   std::vector<std::vector<estimate_result> > classify(const std::vector<datum>& data) const;
+  int train_batch(const std::vector<std::string>& labels,
+                  const datum_batch& data);
+  std::vector<std::vector<estimate_result> > classify_batch(const datum_batch& data) const;
 
   void check_set_config() const;
 
 private:
+  void convert(const fv_converter::datum& d, sfv_t& v,
+               std::vector<float>& dense) const;
+  void convert_and_update_weight(const fv_converter::datum& d, sfv_t& v,
+                                 std::vector<float>& dense);
+  void classify_sfv(const sfv_t& v, const std::vector<float>& dense,
+                    std::vector<estimate_result>& ret) const;
+
   pfi::lang::scoped_ptr<framework::mixer::mixer> mixer_;
 
   config_data config_;
   pfi::lang::shared_ptr<fv_converter::datum_to_fv_converter> converter_;
   pfi::lang::shared_ptr<classifier_base> classifier_;
+  bool use_dense_;
   linear_function_mixer clsfer_;
   mixable_weight_manager wm_;
 };
@@ -24,6 +24,8 @@ public:
     rpc_server::add<config_data(std::string) >("get_config", pfi::lang::bind(&Impl::get_config, static_cast<Impl*>(this), pfi::lang::_1));
     rpc_server::add<int32_t(std::string, std::vector<std::pair<std::string, datum > >) >("train", pfi::lang::bind(&Impl::train, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<std::vector<std::vector<estimate_result > >(std::string, std::vector<datum >) >("classify", pfi::lang::bind(&Impl::classify, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
+    rpc_server::add<int32_t(std::string, std::vector<std::string >, datum_batch) >("train_batch", pfi::lang::bind(&Impl::train_batch, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3));
+    rpc_server::add<std::vector<std::vector<estimate_result > >(std::string, datum_batch) >("classify_batch", pfi::lang::bind(&Impl::classify_batch, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<bool(std::string, std::string) >("save", pfi::lang::bind(&Impl::save, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<bool(std::string, std::string) >("load", pfi::lang::bind(&Impl::load, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<std::map<std::string, std::map<std::string, std::string > >(std::string) >("get_status", pfi::lang::bind(&Impl::get_status, static_cast<Impl*>(this), pfi::lang::_1));
@@ -35,6 +35,10 @@ public:
       return call<bool(std::string, std::string, datum)>("update_row")(name, id, d);
     }
 
+    bool update_rows(std::string name, std::vector<std::pair<std::string, datum > > rows) {
+      return call<bool(std::string, std::vector<std::pair<std::string, datum > >)>("update_rows")(name, rows);
+    }
+
     bool clear(std::string name) {
       return call<bool(std::string)>("clear")(name);
     }
@@ -47,6 +51,10 @@ public:
       return call<datum(std::string, datum)>("complete_row_from_data")(name, d);
     }
 
+    std::vector<datum > complete_row_from_data_batch(std::string name, datum_batch data) {
+      return call<std::vector<datum >(std::string, datum_batch)>("complete_row_from_data_batch")(name, data);
+    }
+
     similar_result similar_row_from_id(std::string name, std::string id, uint32_t size) {
       return call<similar_result(std::string, std::string, uint32_t)>("similar_row_from_id")(name, id, size);
     }
@@ -55,6 +63,22 @@ public:
       return call<similar_result(std::string, datum, uint32_t)>("similar_row_from_data")(name, data, size);
     }
 
+    std::vector<similar_result > similar_rows_from_ids(std::string name, std::vector<std::string > ids, uint32_t size) {
+      return call<std::vector<similar_result >(std::string, std::vector<std::string >, uint32_t)>("similar_rows_from_ids")(name, ids, size);
+    }
+
+    std::vector<similar_result > similar_rows_from_datums(std::string name, datum_batch data, uint32_t size) {
+      return call<std::vector<similar_result >(std::string, datum_batch, uint32_t)>("similar_rows_from_datums")(name, data, size);
+    }
+
+    std::vector<std::pair<std::string, similar_result > > similar_all(std::string name, uint32_t offset, uint32_t page_size, uint32_t size) {
+      return call<std::vector<std::pair<std::string, similar_result > >(std::string, uint32_t, uint32_t, uint32_t)>("similar_all")(name, offset, page_size, size);
+    }
+
+    std::string similar_all_to_file(std::string name, uint32_t size) {
+      return call<std::string(std::string, uint32_t)>("similar_all_to_file")(name, size);
+    }
+
     datum decode_row(std::string name, std::string id) {
       return call<datum(std::string, std::string)>("decode_row")(name, id);
     }
@@ -25,6 +25,9 @@ public:
   bool update_row(std::string name, std::string id, datum d) //update cht(2)
   { JWLOCK__(p_); return get_p()->update_row(id, d); }
 
+  bool update_rows(std::string name, std::vector<std::pair<std::string, datum > > rows) //update cht_batch(2)
+  { NOLOCK__(p_); return get_p()->update_rows(rows); }
+
   bool clear(std::string name) //update broadcast
   { JWLOCK__(p_); return get_p()->clear(); }
 
@@ -34,12 +37,27 @@ public:
   datum complete_row_from_data(std::string name, datum d) //analysis random
   { JRLOCK__(p_); return get_p()->complete_row_from_data(d); }
 
+  std::vector<datum > complete_row_from_data_batch(std::string name, datum_batch data) //analysis random
+  { JRLOCK__(p_); return get_p()->complete_row_from_data_batch(data); }
+
   similar_result similar_row_from_id(std::string name, std::string id, unsigned int size) //analysis cht(2)
   { JRLOCK__(p_); return get_p()->similar_row_from_id(id, size); }
 
   similar_result similar_row_from_data(std::string name, datum data, unsigned int size) //analysis random
   { JRLOCK__(p_); return get_p()->similar_row_from_data(data, size); }
 
+  std::vector<similar_result > similar_rows_from_ids(std::string name, std::vector<std::string > ids, unsigned int size) //analysis cht_scatter(1)
+  { JRLOCK__(p_); return get_p()->similar_rows_from_ids(ids, size); }
+
+  std::vector<similar_result > similar_rows_from_datums(std::string name, datum_batch data, unsigned int size) //analysis random
+  { JRLOCK__(p_); return get_p()->similar_rows_from_datums(data, size); }
+
+  std::vector<std::pair<std::string, similar_result > > similar_all(std::string name, unsigned int offset, unsigned int page_size, unsigned int size) //analysis random
+  { JRLOCK__(p_); return get_p()->similar_all(offset, page_size, size); }
+
+  std::string similar_all_to_file(std::string name, unsigned int size) //analysis random
+  { NOLOCK__(p_); return get_p()->similar_all_to_file(size); }
+
   datum decode_row(std::string name, std::string id) //analysis cht(2)
   { JRLOCK__(p_); return get_p()->decode_row(id); }
 
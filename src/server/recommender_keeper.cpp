@@ -12,11 +12,17 @@ int main(int args, char** argv){
     k.register_random<config_data >("get_config"); //pass analysis
     k.register_cht<2, bool >("clear_row", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
     k.register_cht<2, bool, datum >("update_row", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
+    k.register_cht_batch<2, bool, datum >("update_rows", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
     k.register_broadcast<bool >("clear", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
     k.register_cht<2, datum >("complete_row_from_id", pfi::lang::function<datum(datum,datum)>(&pass<datum >)); //analysis
     k.register_random<datum, datum >("complete_row_from_data"); //pass analysis
+    k.register_random<std::vector<datum >, datum_batch >("complete_row_from_data_batch"); //pass analysis
     k.register_cht<2, similar_result, unsigned int >("similar_row_from_id", pfi::lang::function<similar_result(similar_result,similar_result)>(&pass<similar_result >)); //analysis
     k.register_random<similar_result, datum, unsigned int >("similar_row_from_data"); //pass analysis
+    k.register_cht_scatter<1, similar_result, unsigned int >("similar_rows_from_ids"); //analysis
+    k.register_random<std::vector<similar_result >, datum_batch, unsigned int >("similar_rows_from_datums"); //pass analysis
+    k.register_random<std::vector<std::pair<std::string, similar_result > >, unsigned int, unsigned int, unsigned int >("similar_all"); //pass analysis
+    k.register_random<std::string, unsigned int >("similar_all_to_file"); //pass analysis
     k.register_cht<2, datum >("decode_row", pfi::lang::function<datum(datum,datum)>(&pass<datum >)); //analysis
     k.register_broadcast<std::vector<std::string > >("get_all_rows", pfi::lang::function<std::vector<std::string >(std::vector<std::string >,std::vector<std::string >)>(&concat<std::string >)); //analysis
     k.register_random<float, datum, datum >("similarity"); //pass analysis
@@ -17,10 +17,24 @@
 
 #include "recommender_serv.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <glog/logging.h>
 #include <pficommon/concurrent/lock.h>
+#include <pficommon/concurrent/rwmutex.h>
+#include <pficommon/lang/bind.h>
 #include <pficommon/lang/cast.h>
 
 #include "../common/exception.hpp"
+#include "../common/thread_pool.hpp"
+#include "../framework/datum_batch.hpp"
 #include "../framework/mixer/mixer_factory.hpp"
 #include "../fv_converter/converter_config.hpp"
 #include "../fv_converter/datum.hpp"
@@ -36,17 +50,49 @@ using namespace jubatus::framework;
 namespace jubatus {
 namespace server {
 
+namespace {
+
+// queries converted by a task at least
+const size_t MIN_CONVERT_RANGE_SIZE = 16;
+// rows answered at once by similar_all_to_file
+const size_t SIMILAR_ALL_PAGE_SIZE = 4096;
+
+// candidates fetched for a query are doubled while scores decay
+size_t grow_fetch_num(size_t fetch_num) {
+  return fetch_num > numeric_limits<size_t>::max() / 2
+      ? numeric_limits<size_t>::max() : max<size_t>(fetch_num * 2, 1);
+}
+
+struct greater_score {
+  bool operator()(const pair<string, float>& lhs,
+                  const pair<string, float>& rhs) const {
+    return lhs.second > rhs.second;
+  }
+};
+
+}
+
 recommender_serv::recommender_serv(const server_argv& a,
                                    const cshared_ptr<lock_service>& zk)
-    : server_base(a) {
+    : server_base(a),
+      similar_all_running_(false),
+      similar_all_seq_(0),
+      stopping_(false) {
   mixer_.reset(mixer::create_mixer(a, zk));
   wm_.set_model(mixable_weight_manager::model_ptr(new fv_converter::weight_manager));
 
   mixer_->register_mixable(&rcmdr_);
   mixer_->register_mixable(&wm_);
+  // rows are expired after the recommender is mixed
+  timestamps_.set_recommender(&rcmdr_);
+  mixer_->register_mixable(&timestamps_);
 }
 
 recommender_serv::~recommender_serv() {
+  stopping_ = true;
+  if (similar_all_thread_) {
+    similar_all_thread_->join();
+  }
 }
 
 void recommender_serv::get_status(status_t& status) const {
@@ -65,6 +111,8 @@ int recommender_serv::set_config(config_data config) {
   config_ = config;
   converter_ = converter;
   rcmdr_.set_model(make_model());
+  timestamps_.set_model(mixable_row_timestamps::model_ptr(
+      recommender::create_row_timestamps(config.parameter)));
   (*converter_).set_weight_manager(wm_.get_model());
   return 0;
 }
@@ -79,6 +127,7 @@ int recommender_serv::clear_row(std::string id) {
 
   ++clear_row_cnt_;
   rcmdr_.get_model()->clear_row(id);
+  timestamps_.get_model()->remove(id);
   return 0;
 }
 
@@ -87,10 +136,66 @@ int recommender_serv::update_row(std::string id,datum dat) {
 
   ++update_row_cnt_;
   fv_converter::datum d;
-  convert<jubatus::datum, fv_converter::datum>(dat, d);
+  convert_datum(dat, d);
   sfv_diff_t v;
   converter_->convert_and_update_weight(d, v);
   rcmdr_.get_model()->update_row(id, v);
+  timestamps_.get_model()->touch(id, time(NULL));
+  return 0;
+}
+
+// Rows are converted and their signatures are calculated under the read
+// lock, and the write lock is taken only to update weights and to put rows.
+// A model replaced by set_config in between is updated directly.
+int recommender_serv::update_rows(const vector<pair<string, datum> >& rows) {
+  shared_ptr<fv_converter::datum_to_fv_converter> converter;
+  vector<pair<string, sfv_diff_t> > diffs(rows.size());
+  {
+    pfi::concurrent::scoped_lock lk(pfi::concurrent::rlock(rw_mutex()));
+    check_set_config();
+    converter = converter_;
+    thread_pool::get_shared().run_ranges(
+        rows.size(), MIN_CONVERT_RANGE_SIZE,
+        bind(&recommender_serv::convert_rows_range, this, &rows, &diffs, _1, _2));
+  }
+
+  cshared_ptr<recommender::recommender_base> model;
+  {
+    pfi::concurrent::scoped_lock lk(pfi::concurrent::wlock(rw_mutex()));
+    if (converter_ == converter) {
+      for (size_t i = 0; i < diffs.size(); ++i) {
+        converter_->update_and_apply_weight(diffs[i].second);
+      }
+    } else {
+      fv_converter::datum d;
+      for (size_t i = 0; i < rows.size(); ++i) {
+        convert_datum(rows[i].second, d);
+        converter_->convert_and_update_weight(d, diffs[i].second);
+      }
+    }
+    model = rcmdr_.get_model();
+  }
+
+  recommender::recommender_base::prepared_rows prepared;
+  {
+    pfi::concurrent::scoped_lock lk(pfi::concurrent::rlock(rw_mutex()));
+    model->prepare_rows(diffs, prepared);
+  }
+
+  {
+    pfi::concurrent::scoped_lock lk(pfi::concurrent::wlock(rw_mutex()));
+    event_model_updated();
+    update_row_cnt_ += rows.size();
+    if (rcmdr_.get_model() == model) {
+      model->apply_rows(prepared);
+    } else {
+      rcmdr_.get_model()->update_rows(diffs);
+    }
+    uint64_t now = time(NULL);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      timestamps_.get_model()->touch(rows[i].first, now);
+    }
+  }
   return 0;
 }
 
@@ -101,12 +206,13 @@ int recommender_serv::clear() {
   build_cnt_ = 0;
   mix_cnt_ = 0;
   rcmdr_.get_model()->clear();
+  timestamps_.get_model()->clear();
   return 0;
 }
 
 common::cshared_ptr<recommender::recommender_base> recommender_serv::make_model() {
   return cshared_ptr<recommender::recommender_base>
-    (recommender::create_recommender(config_.method));
+    (recommender::create_recommender(config_.method, config_.parameter));
 }  
 
 datum recommender_serv::complete_row_from_id(std::string id) {
@@ -114,29 +220,51 @@ datum recommender_serv::complete_row_from_id(std::string id) {
 
   sfv_t v;
   fv_converter::datum ret;
-  rcmdr_.get_model()->complete_row(id, v);
+  complete_row(*rcmdr_.get_model(), id, time(NULL), v);
 
   fv_converter::revert_feature(v, ret);
 
   datum ret0;
-  convert<fv_converter::datum, datum>(ret, ret0);
+  convert_datum(ret, ret0);
   return ret0;
 }
 
+vector<datum> recommender_serv::complete_row_from_data_batch(
+    const datum_batch& data) {
+  check_set_config();
+
+  size_t size = datum_batch_size(data);
+  vector<datum> ret(size);
+  fv_converter::datum d, completed;
+  sfv_t u, v;
+  uint64_t now = time(NULL);
+  for (size_t i = 0; i < size; ++i) {
+    decode_datum_batch(data, i, d);
+    converter_->convert(d, u);
+    complete_row(*rcmdr_.get_model(), u, now, v);
+
+    completed.string_values_.clear();
+    completed.num_values_.clear();
+    fv_converter::revert_feature(v, completed);
+    convert_datum(completed, ret[i]);
+  }
+  return ret;
+}
+
 datum recommender_serv::complete_row_from_data(datum dat) {
   check_set_config();
 
   fv_converter::datum d;
-  convert<jubatus::datum, fv_converter::datum>(dat, d);
+  convert_datum(dat, d);
   sfv_t u, v;
   fv_converter::datum ret;
   converter_->convert(d, u);
-  rcmdr_.get_model()->complete_row(u, v);
+  complete_row(*rcmdr_.get_model(), u, time(NULL), v);
 
   fv_converter::revert_feature(v, ret);
 
   datum ret0;
-  convert<fv_converter::datum, datum>(ret, ret0);
+  convert_datum(ret, ret0);
   return ret0;
 }
 
@@ -144,7 +272,7 @@ similar_result recommender_serv::similar_row_from_id(std::string id, size_t ret_
   check_set_config();
 
   similar_result ret;
-  rcmdr_.get_model()->similar_row(id, ret, ret_num);
+  find_similar(*rcmdr_.get_model(), id, ret_num, time(NULL), ret);
   return ret;
 }
 
@@ -153,14 +281,294 @@ similar_result recommender_serv::similar_row_from_data(datum data, size_t s) {
 
   similar_result ret;
   fv_converter::datum d;
-  convert<datum, fv_converter::datum>(data, d);
+  convert_datum(data, d);
 
   sfv_t v;
   converter_->convert(d, v);
-  rcmdr_.get_model()->similar_row(v, ret, s);
+  find_similar(*rcmdr_.get_model(), v, s, time(NULL), ret);
+  return ret;
+}
+
+vector<similar_result> recommender_serv::similar_rows_from_ids(
+    const vector<string>& ids, size_t ret_num) {
+  check_set_config();
+
+  const recommender::recommender_base& model = *rcmdr_.get_model();
+  vector<similar_result> ret;
+  size_t fetch_num = first_fetch_num(ret_num);
+  model.similar_rows(ids, ret, fetch_num);
+  uint64_t now = time(NULL);
+  for (size_t i = 0; i < ret.size(); ++i) {
+    decay_result(model, ids[i], ret_num, fetch_num, now, ret[i]);
+  }
+  return ret;
+}
+
+vector<similar_result> recommender_serv::similar_rows_from_datums(
+    const datum_batch& data, size_t ret_num) {
+  check_set_config();
+
+  size_t size = datum_batch_size(data);
+  vector<sfv_t> queries(size);
+  thread_pool::get_shared().run_ranges(
+      size, MIN_CONVERT_RANGE_SIZE,
+      bind(&recommender_serv::convert_batch_range, this, &data, &queries,
+           pfi::lang::_1, pfi::lang::_2));
+
+  const recommender::recommender_base& model = *rcmdr_.get_model();
+  vector<similar_result> ret;
+  size_t fetch_num = first_fetch_num(ret_num);
+  model.similar_rows(queries, ret, fetch_num);
+  uint64_t now = time(NULL);
+  for (size_t i = 0; i < ret.size(); ++i) {
+    decay_result(model, queries[i], ret_num, fetch_num, now, ret[i]);
+  }
   return ret;
 }
 
+vector<pair<string, similar_result> > recommender_serv::similar_all(
+    size_t offset, size_t page_size, size_t ret_num) {
+  check_set_config();
+
+  const recommender::recommender_base& model = *rcmdr_.get_model();
+  vector<pair<string, similar_result> > ret;
+  size_t fetch_num = first_fetch_num(ret_num);
+  model.similar_all(offset, page_size, fetch_num, ret);
+  uint64_t now = time(NULL);
+  for (size_t i = 0; i < ret.size(); ++i) {
+    decay_result(model, ret[i].first, ret_num, fetch_num, now, ret[i].second);
+  }
+  return ret;
+}
+
+struct recommender_serv::similar_all_job {
+  cshared_ptr<recommender::recommender_base> model;
+  // rows listed when the job is started
+  vector<string> row_ids;
+  size_t ret_num;
+  string path;
+  string tmp_path;
+  ofstream ofs;
+};
+
+// The file is written under a temporary name in the background, and is
+// renamed to the returned path when all rows are written. The path is made
+// by the server, so that clients cannot write files outside tmpdir.
+string recommender_serv::similar_all_to_file(size_t ret_num) {
+  pfi::concurrent::scoped_lock job_lk(similar_all_m_);
+  if (similar_all_running_) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "similar_all_to_file is already running"));
+  }
+  if (similar_all_thread_) {
+    similar_all_thread_->join();
+    similar_all_thread_.reset();
+  }
+
+  shared_ptr<similar_all_job> job(new similar_all_job);
+  {
+    pfi::concurrent::scoped_lock lk(pfi::concurrent::rlock(rw_mutex()));
+    check_set_config();
+    job->model = rcmdr_.get_model();
+    job->model->get_sorted_row_ids(0, ~size_t(0), job->row_ids);
+  }
+  job->ret_num = ret_num;
+
+  ostringstream path;
+  path << argv().tmpdir << '/' << argv().eth << '_' << argv().port
+       << "_similar_all_" << time(NULL) << '_' << similar_all_seq_++ << ".tsv";
+  job->path = path.str();
+  job->tmp_path = job->path + ".tmp";
+  job->ofs.open(job->tmp_path.c_str(), ios::trunc);
+  if (!job->ofs) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(job->tmp_path + ": cannot open")
+        << jubatus::exception::error_errno(errno));
+  }
+
+  similar_all_running_ = true;
+  similar_all_thread_.reset(new pfi::concurrent::thread(
+      bind(&recommender_serv::write_similar_all, this, job)));
+  if (!similar_all_thread_->start()) {
+    similar_all_running_ = false;
+    similar_all_thread_.reset();
+    job->ofs.close();
+    remove(job->tmp_path.c_str());
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "cannot start similar_all_to_file"));
+  }
+  LOG(INFO) << "similar rows are being written to " << job->path;
+  return job->path;
+}
+
+void recommender_serv::write_similar_all(shared_ptr<similar_all_job> job) {
+  const vector<string>& row_ids = job->row_ids;
+  vector<string> page;
+  vector<similar_result> results;
+  bool done = true;
+  try {
+    for (size_t begin = 0; begin < row_ids.size(); begin += SIMILAR_ALL_PAGE_SIZE) {
+      if (stopping_) {
+        done = false;
+        break;
+      }
+      size_t end = min(begin + SIMILAR_ALL_PAGE_SIZE, row_ids.size());
+      page.assign(row_ids.begin() + begin, row_ids.begin() + end);
+      {
+        pfi::concurrent::scoped_lock lk(pfi::concurrent::rlock(rw_mutex()));
+        size_t fetch_num = first_fetch_num(job->ret_num);
+        job->model->similar_rows(page, results, fetch_num);
+        uint64_t now = time(NULL);
+        for (size_t i = 0; i < page.size(); ++i) {
+          decay_result(*job->model, page[i], job->ret_num, fetch_num, now, results[i]);
+        }
+      }
+      for (size_t i = 0; i < page.size(); ++i) {
+        for (size_t j = 0; j < results[i].size(); ++j) {
+          job->ofs << page[i] << '\t' << results[i][j].first << '\t'
+                   << results[i][j].second << '\n';
+        }
+      }
+    }
+    job->ofs.close();
+    if (!job->ofs) {
+      LOG(ERROR) << job->tmp_path << ": cannot write: " << strerror(errno);
+      done = false;
+    } else if (done && rename(job->tmp_path.c_str(), job->path.c_str()) != 0) {
+      LOG(ERROR) << job->path << ": cannot rename: " << strerror(errno);
+      done = false;
+    }
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "similar_all_to_file failed: " << e.what();
+    done = false;
+  }
+
+  if (done) {
+    LOG(INFO) << "similar rows are written to " << job->path;
+  } else {
+    remove(job->tmp_path.c_str());
+  }
+  pfi::concurrent::scoped_lock job_lk(similar_all_m_);
+  similar_all_running_ = false;
+}
+
+void recommender_serv::convert_batch_range(const datum_batch* data,
+                                           vector<sfv_t>* fvs,
+                                           size_t begin, size_t end) const {
+  fv_converter::datum d;
+  for (size_t i = begin; i < end; ++i) {
+    decode_datum_batch(*data, i, d);
+    converter_->convert(d, (*fvs)[i]);
+  }
+}
+
+void recommender_serv::convert_rows_range(const vector<pair<string, datum> >* rows,
+                                          vector<pair<string, sfv_diff_t> >* diffs,
+                                          size_t begin, size_t end) const {
+  fv_converter::datum d;
+  for (size_t i = begin; i < end; ++i) {
+    convert_datum((*rows)[i].second, d);
+    (*diffs)[i].first = (*rows)[i].first;
+    converter_->convert_unweighted(d, (*diffs)[i].second);
+  }
+}
+
+size_t recommender_serv::first_fetch_num(size_t ret_num) const {
+  if (timestamps_.get_model()->half_life() == 0) {
+    return ret_num;
+  }
+  return grow_fetch_num(ret_num);
+}
+
+// As decay never raises a score, rows not fetched, whose scores are not
+// above the last candidate, cannot outrank a result which is not below it.
+bool recommender_serv::decay_scores(similar_result& result, size_t fetch_num,
+                                    size_t ret_num, uint64_t now) const {
+  const recommender::row_timestamps& timestamps = *timestamps_.get_model();
+  if (timestamps.half_life() == 0 || result.empty()) {
+    if (result.size() > ret_num) {
+      result.resize(ret_num);
+    }
+    return true;
+  }
+
+  bool all_fetched = result.size() < fetch_num;
+  float bound = result[0].second;
+  for (size_t i = 0; i < result.size(); ++i) {
+    bound = min(bound, result[i].second);
+    float decay = timestamps.decay(result[i].first, now);
+    // negative scores, e.g. of the euclid metric, are divided to fall
+    float& score = result[i].second;
+    if (score >= 0.f) {
+      score *= decay;
+    } else {
+      score = decay > 0.f ? score / decay : -FLT_MAX;
+    }
+  }
+  stable_sort(result.begin(), result.end(), greater_score());
+  if (!all_fetched && ret_num > 0 && result[min(ret_num, result.size()) - 1].second < bound) {
+    return false;
+  }
+  if (result.size() > ret_num) {
+    result.resize(ret_num);
+  }
+  return true;
+}
+
+void recommender_serv::fetch_similar(const recommender::recommender_base& model,
+                                     const sfv_t& query, size_t fetch_num,
+                                     similar_result& result) const {
+  model.similar_row(query, result, fetch_num);
+}
+
+// Rows are queried as similar_rows and similar_all do, by their signatures
+// if the model keeps them.
+void recommender_serv::fetch_similar(const recommender::recommender_base& model,
+                                     const string& id, size_t fetch_num,
+                                     similar_result& result) const {
+  vector<similar_result> results;
+  model.similar_rows(vector<string>(1, id), results, fetch_num);
+  result.clear();
+  if (!results.empty()) {
+    result.swap(results[0]);
+  }
+}
+
+template <class Query>
+void recommender_serv::decay_result(const recommender::recommender_base& model,
+                                    const Query& query, size_t ret_num,
+                                    size_t fetch_num, uint64_t now,
+                                    similar_result& result) const {
+  while (!decay_scores(result, fetch_num, ret_num, now)) {
+    fetch_num = grow_fetch_num(fetch_num);
+    fetch_similar(model, query, fetch_num, result);
+  }
+}
+
+template <class Query>
+void recommender_serv::find_similar(const recommender::recommender_base& model,
+                                    const Query& query, size_t ret_num,
+                                    uint64_t now, similar_result& result) const {
+  size_t fetch_num = first_fetch_num(ret_num);
+  fetch_similar(model, query, fetch_num, result);
+  decay_result(model, query, ret_num, fetch_num, now, result);
+}
+
+// Rows are completed from decayed neighbors, which are not kept in the
+// neighbor cache since they change with time.
+template <class Query>
+void recommender_serv::complete_row(const recommender::recommender_base& model,
+                                    const Query& query, uint64_t now,
+                                    sfv_t& ret) const {
+  if (timestamps_.get_model()->half_life() == 0) {
+    model.complete_row(query, ret);
+    return;
+  }
+  similar_result neighbors;
+  find_similar(model, query, recommender::recommender_base::complete_row_similar_num(),
+               now, neighbors);
+  model.complete_row_from_neighbors(neighbors, ret);
+}
+
 datum recommender_serv::decode_row(std::string id) {
   check_set_config();
 
@@ -168,10 +576,16 @@ datum recommender_serv::decode_row(std::string id) {
   fv_converter::datum ret;
 
   rcmdr_.get_model()->decode_row(id, v);
+  float decay = timestamps_.get_model()->decay(id, time(NULL));
+  if (decay != 1.f) {
+    for (size_t i = 0; i < v.size(); ++i) {
+      v[i].second *= decay;
+    }
+  }
   fv_converter::revert_feature(v, ret);
   
   datum ret0;
-  convert<fv_converter::datum, datum>(ret, ret0);
+  convert_datum(ret, ret0);
   return ret0;
 }
 
@@ -187,8 +601,8 @@ float recommender_serv::similarity(const datum& l, const datum& r) {
   check_set_config();
 
   fv_converter::datum d0, d1;
-  convert<datum, fv_converter::datum>(l, d0);
-  convert<datum, fv_converter::datum>(r, d1);
+  convert_datum(l, d0);
+  convert_datum(r, d1);
 
   sfv_t v0, v1;
   converter_->convert(d0, v0);
@@ -200,7 +614,7 @@ float recommender_serv::l2norm(const datum& q) {
   check_set_config();
 
   fv_converter::datum d0;
-  convert<datum, fv_converter::datum>(q, d0);
+  convert_datum(q, d0);
 
   sfv_t v0;
   converter_->convert(d0, v0);
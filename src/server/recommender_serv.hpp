@@ -17,15 +17,20 @@
 
 #pragma once
 
+#include <ctime>
 #include <string>
 #include <vector>
 
+#include <pficommon/concurrent/mutex.h>
+#include <pficommon/concurrent/thread.h>
+
 #include "../common/lock_service.hpp"
 #include "../common/shared_ptr.hpp"
 #include "../framework/mixable.hpp"
 #include "../framework/server_base.hpp"
 #include "../fv_converter/datum_to_fv_converter.hpp"
 #include "../recommender/recommender_base.hpp"
+#include "../recommender/row_timestamps.hpp"
 #include "../storage/recommender_storage.hpp"
 #include "recommender_types.hpp"
 #include "mixable_weight_manager.hpp"
@@ -42,6 +47,7 @@ struct rcmdr : public framework::mixable<jubatus::recommender::recommender_base,
 
   void put_diff_impl(const std::string& v) {
     get_model()->get_storage()->set_mixed_and_clear_diff(v);
+    get_model()->clear_neighbor_cache();
   }
 
   void mix_impl(const std::string& lhs,
@@ -54,6 +60,44 @@ struct rcmdr : public framework::mixable<jubatus::recommender::recommender_base,
   void clear() {}
 };
 
+// Rows of the recommender which expire at a mix are removed on every server
+// after the mixed recommender is put.
+struct mixable_row_timestamps
+    : public framework::mixable<jubatus::recommender::row_timestamps,
+                                jubatus::recommender::row_timestamps_diff> {
+  mixable_row_timestamps() : recommender_(NULL) {}
+
+  void set_recommender(rcmdr* r) {
+    recommender_ = r;
+  }
+
+  jubatus::recommender::row_timestamps_diff get_diff_impl() const {
+    jubatus::recommender::row_timestamps_diff ret;
+    get_model()->get_diff(time(NULL), ret);
+    return ret;
+  }
+
+  void put_diff_impl(const jubatus::recommender::row_timestamps_diff& v) {
+    std::vector<std::string> expired;
+    get_model()->put_diff(v, expired);
+    for (size_t i = 0; i < expired.size(); ++i) {
+      recommender_->get_model()->clear_row(expired[i]);
+    }
+  }
+
+  void mix_impl(const jubatus::recommender::row_timestamps_diff& lhs,
+                const jubatus::recommender::row_timestamps_diff& rhs,
+                jubatus::recommender::row_timestamps_diff& mixed) const {
+    mixed = rhs;
+    jubatus::recommender::row_timestamps::mix(lhs, mixed);
+  }
+
+  void clear() {}
+
+ private:
+  rcmdr* recommender_;
+};
+
 class recommender_serv : public framework::server_base {
 public:
   recommender_serv(const framework::server_argv& a,
@@ -71,14 +115,24 @@ public:
 
   int clear_row(std::string id);
   int update_row(std::string id, datum dat);
+  int update_rows(const std::vector<std::pair<std::string, datum> >& rows);
   int clear();
 
   common::cshared_ptr<jubatus::recommender::recommender_base> make_model();
 
   datum complete_row_from_id(std::string id);
   datum complete_row_from_data(datum dat);
+  std::vector<datum> complete_row_from_data_batch(const datum_batch& data);
   similar_result similar_row_from_id(std::string id, size_t ret_num);
   similar_result similar_row_from_data(datum, size_t);
+  std::vector<similar_result> similar_rows_from_ids(const std::vector<std::string>& ids,
+                                                    size_t ret_num);
+  std::vector<similar_result> similar_rows_from_datums(const datum_batch& data,
+                                                       size_t ret_num);
+  std::vector<std::pair<std::string, similar_result> > similar_all(size_t offset,
+                                                                   size_t page_size,
+                                                                   size_t ret_num);
+  std::string similar_all_to_file(size_t ret_num);
 
   float similarity(const datum& , const datum&);
   float l2norm(const datum& q);
@@ -89,12 +143,57 @@ public:
   void check_set_config()const;
 
 private:
+  void convert_batch_range(const datum_batch* data, std::vector<sfv_t>* fvs,
+                           size_t begin, size_t end) const;
+  // Converts rows without weights, which are applied under the write lock.
+  void convert_rows_range(const std::vector<std::pair<std::string, datum> >* rows,
+                          std::vector<std::pair<std::string, sfv_diff_t> >* diffs,
+                          size_t begin, size_t end) const;
+  // Scores are decayed before the top ret_num rows are chosen. Candidates
+  // are fetched first_fetch_num(ret_num) at a time, and more of them while
+  // rows not fetched may outrank the results.
+  size_t first_fetch_num(size_t ret_num) const;
+  // Scales scores of fetch_num candidates by the decay of rows so that they
+  // never rise, sorts them, and keeps ret_num of them. Returns false if
+  // more candidates are needed.
+  bool decay_scores(similar_result& result, size_t fetch_num, size_t ret_num,
+                    uint64_t now) const;
+  void fetch_similar(const recommender::recommender_base& model, const sfv_t& query,
+                     size_t fetch_num, similar_result& result) const;
+  void fetch_similar(const recommender::recommender_base& model, const std::string& id,
+                     size_t fetch_num, similar_result& result) const;
+  // Decays result fetched with fetch_num candidates, fetching more as needed.
+  template <class Query>
+  void decay_result(const recommender::recommender_base& model, const Query& query,
+                    size_t ret_num, size_t fetch_num, uint64_t now,
+                    similar_result& result) const;
+  template <class Query>
+  void find_similar(const recommender::recommender_base& model, const Query& query,
+                    size_t ret_num, uint64_t now, similar_result& result) const;
+  template <class Query>
+  void complete_row(const recommender::recommender_base& model, const Query& query,
+                    uint64_t now, sfv_t& ret) const;
+
+  struct similar_all_job;
+  // Writes a file of similar_all_to_file page by page, taking the read lock
+  // for each page.
+  void write_similar_all(pfi::lang::shared_ptr<similar_all_job> job);
+
   pfi::lang::scoped_ptr<framework::mixer::mixer> mixer_;
 
   config_data config_;
   pfi::lang::shared_ptr<fv_converter::datum_to_fv_converter> converter_;
   rcmdr rcmdr_;
   mixable_weight_manager wm_;
+  mixable_row_timestamps timestamps_;
+
+  // similar_all_to_file runs one job at a time on this thread
+  pfi::lang::shared_ptr<pfi::concurrent::thread> similar_all_thread_;
+  volatile bool similar_all_running_;
+  // numbers the files in the same second
+  uint64_t similar_all_seq_;
+  volatile bool stopping_;
+  pfi::concurrent::mutex similar_all_m_;
 
   uint64_t clear_row_cnt_;
   uint64_t update_row_cnt_;
@@ -24,11 +24,17 @@ public:
     rpc_server::add<config_data(std::string) >("get_config", pfi::lang::bind(&Impl::get_config, static_cast<Impl*>(this), pfi::lang::_1));
     rpc_server::add<bool(std::string, std::string) >("clear_row", pfi::lang::bind(&Impl::clear_row, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<bool(std::string, std::string, datum) >("update_row", pfi::lang::bind(&Impl::update_row, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3));
+    rpc_server::add<bool(std::string, std::vector<std::pair<std::string, datum > >) >("update_rows", pfi::lang::bind(&Impl::update_rows, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<bool(std::string) >("clear", pfi::lang::bind(&Impl::clear, static_cast<Impl*>(this), pfi::lang::_1));
     rpc_server::add<datum(std::string, std::string) >("complete_row_from_id", pfi::lang::bind(&Impl::complete_row_from_id, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<datum(std::string, datum) >("complete_row_from_data", pfi::lang::bind(&Impl::complete_row_from_data, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
+    rpc_server::add<std::vector<datum >(std::string, datum_batch) >("complete_row_from_data_batch", pfi::lang::bind(&Impl::complete_row_from_data_batch, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<similar_result(std::string, std::string, uint32_t) >("similar_row_from_id", pfi::lang::bind(&Impl::similar_row_from_id, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3));
     rpc_server::add<similar_result(std::string, datum, uint32_t) >("similar_row_from_data", pfi::lang::bind(&Impl::similar_row_from_data, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3));
+    rpc_server::add<std::vector<similar_result >(std::string, std::vector<std::string >, uint32_t) >("similar_rows_from_ids", pfi::lang::bind(&Impl::similar_rows_from_ids, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3));
+    rpc_server::add<std::vector<similar_result >(std::string, datum_batch, uint32_t) >("similar_rows_from_datums", pfi::lang::bind(&Impl::similar_rows_from_datums, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3));
+    rpc_server::add<std::vector<std::pair<std::string, similar_result > >(std::string, uint32_t, uint32_t, uint32_t) >("similar_all", pfi::lang::bind(&Impl::similar_all, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4));
+    rpc_server::add<std::string(std::string, uint32_t) >("similar_all_to_file", pfi::lang::bind(&Impl::similar_all_to_file, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<datum(std::string, std::string) >("decode_row", pfi::lang::bind(&Impl::decode_row, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2));
     rpc_server::add<std::vector<std::string >(std::string) >("get_all_rows", pfi::lang::bind(&Impl::get_all_rows, static_cast<Impl*>(this), pfi::lang::_1));
     rpc_server::add<float(std::string, datum, datum) >("similarity", pfi::lang::bind(&Impl::similarity, static_cast<Impl*>(this), pfi::lang::_1, pfi::lang::_2, pfi::lang::_3));
@@ -22,10 +22,11 @@ struct config_data {
 public:
 
   
-  MSGPACK_DEFINE(method, converter);  
+  MSGPACK_DEFINE(method, converter, parameter);  
 
   std::string method;
   std::string converter;
+  std::map<std::string, std::string > parameter;
 };
 
 struct datum {
@@ -38,6 +39,21 @@ public:
   std::vector<std::pair<std::string, double > > num_values;
 };
 
+struct datum_batch {
+public:
+
+  
+  MSGPACK_DEFINE(keys, string_offsets, string_keys, string_values, num_offsets, num_keys, num_values);  
+
+  std::vector<std::string > keys;
+  std::vector<uint32_t > string_offsets;
+  std::vector<uint32_t > string_keys;
+  std::vector<std::string > string_values;
+  std::vector<uint32_t > num_offsets;
+  std::vector<uint32_t > num_keys;
+  std::vector<double > num_values;
+};
+
 } // namespace jubatus
 
 
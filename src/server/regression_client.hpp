@@ -35,6 +35,14 @@ public:
       return call<std::vector<float >(std::string, std::vector<datum >)>("estimate")(name, estimate_data);
     }
 
+    int32_t train_batch(std::string name, std::vector<float > values, datum_batch train_data) {
+      return call<int32_t(std::string, std::vector<float >, datum_batch)>("train_batch")(name, values, train_data);
+    }
+
+    std::vector<float > estimate_batch(std::string name, datum_batch estimate_data) {
+      return call<std::vector<float >(std::string, datum_batch)>("estimate_batch")(name, estimate_data);
+    }
+
     bool save(std::string name, std::string arg1) {
       return call<bool(std::string, std::string)>("save")(name, arg1);
     }
@@ -25,6 +25,12 @@ public:
   std::vector<float > estimate(std::string name, std::vector<datum > estimate_data) //analysis random
   { JRLOCK__(p_); return get_p()->estimate(estimate_data); }
 
+  int train_batch(std::string name, std::vector<float > values, datum_batch train_data) //update random
+  { JWLOCK__(p_); return get_p()->train_batch(values, train_data); }
+
+  std::vector<float > estimate_batch(std::string name, datum_batch estimate_data) //analysis random
+  { JRLOCK__(p_); return get_p()->estimate_batch(estimate_data); }
+
   bool save(std::string name, std::string arg1) //update broadcast
   { JWLOCK__(p_); return get_p()->save(arg1); }
 
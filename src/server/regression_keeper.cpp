@@ -12,6 +12,8 @@ int main(int args, char** argv){
     k.register_random<config_data >("get_config"); //pass analysis
     k.register_random<int, std::vector<std::pair<float,datum > > >("train"); //pass update
     k.register_random<std::vector<float >, std::vector<datum > >("estimate"); //pass analysis
+    k.register_random<int, std::vector<float >, datum_batch >("train_batch"); //pass update
+    k.register_random<std::vector<float >, datum_batch >("estimate_batch"); //pass analysis
     k.register_broadcast<bool, std::string >("save", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
     k.register_broadcast<bool, std::string >("load", pfi::lang::function<bool(bool,bool)>(&all_and)); //update
     k.register_broadcast<std::map<std::string,std::map<std::string,std::string > > >("get_status", pfi::lang::function<std::map<std::string,std::map<std::string,std::string > >(std::map<std::string,std::map<std::string,std::string > >,std::map<std::string,std::map<std::string,std::string > >)>(&merge<std::string,std::map<std::string,std::string > >)); //analysis
@@ -20,6 +20,7 @@
 #include "../regression/regression_factory.hpp"
 #include "../common/util.hpp"
 #include "../common/vector_util.hpp"
+#include "../framework/datum_batch.hpp"
 #include "../framework/mixer/mixer_factory.hpp"
 #include "../fv_converter/datum.hpp"
 #include "../fv_converter/datum_to_fv_converter.hpp"
@@ -44,7 +45,7 @@ linear_function_mixer::model_ptr make_model(const framework::server_argv& arg) {
 
 regression_serv::regression_serv(const framework::server_argv& a,
                                  const cshared_ptr<lock_service>& zk)
-    : server_base(a) {
+    : server_base(a), use_dense_(false) {
   gresser_.set_model(make_model(a));
   wm_.set_model(mixable_weight_manager::model_ptr(new weight_manager));
 
@@ -77,6 +78,13 @@ int regression_serv::set_config(const config_data& config) {
 
   regression_.reset(regression_factory().create_regression(config.method, gresser_.get_model().get()));
 
+  // algorithms without dense support get values of dense rules as ordinary
+  // features from the converter
+  vector<string> dense_features;
+  converter_->get_dense_features(dense_features);
+  use_dense_ = !dense_features.empty() && regression_->supports_dense();
+  gresser_.get_model()->set_dense_features(use_dense_ ? dense_features : vector<string>());
+
   // FIXME: switch the function when set_config is done
   // because mixing method differs btwn PA, CW, etc...
   return 0;
@@ -93,12 +101,38 @@ int regression_serv::train(const vector<pair<float, jubatus::datum> >& data) {
 
   int count = 0;
   sfv_t v;
+  vector<float> dense;
   fv_converter::datum d;
   
   for (size_t i = 0; i < data.size(); ++i) {
-    convert<jubatus::datum, fv_converter::datum>(data[i].second, d);
-    converter_->convert_and_update_weight(d, v);
-    regression_->train(v, data[i].first);
+    convert_datum(data[i].second, d);
+    convert_and_update_weight(d, v, dense);
+    regression_->train(v, dense, data[i].first);
+    count++;
+  }
+  // FIXME: send count incrementation to mixer
+  return count;
+}
+
+int regression_serv::train_batch(const vector<float>& values,
+                                 const datum_batch& data) {
+  check_set_config();
+
+  size_t size = datum_batch_size(data);
+  if (values.size() != size) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "the number of values does not match the number of datum"));
+  }
+
+  int count = 0;
+  sfv_t v;
+  vector<float> dense;
+  fv_converter::datum d;
+
+  for (size_t i = 0; i < size; ++i) {
+    decode_datum_batch(data, i, d);
+    convert_and_update_weight(d, v, dense);
+    regression_->train(v, dense, values[i]);
     count++;
   }
   // FIXME: send count incrementation to mixer
@@ -110,15 +144,52 @@ vector<float> regression_serv::estimate(const vector<jubatus::datum>& data) cons
 
   vector<float> ret;
   sfv_t v;
+  vector<float> dense;
   fv_converter::datum d;
   for (size_t i = 0; i < data.size(); ++i) {
-    convert<datum, fv_converter::datum>(data[i], d);
-    converter_->convert(d, v);
-    ret.push_back(regression_->estimate(v));
+    convert_datum(data[i], d);
+    convert(d, v, dense);
+    ret.push_back(regression_->estimate(v, dense));
   }
   return ret; //vector<estimate_results> >::ok(ret);
 }
 
+vector<float> regression_serv::estimate_batch(const datum_batch& data) const {
+  check_set_config();
+
+  size_t size = datum_batch_size(data);
+  vector<float> ret;
+  ret.reserve(size);
+  sfv_t v;
+  vector<float> dense;
+  fv_converter::datum d;
+  for (size_t i = 0; i < size; ++i) {
+    decode_datum_batch(data, i, d);
+    convert(d, v, dense);
+    ret.push_back(regression_->estimate(v, dense));
+  }
+  return ret;
+}
+
+void regression_serv::convert(const fv_converter::datum& d, sfv_t& v,
+                              vector<float>& dense) const {
+  if (use_dense_) {
+    converter_->convert(d, v, dense);
+  } else {
+    converter_->convert(d, v);
+  }
+}
+
+void regression_serv::convert_and_update_weight(const fv_converter::datum& d,
+                                                sfv_t& v,
+                                                vector<float>& dense) {
+  if (use_dense_) {
+    converter_->convert_and_update_weight(d, v, dense);
+  } else {
+    converter_->convert_and_update_weight(d, v);
+  }
+}
+
 void regression_serv::check_set_config() const {
   if (!regression_) {
     throw JUBATUS_EXCEPTION(config_not_set());
@@ -24,6 +24,7 @@
 #include "../framework/mixable.hpp"
 #include "../framework/mixer/mixer.hpp"
 #include "../framework/server_base.hpp"
+#include "../fv_converter/datum.hpp"
 #include "../regression/regression_base.hpp"
 #include "regression_types.hpp"
 #include "diffv.hpp"
@@ -49,15 +50,23 @@ public:
   config_data get_config();
   int train(const std::vector<std::pair<float, datum> >& data);
   std::vector<float> estimate(const std::vector<datum>& data) const;
+  int train_batch(const std::vector<float>& values, const datum_batch& data);
+  std::vector<float> estimate_batch(const datum_batch& data) const;
 
   void check_set_config() const;
 
 private:
+  void convert(const fv_converter::datum& d, sfv_t& v,
+               std::vector<float>& dense) const;
+  void convert_and_update_weight(const fv_converter::datum& d, sfv_t& v,
+                                 std::vector<float>& dense);
+
   pfi::lang::scoped_ptr<framework::mixer::mixer> mixer_;
 
   config_data config_;
   pfi::lang::shared_ptr<fv_converter::datum_to_fv_converter> converter_;
   pfi::lang::shared_ptr<regression_base> regression_;
+  bool use_dense_;
   linear_function_mixer gresser_;
   mixable_weight_manager wm_;
 };
@@ -15,10 +15,14 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
 #include <iterator>
 #include "bit_index_storage.hpp"
 #include <pficommon/data/serialization.h>
 #include <pficommon/data/serialization/unordered_map.h>
+#include "../common/compaction.hpp"
+#include "../common/exception.hpp"
+#include "../common/thread_pool.hpp"
 #include "fixed_size_heap.hpp"
 
 using namespace std;
@@ -27,13 +31,58 @@ using namespace pfi::data;
 namespace jubatus {
 namespace storage{
 
-bit_index_storage::bit_index_storage(){
+namespace {
+
+const uint64_t BITMAP_BLOCK_SIZE = 64;
+
+bool get_bit(const vector<uint64_t>& bitmap, uint64_t pos){
+  return (bitmap[pos / BITMAP_BLOCK_SIZE] >> (pos % BITMAP_BLOCK_SIZE)) & 1LLU;
+}
+
+void set_bit(vector<uint64_t>& bitmap, uint64_t pos, bool val){
+  uint64_t mask = 1LLU << (pos % BITMAP_BLOCK_SIZE);
+  if (val){
+    bitmap[pos / BITMAP_BLOCK_SIZE] |= mask;
+  } else {
+    bitmap[pos / BITMAP_BLOCK_SIZE] &= ~mask;
+  }
+}
+
+}
+
+bit_index_storage::bit_index_storage()
+    : bit_num_(0), block_num_(0), mix_epoch_(0),
+      band_num_(0), probe_num_(0), partition_num_(1), group_width_(1), band_width_(0) {
+}
+
+bit_index_storage::bit_index_storage(uint64_t band_num, uint64_t probe_num,
+                                     uint64_t partition_num)
+    : bit_num_(0), block_num_(0), mix_epoch_(0),
+      band_num_(band_num), probe_num_(probe_num),
+      partition_num_(max<uint64_t>(1, partition_num)), group_width_(1), band_width_(0) {
+}
+
+bit_index_storage::bit_index_storage(uint64_t band_num, uint64_t probe_num,
+                                     uint64_t partition_num, uint64_t group_width)
+    : bit_num_(0), block_num_(0), mix_epoch_(0),
+      band_num_(band_num), probe_num_(probe_num),
+      partition_num_(max<uint64_t>(1, partition_num)), group_width_(group_width),
+      band_width_(0) {
+  if (group_width == 0 || group_width > BITMAP_BLOCK_SIZE
+      || (group_width & (group_width - 1)) != 0){
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error(
+        "group_width must be a power of 2 up to 64"));
+  }
 }
 bit_index_storage::~bit_index_storage(){
 }
 
 void bit_index_storage::set_row(const string& row, const bit_vector& bv){
   bitvals_diff_[row] = bv;
+  uint64_t id = row2id_.get_id_const(row);
+  if (id != key_manager::NOTFOUND){
+    set_bit(updated_, id, true);
+  }
 }
 
 void bit_index_storage::get_row(const string& row, bit_vector& bv) const {
@@ -44,37 +93,171 @@ void bit_index_storage::get_row(const string& row, bit_vector& bv) const {
       return;
     }
   }
-  {
-    bit_table_t::const_iterator it = bitvals_.find(row);
-    if (it != bitvals_.end()) {
-      bv = it->second;
-      return;
-    }
+  uint64_t id = row2id_.get_id_const(row);
+  if (id != key_manager::NOTFOUND && !get_bit(removed_, id)){
+    bv.assign(&bitvals_[id * block_num_], bit_num_);
+    return;
   }
   bv = bit_vector();
 }
 
 void bit_index_storage::remove_row(const string& row){
-  bitvals_diff_[row] = bit_vector();
+  set_row(row, bit_vector());
 }
 
 void bit_index_storage::clear(){
+  row2id_.clear();
   bitvals_.clear();
+  bit_num_ = 0;
+  block_num_ = 0;
+  removed_.clear();
+  updated_.clear();
+  tombstones_.clear();
+  band_width_ = 0;
+  bands_.clear();
   bitvals_diff_.clear();
 }
 
 void bit_index_storage::get_all_row_ids(std::vector<std::string>& ids) const{
   ids.clear();
-  for (bit_table_t::const_iterator it = bitvals_.begin(); it != bitvals_.end(); ++it){
-    ids.push_back(it->first);
+  for (uint64_t id = 0; id < row2id_.size(); ++id){
+    ids.push_back(row2id_.get_key(id));
   }
   for (bit_table_t::const_iterator it = bitvals_diff_.begin(); it != bitvals_diff_.end(); ++it){
-    if (bitvals_.find(it->first) == bitvals_.end()){
+    if (row2id_.get_id_const(it->first) == key_manager::NOTFOUND){
       ids.push_back(it->first);
     }
   }
 }
 
+bool bit_index_storage::is_live(uint64_t id) const {
+  return !get_bit(removed_, id) && !get_bit(updated_, id);
+}
+
+uint64_t bit_index_storage::calc_match_num(const uint64_t* query, uint64_t id) const {
+  return bit_num_ / group_width_ - bit_vector::calc_group_distance(
+      query, &bitvals_[id * block_num_], block_num_, group_width_);
+}
+
+void bit_index_storage::set_mixed_row(const string& row, const bit_vector& bv){
+  uint64_t id = row2id_.get_id_const(row);
+  bool live = false;
+  if (id == key_manager::NOTFOUND){
+    if (bv.bit_num() == 0){
+      return;
+    }
+    id = row2id_.get_id(row);
+    if (id / BITMAP_BLOCK_SIZE >= removed_.size()){
+      removed_.resize(id / BITMAP_BLOCK_SIZE + 1);
+      updated_.resize(id / BITMAP_BLOCK_SIZE + 1);
+    }
+    set_bit(removed_, id, true);
+    bitvals_.resize(row2id_.size() * block_num_);
+  } else if (!get_bit(removed_, id)){
+    live = true;
+    erase_from_bands(id);
+  }
+
+  if (bv.bit_num() == 0){
+    if (live){
+      set_bit(removed_, id, true);
+      fill(bitvals_.begin() + id * block_num_, bitvals_.begin() + (id + 1) * block_num_, 0);
+      tombstones_.push_back(make_pair(id, mix_epoch_));
+    }
+    return;
+  }
+  if (bv.bit_num() != bit_num_){
+    reset_bit_num(bv.bit_num());
+  }
+  set_bit(removed_, id, false);
+  copy(bv.blocks(), bv.blocks() + block_num_, &bitvals_[id * block_num_]);
+  insert_to_bands(id);
+}
+
+// All rows have the same number of bits in the matrix, which can only be
+// changed while all mixed rows are removed.
+void bit_index_storage::reset_bit_num(uint64_t bit_num){
+  for (uint64_t id = 0; id < row2id_.size(); ++id){
+    if (!get_bit(removed_, id)){
+      throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error("bit_num of rows mismatch"));
+    }
+  }
+  bit_num_ = bit_num;
+  block_num_ = (bit_num + BITMAP_BLOCK_SIZE - 1) / BITMAP_BLOCK_SIZE;
+  bitvals_.assign(row2id_.size() * block_num_, 0);
+
+  // bands have the same width of at most 64 bits, and the rest is not indexed
+  bands_.clear();
+  if (band_num_ > 0){
+    band_width_ = max<uint64_t>(1, min<uint64_t>(BITMAP_BLOCK_SIZE, bit_num / band_num_));
+    bands_.resize(min(band_num_, bit_num / band_width_));
+  }
+}
+
+uint64_t bit_index_storage::get_band_key(const uint64_t* blocks, uint64_t band) const {
+  uint64_t pos = band * band_width_;
+  uint64_t offset = pos % BITMAP_BLOCK_SIZE;
+  uint64_t key = blocks[pos / BITMAP_BLOCK_SIZE] >> offset;
+  if (offset + band_width_ > BITMAP_BLOCK_SIZE){
+    key |= blocks[pos / BITMAP_BLOCK_SIZE + 1] << (BITMAP_BLOCK_SIZE - offset);
+  }
+  if (band_width_ < BITMAP_BLOCK_SIZE){
+    key &= (1LLU << band_width_) - 1;
+  }
+  return key;
+}
+
+void bit_index_storage::insert_to_bands(uint64_t id){
+  const uint64_t* blocks = &bitvals_[id * block_num_];
+  for (uint64_t band = 0; band < bands_.size(); ++band){
+    bands_[band][get_band_key(blocks, band)].push_back(id);
+  }
+}
+
+void bit_index_storage::erase_from_bands(uint64_t id){
+  const uint64_t* blocks = &bitvals_[id * block_num_];
+  for (uint64_t band = 0; band < bands_.size(); ++band){
+    bucket_table_t::iterator it = bands_[band].find(get_band_key(blocks, band));
+    if (it == bands_[band].end()){
+      continue;
+    }
+    vector<uint64_t>& bucket = it->second;
+    vector<uint64_t>::iterator pos = find(bucket.begin(), bucket.end(), id);
+    if (pos != bucket.end()){
+      *pos = bucket.back();
+      bucket.pop_back();
+    }
+    if (bucket.empty()){
+      bands_[band].erase(it);
+    }
+  }
+}
+
+void bit_index_storage::get_candidates(const uint64_t* query, vector<uint64_t>& ids) const {
+  ids.clear();
+  for (uint64_t band = 0; band < bands_.size(); ++band){
+    probe_bucket(band, get_band_key(query, band), 0, probe_num_, ids);
+  }
+  sort(ids.begin(), ids.end());
+  ids.erase(unique(ids.begin(), ids.end()), ids.end());
+}
+
+// Collects the rows in the bucket of key and, recursively, in the buckets of
+// keys which differ in up to probe_num bits at from_bit or later.
+void bit_index_storage::probe_bucket(uint64_t band, uint64_t key, uint64_t from_bit,
+                                     uint64_t probe_num, vector<uint64_t>& ids) const {
+  bucket_table_t::const_iterator it = bands_[band].find(key);
+  if (it != bands_[band].end()){
+    ids.insert(ids.end(), it->second.begin(), it->second.end());
+  }
+  if (probe_num == 0){
+    return;
+  }
+  for (uint64_t bit = from_bit; bit < band_width_; ++bit){
+    probe_bucket(band, key ^ (1LLU << bit), bit + 1, probe_num - 1, ids);
+  }
+}
+
 void bit_index_storage::get_diff(string& diff) const {
   ostringstream os;
   {
@@ -90,9 +273,90 @@ void bit_index_storage::set_mixed_and_clear_diff(const string& mixed_diff_str) {
   bit_table_t mixed_diff;
   bi >> mixed_diff;
   for (bit_table_t::const_iterator it = mixed_diff.begin(); it != mixed_diff.end(); ++it){
-    bitvals_[it->first] = it->second;
+    set_mixed_row(it->first, it->second);
   }
+  fill(updated_.begin(), updated_.end(), 0);
   bitvals_diff_.clear();
+  ++mix_epoch_;
+  compact_if_needed();
+}
+
+void bit_index_storage::compact_if_needed(){
+  uint64_t num = 0;
+  for (size_t i = 0; i < tombstones_.size(); ++i){
+    if (tombstones_[i].second + 1 < mix_epoch_){
+      ++num;
+    }
+  }
+  if (needs_compaction(num, row2id_.size())){
+    compact();
+  }
+}
+
+void bit_index_storage::compact(){
+  // A row removed at the mix of epoch e is kept until the mix of e + 1 is
+  // done. A row may be removed again after it is set again.
+  const uint64_t no_epoch = ~0LLU;
+  vector<uint64_t> epochs(row2id_.size(), no_epoch);
+  for (size_t i = 0; i < tombstones_.size(); ++i){
+    uint64_t id = tombstones_[i].first;
+    if (get_bit(removed_, id)
+        && (epochs[id] == no_epoch || epochs[id] < tombstones_[i].second)){
+      epochs[id] = tombstones_[i].second;
+    }
+  }
+
+  vector<string> keys;
+  vector<uint64_t> bitvals;
+  vector<uint64_t> removed;
+  vector<uint64_t> updated;
+  vector<pair<uint64_t, uint64_t> > tombstones;
+  for (uint64_t id = 0; id < row2id_.size(); ++id){
+    bool is_tombstone = get_bit(removed_, id);
+    if (is_tombstone && (epochs[id] == no_epoch || epochs[id] + 1 < mix_epoch_)){
+      continue;
+    }
+    uint64_t new_id = keys.size();
+    keys.push_back(row2id_.get_key(id));
+    bitvals.insert(bitvals.end(), bitvals_.begin() + id * block_num_,
+                   bitvals_.begin() + (id + 1) * block_num_);
+    if (new_id / BITMAP_BLOCK_SIZE >= removed.size()){
+      removed.resize(new_id / BITMAP_BLOCK_SIZE + 1);
+      updated.resize(new_id / BITMAP_BLOCK_SIZE + 1);
+    }
+    if (is_tombstone){
+      set_bit(removed, new_id, true);
+      tombstones.push_back(make_pair(new_id, epochs[id]));
+    }
+    if (get_bit(updated_, id)){
+      set_bit(updated, new_id, true);
+    }
+  }
+
+  row2id_.init_by_id2key(keys);
+  bitvals_.swap(bitvals);
+  removed_.swap(removed);
+  updated_.swap(updated);
+  tombstones_.swap(tombstones);
+
+  for (uint64_t band = 0; band < bands_.size(); ++band){
+    bands_[band].clear();
+  }
+  for (uint64_t id = 0; id < row2id_.size(); ++id){
+    if (!get_bit(removed_, id)){
+      insert_to_bands(id);
+    }
+  }
+}
+
+uint64_t bit_index_storage::tombstone_num() const{
+  uint64_t num = 0;
+  for (uint64_t id = 0; id < row2id_.size(); ++id){
+    if (get_bit(removed_, id)){
+      ++num;
+    }
+  }
+  return num;
 }
 
 void bit_index_storage::mix(const string& lhs, string& rhs) const{
@@ -122,13 +386,108 @@ void bit_index_storage::mix(const string& lhs, string& rhs) const{
 }
 
 
-typedef fixed_size_heap<pair<uint64_t, string>, greater<pair<uint64_t, string> > > heap_type;
+namespace {
+
+// number of matched groups of bits and the row, which is not copied while
+// scanning
+typedef pair<uint64_t, const string*> scored_row;
+
+struct greater_score {
+  bool operator()(const scored_row& lhs, const scored_row& rhs) const {
+    if (lhs.first != rhs.first) {
+      return lhs.first > rhs.first;
+    }
+    return *lhs.second > *rhs.second;
+  }
+};
+
+typedef fixed_size_heap<scored_row, greater_score> heap_type;
+
+// rows (or candidates) scored by a task at least
+const uint64_t MIN_PARTITION_SIZE = 4096;
+
+void push_diff_rows(const bit_table_t& diff, const bit_vector& bv, uint64_t group_width,
+                    heap_type& heap) {
+  for (bit_table_t::const_iterator it = diff.begin(); it != diff.end(); ++it){
+    if (it->second.bit_num() == 0){
+      continue;  // removed
+    }
+    heap.push(make_pair(bv.calc_group_similarity(it->second, group_width), &it->first));
+  }
+}
+
+void get_top_rows(const heap_type& heap, uint64_t group_num, uint64_t ret_num,
+                  vector<pair<string, float> >& ids) {
+  vector<scored_row> scores;
+  heap.get_sorted(scores);
+  for (size_t i = 0; i < scores.size() && i < ret_num; ++i){
+    ids.push_back(make_pair(*scores[i].second, (float)scores[i].first / group_num));
+  }
+}
+
+}
+
+// Scores the mixed rows of ids in [begin, end), or of candidates[begin, end),
+// for each query. Each row is read once for all the queries.
+struct bit_index_storage::scan_task {
+  const bit_index_storage* storage;
+  const vector<const uint64_t*>* queries;
+  const vector<uint64_t>* candidates;
+  uint64_t begin;
+  uint64_t end;
+  heap_type* heaps;  // one for each query
+
+  void operator()() const {
+    const size_t query_num = queries->size();
+    for (uint64_t i = begin; i < end; ++i){
+      uint64_t id = candidates ? (*candidates)[i] : i;
+      if (!storage->is_live(id)){
+        continue;
+      }
+      const string* key = &storage->row2id_.get_key(id);
+      for (size_t q = 0; q < query_num; ++q){
+        heaps[q].push(make_pair(storage->calc_match_num((*queries)[q], id), key));
+      }
+    }
+  }
+};
 
-static
-void similar_row_one(const bit_vector& x, const pair<string, bit_vector>& y,
-                     heap_type& heap) {
-  uint64_t match_num = x.calc_hamming_similarity(y.second);
-  heap.push(make_pair(match_num, y.first));
+void bit_index_storage::scan_mixed_rows(const vector<const uint64_t*>& queries,
+                                        const vector<uint64_t>* candidates, uint64_t size,
+                                        uint64_t ret_num,
+                                        vector<vector<scored_row> >& scores) const {
+  const size_t query_num = queries.size();
+
+  // each partition keeps its own top ret_num rows, merged at the end
+  uint64_t partition_num = min(partition_num_, max<uint64_t>(1, size / MIN_PARTITION_SIZE));
+  vector<heap_type> heaps(partition_num * query_num, heap_type(ret_num));
+  vector<common::thread_pool::task_t> tasks;
+  for (uint64_t p = 0; p < partition_num; ++p){
+    scan_task task = {
+      this, &queries, candidates,
+      size * p / partition_num, size * (p + 1) / partition_num, &heaps[p * query_num]
+    };
+    tasks.push_back(task);
+  }
+  if (partition_num == 1){
+    tasks[0]();
+  } else {
+    common::thread_pool::get_shared().run(tasks);
+  }
+
+  scores.clear();
+  scores.resize(query_num);
+  vector<scored_row> partition_scores;
+  for (size_t q = 0; q < query_num; ++q){
+    heap_type heap(ret_num);
+    for (uint64_t p = 0; p < partition_num; ++p){
+      heaps[p * query_num + q].get_sorted(partition_scores);
+      for (size_t i = 0; i < partition_scores.size(); ++i){
+        heap.push(partition_scores[i]);
+      }
+    }
+    heap.get_sorted(scores[q]);
+  }
 }
 
 void bit_index_storage::similar_row(const bit_vector& bv, vector<pair<string, float> >& ids, uint64_t ret_num) const {
@@ -139,21 +498,67 @@ void bit_index_storage::similar_row(const bit_vector& bv, vector<pair<string, fl
   }
 
   heap_type heap(ret_num);
+  push_diff_rows(bitvals_diff_, bv, group_width_, heap);
 
-  for (bit_table_t::const_iterator it = bitvals_diff_.begin(); it != bitvals_diff_.end(); ++it){
-    similar_row_one(bv, *it, heap);
+  const uint64_t num_rows = row2id_.size();
+  if (bit_num == bit_num_){
+    vector<uint64_t> candidates;
+    uint64_t size = num_rows;
+    if (!bands_.empty()){
+      get_candidates(bv.blocks(), candidates);
+      size = candidates.size();
+    }
+
+    vector<const uint64_t*> queries(1, bv.blocks());
+    vector<vector<scored_row> > scores;
+    scan_mixed_rows(queries, bands_.empty() ? NULL : &candidates, size, ret_num, scores);
+    for (size_t i = 0; i < scores[0].size(); ++i){
+      heap.push(scores[0][i]);
+    }
+  } else {
+    bit_vector row;
+    for (uint64_t id = 0; id < num_rows; ++id){
+      if (!is_live(id)){
+        continue;
+      }
+      row.assign(&bitvals_[id * block_num_], bit_num_);
+      heap.push(make_pair(bv.calc_group_similarity(row, group_width_), &row2id_.get_key(id)));
+    }
   }
-  for (bit_table_t::const_iterator it = bitvals_.begin(); it != bitvals_.end(); ++it){
-    if (bitvals_diff_.find(it->first) != bitvals_diff_.end()) {
-      continue;
+
+  get_top_rows(heap, max<uint64_t>(1, bit_num / group_width_), ret_num, ids);
+}
+
+void bit_index_storage::similar_rows(const vector<bit_vector>& bvs,
+                                     vector<vector<pair<string, float> > >& ids,
+                                     uint64_t ret_num) const {
+  ids.clear();
+  ids.resize(bvs.size());
+
+  vector<size_t> shared;
+  vector<const uint64_t*> queries;
+  for (size_t i = 0; i < bvs.size(); ++i){
+    if (bands_.empty() && bvs[i].bit_num() != 0 && bvs[i].bit_num() == bit_num_){
+      shared.push_back(i);
+      queries.push_back(bvs[i].blocks());
+    } else {
+      similar_row(bvs[i], ids[i], ret_num);
     }
-    similar_row_one(bv, *it, heap);
+  }
+  if (shared.empty()){
+    return;
   }
 
-  vector<pair<uint64_t, string> > scores;
-  heap.get_sorted(scores);
-  for (size_t i = 0; i < scores.size() && i < ret_num; ++i){
-    ids.push_back(make_pair(scores[i].second, (float)scores[i].first / bit_num));
+  vector<vector<scored_row> > scores;
+  scan_mixed_rows(queries, NULL, row2id_.size(), ret_num, scores);
+  for (size_t k = 0; k < shared.size(); ++k){
+    const bit_vector& bv = bvs[shared[k]];
+    heap_type heap(ret_num);
+    push_diff_rows(bitvals_diff_, bv, group_width_, heap);
+    for (size_t i = 0; i < scores[k].size(); ++i){
+      heap.push(scores[k][i]);
+    }
+    get_top_rows(heap, max<uint64_t>(1, bv.bit_num() / group_width_), ret_num, ids[shared[k]]);
   }
 }
 
@@ -169,6 +574,37 @@ bool bit_index_storage::load(std::istream& is){
   return true;
 }
 
+void bit_index_storage::get_table(bit_table_t& bitvals) const{
+  for (uint64_t id = 0; id < row2id_.size(); ++id){
+    bit_vector& bv = bitvals[row2id_.get_key(id)];
+    if (!get_bit(removed_, id)){
+      bv.assign(&bitvals_[id * block_num_], bit_num_);
+    }
+  }
+}
+
+void bit_index_storage::set_table(const bit_table_t& bitvals){
+  row2id_.clear();
+  bitvals_.clear();
+  bit_num_ = 0;
+  block_num_ = 0;
+  removed_.clear();
+  updated_.clear();
+  tombstones_.clear();
+  band_width_ = 0;
+  bands_.clear();
+  // tombstones in the table are dropped
+  for (bit_table_t::const_iterator it = bitvals.begin(); it != bitvals.end(); ++it){
+    set_mixed_row(it->first, it->second);
+  }
+  for (bit_table_t::const_iterator it = bitvals_diff_.begin(); it != bitvals_diff_.end(); ++it){
+    uint64_t id = row2id_.get_id_const(it->first);
+    if (id != key_manager::NOTFOUND){
+      set_bit(updated_, id, true);
+    }
+  }
+}
+
 string bit_index_storage::name() const{
   return string("bit_index_storage");
 }
@@ -32,6 +32,16 @@ namespace storage{
 class bit_index_storage : public recommender_storage_base {
 public:
   bit_index_storage();
+  // Mixed rows are also indexed by band_num bands of their bits, and
+  // similar_row only scores rows which share a band with the query, allowing
+  // up to probe_num different bits in each band. 0 bands means a full scan.
+  // Mixed rows are scored in up to partition_num tasks on the shared
+  // thread pool.
+  bit_index_storage(uint64_t band_num, uint64_t probe_num, uint64_t partition_num);
+  // Rows are compared in groups of group_width bits, a power of 2 up to 64,
+  // and scored by the ratio of the same groups.
+  bit_index_storage(uint64_t band_num, uint64_t probe_num, uint64_t partition_num,
+                    uint64_t group_width);
   ~bit_index_storage();
 
   void set_row(const std::string& row, const bit_vector& bv);
@@ -41,6 +51,11 @@ public:
   void get_all_row_ids(std::vector<std::string>& ids) const;
 
   void similar_row(const bit_vector& bv, std::vector<std::pair<std::string, float> >& ids, uint64_t ret_num) const;
+  // Without bands, queries of the same width as mixed rows share one scan
+  // of the mixed rows. Other queries are answered one by one.
+  void similar_rows(const std::vector<bit_vector>& bvs,
+                    std::vector<std::vector<std::pair<std::string, float> > >& ids,
+                    uint64_t ret_num) const;
   std::string name() const;
 
   bool save(std::ostream& os);
@@ -50,14 +65,74 @@ public:
   void set_mixed_and_clear_diff(const std::string& mixed_diff);
   void mix(const std::string& lhs, std::string& rhs) const;
 
+  // Drops tombstones of rows removed before the last mix, i.e. which every
+  // server has seen a mix after, and renumbers the rest of mixed rows.
+  // This runs at mix when such tombstones grow large.
+  void compact();
+  uint64_t tombstone_num() const;
+
 private:
+  struct scan_task;
+  friend struct scan_task;
+
+  void set_mixed_row(const std::string& row, const bit_vector& bv);
+  void compact_if_needed();
+  void reset_bit_num(uint64_t bit_num);
+  bool is_live(uint64_t id) const;
+  uint64_t calc_match_num(const uint64_t* query, uint64_t id) const;
+  // Returns the top ret_num mixed rows for each query, which are scored in
+  // ids or candidates[0, size).
+  void scan_mixed_rows(const std::vector<const uint64_t*>& queries,
+                       const std::vector<uint64_t>* candidates, uint64_t size,
+                       uint64_t ret_num,
+                       std::vector<std::vector<std::pair<uint64_t, const std::string*> > >& scores) const;
+
+  uint64_t get_band_key(const uint64_t* blocks, uint64_t band) const;
+  void insert_to_bands(uint64_t id);
+  void erase_from_bands(uint64_t id);
+  void get_candidates(const uint64_t* query, std::vector<uint64_t>& ids) const;
+  void probe_bucket(uint64_t band, uint64_t key, uint64_t from_bit, uint64_t probe_num,
+                    std::vector<uint64_t>& ids) const;
+
+  // The model file keeps the table of mixed rows as before.
+  void get_table(bit_table_t& bitvals) const;
+  void set_table(const bit_table_t& bitvals);
+
   friend class pfi::data::serialization::access;
   template <class Ar>
   void serialize(Ar& ar) {
-    ar & MEMBER(bitvals_) & MEMBER(bitvals_diff_);
+    bit_table_t bitvals;
+    if (!ar.is_read) {
+      get_table(bitvals);
+    }
+    ar & NAMED_MEMBER("bitvals_", bitvals) & MEMBER(bitvals_diff_);
+    if (ar.is_read) {
+      set_table(bitvals);
+    }
   }
-  
-  bit_table_t bitvals_;
+
+  // Mixed rows are packed in one row-major matrix in the order of their ids,
+  // and rows removed at mix are kept as tombstones until compaction.
+  key_manager row2id_;
+  std::vector<uint64_t> bitvals_;
+  uint64_t bit_num_;
+  uint64_t block_num_;
+  // bitmaps indexed by row id
+  std::vector<uint64_t> removed_;
+  std::vector<uint64_t> updated_;  // overridden by bitvals_diff_
+  // number of mixes so far, and ids of tombstones with the mix removing them
+  uint64_t mix_epoch_;
+  std::vector<std::pair<uint64_t, uint64_t> > tombstones_;
+
+  // ids of mixed rows in each bucket of each band, rebuilt on load
+  typedef pfi::data::unordered_map<uint64_t, std::vector<uint64_t> > bucket_table_t;
+  uint64_t band_num_;
+  uint64_t probe_num_;
+  uint64_t partition_num_;
+  uint64_t group_width_;
+  uint64_t band_width_;
+  std::vector<bucket_table_t> bands_;
+
   bit_table_t bitvals_diff_;
 };
 
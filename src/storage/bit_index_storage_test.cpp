@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <iostream>
+#include <cstdlib>
 #include <gtest/gtest.h>
+#include <pficommon/lang/cast.h>
 #include "bit_index_storage.hpp"
 
 namespace jubatus {
@@ -54,6 +57,241 @@ TEST(bit_index_storage, trivial) {
   EXPECT_TRUE(ids.empty());
 }
 
+TEST(bit_index_storage, mixed_and_updated) {
+  bit_index_storage s;
+  s.set_row("r1", make_vector("0101"));
+  s.set_row("r2", make_vector("1010"));
+  s.set_row("r3", make_vector("1100"));
+  string d;
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+
+  // updates which are not mixed yet have priority
+  s.set_row("r1", make_vector("1100"));
+  s.remove_row("r3");
+
+  vector<pair<string, float> > ids;
+  s.similar_row(make_vector("1100"), ids, 3);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_EQ("r1", ids[0].first);
+  EXPECT_FLOAT_EQ(1.0, ids[0].second);
+  EXPECT_EQ("r2", ids[1].first);
+  EXPECT_FLOAT_EQ(0.5, ids[1].second);
+
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+
+  // removed rows are kept as empty rows
+  vector<string> rows;
+  s.get_all_row_ids(rows);
+  EXPECT_EQ(3u, rows.size());
+  bit_vector v;
+  s.get_row("r3", v);
+  EXPECT_TRUE(v == bit_vector());
+
+  stringstream ss;
+  s.save(ss);
+  bit_index_storage t;
+  t.load(ss);
+  t.get_row("r1", v);
+  EXPECT_TRUE(make_vector("1100") == v);
+  t.get_row("r3", v);
+  EXPECT_TRUE(v == bit_vector());
+  ids.clear();
+  t.similar_row(make_vector("1100"), ids, 3);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_EQ("r1", ids[0].first);
+  EXPECT_EQ("r2", ids[1].first);
+
+  // rows of a different size cannot be mixed while other rows are kept
+  t.set_row("r4", make_vector("11000"));
+  t.get_diff(d);
+  EXPECT_ANY_THROW(t.set_mixed_and_clear_diff(d));
+}
+
+TEST(bit_index_storage, bands) {
+  // 4 bands of 4 bits
+  bit_index_storage s(4, 0, 1);
+  s.set_row("r1", make_vector("1111000011110000"));
+  s.set_row("r2", make_vector("1111111111111111"));
+  s.set_row("r3", make_vector("0111100010110100"));
+  s.set_row("r4", make_vector("1110000111100001"));
+  string d;
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+
+  // only rows sharing a band with the query are scored
+  vector<pair<string, float> > ids;
+  s.similar_row(make_vector("1111000011110000"), ids, 4);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_EQ("r1", ids[0].first);
+  EXPECT_FLOAT_EQ(1.0, ids[0].second);
+  EXPECT_EQ("r2", ids[1].first);
+  EXPECT_FLOAT_EQ(0.5, ids[1].second);
+
+  // updated rows are reindexed at mix
+  s.set_row("r2", make_vector("0000000000000000"));
+  s.remove_row("r1");
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+  ids.clear();
+  s.similar_row(make_vector("1111000011110000"), ids, 4);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ("r2", ids[0].first);
+
+  // the index is rebuilt on load
+  stringstream ss;
+  s.save(ss);
+  bit_index_storage t(4, 1, 1);
+  t.load(ss);
+  ids.clear();
+  t.similar_row(make_vector("1111000011110000"), ids, 4);
+  ASSERT_EQ(3u, ids.size());
+  EXPECT_EQ("r4", ids[0].first);
+  EXPECT_FLOAT_EQ(0.75, ids[0].second);
+  EXPECT_EQ("r3", ids[1].first);
+  EXPECT_FLOAT_EQ(0.75, ids[1].second);
+  EXPECT_EQ("r2", ids[2].first);
+}
+
+TEST(bit_index_storage, partitions) {
+  // rows are scanned in 4 partitions
+  bit_index_storage s1, s4(0, 0, 4);
+  srand(1);
+  for (int i = 0; i < 20000; ++i) {
+    string b;
+    for (int j = 0; j < 100; ++j) {
+      b += (rand() % 2) ? '1' : '0';
+    }
+    string row = "r" + pfi::lang::lexical_cast<string>(i);
+    s1.set_row(row, make_vector(b));
+    s4.set_row(row, make_vector(b));
+  }
+  string d;
+  s4.get_diff(d);
+  s4.set_mixed_and_clear_diff(d);
+  s1.set_mixed_and_clear_diff(d);
+
+  for (int n = 0; n < 10; ++n) {
+    string b;
+    for (int j = 0; j < 100; ++j) {
+      b += (rand() % 2) ? '1' : '0';
+    }
+    vector<pair<string, float> > expected, actual;
+    s1.similar_row(make_vector(b), expected, 10);
+    s4.similar_row(make_vector(b), actual, 10);
+    ASSERT_EQ(10u, actual.size());
+    EXPECT_TRUE(expected == actual);
+  }
+}
+
+TEST(bit_index_storage, similar_rows) {
+  bit_index_storage s(0, 0, 4);
+  srand(2);
+  for (int i = 0; i < 20000; ++i) {
+    string b;
+    for (int j = 0; j < 100; ++j) {
+      b += (rand() % 2) ? '1' : '0';
+    }
+    s.set_row("r" + pfi::lang::lexical_cast<string>(i), make_vector(b));
+  }
+  string d;
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+  s.set_row("r0", make_vector(string(100, '1')));  // not mixed yet
+
+  vector<bit_vector> queries;
+  for (int n = 0; n < 10; ++n) {
+    string b;
+    for (int j = 0; j < 100; ++j) {
+      b += (rand() % 2) ? '1' : '0';
+    }
+    queries.push_back(make_vector(b));
+  }
+  queries.push_back(make_vector(string(100, '1')));
+  queries.push_back(make_vector("0101"));  // answered alone
+  queries.push_back(bit_vector());
+
+  vector<vector<pair<string, float> > > actual;
+  s.similar_rows(queries, actual, 10);
+  ASSERT_EQ(queries.size(), actual.size());
+  for (size_t n = 0; n < queries.size(); ++n) {
+    vector<pair<string, float> > expected;
+    s.similar_row(queries[n], expected, 10);
+    EXPECT_TRUE(expected == actual[n]) << n;
+  }
+  ASSERT_FALSE(actual[10].empty());
+  EXPECT_EQ("r0", actual[10][0].first);
+  EXPECT_TRUE(actual[12].empty());
+}
+
+TEST(bit_index_storage, compaction) {
+  bit_index_storage s(4, 0, 1);
+  string d;
+  for (int i = 0; i < 10; ++i) {
+    string b(8, '0');
+    b[i % 8] = '1';
+    s.set_row("r" + pfi::lang::lexical_cast<string>(i), make_vector(b));
+  }
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+
+  for (int i = 0; i < 5; ++i) {
+    s.remove_row("r" + pfi::lang::lexical_cast<string>(i));
+  }
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+  vector<string> ids;
+  s.get_all_row_ids(ids);
+  EXPECT_EQ(10u, ids.size());
+  EXPECT_EQ(5u, s.tombstone_num());
+
+  // tombstones are kept until another mix is done
+  s.compact();
+  EXPECT_EQ(5u, s.tombstone_num());
+  s.set_row("r1", make_vector("01000000"));
+  s.get_diff(d);
+  s.set_mixed_and_clear_diff(d);
+  s.compact();
+  EXPECT_EQ(0u, s.tombstone_num());
+
+  s.get_all_row_ids(ids);
+  sort(ids.begin(), ids.end());
+  ASSERT_EQ(6u, ids.size());
+  EXPECT_EQ("r1", ids[0]);
+  EXPECT_EQ("r9", ids[5]);
+
+  vector<pair<string, float> > similar;
+  s.similar_row(make_vector("01000000"), similar, 2);
+  ASSERT_EQ(2u, similar.size());
+  EXPECT_FLOAT_EQ(1.0, similar[0].second);
+  EXPECT_FLOAT_EQ(1.0, similar[1].second);
+  s.similar_row(make_vector("00000100"), similar, 1);
+  ASSERT_EQ(1u, similar.size());
+  EXPECT_EQ("r5", similar[0].first);
+
+  // a mix drops large tombstones by itself
+  bit_index_storage t;
+  for (int i = 0; i < 3000; ++i) {
+    t.set_row("r" + pfi::lang::lexical_cast<string>(i), make_vector("0101"));
+  }
+  t.get_diff(d);
+  t.set_mixed_and_clear_diff(d);
+  for (int i = 0; i < 2000; ++i) {
+    t.remove_row("r" + pfi::lang::lexical_cast<string>(i));
+  }
+  t.get_diff(d);
+  t.set_mixed_and_clear_diff(d);
+  EXPECT_EQ(2000u, t.tombstone_num());
+  t.get_diff(d);
+  t.set_mixed_and_clear_diff(d);
+  EXPECT_EQ(0u, t.tombstone_num());
+  t.get_all_row_ids(ids);
+  EXPECT_EQ(1000u, ids.size());
+  t.similar_row(make_vector("0101"), similar, 2000);
+  EXPECT_EQ(1000u, similar.size());
+}
+
 TEST(bit_index_storage, diff) {
   bit_index_storage s1, s2;
   s1.set_row("r1", make_vector("0101"));
@@ -15,6 +15,7 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
 #include <iostream>
 #include "bit_vector.hpp"
 
@@ -25,6 +26,48 @@ namespace storage {
 
 static const uint64_t BLOCKSIZE = 64;
 
+namespace {
+
+typedef uint64_t (*hamming_distance_func)(const uint64_t*, const uint64_t*, size_t);
+
+uint64_t hamming_distance_generic(const uint64_t* x, const uint64_t* y, size_t size){
+  uint64_t ret = 0;
+  for (size_t i = 0; i < size; ++i){
+    ret += bit_vector::pop_count(x[i] ^ y[i]);
+  }
+  return ret;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__) && \
+  (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#define JUBATUS_DISPATCH_POPCNT
+
+// compiled with POPCNT instruction regardless of the target of the build,
+// and only called after the CPU is checked
+__attribute__((target("popcnt")))
+uint64_t hamming_distance_popcnt(const uint64_t* x, const uint64_t* y, size_t size){
+  uint64_t ret = 0;
+  for (size_t i = 0; i < size; ++i){
+    ret += __builtin_popcountll(x[i] ^ y[i]);
+  }
+  return ret;
+}
+#endif
+
+hamming_distance_func select_hamming_distance(){
+#ifdef JUBATUS_DISPATCH_POPCNT
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("popcnt")) {
+    return hamming_distance_popcnt;
+  }
+#endif
+  return hamming_distance_generic;
+}
+
+const hamming_distance_func hamming_distance = select_hamming_distance();
+
+}
+
 bit_vector::bit_vector() : bit_num_(0) {}
 
 bit_vector::~bit_vector() {}
@@ -43,13 +86,53 @@ void bit_vector::set_bit(uint64_t pos){
   bits_[pos / BLOCKSIZE] |= (1LLU << (pos % BLOCKSIZE));
 }
 
+void bit_vector::assign(const uint64_t* blocks, uint64_t bit_num){
+  bit_num_ = bit_num;
+  bits_.assign(blocks, blocks + (bit_num + BLOCKSIZE - 1) / BLOCKSIZE);
+}
+
 uint64_t  bit_vector::calc_hamming_similarity(const bit_vector& bv) const{
-  uint64_t match_num = 0;
-  for (size_t i = 0; i < bits_.size() && i < bv.bits_.size(); ++i){
-    uint64_t all_num = ((i+1) * BLOCKSIZE > bit_num_) ?  bit_num_ - i * BLOCKSIZE : BLOCKSIZE;
-    match_num += all_num - pop_count(bits_[i] ^ bv.bits_[i]);
+  size_t size = std::min(bits_.size(), bv.bits_.size());
+  if (size == 0){
+    return 0;
+  }
+  uint64_t all_num = std::min(bit_num_, size * BLOCKSIZE);
+  return all_num - hamming_distance(&bits_[0], &bv.bits_[0], size);
+}
+
+uint64_t bit_vector::calc_hamming_distance(const uint64_t* x, const uint64_t* y, size_t size){
+  return hamming_distance(x, y, size);
+}
+
+uint64_t bit_vector::calc_group_distance(const uint64_t* x, const uint64_t* y, size_t size,
+                                         uint64_t group_width){
+  if (group_width == 1){
+    return hamming_distance(x, y, size);
+  }
+  // the first bit of each group
+  uint64_t first_bits = 0;
+  for (uint64_t i = 0; i < BLOCKSIZE; i += group_width){
+    first_bits |= 1LLU << i;
+  }
+  uint64_t ret = 0;
+  for (size_t i = 0; i < size; ++i){
+    // the first bit of a group becomes the OR of the group
+    uint64_t d = x[i] ^ y[i];
+    for (uint64_t shift = 1; shift < group_width; shift <<= 1){
+      d |= d >> shift;
+    }
+    ret += pop_count(d & first_bits);
+  }
+  return ret;
+}
+
+uint64_t bit_vector::calc_group_similarity(const bit_vector& bv, uint64_t group_width) const{
+  size_t size = std::min(bits_.size(), bv.bits_.size());
+  if (size == 0){
+    return 0;
   }
-  return match_num;
+  uint64_t all_num = std::min(bit_num_, size * BLOCKSIZE) / group_width;
+  return all_num - calc_group_distance(&bits_[0], &bv.bits_[0], size, group_width);
 }
 }
 }
@@ -36,6 +36,15 @@ public:
   void set_bit(uint64_t pos);
   uint64_t calc_hamming_similarity(const bit_vector& bv) const;
 
+  // number of different bits in the first size blocks of x and y, counted
+  // with POPCNT instruction when the CPU supports it
+  static uint64_t calc_hamming_distance(const uint64_t* x, const uint64_t* y, size_t size);
+  // number of different groups of group_width bits in the first size blocks
+  // of x and y, where group_width is a power of 2 up to 64
+  static uint64_t calc_group_distance(const uint64_t* x, const uint64_t* y, size_t size,
+                                      uint64_t group_width);
+  uint64_t calc_group_similarity(const bit_vector& bv, uint64_t group_width) const;
+
   static uint64_t pop_count(uint64_t r){
     r = (r & 0x5555555555555555ULL) +
       ((r >> 1) & 0x5555555555555555ULL);
@@ -52,6 +61,17 @@ public:
     return bit_num_;
   }
 
+  // raw blocks of 64 bits, where the bits over bit_num() are 0
+  size_t block_num() const {
+    return bits_.size();
+  }
+
+  const uint64_t* blocks() const {
+    return bits_.empty() ? NULL : &bits_[0];
+  }
+
+  void assign(const uint64_t* blocks, uint64_t bit_num);
+
   void debug_print(std::ostream& os) const{
     for (uint64_t i = 0; i < bit_num_; ++i){
       if ((bits_[i / 64] >> (i % 64)) & 1LLU){
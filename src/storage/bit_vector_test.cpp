@@ -10,6 +10,32 @@ TEST(bit_vector, pop_count) {
   EXPECT_EQ(64u, bit_vector::pop_count(-1));
 }
 
+TEST(bit_vector, calc_hamming_distance) {
+  uint64_t x[3] = { 0ULL, -1ULL, 0x0f0fULL };
+  uint64_t y[3] = { 0x11ULL, -1ULL, 0xf0f0ULL };
+  EXPECT_EQ(0u, bit_vector::calc_hamming_distance(x, y, 0));
+  EXPECT_EQ(2u, bit_vector::calc_hamming_distance(x, y, 2));
+  EXPECT_EQ(18u, bit_vector::calc_hamming_distance(x, y, 3));
+}
+
+TEST(bit_vector, calc_group_distance) {
+  const uint64_t x[2] = { 0x0f0f0000ffffffffULL, 0x1ULL };
+  const uint64_t y[2] = { 0x0f0e0000fffffff0ULL, 0x3ULL };
+  EXPECT_EQ(6u, bit_vector::calc_group_distance(x, y, 2, 1));
+  EXPECT_EQ(4u, bit_vector::calc_group_distance(x, y, 2, 2));
+  EXPECT_EQ(3u, bit_vector::calc_group_distance(x, y, 2, 4));
+  EXPECT_EQ(3u, bit_vector::calc_group_distance(x, y, 2, 8));
+  EXPECT_EQ(3u, bit_vector::calc_group_distance(x, y, 2, 32));
+  EXPECT_EQ(2u, bit_vector::calc_group_distance(x, y, 2, 64));
+
+  bit_vector v1, v2;
+  v1.resize_and_clear(16);
+  v2.resize_and_clear(16);
+  v2.set_bit(5);
+  v2.set_bit(6);
+  EXPECT_EQ(3u, v1.calc_group_similarity(v2, 4));
+}
+
 TEST(bit_vector, trivial) {
   bit_vector v1, v2;
   v1.resize_and_clear(2);
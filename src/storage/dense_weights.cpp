@@ -0,0 +1,141 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include "dense_weights.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+namespace jubatus {
+namespace storage {
+
+float dot_product(const float* x, const float* y, size_t n) {
+  size_t i = 0;
+  float sum = 0.f;
+#ifdef __SSE__
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i),
+                                       _mm_loadu_ps(y + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+                                       _mm_loadu_ps(y + i + 4)));
+  }
+  float partial[4];
+  _mm_storeu_ps(partial, _mm_add_ps(acc0, acc1));
+  sum = (partial[0] + partial[1]) + (partial[2] + partial[3]);
+#endif
+  for (; i < n; ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+void add_scaled(float a, const float* x, float* y, size_t n) {
+  size_t i = 0;
+#ifdef __SSE__
+  __m128 va = _mm_set1_ps(a);
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                    _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+void dense_weights::set_features(const vector<string>& features) {
+  pfi::data::unordered_map<string, size_t> index;
+  for (size_t i = 0; i < features.size(); ++i) {
+    index.insert(make_pair(features[i], i));
+  }
+
+  features_ = features;
+  index_.swap(index);
+  rows_.clear();
+}
+
+bool dense_weights::find(const string& feature, size_t& index) const {
+  if (index_.empty()) {
+    return false;
+  }
+  pfi::data::unordered_map<string, size_t>::const_iterator it =
+      index_.find(feature);
+  if (it == index_.end()) {
+    return false;
+  }
+  index = it->second;
+  return true;
+}
+
+const vector<float>& dense_weights::row(uint64_t class_id) const {
+  static const vector<float> empty_row;
+  if (class_id >= rows_.size()) {
+    return empty_row;
+  }
+  return rows_[class_id];
+}
+
+vector<float>& dense_weights::mutable_row(uint64_t class_id) {
+  if (class_id >= rows_.size()) {
+    rows_.resize(class_id + 1);
+  }
+  vector<float>& r = rows_[class_id];
+  if (r.size() != features_.size()) {
+    r.resize(features_.size());
+  }
+  return r;
+}
+
+void dense_weights::inp(const vector<float>& x, vector<float>& ret) const {
+  size_t n = min(x.size(), features_.size());
+  if (n == 0) {
+    return;
+  }
+  size_t num = min(rows_.size(), ret.size());
+  for (size_t c = 0; c < num; ++c) {
+    if (rows_[c].empty()) {
+      continue;
+    }
+    ret[c] += dot_product(&rows_[c][0], &x[0], n);
+  }
+}
+
+void dense_weights::add(uint64_t class_id, float a, const vector<float>& x) {
+  size_t n = min(x.size(), features_.size());
+  if (n == 0) {
+    return;
+  }
+  vector<float>& r = mutable_row(class_id);
+  add_scaled(a, &x[0], &r[0], n);
+}
+
+void dense_weights::swap(dense_weights& w) {
+  features_.swap(w.features_);
+  index_.swap(w.index_);
+  rows_.swap(w.rows_);
+}
+
+}
+}
@@ -0,0 +1,88 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <pficommon/data/unordered_map.h>
+
+namespace jubatus {
+namespace storage {
+
+// returns sum of x[i] * y[i]
+float dot_product(const float* x, const float* y, size_t n);
+
+// y[i] += a * x[i]
+void add_scaled(float a, const float* x, float* y, size_t n);
+
+// Weights of a fixed, ordered list of features.
+// The weights of each class are stored in a contiguous row indexed by the
+// position of the feature in the list, so an inner product with a dense
+// feature vector is a single dot product per class.
+// Only the weight (v1 of val3_t) is kept.
+class dense_weights {
+ public:
+  void set_features(const std::vector<std::string>& features);
+
+  const std::vector<std::string>& features() const {
+    return features_;
+  }
+
+  size_t size() const {
+    return features_.size();
+  }
+
+  bool empty() const {
+    return features_.empty();
+  }
+
+  // returns false if the feature is not in the list
+  bool find(const std::string& feature, size_t& index) const;
+
+  size_t num_rows() const {
+    return rows_.size();
+  }
+
+  // returns an empty row if no weight of the class is stored
+  const std::vector<float>& row(uint64_t class_id) const;
+
+  // creates a zero-filled row if needed
+  std::vector<float>& mutable_row(uint64_t class_id);
+
+  // ret[class_id] += (weights of the class) * x
+  void inp(const std::vector<float>& x, std::vector<float>& ret) const;
+
+  // (weights of the class) += a * x
+  void add(uint64_t class_id, float a, const std::vector<float>& x);
+
+  void clear_rows() {
+    rows_.clear();
+  }
+
+  void swap(dense_weights& w);
+
+ private:
+  std::vector<std::string> features_;
+  pfi::data::unordered_map<std::string, size_t> index_;
+  std::vector<std::vector<float> > rows_;
+};
+
+}
+}
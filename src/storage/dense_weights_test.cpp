@@ -0,0 +1,97 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <gtest/gtest.h>
+#include "dense_weights.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace storage {
+
+TEST(dense_weights, dot_product) {
+  for (size_t n = 0; n < 20; ++n) {
+    vector<float> x(n + 1), y(n + 1);
+    float expect = 0.f;
+    for (size_t i = 0; i < n; ++i) {
+      x[i] = i + 1;
+      y[i] = 0.5f * i - 2;
+      expect += x[i] * y[i];
+    }
+    EXPECT_FLOAT_EQ(expect, dot_product(&x[0], &y[0], n)) << n;
+  }
+}
+
+TEST(dense_weights, add_scaled) {
+  for (size_t n = 0; n < 20; ++n) {
+    vector<float> x(n + 1), y(n + 1, 1.f);
+    for (size_t i = 0; i < n; ++i) {
+      x[i] = i;
+    }
+    add_scaled(2.f, &x[0], &y[0], n);
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_FLOAT_EQ(1.f + 2.f * i, y[i]);
+    }
+    // out of range
+    EXPECT_FLOAT_EQ(1.f, y[n]);
+  }
+}
+
+TEST(dense_weights, trivial) {
+  dense_weights w;
+  EXPECT_TRUE(w.empty());
+
+  vector<string> features;
+  features.push_back("a");
+  features.push_back("b");
+  features.push_back("c");
+  w.set_features(features);
+  ASSERT_EQ(3u, w.size());
+
+  size_t index = 100;
+  EXPECT_TRUE(w.find("b", index));
+  EXPECT_EQ(1u, index);
+  EXPECT_FALSE(w.find("d", index));
+
+  EXPECT_EQ(0u, w.num_rows());
+  EXPECT_TRUE(w.row(2).empty());
+
+  vector<float> x;
+  x.push_back(1);
+  x.push_back(2);
+  x.push_back(3);
+  w.add(2, 0.5f, x);
+  ASSERT_EQ(3u, w.num_rows());
+  EXPECT_TRUE(w.row(0).empty());
+  ASSERT_EQ(3u, w.row(2).size());
+  EXPECT_FLOAT_EQ(1.5f, w.row(2)[2]);
+
+  w.mutable_row(0)[0] = 2;
+
+  vector<float> ret(3);
+  w.inp(x, ret);
+  EXPECT_FLOAT_EQ(2.f, ret[0]);
+  EXPECT_FLOAT_EQ(0.f, ret[1]);
+  EXPECT_FLOAT_EQ(7.f, ret[2]);
+
+  w.clear_rows();
+  EXPECT_EQ(0u, w.num_rows());
+  EXPECT_EQ(3u, w.size());
+}
+
+}
+}
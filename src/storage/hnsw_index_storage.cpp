@@ -0,0 +1,660 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include "hnsw_index_storage.hpp"
+#include <pficommon/data/serialization.h>
+#include <pficommon/data/serialization/unordered_map.h>
+#include "../common/compaction.hpp"
+#include "../common/exception.hpp"
+#include "../common/hash.hpp"
+#include "../common/vector_util.hpp"
+
+using namespace std;
+using namespace pfi::data;
+
+namespace jubatus {
+namespace storage {
+
+namespace {
+
+const uint64_t NO_NODE = ~0LLU;
+const uint64_t MAX_LEVEL = 16;
+// initial slots of a visited set for each candidate kept in a search
+const uint64_t VISITED_SLOTS_PER_CANDIDATE = 8;
+
+const uint64_t DEFAULT_M = 16;
+const uint64_t DEFAULT_EF_CONSTRUCTION = 100;
+const uint64_t DEFAULT_EF = 50;
+
+// Ids of nodes visited in a search, kept in an open addressing table sized
+// to the visited nodes rather than to all nodes.
+class visited_set {
+public:
+  explicit visited_set(uint64_t expected_num) : num_(0) {
+    uint64_t size = 16;
+    while (size < expected_num * 2) {
+      size <<= 1;
+    }
+    slots_.assign(size, NO_NODE);
+  }
+
+  // Returns false if the id is already visited.
+  bool insert(uint64_t id) {
+    if ((num_ + 1) * 2 > slots_.size()) {
+      grow();
+    }
+    if (!insert_to(slots_, id)) {
+      return false;
+    }
+    ++num_;
+    return true;
+  }
+
+private:
+  static bool insert_to(vector<uint64_t>& slots, uint64_t id) {
+    uint64_t mask = slots.size() - 1;
+    for (uint64_t i = hash_util::mix64(id) & mask; ; i = (i + 1) & mask) {
+      if (slots[i] == id) {
+        return false;
+      } else if (slots[i] == NO_NODE) {
+        slots[i] = id;
+        return true;
+      }
+    }
+  }
+
+  void grow() {
+    vector<uint64_t> slots(slots_.size() * 2, NO_NODE);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (slots_[i] != NO_NODE) {
+        insert_to(slots, slots_[i]);
+      }
+    }
+    slots_.swap(slots);
+  }
+
+  vector<uint64_t> slots_;
+  uint64_t num_;
+};
+
+float calc_norm2(const vector<pair<uint64_t, float> >& columns) {
+  float norm2 = 0.f;
+  for (size_t i = 0; i < columns.size(); ++i) {
+    norm2 += columns[i].second * columns[i].second;
+  }
+  return norm2;
+}
+
+void normalize(vector<pair<uint64_t, float> >& columns, float& norm2) {
+  if (norm2 <= 0.f) {
+    return;
+  }
+  float scale = 1.f / sqrt(norm2);
+  for (size_t i = 0; i < columns.size(); ++i) {
+    columns[i].second *= scale;
+  }
+  norm2 = 1.f;
+}
+
+}
+
+hnsw_index_storage::hnsw_index_storage()
+    : metric_(COSINE), m_(DEFAULT_M),
+      ef_construction_(DEFAULT_EF_CONSTRUCTION), ef_(DEFAULT_EF),
+      level_mult_(1. / log(static_cast<double>(DEFAULT_M))),
+      entry_(NO_NODE), max_level_(0), removed_num_(0) {
+}
+
+hnsw_index_storage::hnsw_index_storage(metric_type metric, uint64_t m,
+                                       uint64_t ef_construction, uint64_t ef)
+    : metric_(metric), m_(m), ef_construction_(ef_construction), ef_(ef),
+      level_mult_(0.), entry_(NO_NODE), max_level_(0), removed_num_(0) {
+  if (m < 2) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error("M < 2"));
+  }
+  if (ef_construction == 0 || ef == 0) {
+    throw JUBATUS_EXCEPTION(jubatus::exception::runtime_error("ef == 0"));
+  }
+  level_mult_ = 1. / log(static_cast<double>(m));
+}
+
+hnsw_index_storage::~hnsw_index_storage(){
+}
+
+void hnsw_index_storage::set_row(const string& row, const sfv_t& columns){
+  if (columns.empty()) {
+    remove_row(row);
+    return;
+  }
+  map_float_t& diff = diff_[row];
+  diff.clear();
+  for (size_t i = 0; i < columns.size(); ++i) {
+    diff[columns[i].first] = columns[i].second;
+  }
+  set_row_columns(row, columns);
+}
+
+void hnsw_index_storage::remove_row(const string& row){
+  diff_[row] = map_float_t();
+  remove_node(row);
+  repair_if_needed();
+}
+
+void hnsw_index_storage::clear(){
+  column2id_.clear();
+  row2id_.clear();
+  nodes_.clear();
+  column_ids_.clear();
+  values_.clear();
+  entry_ = NO_NODE;
+  max_level_ = 0;
+  removed_num_ = 0;
+  diff_.clear();
+}
+
+void hnsw_index_storage::get_all_row_ids(vector<string>& ids) const{
+  ids.clear();
+  for (uint64_t id = 0; id < nodes_.size(); ++id) {
+    if (!nodes_[id].removed) {
+      ids.push_back(nodes_[id].row);
+    }
+  }
+}
+
+void hnsw_index_storage::similar_row(const sfv_t& query,
+                                     vector<pair<string, float> >& ids,
+                                     uint64_t ret_num) const{
+  ids.clear();
+  if (ret_num == 0 || row2id_.empty()) {
+    return;
+  }
+
+  vector<uint64_t> column_ids;
+  vector<float> values;
+  vector_view q;
+  make_query(query, column_ids, values, q);
+
+  vector<scored_node> entries(1, make_pair(calc_similarity(q, get_view(entry_)), entry_));
+  for (uint64_t level = max_level_; level > 0; --level) {
+    search_level(q, 1, level, entries);
+  }
+  // tombstones found in the search are skipped
+  uint64_t ef = max(ef_, ret_num) * nodes_.size() / row2id_.size();
+  search_level(q, ef, 0, entries);
+
+  for (size_t i = 0; i < entries.size() && ids.size() < ret_num; ++i) {
+    const node& n = nodes_[entries[i].second];
+    if (!n.removed) {
+      ids.push_back(make_pair(n.row, entries[i].first));
+    }
+  }
+}
+
+string hnsw_index_storage::name() const{
+  return string("hnsw_index_storage");
+}
+
+uint64_t hnsw_index_storage::node_num() const{
+  return nodes_.size();
+}
+
+void hnsw_index_storage::set_row_columns(const string& row, const sfv_t& columns){
+  vector<pair<uint64_t, float> > sorted;
+  make_columns(columns, sorted);
+
+  pfi::data::unordered_map<string, uint64_t>::const_iterator it = row2id_.find(row);
+  if (it != row2id_.end()) {
+    if (has_same_columns(it->second, sorted)) {
+      return;
+    }
+    remove_node(row);
+  }
+
+  uint64_t id = nodes_.size();
+  nodes_.push_back(node());
+  node& n = nodes_.back();
+  n.row = row;
+  n.offset = column_ids_.size();
+  n.size = sorted.size();
+  n.norm2 = calc_norm2(sorted);
+  n.level = calc_level(row);
+  n.links.resize(n.level + 1);
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    column_ids_.push_back(sorted[i].first);
+    values_.push_back(sorted[i].second);
+  }
+  row2id_[row] = id;
+
+  connect(id);
+  repair_if_needed();
+}
+
+void hnsw_index_storage::remove_node(const string& row){
+  pfi::data::unordered_map<string, uint64_t>::iterator it = row2id_.find(row);
+  if (it == row2id_.end()) {
+    return;
+  }
+  nodes_[it->second].removed = true;
+  row2id_.erase(it);
+  ++removed_num_;
+}
+
+bool hnsw_index_storage::has_same_columns(uint64_t id,
+                                          const vector<pair<uint64_t, float> >& columns) const{
+  const node& n = nodes_[id];
+  if (n.size != columns.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (column_ids_[n.offset + i] != columns[i].first
+        || values_[n.offset + i] != columns[i].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void hnsw_index_storage::make_columns(const sfv_t& columns,
+                                      vector<pair<uint64_t, float> >& ret){
+  ret.clear();
+  for (size_t i = 0; i < columns.size(); ++i) {
+    ret.push_back(make_pair(column2id_.get_id(columns[i].first), columns[i].second));
+  }
+  sort_and_keep_last(ret);
+  if (metric_ == COSINE) {
+    float norm2 = calc_norm2(ret);
+    normalize(ret, norm2);
+  }
+}
+
+void hnsw_index_storage::make_query(const sfv_t& query,
+                                    vector<uint64_t>& column_ids,
+                                    vector<float>& values,
+                                    vector_view& view) const{
+  vector<pair<uint64_t, float> > columns;
+  float unknown_norm2 = 0.f;
+  for (size_t i = 0; i < query.size(); ++i) {
+    uint64_t id = column2id_.get_id_const(query[i].first);
+    if (id == key_manager::NOTFOUND) {
+      unknown_norm2 += query[i].second * query[i].second;
+    } else {
+      columns.push_back(make_pair(id, query[i].second));
+    }
+  }
+  sort_and_keep_last(columns);
+  float norm2 = calc_norm2(columns) + unknown_norm2;
+  if (metric_ == COSINE) {
+    normalize(columns, norm2);
+  }
+
+  column_ids.resize(columns.size());
+  values.resize(columns.size());
+  for (size_t i = 0; i < columns.size(); ++i) {
+    column_ids[i] = columns[i].first;
+    values[i] = columns[i].second;
+  }
+  view.size = columns.size();
+  view.column_ids = columns.empty() ? NULL : &column_ids[0];
+  view.values = columns.empty() ? NULL : &values[0];
+  view.norm2 = norm2;
+}
+
+hnsw_index_storage::vector_view hnsw_index_storage::get_view(uint64_t id) const{
+  const node& n = nodes_[id];
+  vector_view view;
+  if (n.size > 0) {
+    view.column_ids = &column_ids_[n.offset];
+    view.values = &values_[n.offset];
+    view.size = n.size;
+  }
+  view.norm2 = n.norm2;
+  return view;
+}
+
+float hnsw_index_storage::calc_similarity(const vector_view& lhs,
+                                          const vector_view& rhs) const{
+  float dot = 0.f;
+  size_t i = 0, j = 0;
+  while (i < lhs.size && j < rhs.size) {
+    if (lhs.column_ids[i] < rhs.column_ids[j]) {
+      ++i;
+    } else if (lhs.column_ids[i] > rhs.column_ids[j]) {
+      ++j;
+    } else {
+      dot += lhs.values[i++] * rhs.values[j++];
+    }
+  }
+  if (metric_ == COSINE) {
+    return dot;
+  }
+  return -sqrt(max(0.f, lhs.norm2 + rhs.norm2 - 2 * dot));
+}
+
+uint64_t hnsw_index_storage::calc_level(const string& row) const{
+  // levels are drawn from the hash of the row so that they are reproducible
+  uint64_t h = hash_util::mix64(hash_util::calc_string_hash(row));
+  double u = (static_cast<double>(h >> 11) + 0.5) / 9007199254740992.;  // 2^53
+  uint64_t level = static_cast<uint64_t>(-log(u) * level_mult_);
+  return min(level, MAX_LEVEL);
+}
+
+uint64_t hnsw_index_storage::max_link_num(uint64_t level) const{
+  return level == 0 ? 2 * m_ : m_;
+}
+
+void hnsw_index_storage::connect(uint64_t id){
+  uint64_t level = nodes_[id].level;
+  if (entry_ == NO_NODE) {
+    entry_ = id;
+    max_level_ = level;
+    return;
+  }
+
+  vector_view q = get_view(id);
+  vector<scored_node> entries(1, make_pair(calc_similarity(q, get_view(entry_)), entry_));
+  for (uint64_t l = max_level_; l > level; --l) {
+    search_level(q, 1, l, entries);
+  }
+
+  vector<scored_node> candidates;
+  for (uint64_t l = min(level, max_level_) + 1; l-- > 0; ) {
+    search_level(q, ef_construction_, l, entries);
+    candidates.clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (!nodes_[entries[i].second].removed && entries[i].second != id) {
+        candidates.push_back(entries[i]);
+      }
+    }
+    vector<uint64_t>& links = nodes_[id].links[l];
+    select_neighbors(candidates, m_, links);
+    for (size_t i = 0; i < links.size(); ++i) {
+      vector<uint64_t>& back_links = nodes_[links[i]].links[l];
+      if (find(back_links.begin(), back_links.end(), id) != back_links.end()) {
+        continue;
+      }
+      back_links.push_back(id);
+      if (back_links.size() > max_link_num(l)) {
+        shrink_links(links[i], l);
+      }
+    }
+  }
+
+  if (level > max_level_ || (nodes_[entry_].removed && level == max_level_)) {
+    entry_ = id;
+    max_level_ = level;
+  }
+}
+
+void hnsw_index_storage::search_level(const vector_view& query, uint64_t ef,
+                                      uint64_t level,
+                                      vector<scored_node>& entries) const{
+  visited_set visited(min(ef * VISITED_SLOTS_PER_CANDIDATE,
+                          static_cast<uint64_t>(nodes_.size())));
+  // nearest candidate first
+  priority_queue<scored_node> candidates;
+  // farthest result first
+  priority_queue<scored_node, vector<scored_node>, greater<scored_node> > results;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    visited.insert(entries[i].second);
+    candidates.push(entries[i]);
+    results.push(entries[i]);
+    if (results.size() > ef) {
+      results.pop();
+    }
+  }
+
+  while (!candidates.empty()) {
+    scored_node c = candidates.top();
+    if (results.size() >= ef && c.first < results.top().first) {
+      break;
+    }
+    candidates.pop();
+
+    const vector<uint64_t>& links = nodes_[c.second].links[level];
+    for (size_t i = 0; i < links.size(); ++i) {
+      uint64_t id = links[i];
+      if (!visited.insert(id)) {
+        continue;
+      }
+      float score = calc_similarity(query, get_view(id));
+      if (results.size() < ef || score > results.top().first) {
+        candidates.push(make_pair(score, id));
+        results.push(make_pair(score, id));
+        if (results.size() > ef) {
+          results.pop();
+        }
+      }
+    }
+  }
+
+  entries.resize(results.size());
+  for (size_t i = entries.size(); i-- > 0; ) {
+    entries[i] = results.top();
+    results.pop();
+  }
+}
+
+void hnsw_index_storage::select_neighbors(const vector<scored_node>& candidates,
+                                          uint64_t num,
+                                          vector<uint64_t>& ret) const{
+  ret.clear();
+  vector<uint64_t> pruned;
+  for (size_t i = 0; i < candidates.size() && ret.size() < num; ++i) {
+    vector_view c = get_view(candidates[i].second);
+    bool diverse = true;
+    for (size_t j = 0; j < ret.size(); ++j) {
+      if (calc_similarity(c, get_view(ret[j])) > candidates[i].first) {
+        diverse = false;
+        break;
+      }
+    }
+    if (diverse) {
+      ret.push_back(candidates[i].second);
+    } else {
+      pruned.push_back(candidates[i].second);
+    }
+  }
+  // links of pruned candidates are kept to fill the rest
+  for (size_t i = 0; i < pruned.size() && ret.size() < num; ++i) {
+    ret.push_back(pruned[i]);
+  }
+}
+
+void hnsw_index_storage::shrink_links(uint64_t id, uint64_t level){
+  vector_view v = get_view(id);
+  vector<uint64_t>& links = nodes_[id].links[level];
+  vector<scored_node> candidates;
+  for (size_t i = 0; i < links.size(); ++i) {
+    if (!nodes_[links[i]].removed) {
+      candidates.push_back(make_pair(calc_similarity(v, get_view(links[i])), links[i]));
+    }
+  }
+  sort(candidates.begin(), candidates.end(), greater<scored_node>());
+  select_neighbors(candidates, max_link_num(level), links);
+}
+
+void hnsw_index_storage::repair_if_needed(){
+  if (needs_compaction(removed_num_, nodes_.size())) {
+    repair();
+  }
+}
+
+void hnsw_index_storage::repair(){
+  if (removed_num_ == 0) {
+    return;
+  }
+
+  // Links to tombstones are replaced with the best of the other links and
+  // the links of the tombstones.
+  vector<uint64_t> ids;
+  vector<scored_node> candidates;
+  for (uint64_t id = 0; id < nodes_.size(); ++id) {
+    if (nodes_[id].removed) {
+      continue;
+    }
+    vector_view v = get_view(id);
+    for (uint64_t l = 0; l <= nodes_[id].level; ++l) {
+      vector<uint64_t>& links = nodes_[id].links[l];
+      ids.clear();
+      bool has_tombstone = false;
+      for (size_t i = 0; i < links.size(); ++i) {
+        const node& n = nodes_[links[i]];
+        if (!n.removed) {
+          ids.push_back(links[i]);
+          continue;
+        }
+        has_tombstone = true;
+        for (size_t j = 0; j < n.links[l].size(); ++j) {
+          uint64_t k = n.links[l][j];
+          if (k != id && !nodes_[k].removed) {
+            ids.push_back(k);
+          }
+        }
+      }
+      if (!has_tombstone) {
+        continue;
+      }
+      sort(ids.begin(), ids.end());
+      ids.erase(unique(ids.begin(), ids.end()), ids.end());
+      candidates.clear();
+      for (size_t i = 0; i < ids.size(); ++i) {
+        candidates.push_back(make_pair(calc_similarity(v, get_view(ids[i])), ids[i]));
+      }
+      sort(candidates.begin(), candidates.end(), greater<scored_node>());
+      select_neighbors(candidates, max_link_num(l), links);
+    }
+  }
+
+  // Live nodes are renumbered and their columns are packed.
+  vector<uint64_t> new_ids(nodes_.size(), NO_NODE);
+  vector<node> nodes;
+  vector<uint64_t> column_ids;
+  vector<float> values;
+  for (uint64_t id = 0; id < nodes_.size(); ++id) {
+    node& n = nodes_[id];
+    if (n.removed) {
+      continue;
+    }
+    new_ids[id] = nodes.size();
+    column_ids.insert(column_ids.end(), column_ids_.begin() + n.offset,
+                      column_ids_.begin() + n.offset + n.size);
+    values.insert(values.end(), values_.begin() + n.offset,
+                  values_.begin() + n.offset + n.size);
+    n.offset = column_ids.size() - n.size;
+    nodes.push_back(node());
+    swap(nodes.back(), n);
+  }
+  entry_ = NO_NODE;
+  max_level_ = 0;
+  row2id_.clear();
+  for (uint64_t id = 0; id < nodes.size(); ++id) {
+    node& n = nodes[id];
+    for (size_t l = 0; l < n.links.size(); ++l) {
+      size_t num = 0;
+      for (size_t i = 0; i < n.links[l].size(); ++i) {
+        uint64_t k = new_ids[n.links[l][i]];
+        if (k != NO_NODE) {
+          n.links[l][num++] = k;
+        }
+      }
+      n.links[l].resize(num);
+    }
+    if (entry_ == NO_NODE || n.level > max_level_) {
+      entry_ = id;
+      max_level_ = n.level;
+    }
+    row2id_[n.row] = id;
+  }
+  nodes_.swap(nodes);
+  column_ids_.swap(column_ids);
+  values_.swap(values);
+  removed_num_ = 0;
+
+  // nodes which lost all of their links are inserted again
+  for (uint64_t id = 0; id < nodes_.size(); ++id) {
+    if (id != entry_ && nodes_[id].links[0].empty()) {
+      for (size_t l = 0; l < nodes_[id].links.size(); ++l) {
+        nodes_[id].links[l].clear();
+      }
+      connect(id);
+    }
+  }
+}
+
+void hnsw_index_storage::get_diff(string& diff) const {
+  ostringstream os;
+  {
+    pfi::data::serialization::binary_oarchive bo(os);
+    bo << const_cast<row_table_t&>(diff_);
+  }
+  diff = os.str();
+}
+
+void hnsw_index_storage::set_mixed_and_clear_diff(const string& mixed_diff_str) {
+  istringstream is(mixed_diff_str);
+  pfi::data::serialization::binary_iarchive bi(is);
+  row_table_t mixed_diff;
+  bi >> mixed_diff;
+
+  sfv_t columns;
+  for (row_table_t::const_iterator it = mixed_diff.begin(); it != mixed_diff.end(); ++it){
+    if (it->second.empty()) {
+      remove_node(it->first);
+      continue;
+    }
+    // rows already set locally are kept in the graph as they are
+    columns.assign(it->second.begin(), it->second.end());
+    set_row_columns(it->first, columns);
+  }
+  diff_.clear();
+  repair_if_needed();
+}
+
+void hnsw_index_storage::mix(const string& lhs, string& rhs) const{
+  row_table_t lhs_diff;
+  {
+    istringstream is(lhs);
+    pfi::data::serialization::binary_iarchive bi(is);
+    bi >> lhs_diff;
+  }
+  row_table_t rhs_diff;
+  {
+    istringstream is(rhs);
+    pfi::data::serialization::binary_iarchive bi(is);
+    bi >> rhs_diff;
+  }
+
+  for (row_table_t::const_iterator it = lhs_diff.begin(); it != lhs_diff.end(); ++it){
+    rhs_diff[it->first] = it->second;
+  }
+
+  ostringstream os;
+  {
+    pfi::data::serialization::binary_oarchive bo(os);
+    bo << rhs_diff;
+  }
+  rhs = os.str();
+}
+
+}
+}
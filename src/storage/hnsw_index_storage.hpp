@@ -0,0 +1,177 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <pficommon/data/serialization.h>
+#include <pficommon/data/serialization/unordered_map.h>
+#include <pficommon/data/unordered_map.h>
+#include "../common/key_manager.hpp"
+#include "../common/type.hpp"
+#include "storage_type.hpp"
+#include "recommender_storage_base.hpp"
+
+namespace jubatus {
+namespace storage {
+
+// Rows are kept in a hierarchical navigable small world graph, where each row
+// is linked to its nearest rows on each of its levels, and similar_row
+// searches the graph greedily from the top level.
+//
+// A removed or updated row is left in the graph as a tombstone to keep
+// navigating through it, and the links of tombstones are repaired and
+// tombstones are dropped when they grow large.
+//
+// Rows are inserted into the graph as soon as they are set. The diff for mix
+// is the table of rows set or removed since the last mix, and each server
+// builds its own graph of mixed rows.
+class hnsw_index_storage : public recommender_storage_base {
+public:
+  enum metric_type {
+    // cosine similarity of rows
+    COSINE,
+    // negative euclidean distance of rows
+    EUCLID
+  };
+
+  hnsw_index_storage();
+  // Rows are linked to up to m rows on each level but level 0, where they
+  // are linked to up to 2 * m rows. Up to ef_construction and ef candidates
+  // are kept in a search on insertion and on similar_row respectively.
+  hnsw_index_storage(metric_type metric, uint64_t m,
+                     uint64_t ef_construction, uint64_t ef);
+  ~hnsw_index_storage();
+
+  void set_row(const std::string& row, const sfv_t& columns);
+  void remove_row(const std::string& row);
+  void clear();
+  void get_all_row_ids(std::vector<std::string>& ids) const;
+
+  void similar_row(const sfv_t& query, std::vector<std::pair<std::string, float> >& ids,
+                   uint64_t ret_num) const;
+  std::string name() const;
+
+  // number of rows including tombstones
+  uint64_t node_num() const;
+  // Repairs links to tombstones and drops them.
+  void repair();
+
+  void get_diff(std::string& diff) const;
+  void set_mixed_and_clear_diff(const std::string& mixed_diff);
+  void mix(const std::string& lhs, std::string& rhs) const;
+
+private:
+  // A removed row is an empty row in a diff.
+  typedef pfi::data::unordered_map<std::string, map_float_t> row_table_t;
+  typedef std::pair<float, uint64_t> scored_node;
+
+  struct node {
+    node() : offset(0), size(0), norm2(0.f), level(0), removed(false) {}
+    std::string row;
+    // range in column_ids_ and values_
+    uint64_t offset;
+    uint64_t size;
+    float norm2;
+    uint64_t level;
+    bool removed;
+    // ids of linked nodes on each level
+    std::vector<std::vector<uint64_t> > links;
+
+    friend class pfi::data::serialization::access;
+    template <class Ar>
+    void serialize(Ar& ar) {
+      ar & MEMBER(row) & MEMBER(offset) & MEMBER(size) & MEMBER(norm2)
+        & MEMBER(level) & MEMBER(removed) & MEMBER(links);
+    }
+  };
+
+  // A row whose columns are sorted by column id.
+  struct vector_view {
+    vector_view() : column_ids(NULL), values(NULL), size(0), norm2(0.f) {}
+    const uint64_t* column_ids;
+    const float* values;
+    size_t size;
+    float norm2;
+  };
+
+  void set_row_columns(const std::string& row, const sfv_t& columns);
+  void remove_node(const std::string& row);
+  bool has_same_columns(uint64_t id, const std::vector<std::pair<uint64_t, float> >& columns) const;
+  // Converts columns to ones sorted by id. Unknown columns of a query are
+  // only counted in the norm.
+  void make_columns(const sfv_t& columns, std::vector<std::pair<uint64_t, float> >& ret);
+  void make_query(const sfv_t& query, std::vector<uint64_t>& column_ids,
+                  std::vector<float>& values, vector_view& view) const;
+  vector_view get_view(uint64_t id) const;
+  float calc_similarity(const vector_view& lhs, const vector_view& rhs) const;
+  uint64_t calc_level(const std::string& row) const;
+  uint64_t max_link_num(uint64_t level) const;
+
+  void connect(uint64_t id);
+  // Searches the nearest ef nodes to the query on a level from entries,
+  // which are replaced by the result in descending order of similarity.
+  void search_level(const vector_view& query, uint64_t ef, uint64_t level,
+                    std::vector<scored_node>& entries) const;
+  // Selects up to num nodes from candidates in descending order of
+  // similarity to a node, preferring ones that are not closer to a selected
+  // node than to the node.
+  void select_neighbors(const std::vector<scored_node>& candidates, uint64_t num,
+                        std::vector<uint64_t>& ret) const;
+  void shrink_links(uint64_t id, uint64_t level);
+  void repair_if_needed();
+
+  friend class pfi::data::serialization::access;
+  template <class Ar>
+  void serialize(Ar& ar) {
+    ar & MEMBER(column2id_) & MEMBER(nodes_)
+      & MEMBER(column_ids_) & MEMBER(values_)
+      & MEMBER(entry_) & MEMBER(max_level_) & MEMBER(removed_num_)
+      & MEMBER(diff_);
+    if (ar.is_read) {
+      row2id_.clear();
+      for (uint64_t id = 0; id < nodes_.size(); ++id) {
+        if (!nodes_[id].removed) {
+          row2id_[nodes_[id].row] = id;
+        }
+      }
+    }
+  }
+
+  metric_type metric_;
+  uint64_t m_;
+  uint64_t ef_construction_;
+  uint64_t ef_;
+  double level_mult_;
+
+  key_manager column2id_;
+  pfi::data::unordered_map<std::string, uint64_t> row2id_;  // live rows
+  std::vector<node> nodes_;
+  std::vector<uint64_t> column_ids_;
+  std::vector<float> values_;
+  uint64_t entry_;
+  uint64_t max_level_;
+  uint64_t removed_num_;
+
+  row_table_t diff_;
+};
+
+}
+}
@@ -0,0 +1,305 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <pficommon/data/serialization.h>
+#include <pficommon/lang/cast.h>
+#include "hnsw_index_storage.hpp"
+
+namespace jubatus {
+namespace storage {
+
+using namespace std;
+using pfi::lang::lexical_cast;
+
+namespace {
+
+sfv_t make_dense(const vector<float>& v) {
+  sfv_t ret;
+  for (size_t i = 0; i < v.size(); ++i) {
+    ret.push_back(make_pair("c" + lexical_cast<string>(i), v[i]));
+  }
+  return ret;
+}
+
+void make_random_rows(size_t num, size_t dim, unsigned int seed,
+                      vector<sfv_t>& rows) {
+  srand(seed);
+  rows.clear();
+  for (size_t i = 0; i < num; ++i) {
+    vector<float> v(dim);
+    for (size_t j = 0; j < dim; ++j) {
+      v[j] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+    }
+    rows.push_back(make_dense(v));
+  }
+}
+
+float calc_cosine(const sfv_t& x, const sfv_t& y) {
+  float dot = 0, x2 = 0, y2 = 0;
+  for (size_t i = 0; i < x.size(); ++i) {
+    dot += x[i].second * y[i].second;
+    x2 += x[i].second * x[i].second;
+    y2 += y[i].second * y[i].second;
+  }
+  return dot / sqrt(x2 * y2);
+}
+
+// ratio of the true top ret_num rows of live rows found by the storage
+float calc_recall(const hnsw_index_storage& s, const vector<sfv_t>& rows,
+                  const vector<bool>& live, const vector<sfv_t>& queries,
+                  size_t ret_num) {
+  size_t found = 0;
+  for (size_t q = 0; q < queries.size(); ++q) {
+    vector<pair<float, string> > scores;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (live[i]) {
+        scores.push_back(make_pair(calc_cosine(queries[q], rows[i]),
+                                   "r" + lexical_cast<string>(i)));
+      }
+    }
+    sort(scores.begin(), scores.end(), greater<pair<float, string> >());
+
+    vector<pair<string, float> > ids;
+    s.similar_row(queries[q], ids, ret_num);
+    for (size_t i = 0; i < ret_num; ++i) {
+      for (size_t j = 0; j < ids.size(); ++j) {
+        if (ids[j].first == scores[i].second) {
+          ++found;
+          break;
+        }
+      }
+    }
+  }
+  return static_cast<float>(found) / (queries.size() * ret_num);
+}
+
+}
+
+TEST(hnsw_index_storage, trivial) {
+  hnsw_index_storage s;
+  EXPECT_EQ("hnsw_index_storage", s.name());
+
+  vector<float> v(3);
+  v[0] = 1; v[1] = 0; v[2] = 0;
+  s.set_row("r1", make_dense(v));
+  v[0] = 1; v[1] = 1; v[2] = 0;
+  s.set_row("r2", make_dense(v));
+  v[0] = 0; v[1] = 0; v[2] = 1;
+  s.set_row("r3", make_dense(v));
+
+  v[0] = 2; v[1] = 0; v[2] = 0;
+  vector<pair<string, float> > ids;
+  s.similar_row(make_dense(v), ids, 2);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_EQ("r1", ids[0].first);
+  EXPECT_FLOAT_EQ(1.0, ids[0].second);
+  EXPECT_EQ("r2", ids[1].first);
+  EXPECT_FLOAT_EQ(1 / sqrt(2.0), ids[1].second);
+
+  s.remove_row("r1");
+  s.similar_row(make_dense(v), ids, 3);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_EQ("r2", ids[0].first);
+
+  vector<string> rows;
+  s.get_all_row_ids(rows);
+  sort(rows.begin(), rows.end());
+  ASSERT_EQ(2u, rows.size());
+  EXPECT_EQ("r2", rows[0]);
+  EXPECT_EQ("r3", rows[1]);
+
+  s.clear();
+  s.similar_row(make_dense(v), ids, 2);
+  EXPECT_TRUE(ids.empty());
+  EXPECT_EQ(0u, s.node_num());
+}
+
+TEST(hnsw_index_storage, euclid) {
+  hnsw_index_storage s(hnsw_index_storage::EUCLID, 4, 16, 8);
+  for (int i = 0; i < 10; ++i) {
+    vector<float> v(2);
+    v[0] = i;
+    s.set_row("r" + lexical_cast<string>(i), make_dense(v));
+  }
+
+  vector<float> v(2);
+  v[0] = 3.2;
+  v[1] = 0;
+  vector<pair<string, float> > ids;
+  s.similar_row(make_dense(v), ids, 3);
+  ASSERT_EQ(3u, ids.size());
+  EXPECT_EQ("r3", ids[0].first);
+  EXPECT_NEAR(-0.2, ids[0].second, 1e-5);
+  EXPECT_EQ("r4", ids[1].first);
+  EXPECT_NEAR(-0.8, ids[1].second, 1e-5);
+  EXPECT_EQ("r2", ids[2].first);
+  EXPECT_NEAR(-1.2, ids[2].second, 1e-5);
+
+  EXPECT_ANY_THROW(hnsw_index_storage(hnsw_index_storage::EUCLID, 1, 16, 8));
+  EXPECT_ANY_THROW(hnsw_index_storage(hnsw_index_storage::EUCLID, 4, 16, 0));
+}
+
+TEST(hnsw_index_storage, recall) {
+  vector<sfv_t> rows, queries;
+  make_random_rows(1000, 16, 0, rows);
+  make_random_rows(50, 16, 1, queries);
+
+  hnsw_index_storage s;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    s.set_row("r" + lexical_cast<string>(i), rows[i]);
+  }
+  vector<bool> live(rows.size(), true);
+  EXPECT_LT(0.9, calc_recall(s, rows, live, queries, 10));
+
+  // removed rows are dropped by the repair, and the rest are still found
+  for (size_t i = 0; i < rows.size(); i += 2) {
+    s.remove_row("r" + lexical_cast<string>(i));
+    live[i] = false;
+  }
+  EXPECT_EQ(1000u, s.node_num());
+  EXPECT_LT(0.9, calc_recall(s, rows, live, queries, 10));
+
+  s.repair();
+  EXPECT_EQ(500u, s.node_num());
+  EXPECT_LT(0.9, calc_recall(s, rows, live, queries, 10));
+
+  vector<pair<string, float> > ids;
+  s.similar_row(rows[0], ids, 10);
+  ASSERT_EQ(10u, ids.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(1, lexical_cast<int>(ids[i].first.substr(1)) % 2);
+  }
+}
+
+TEST(hnsw_index_storage, update) {
+  hnsw_index_storage s;
+  vector<float> v(2);
+  v[0] = 1;
+  s.set_row("r1", make_dense(v));
+  v[0] = 0;
+  v[1] = 1;
+  s.set_row("r2", make_dense(v));
+
+  // an updated row is inserted again and the old one is left as a tombstone
+  v[0] = 1;
+  v[1] = 0;
+  s.set_row("r2", make_dense(v));
+  s.set_row("r2", make_dense(v));
+  EXPECT_EQ(3u, s.node_num());
+
+  v[0] = 0;
+  v[1] = 1;
+  vector<pair<string, float> > ids;
+  s.similar_row(make_dense(v), ids, 2);
+  ASSERT_EQ(2u, ids.size());
+  EXPECT_FLOAT_EQ(0, ids[0].second);
+  EXPECT_FLOAT_EQ(0, ids[1].second);
+
+  s.repair();
+  EXPECT_EQ(2u, s.node_num());
+  s.similar_row(make_dense(v), ids, 2);
+  EXPECT_EQ(2u, ids.size());
+}
+
+TEST(hnsw_index_storage, save_load) {
+  vector<sfv_t> rows;
+  make_random_rows(200, 8, 0, rows);
+  hnsw_index_storage s;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    s.set_row("r" + lexical_cast<string>(i), rows[i]);
+  }
+  s.remove_row("r0");
+
+  stringstream ss;
+  {
+    pfi::data::serialization::binary_oarchive oa(ss);
+    oa << s;
+  }
+  hnsw_index_storage t;
+  {
+    pfi::data::serialization::binary_iarchive ia(ss);
+    ia >> t;
+  }
+
+  EXPECT_EQ(s.node_num(), t.node_num());
+  for (size_t i = 0; i < 10; ++i) {
+    vector<pair<string, float> > ids1, ids2;
+    s.similar_row(rows[i], ids1, 5);
+    t.similar_row(rows[i], ids2, 5);
+    EXPECT_TRUE(ids1 == ids2);
+  }
+
+  string d1, d2;
+  s.get_diff(d1);
+  t.get_diff(d2);
+  EXPECT_EQ(d1, d2);
+}
+
+TEST(hnsw_index_storage, mix) {
+  hnsw_index_storage s1, s2, s3;
+  vector<float> v(2);
+  v[0] = 1;
+  s1.set_row("r1", make_dense(v));
+  s3.set_row("r1", make_dense(v));
+  v[1] = 1;
+  s2.set_row("r2", make_dense(v));
+  v[0] = 0;
+  s2.set_row("r3", make_dense(v));
+
+  string d1, d2;
+  s1.get_diff(d1);
+  s2.get_diff(d2);
+  s1.mix(d1, d2);
+  s1.set_mixed_and_clear_diff(d2);
+  s2.set_mixed_and_clear_diff(d2);
+  s3.set_mixed_and_clear_diff(d2);
+  EXPECT_EQ(3u, s1.node_num());
+  EXPECT_EQ(3u, s3.node_num());
+
+  vector<string> rows1, rows2;
+  s1.get_all_row_ids(rows1);
+  s2.get_all_row_ids(rows2);
+  sort(rows1.begin(), rows1.end());
+  sort(rows2.begin(), rows2.end());
+  ASSERT_EQ(3u, rows1.size());
+  EXPECT_TRUE(rows1 == rows2);
+
+  // removals are mixed too
+  s2.remove_row("r2");
+  s2.get_diff(d2);
+  s1.set_mixed_and_clear_diff(d2);
+  s1.get_all_row_ids(rows1);
+  sort(rows1.begin(), rows1.end());
+  ASSERT_EQ(2u, rows1.size());
+  EXPECT_EQ("r1", rows1[0]);
+  EXPECT_EQ("r3", rows1[1]);
+
+  s1.get_diff(d1);
+  hnsw_index_storage empty;
+  string d3;
+  empty.get_diff(d3);
+  EXPECT_EQ(d3, d1);
+}
+
+}
+}
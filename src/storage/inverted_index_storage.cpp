@@ -15,8 +15,11 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
 #include "inverted_index_storage.hpp"
+#include "../common/thread_pool.hpp"
 
 
 using namespace std;
@@ -47,7 +50,56 @@ void revert_diff(const string& diff,
 }
 
 
-inverted_index_storage::inverted_index_storage(){
+namespace {
+
+// diffs of a row are deduplicated when the number of them reaches a power of
+// two larger than this
+const size_t MIN_DIFF_DEDUP_SIZE = 64;
+
+// a distinct row in a query and its cursor on the posting list
+struct query_term {
+  explicit query_term(const posting_list& p)
+      : cursor(p), val(0.f), rank(0) {
+  }
+
+  uint64_t column() const {
+    return cursor.id();
+  }
+
+  bool end() const {
+    return cursor.end();
+  }
+
+  posting_list::cursor cursor;
+  float val;  // sum of the values in the query
+  size_t rank;  // position in the order of val * val
+  std::vector<size_t> occurrences;  // indexes in the query
+};
+
+bool less_weight(const query_term* lhs, const query_term* rhs) {
+  return lhs->val * lhs->val < rhs->val * rhs->val;
+}
+
+bool greater_column(const query_term* lhs, const query_term* rhs) {
+  return lhs->column() > rhs->column();
+}
+
+// Upper bound of the score of a column which has values only in rows whose
+// squared query values sum up to sq_sum. As the column norm is not less than
+// the norm of the values in these rows, Cauchy-Schwarz inequality gives
+// sqrt(sq_sum) / query_norm. The margin absorbs rounding errors of norms.
+float score_upper_bound(float sq_sum, float query_norm) {
+  return sqrt(sq_sum) / query_norm * 1.001f + 1e-6f;
+}
+
+}
+
+inverted_index_storage::inverted_index_storage()
+    : partition_num_(1) {
+}
+
+inverted_index_storage::inverted_index_storage(uint64_t partition_num)
+    : partition_num_(max<uint64_t>(1, partition_num)) {
 }
 
 inverted_index_storage::~inverted_index_storage(){
@@ -58,54 +110,74 @@ void inverted_index_storage::set(const std::string& row, const std::string& colu
 
   if (column_id == key_manager::NOTFOUND){
     column_id = column2id_.get_id(column);
+    add_norm_diff(column_id, val * val);
   } else {
     float cur_val = get(row, column);
-    column2norm_diff_[column_id] -= cur_val * cur_val;
+    add_norm_diff(column_id, val * val - cur_val * cur_val);
   }
-  inv_diff_[row][column_id] = val;
-  column2norm_diff_[column_id] += val * val;
+
+  if (val == 0.f){
+    posting_tbl_t::iterator it = inv_.find(row);
+    if (it != inv_.end()){
+      it->second.remove(column_id);
+      if (it->second.empty()){
+        inv_.erase(it);
+      }
+    }
+  } else {
+    inv_[row].set(column_id, val);
+  }
+  add_diff(row, column_id);
 }
 
-float inverted_index_storage::get(const string& row, const string& column) const {
-  uint64_t column_id = column2id_.get_id_const(column);
-  if (column_id == key_manager::NOTFOUND){
-    return 0.f;
+void inverted_index_storage::add_diff(const std::string& row, uint64_t column_id){
+  vector<uint64_t>& columns = inv_diff_[row];
+  columns.push_back(column_id);
+  size_t size = columns.size();
+  if (size >= MIN_DIFF_DEDUP_SIZE && (size & (size - 1)) == 0){
+    sort(columns.begin(), columns.end());
+    columns.erase(unique(columns.begin(), columns.end()), columns.end());
   }
-  {
-    bool exist = false;
-    float ret = get_from_tbl(row, column_id, inv_diff_, exist);
-    if (exist){
-      return ret;
-    }
+}
+
+void inverted_index_storage::add_norm_diff(uint64_t column_id, float diff){
+  reserve_columns(column_id);
+  size_t& index = norm_diff_index_[column_id];
+  if (index == 0){
+    column2norm_diff_.push_back(make_pair(column_id, 0.f));
+    index = column2norm_diff_.size();
   }
-  {
-    bool exist = false;
-    float ret = get_from_tbl(row, column_id, inv_, exist);
-    if (exist){
-      return ret;
-    }
+  column2norm_diff_[index - 1].second += diff;
+}
+
+void inverted_index_storage::reserve_columns(uint64_t column_id){
+  if (column_id >= column2norm_.size()){
+    column2norm_.resize(column_id + 1);
+    norm_diff_index_.resize(column_id + 1);
   }
-  return 0.0;
 }
 
-float  inverted_index_storage::get_from_tbl(const std::string& row, uint64_t column_id, const tbl_t& tbl, bool& exist) const{
-  exist = false;
+void inverted_index_storage::clear_norm_diff(){
+  for (size_t i = 0; i < column2norm_diff_.size(); ++i){
+    norm_diff_index_[column2norm_diff_[i].first] = 0;
+  }
+  column2norm_diff_.clear();
+}
 
+float inverted_index_storage::get(const string& row, const string& column) const {
+  uint64_t column_id = column2id_.get_id_const(column);
   if (column_id == key_manager::NOTFOUND){
     return 0.f;
   }
-  tbl_t::const_iterator it = tbl.find(row);
-  if (it == inv_.end()) {
+  posting_tbl_t::const_iterator it = inv_.find(row);
+  if (it == inv_.end()){
     return 0.f;
-  } else {
-    row_t::const_iterator it_row = it->second.find(column_id);
-    if (it_row == it->second.end()) {
-      return 0.f;
-    } else {
-      exist = true;
-      return it_row->second;
-    }
   }
+  float val = 0.f;
+  if (it->second.get(column_id, val)){
+    return val;
+  }
+  return 0.f;
 }
 
 void inverted_index_storage::remove(const std::string& row, const std::string& column){
@@ -117,34 +189,42 @@ void inverted_index_storage::clear(){
   inv_diff_.clear();
   column2norm_.clear();
   column2norm_diff_.clear();
+  norm_diff_index_.clear();
 }
 
 void inverted_index_storage::get_all_column_ids(std::vector<std::string>& ids) const{
   ids.clear();
-  for (imap_float_t::const_iterator it = column2norm_.begin(); it != column2norm_.end(); ++it){
-    ids.push_back(column2id_.get_key(it->first));
-  }
-  for (imap_float_t::const_iterator it = column2norm_diff_.begin(); it != column2norm_diff_.end(); ++it){
-    if (column2norm_.find(it->first) == column2norm_.end()){
-      ids.push_back(column2id_.get_key(it->first));
+  for (uint64_t id = 0; id < column2norm_.size(); ++id){
+    if (column2norm_[id] != 0.f || norm_diff_index_[id] != 0){
+      ids.push_back(column2id_.get_key(id));
     }
   }
 }
 
 void inverted_index_storage::get_diff(std::string& diff_str) const {
   sparse_matrix_storage diff;
-  for (tbl_t::const_iterator it = inv_diff_.begin(); it != inv_diff_.end(); ++it){
+  for (diff_tbl_t::const_iterator it = inv_diff_.begin(); it != inv_diff_.end(); ++it){
+    vector<uint64_t> ids(it->second);
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    posting_tbl_t::const_iterator it_row = inv_.find(it->first);
     vector<pair<string, float> > columns;
-    for (row_t::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2){
-      columns.push_back(make_pair(column2id_.get_key(it2->first), it2->second));
+    for (size_t i = 0; i < ids.size(); ++i){
+      // removed values are sent as 0
+      float val = 0.f;
+      if (it_row != inv_.end()){
+        it_row->second.get(ids[i], val);
+      }
+      columns.push_back(make_pair(column2id_.get_key(ids[i]), val));
     }
     diff.set_row(it->first, columns);
   }
 
   map_float_t column2norm_diff;
-  for (imap_float_t::const_iterator it = column2norm_diff_.begin();
-       it != column2norm_diff_.end(); ++it){
-    column2norm_diff[column2id_.get_key(it->first)] = it->second;
+  for (size_t i = 0; i < column2norm_diff_.size(); ++i){
+    column2norm_diff[column2id_.get_key(column2norm_diff_[i].first)] =
+        column2norm_diff_[i].second;
   }
   convert_diff(diff, column2norm_diff, diff_str);
 }
@@ -159,28 +239,42 @@ void inverted_index_storage::set_mixed_and_clear_diff(const string& mixed_diff_s
   mixed_inv.get_all_row_ids(ids);
   for (size_t i = 0; i < ids.size(); ++i){
     const string& row = ids[i];
-    row_t& v = inv_[row];
+    posting_list& v = inv_[row];
     vector<pair<string, float> > columns;
     mixed_inv.get_row(row, columns);
     for (size_t j = 0; j < columns.size(); ++j){
       size_t id = column2id_.get_id(columns[j].first);
       if (columns[j].second == 0.f){
-        v.erase(id);
+        v.remove(id);
       } else {
-        v[id] = columns[j].second;
+        v.set(id, columns[j].second);
       }
     }
   }
+
+  // merge update buffers of rows updated since the last mix
+  for (diff_tbl_t::const_iterator it = inv_diff_.begin(); it != inv_diff_.end(); ++it){
+    ids.push_back(it->first);
+  }
+  for (size_t i = 0; i < ids.size(); ++i){
+    posting_tbl_t::iterator it = inv_.find(ids[i]);
+    if (it == inv_.end()){
+      continue;
+    }
+    if (it->second.empty()){
+      inv_.erase(it);
+    } else {
+      it->second.flush();
+    }
+  }
   inv_diff_.clear();
 
   for (map_float_t::const_iterator it = mixed_column2norm.begin(); it != mixed_column2norm.end(); ++it){
     uint64_t column_index = column2id_.get_id(it->first);
+    reserve_columns(column_index);
     column2norm_[column_index] += it->second;
-    if (column2norm_[column_index] == 0.f){
-      column2norm_.erase(column_index);
-    }
   }
-  column2norm_diff_.clear();
+  clear_norm_diff();
 }
 
 void inverted_index_storage::mix(const string& lhs, string& rhs) const{
@@ -220,84 +314,279 @@ bool inverted_index_storage::load(std::istream& is){
   return true;
 }
 
+namespace {
+
+typedef pair<float, uint64_t> scored_column;
+
+// columns scored by a task at least
+const uint64_t MIN_PARTITION_SIZE = 4096;
+
+}
+
+// Finds the top ret_num columns whose ids are in [begin, end) with MaxScore
+// traversal over the posting lists. Rows are sorted by their bounds, and the
+// longest prefix of them whose bound is below the current k-th score is
+// "non-essential": a column which appears only in these rows cannot enter
+// the top-k. Candidates are taken from the other rows in column order, and the
+// non-essential rows are only looked up for the candidates. Scores are summed
+// in the order of the query, so the result is the same as scoring all columns.
+struct inverted_index_storage::score_task {
+  const inverted_index_storage* storage;
+  const sfv_t* query;
+  const vector<query_term>* terms;
+  const vector<float>* sq_prefix;  // sq_prefix[i]: sum of squared values of the first i rows
+  float query_norm;
+  size_t ret_num;
+  uint64_t begin;
+  uint64_t end;
+  vector<scored_column>* top;  // min-heap of the top-k by score
+
+  void operator()() const {
+    // cursors are moved, so each task has its own copy of the rows
+    vector<query_term> local_terms(*terms);
+    vector<query_term*> sorted_terms(local_terms.size());
+    for (size_t i = 0; i < local_terms.size(); ++i){
+      sorted_terms[local_terms[i].rank] = &local_terms[i];
+    }
+    size_t num_nonessential = 0;
+
+    // min-heap of cursors by column
+    vector<query_term*> cursors;
+    for (size_t i = 0; i < sorted_terms.size(); ++i){
+      query_term* term = sorted_terms[i];
+      term->cursor.seek(begin);
+      if (!term->end() && term->column() < end){
+        cursors.push_back(term);
+      }
+    }
+    make_heap(cursors.begin(), cursors.end(), greater_column);
+    vector<pair<size_t, float> > products;
+
+    while (!cursors.empty() && num_nonessential < sorted_terms.size()){
+      const uint64_t column = cursors.front()->column();
+      products.clear();
+      float sq_sum = (*sq_prefix)[num_nonessential];
+      bool has_essential = false;
+
+      while (!cursors.empty() && cursors.front()->column() == column){
+        pop_heap(cursors.begin(), cursors.end(), greater_column);
+        query_term* term = cursors.back();
+        if (term->rank < num_nonessential){
+          // became non-essential, and is only looked up from now on
+          cursors.pop_back();
+          continue;
+        }
+        has_essential = true;
+        add_products(*term, products);
+        sq_sum += term->val * term->val;
+        term->cursor.next();
+        if (term->end() || term->column() >= end){
+          cursors.pop_back();
+        } else {
+          push_heap(cursors.begin(), cursors.end(), greater_column);
+        }
+      }
+
+      if (!has_essential){
+        continue;
+      }
+      if (top->size() == ret_num
+          && score_upper_bound(sq_sum, query_norm) < top->front().first){
+        continue;
+      }
+
+      for (size_t i = 0; i < num_nonessential; ++i){
+        query_term* term = sorted_terms[i];
+        term->cursor.seek(column);
+        if (!term->end() && term->column() == column){
+          add_products(*term, products);
+        }
+      }
+
+      sort(products.begin(), products.end());
+      float score = 0.f;
+      for (size_t i = 0; i < products.size(); ++i){
+        score += products[i].second;
+      }
+      float norm = storage->calc_columnl2norm(column);
+      float normed_score = (norm != 0.f) ? score / norm / query_norm : 0.f;
+      scored_column candidate(normed_score, column);
+
+      if (top->size() < ret_num){
+        top->push_back(candidate);
+        push_heap(top->begin(), top->end(), greater<scored_column>());
+      } else if (top->front() < candidate){
+        pop_heap(top->begin(), top->end(), greater<scored_column>());
+        top->back() = candidate;
+        push_heap(top->begin(), top->end(), greater<scored_column>());
+      } else {
+        continue;
+      }
+
+      if (top->size() == ret_num){
+        while (num_nonessential < sorted_terms.size()
+               && score_upper_bound((*sq_prefix)[num_nonessential + 1], query_norm)
+                  < top->front().first){
+          ++num_nonessential;
+        }
+      }
+    }
+  }
+
+  void add_products(const query_term& term, vector<pair<size_t, float> >& products) const {
+    float w = term.cursor.value();
+    for (size_t j = 0; j < term.occurrences.size(); ++j){
+      size_t index = term.occurrences[j];
+      products.push_back(make_pair(index, w * (*query)[index].second));
+    }
+  }
+};
+
+// Column ids are split into up to partition_num_ ranges, and the top-k of
+// each range is found on the shared thread pool.
 void inverted_index_storage::calc_scores(const sfv_t& query, 
                                          vector<pair<string, float> >& scores,
                                          size_t ret_num) const {
-  float query_norm = calc_l2norm(query);
+  if (ret_num == 0){
+    return;
+  }
+
+  vector<query_term> terms;
+  float query_norm = 0.f;
+  {
+    pfi::data::unordered_map<string, size_t> term_ids;
+    for (size_t i = 0; i < query.size(); ++i){
+      query_norm += query[i].second * query[i].second;
+      posting_tbl_t::const_iterator it = inv_.find(query[i].first);
+      if (it == inv_.end() || it->second.empty()){
+        continue;
+      }
+      pair<pfi::data::unordered_map<string, size_t>::iterator, bool> ins =
+          term_ids.insert(make_pair(query[i].first, terms.size()));
+      if (ins.second){
+        terms.push_back(query_term(it->second));
+      }
+      query_term& term = terms[ins.first->second];
+      term.val += query[i].second;
+      term.occurrences.push_back(i);
+    }
+  }
+  query_norm = sqrt(query_norm);
   if (query_norm == 0.f){
     return;
   }
-  pfi::data::unordered_map<uint64_t, float> i_scores;
-  for (size_t i = 0; i < query.size(); ++i){
-    const string& fid = query[i].first;
-    float val = query[i].second;
-    add_inp_scores(fid, val, i_scores);
+
+  vector<query_term*> sorted_terms;
+  for (size_t i = 0; i < terms.size(); ++i){
+    sorted_terms.push_back(&terms[i]);
+  }
+  sort(sorted_terms.begin(), sorted_terms.end(), less_weight);
+  vector<float> sq_prefix(sorted_terms.size() + 1);
+  for (size_t i = 0; i < sorted_terms.size(); ++i){
+    sorted_terms[i]->rank = i;
+    sq_prefix[i + 1] = sq_prefix[i] + sorted_terms[i]->val * sorted_terms[i]->val;
   }
 
-  vector<pair<float, uint64_t> > sorted_scores;
-  for (pfi::data::unordered_map<uint64_t, float>::const_iterator it = i_scores.begin(); it != i_scores.end(); ++it){
-    float norm = calc_columnl2norm(it->first);
-    float normed_score = (norm != 0.f) ? it->second / norm / query_norm : 0.f;
-    sorted_scores.push_back(make_pair(normed_score, it->first));
+  const uint64_t num_columns = column2id_.size();
+  uint64_t partition_num = min(partition_num_, max<uint64_t>(1, num_columns / MIN_PARTITION_SIZE));
+  vector<vector<scored_column> > tops(partition_num);
+  vector<common::thread_pool::task_t> tasks;
+  for (uint64_t p = 0; p < partition_num; ++p){
+    score_task task = {
+      this, &query, &terms, &sq_prefix, query_norm, ret_num,
+      num_columns * p / partition_num, num_columns * (p + 1) / partition_num,
+      &tops[p]
+    };
+    tasks.push_back(task);
   }
-  sort(sorted_scores.rbegin(), sorted_scores.rend());
-  for (size_t i = 0; i < sorted_scores.size() && i < ret_num; ++i){
-    scores.push_back(make_pair(column2id_.get_key(sorted_scores[i].second), sorted_scores[i].first));
+  if (partition_num == 1){
+    tasks[0]();
+  } else {
+    common::thread_pool::get_shared().run(tasks);
   }
-}
 
-float inverted_index_storage::calc_l2norm(const sfv_t& sfv){
-  float ret = 0.f;
-  for (size_t i = 0; i < sfv.size(); ++i){
-    ret +=  sfv[i].second * sfv[i].second;
+  vector<scored_column> top;
+  for (uint64_t p = 0; p < partition_num; ++p){
+    top.insert(top.end(), tops[p].begin(), tops[p].end());
+  }
+  sort(top.rbegin(), top.rend());
+  if (top.size() > ret_num){
+    top.resize(ret_num);
+  }
+  for (size_t i = 0; i < top.size(); ++i){
+    scores.push_back(make_pair(column2id_.get_key(top[i].second), top[i].first));
   }
-  return sqrt(ret);
 }
 
 float inverted_index_storage::calc_columnl2norm(uint64_t column_id) const{
-  float ret = 0.f;
-  imap_float_t::const_iterator it_diff = column2norm_diff_.find(column_id);
-  if (it_diff != column2norm_diff_.end()) {
-    ret += it_diff->second;
+  if (column_id >= column2norm_.size()){
+    return 0.f;
   }
-  imap_float_t::const_iterator it = column2norm_.find(column_id);
-  if (it != column2norm_.end()){
-    ret += it->second;
+  float ret = 0.f;
+  size_t index = norm_diff_index_[column_id];
+  if (index != 0){
+    ret += column2norm_diff_[index - 1].second;
   }
+  ret += column2norm_[column_id];
   return sqrt(ret);
 }
 
-void inverted_index_storage::add_inp_scores(const std::string& row, 
-                                            float val, 
-                                            pfi::data::unordered_map<uint64_t, float>& scores) const{
-  tbl_t::const_iterator it_diff = inv_diff_.find(row);
-  if (it_diff != inv_diff_.end()){
-    const row_t& row_v = it_diff->second;
-    for (row_t::const_iterator row_it = row_v.begin(); row_it != row_v.end(); ++row_it){
-      scores[row_it->first] += row_it->second * val;
-    }
+void inverted_index_storage::get_tables(tbl_t& inv, tbl_t& inv_diff) const{
+  vector<posting_list::entry_t> entries;
+  for (posting_tbl_t::const_iterator it = inv_.begin(); it != inv_.end(); ++it){
+    it->second.get_all(entries);
+    row_t& row = inv[it->first];
+    row.insert(entries.begin(), entries.end());
   }
 
-  tbl_t::const_iterator it = inv_.find(row);
-  if (it != inv_.end()){
-    const row_t& row_v = it->second;
-    if (it_diff == inv_diff_.end()){
-      for (row_t::const_iterator row_it = row_v.begin(); row_it != row_v.end(); ++row_it){
-        scores[row_it->first] += row_it->second * val;
-      }
-    } else {
-      const row_t& row_diff_v = it_diff->second;
-      for (row_t::const_iterator row_it = row_v.begin(); row_it != row_v.end(); ++row_it){
-        if (row_diff_v.find(row_it->first) == row_diff_v.end()){
-          scores[row_it->first] += row_it->second * val;
-        }
+  for (diff_tbl_t::const_iterator it = inv_diff_.begin(); it != inv_diff_.end(); ++it){
+    posting_tbl_t::const_iterator it_row = inv_.find(it->first);
+    row_t& row = inv_diff[it->first];
+    for (size_t i = 0; i < it->second.size(); ++i){
+      float val = 0.f;
+      if (it_row != inv_.end()){
+        it_row->second.get(it->second[i], val);
       }
+      row[it->second[i]] = val;
     }
   }
 }
 
+void inverted_index_storage::set_tables(const tbl_t& inv, const tbl_t& inv_diff){
+  inv_.clear();
+  inv_diff_.clear();
 
+  vector<posting_list::entry_t> entries;
+  for (tbl_t::const_iterator it = inv.begin(); it != inv.end(); ++it){
+    // values in diffs have priority
+    tbl_t::const_iterator it_diff = inv_diff.find(it->first);
+    entries.clear();
+    for (row_t::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2){
+      if (it_diff == inv_diff.end()
+          || it_diff->second.find(it2->first) == it_diff->second.end()){
+        entries.push_back(*it2);
+      }
+    }
+    if (!entries.empty()){
+      sort(entries.begin(), entries.end());
+      inv_[it->first].assign(entries);
+    }
+  }
 
+  for (tbl_t::const_iterator it = inv_diff.begin(); it != inv_diff.end(); ++it){
+    vector<uint64_t>& diff_columns = inv_diff_[it->first];
+    for (row_t::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2){
+      diff_columns.push_back(it2->first);
+      if (it2->second != 0.f){
+        inv_[it->first].set(it2->first, it2->second);
+      }
+    }
+    posting_tbl_t::iterator it_row = inv_.find(it->first);
+    if (it_row != inv_.end()){
+      it_row->second.flush();
+    }
+  }
+}
 
 std::string inverted_index_storage::name() const{
   return string("inverted_index_storage");
@@ -305,5 +594,30 @@ std::string inverted_index_storage::name() const{
 
 
 
+void inverted_index_storage::get_norms(imap_float_t& norm, imap_float_t& norm_diff) const{
+  for (uint64_t id = 0; id < column2norm_.size(); ++id){
+    if (column2norm_[id] != 0.f){
+      norm[id] = column2norm_[id];
+    }
+  }
+  norm_diff.insert(column2norm_diff_.begin(), column2norm_diff_.end());
+}
+
+void inverted_index_storage::set_norms(const imap_float_t& norm, const imap_float_t& norm_diff){
+  column2norm_.clear();
+  column2norm_diff_.clear();
+  norm_diff_index_.clear();
+  if (column2id_.size() > 0){
+    reserve_columns(column2id_.size() - 1);
+  }
+  for (imap_float_t::const_iterator it = norm.begin(); it != norm.end(); ++it){
+    reserve_columns(it->first);
+    column2norm_[it->first] = it->second;
+  }
+  for (imap_float_t::const_iterator it = norm_diff.begin(); it != norm_diff.end(); ++it){
+    add_norm_diff(it->first, it->second);
+  }
+}
+
 }
 }
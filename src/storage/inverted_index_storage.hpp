@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <utility>
+#include <vector>
 #include <pficommon/data/serialization.h>
 #include <pficommon/data/serialization/unordered_map.h>
 #include <pficommon/data/unordered_map.h>
@@ -24,6 +26,7 @@
 #include "../common/type.hpp"
 #include "../common/key_manager.hpp"
 #include "index_storage.hpp"
+#include "posting_list.hpp"
 #include "sparse_matrix_storage.hpp"
 #include "recommender_storage_base.hpp"
 
@@ -33,6 +36,8 @@ namespace storage{
 class inverted_index_storage : public recommender_storage_base{
 public:
   inverted_index_storage();
+  // calc_scores runs in up to partition_num tasks on the shared thread pool
+  explicit inverted_index_storage(uint64_t partition_num);
   ~inverted_index_storage();
 
   void set(const std::string& row, const std::string& column, float val); 
@@ -53,29 +58,59 @@ public:
   bool load(std::istream& is);
 
 private:
-  static float calc_l2norm(const sfv_t& sfv);
+  struct score_task;
+  friend struct score_task;
+
+  // columns which have a value in each row
+  typedef pfi::data::unordered_map<std::string, posting_list> posting_tbl_t;
+  // columns updated in each row since the last mix, which may be duplicated
+  typedef pfi::data::unordered_map<std::string, std::vector<uint64_t> > diff_tbl_t;
+
   float calc_columnl2norm(uint64_t column_id) const;
-  float get_from_tbl(const std::string& row, uint64_t column_id, const tbl_t& tbl, bool& exist) const;
+  void add_diff(const std::string& row, uint64_t column_id);
+  void add_norm_diff(uint64_t column_id, float diff);
+  void reserve_columns(uint64_t column_id);
+  void clear_norm_diff();
+
+  // The model file keeps norms in maps from column ids as before.
+  void get_norms(imap_float_t& norm, imap_float_t& norm_diff) const;
+  void set_norms(const imap_float_t& norm, const imap_float_t& norm_diff);
+
+  // The model file keeps the tables of mixed values and diffs as before.
+  void get_tables(tbl_t& inv, tbl_t& inv_diff) const;
+  void set_tables(const tbl_t& inv, const tbl_t& inv_diff);
 
   friend class pfi::data::serialization::access;
   template <class Ar>
   void serialize(Ar& ar) {
-    ar & MEMBER(inv_)
-       & MEMBER(inv_diff_)
-       & MEMBER(column2norm_)
-       & MEMBER(column2norm_diff_)
+    tbl_t inv, inv_diff;
+    imap_float_t norm, norm_diff;
+    if (!ar.is_read) {
+      get_tables(inv, inv_diff);
+      get_norms(norm, norm_diff);
+    }
+    ar & NAMED_MEMBER("inv_", inv)
+       & NAMED_MEMBER("inv_diff_", inv_diff)
+       & NAMED_MEMBER("column2norm_", norm)
+       & NAMED_MEMBER("column2norm_diff_", norm_diff)
        & MEMBER(column2id_);
-
+    if (ar.is_read) {
+      set_tables(inv, inv_diff);
+      set_norms(norm, norm_diff);
+    }
   }
 
-  void add_inp_scores(const std::string& row, float val, 
-                      pfi::data::unordered_map<uint64_t, float>& scores) const;
-  
-  tbl_t inv_;
-  tbl_t inv_diff_;
-  imap_float_t column2norm_;
-  imap_float_t column2norm_diff_;
+  // current values, including ones not mixed yet
+  posting_tbl_t inv_;
+  diff_tbl_t inv_diff_;
+  // squared norms of columns indexed by column id
+  std::vector<float> column2norm_;
+  // updates of squared norms since the last mix, and the position of each
+  // column in it plus one (0 for columns not updated)
+  std::vector<std::pair<uint64_t, float> > column2norm_diff_;
+  std::vector<size_t> norm_diff_index_;
   key_manager column2id_;
+  uint64_t partition_num_;
 };
 
 }
@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <map>
+#include <pficommon/lang/cast.h>
 #include "inverted_index_storage.hpp"
 
 namespace jubatus {
@@ -53,6 +57,215 @@ TEST(inverted_index_storage, trivial) {
   EXPECT_EQ("r2", scores2[2].first);
 }
 
+TEST(inverted_index_storage, top_k) {
+  inverted_index_storage s;
+  srand(1);
+  for (int step = 0; step < 2; ++step) {
+    for (int i = 0; i < 3000; ++i) {
+      // rows with small ids are popular
+      int row = rand() % (1 + rand() % 40);
+      int column = rand() % 300;
+      float val = (rand() % 100 + 1) / 10.f;
+      s.set("c" + pfi::lang::lexical_cast<string>(row),
+            "r" + pfi::lang::lexical_cast<string>(column), val);
+    }
+    // move the current values to the mixed table
+    string diff;
+    s.get_diff(diff);
+    s.set_mixed_and_clear_diff(diff);
+  }
+  s.set("c1", "r10", 0.5f);
+
+  for (int n = 0; n < 20; ++n) {
+    sfv_t v;
+    for (int i = 0; i < 10; ++i) {
+      int row = rand() % 45;
+      v.push_back(make_pair("c" + pfi::lang::lexical_cast<string>(row),
+                            (rand() % 100 + 1) / 10.f));
+    }
+
+    // all columns sharing a row with the query
+    vector<pair<string, float> > all;
+    s.calc_scores(v, all, 100000);
+    ASSERT_LT(0u, all.size());
+    for (size_t i = 1; i < all.size(); ++i) {
+      EXPECT_GE(all[i - 1].second, all[i].second);
+    }
+
+    const size_t ks[] = {1, 3, 10, 50};
+    for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i) {
+      vector<pair<string, float> > top;
+      s.calc_scores(v, top, ks[i]);
+      ASSERT_EQ(min(ks[i], all.size()), top.size());
+      for (size_t j = 0; j < top.size(); ++j) {
+        EXPECT_EQ(all[j].first, top[j].first);
+        EXPECT_EQ(all[j].second, top[j].second);
+      }
+    }
+  }
+}
+
+TEST(inverted_index_storage, partitions) {
+  // columns are scored in 4 partitions
+  inverted_index_storage s1, s4(4);
+  srand(1);
+  for (int i = 0; i < 50000; ++i) {
+    string row = "c" + pfi::lang::lexical_cast<string>(rand() % 20);
+    string column = "r" + pfi::lang::lexical_cast<string>(rand() % 20000);
+    float val = (rand() % 100 + 1) / 10.f;
+    s1.set(row, column, val);
+    s4.set(row, column, val);
+  }
+
+  for (int n = 0; n < 10; ++n) {
+    sfv_t v;
+    for (int i = 0; i < 5; ++i) {
+      v.push_back(make_pair("c" + pfi::lang::lexical_cast<string>(rand() % 20),
+                            (rand() % 100 + 1) / 10.f));
+    }
+    vector<pair<string, float> > expected, actual;
+    s1.calc_scores(v, expected, 20);
+    s4.calc_scores(v, actual, 20);
+    ASSERT_EQ(20u, actual.size());
+    EXPECT_TRUE(expected == actual);
+  }
+}
+
+TEST(inverted_index_storage, top_k_removed) {
+  inverted_index_storage s;
+  s.set("c1", "r1", 1);
+  s.set("c1", "r2", 1);
+  s.set("c2", "r2", 1);
+  s.remove("c1", "r1");
+
+  sfv_t v;
+  v.push_back(make_pair("c1", 1.0));
+  v.push_back(make_pair("c1", 1.0));
+
+  vector<pair<string, float> > scores;
+  s.calc_scores(v, scores, 1);
+  ASSERT_EQ(1u, scores.size());
+  EXPECT_EQ("r2", scores[0].first);
+  EXPECT_FLOAT_EQ(2.0 / sqrt(2) / sqrt(2), scores[0].second);
+
+  // removed values are erased after mix
+  string diff;
+  s.get_diff(diff);
+  s.set_mixed_and_clear_diff(diff);
+  scores.clear();
+  s.calc_scores(v, scores, 10);
+  ASSERT_EQ(1u, scores.size());
+  EXPECT_EQ("r2", scores[0].first);
+}
+
+TEST(inverted_index_storage, deserialize) {
+  inverted_index_storage s;
+  s.set("c1", "r1", 1);
+  s.set("c2", "r1", 1);
+  s.set("c1", "r2", 1);
+
+  // the storage is deserialized directly, without load()
+  stringstream ss;
+  {
+    pfi::data::serialization::binary_oarchive oa(ss);
+    oa << s;
+  }
+  inverted_index_storage s2;
+  {
+    pfi::data::serialization::binary_iarchive ia(ss);
+    ia >> s2;
+  }
+
+  sfv_t v;
+  v.push_back(make_pair("c1", 1.0));
+  vector<pair<string, float> > scores;
+  s2.calc_scores(v, scores, 10);
+  ASSERT_EQ(2u, scores.size());
+  EXPECT_EQ("r2", scores[0].first);
+  EXPECT_FLOAT_EQ(1.0, scores[0].second);
+  EXPECT_EQ("r1", scores[1].first);
+  EXPECT_FLOAT_EQ(1.0 / sqrt(2), scores[1].second);
+}
+
+TEST(inverted_index_storage, save_load_diff) {
+  inverted_index_storage s;
+  s.set("c1", "r1", 1);
+  s.set("c1", "r2", 2);
+  string diff;
+  s.get_diff(diff);
+  s.set_mixed_and_clear_diff(diff);
+
+  // not mixed yet
+  s.set("c1", "r2", 3);
+  s.set("c2", "r1", 4);
+  s.remove("c1", "r1");
+
+  stringstream ss;
+  s.save(ss);
+  inverted_index_storage t;
+  t.load(ss);
+
+  EXPECT_EQ(0.0, t.get("c1", "r1"));
+  EXPECT_EQ(3.0, t.get("c1", "r2"));
+  EXPECT_EQ(4.0, t.get("c2", "r1"));
+
+  // the diff is kept, including the removed value
+  inverted_index_storage u;
+  u.set("c1", "r1", 5);
+  string d1, d2;
+  s.get_diff(d1);
+  t.get_diff(d2);
+  EXPECT_EQ(d1.size(), d2.size());
+  u.set_mixed_and_clear_diff(d2);
+  EXPECT_EQ(0.0, u.get("c1", "r1"));
+  EXPECT_EQ(3.0, u.get("c1", "r2"));
+  EXPECT_EQ(4.0, u.get("c2", "r1"));
+}
+
+TEST(inverted_index_storage, all_column_ids) {
+  inverted_index_storage s;
+  s.set("c1", "r1", 1);
+  s.set("c1", "r2", 2);
+  s.set("c2", "r3", 3);
+  string diff;
+  s.get_diff(diff);
+  s.set_mixed_and_clear_diff(diff);
+
+  s.remove("c2", "r3");
+  s.set("c2", "r4", 4);
+
+  vector<string> ids;
+  s.get_all_column_ids(ids);
+  sort(ids.begin(), ids.end());
+  ASSERT_EQ(4u, ids.size());
+  EXPECT_EQ("r1", ids[0]);
+  EXPECT_EQ("r3", ids[2]);
+  EXPECT_EQ("r4", ids[3]);
+
+  // the column whose norm became 0 is dropped at mix
+  s.get_diff(diff);
+  s.set_mixed_and_clear_diff(diff);
+  s.get_all_column_ids(ids);
+  sort(ids.begin(), ids.end());
+  ASSERT_EQ(3u, ids.size());
+  EXPECT_EQ("r4", ids[2]);
+
+  stringstream ss;
+  s.save(ss);
+  inverted_index_storage t;
+  t.load(ss);
+  t.get_all_column_ids(ids);
+  EXPECT_EQ(3u, ids.size());
+
+  sfv_t q;
+  q.push_back(make_pair("c2", 1.0));
+  vector<pair<string, float> > scores;
+  t.calc_scores(q, scores, 10);
+  ASSERT_EQ(1u, scores.size());
+  EXPECT_EQ("r4", scores[0].first);
+  EXPECT_FLOAT_EQ(1.0, scores[0].second);
+}
+
 TEST(inverted_index_storage, diff) {
   inverted_index_storage s;
   // r1: (1, 1, 0, 0, 0)
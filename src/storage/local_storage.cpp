@@ -41,6 +41,16 @@ local_storage::~local_storage()
 void local_storage::get(const string& feature, feature_val1_t& ret)
 {
   ret.clear();
+  size_t index;
+  if (dense_.find(feature, index)) {
+    for (size_t c = 0; c < dense_.num_rows(); ++c) {
+      const vector<float>& row = dense_.row(c);
+      if (!row.empty()) {
+        ret.push_back(make_pair(class2id_.get_key(c), row[index]));
+      }
+    }
+    return;
+  }
   id_features3_t::const_iterator cit = tbl_.find(feature);
   if (cit == tbl_.end()){
     return ;
@@ -54,6 +64,16 @@ void local_storage::get(const string& feature, feature_val1_t& ret)
 void local_storage::get2(const string& feature, feature_val2_t& ret)
 {
   ret.clear();
+  size_t index;
+  if (dense_.find(feature, index)) {
+    for (size_t c = 0; c < dense_.num_rows(); ++c) {
+      const vector<float>& row = dense_.row(c);
+      if (!row.empty()) {
+        ret.push_back(make_pair(class2id_.get_key(c), val2_t(row[index], 0)));
+      }
+    }
+    return;
+  }
   id_features3_t::const_iterator cit = tbl_.find(feature);
   if (cit == tbl_.end()){
     return ;
@@ -67,6 +87,16 @@ void local_storage::get2(const string& feature, feature_val2_t& ret)
 void local_storage::get3(const string& feature, feature_val3_t& ret)
 {
   ret.clear();
+  size_t index;
+  if (dense_.find(feature, index)) {
+    for (size_t c = 0; c < dense_.num_rows(); ++c) {
+      const vector<float>& row = dense_.row(c);
+      if (!row.empty()) {
+        ret.push_back(make_pair(class2id_.get_key(c), val3_t(row[index], 0, 0)));
+      }
+    }
+    return;
+  }
   id_features3_t::const_iterator cit = tbl_.find(feature);
   if (cit == tbl_.end()){
     return ;
@@ -78,9 +108,19 @@ void local_storage::get3(const string& feature, feature_val3_t& ret)
 }
 
 void local_storage::inp(const sfv_t& sfv, map_feature_val1_t& ret) {
-  ret.clear();
-  
   std::vector<float> ret_id(class2id_.size());
+  inp_by_id(sfv, ret_id);
+  make_inp_result(ret_id, ret);
+}
+
+void local_storage::inp_dense(const sfv_t& sfv, const vector<float>& dense, map_feature_val1_t& ret) {
+  std::vector<float> ret_id(class2id_.size());
+  inp_by_id(sfv, ret_id);
+  dense_.inp(dense, ret_id);
+  make_inp_result(ret_id, ret);
+}
+
+void local_storage::inp_by_id(const sfv_t& sfv, std::vector<float>& ret_id) const {
   for (sfv_t::const_iterator it = sfv.begin(); it != sfv.end(); ++it){
     const string& feature = it->first;
     const float val = it->second;
@@ -91,7 +131,10 @@ void local_storage::inp(const sfv_t& sfv, map_feature_val1_t& ret) {
       ret_id[it3->first] += it3->second.v1 * val;
     }
   }
-  
+}
+
+void local_storage::make_inp_result(const std::vector<float>& ret_id, map_feature_val1_t& ret) const {
+  ret.clear();
   for (size_t i = 0; i < ret_id.size(); ++i){
     if (ret_id[i] == 0.f) continue;
     ret[class2id_.get_key(i)] = ret_id[i];
@@ -100,11 +143,21 @@ void local_storage::inp(const sfv_t& sfv, map_feature_val1_t& ret) {
 
 void local_storage::set(const string &feature, const string& klass, const val1_t& w)
 {
+  size_t index;
+  if (dense_.find(feature, index)) {
+    dense_.mutable_row(class2id_.get_id(klass))[index] = w;
+    return;
+  }
   tbl_[feature][class2id_.get_id(klass)].v1 = w;
 }
 
 void local_storage::set2(const string &feature, const string& klass, const val2_t& w)
 {
+  size_t index;
+  if (dense_.find(feature, index)) {
+    dense_.mutable_row(class2id_.get_id(klass))[index] = w.v1;
+    return;
+  }
   val3_t& val3 = tbl_[feature][class2id_.get_id(klass)];
   val3.v1 = w.v1;
   val3.v2 = w.v2;
@@ -112,12 +165,18 @@ void local_storage::set2(const string &feature, const string& klass, const val2_
 
 void local_storage::set3(const string &feature, const string& klass, const val3_t& w)
 {
+  size_t index;
+  if (dense_.find(feature, index)) {
+    dense_.mutable_row(class2id_.get_id(klass))[index] = w.v1;
+    return;
+  }
   tbl_[feature][class2id_.get_id(klass)] = w;
 }
 
 void local_storage::get_status(std::map<string,std::string>& status){
   status["num_features"] = pfi::lang::lexical_cast<std::string>(tbl_.size());
   status["num_classes"] = pfi::lang::lexical_cast<std::string>(class2id_.size());
+  status["num_dense_features"] = pfi::lang::lexical_cast<std::string>(dense_.size());
 }
 
 float feature_fabssum(const id_feature_val3_t& f){
@@ -147,21 +206,73 @@ void local_storage::bulk_update(const sfv_t& sfv, float step_width, const string
   }
 }
 
+void local_storage::bulk_update_dense(const sfv_t& sfv, const vector<float>& dense, float step_width, const string& inc_class, const string& dec_class){
+  bulk_update(sfv, step_width, inc_class, dec_class);
+  dense_.add(class2id_.get_id(inc_class), step_width, dense);
+  if (dec_class != ""){
+    dense_.add(class2id_.get_id(dec_class), -step_width, dense);
+  }
+}
+
 void local_storage::update(const string &feature, const string& inc_class, const string& dec_class, const val1_t& v) {
+  size_t index;
+  if (dense_.find(feature, index)) {
+    dense_.mutable_row(class2id_.get_id(inc_class))[index] += v;
+    dense_.mutable_row(class2id_.get_id(dec_class))[index] -= v;
+    return;
+  }
   id_feature_val3_t& feature_row = tbl_[feature];
   feature_row[class2id_.get_id(inc_class)].v1 += v;
   feature_row[class2id_.get_id(dec_class)].v1 -= v;
 }
 
+void local_storage::set_dense_features(const vector<string>& features) {
+  fold_dense();
+  dense_.set_features(features);
+  extract_dense();
+}
+
+void local_storage::fold_dense() {
+  const vector<string>& features = dense_.features();
+  for (size_t c = 0; c < dense_.num_rows(); ++c) {
+    const vector<float>& row = dense_.row(c);
+    for (size_t i = 0; i < row.size(); ++i) {
+      if (row[i] != 0.f) {
+        tbl_[features[i]][c].v1 = row[i];
+      }
+    }
+  }
+  dense_.clear_rows();
+}
+
+void local_storage::extract_dense() {
+  const vector<string>& features = dense_.features();
+  for (size_t i = 0; i < features.size(); ++i) {
+    id_features3_t::iterator it = tbl_.find(features[i]);
+    if (it == tbl_.end()) {
+      continue;
+    }
+    for (id_feature_val3_t::const_iterator it2 = it->second.begin();
+         it2 != it->second.end(); ++it2) {
+      dense_.mutable_row(it2->first)[i] = it2->second.v1;
+    }
+    tbl_.erase(it);
+  }
+}
+
 bool local_storage::save(std::ostream& os) {
+  fold_dense();
   pfi::data::serialization::binary_oarchive oa(os);
   oa << *this;
+  extract_dense();
   return true;
 }
 
 bool local_storage::load(std::istream& is){
   pfi::data::serialization::binary_iarchive ia(is);
   ia >> *this;
+  dense_.clear_rows();
+  extract_dense();
   return true;
 }
 
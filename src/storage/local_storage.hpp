@@ -21,6 +21,7 @@
 #include <pficommon/data/serialization/unordered_map.h>
 #include <pficommon/data/unordered_map.h>
 #include "storage_base.hpp"
+#include "dense_weights.hpp"
 #include "../common/key_manager.hpp"
 
 namespace jubatus {
@@ -51,14 +52,26 @@ public:
   void update(const std::string &feature, const std::string& inc_class, const std::string& dec_class, const val1_t& v);
   void bulk_update(const sfv_t& sfv, float step_width, const std::string& inc_class, const std::string& dec_class);
 
+  void set_dense_features(const std::vector<std::string>& features);
+  void inp_dense(const sfv_t& sfv, const std::vector<float>& dense, map_feature_val1_t& ret);
+  void bulk_update_dense(const sfv_t& sfv, const std::vector<float>& dense, float step_width, const std::string& inc_class, const std::string& dec_class);
+
   bool save(std::ostream&);
   bool load(std::istream&);
   std::string type()const;
 
 protected:
+  void inp_by_id(const sfv_t& sfv, std::vector<float>& ret_id) const;
+  void make_inp_result(const std::vector<float>& ret_id, map_feature_val1_t& ret) const;
+
+  // dense weights are stored in tbl_ while the storage is serialized
+  void fold_dense();
+  void extract_dense();
+
   //map_features3_t tbl_;
   id_features3_t tbl_;
   key_manager class2id_;
+  dense_weights dense_;
 
 protected:
   friend class pfi::data::serialization::access;
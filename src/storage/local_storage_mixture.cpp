@@ -44,6 +44,17 @@ local_storage_mixture::~local_storage_mixture()
 
 bool local_storage_mixture::get_internal(const string& feature, id_feature_val3_t& ret) const{
   ret.clear();
+  size_t index;
+  if (dense_.find(feature, index)) {
+    for (size_t c = 0; c < dense_.num_rows(); ++c) {
+      const vector<float>& row = dense_.row(c);
+      if (!row.empty()) {
+        ret[c] = val3_t(row[index], 0, 0);
+      }
+    }
+    return !ret.empty();
+  }
+
   id_features3_t::const_iterator it = tbl_.find(feature);
 
   bool found = false;
@@ -92,9 +103,19 @@ void local_storage_mixture::get3(const std::string &feature, feature_val3_t& ret
 }
 
 void local_storage_mixture::inp(const sfv_t& sfv, map_feature_val1_t& ret) {
-  ret.clear();
-  
   std::vector<float> ret_id(class2id_.size());
+  inp_by_id(sfv, ret_id);
+  make_inp_result(ret_id, ret);
+}
+
+void local_storage_mixture::inp_dense(const sfv_t& sfv, const vector<float>& dense, map_feature_val1_t& ret) {
+  std::vector<float> ret_id(class2id_.size());
+  inp_by_id(sfv, ret_id);
+  dense_.inp(dense, ret_id);
+  make_inp_result(ret_id, ret);
+}
+
+void local_storage_mixture::inp_by_id(const sfv_t& sfv, std::vector<float>& ret_id) const {
   for (sfv_t::const_iterator it = sfv.begin(); it != sfv.end(); ++it){
     const string& feature = it->first;
     const float val = it->second;
@@ -104,7 +125,10 @@ void local_storage_mixture::inp(const sfv_t& sfv, map_feature_val1_t& ret) {
       ret_id[it3->first] += it3->second.v1 * val;
     }
   }
-  
+}
+
+void local_storage_mixture::make_inp_result(const std::vector<float>& ret_id, map_feature_val1_t& ret) const {
+  ret.clear();
   for (size_t i = 0; i < ret_id.size(); ++i){
     if (ret_id[i] == 0.f) continue;
     ret[class2id_.get_key(i)] = ret_id[i];
@@ -113,9 +137,21 @@ void local_storage_mixture::inp(const sfv_t& sfv, map_feature_val1_t& ret) {
 
 
 
+void local_storage_mixture::set_dense(size_t index, uint64_t class_id, float w)
+{
+  float& current = dense_.mutable_row(class_id)[index];
+  dense_diff_.mutable_row(class_id)[index] += w - current;
+  current = w;
+}
+
 void local_storage_mixture::set(const string &feature, const string& klass, const val1_t& w)
 {
   uint64_t class_id = class2id_.get_id(klass);
+  size_t index;
+  if (dense_.find(feature, index)) {
+    set_dense(index, class_id, w);
+    return;
+  }
   float w_in_table = tbl_[feature][class_id].v1;
   tbl_diff_[feature][class_id].v1 = w - w_in_table;
 }
@@ -123,6 +159,11 @@ void local_storage_mixture::set(const string &feature, const string& klass, cons
 void local_storage_mixture::set2(const string &feature, const string& klass, const val2_t& w)
 {
   uint64_t class_id = class2id_.get_id(klass);
+  size_t index;
+  if (dense_.find(feature, index)) {
+    set_dense(index, class_id, w.v1);
+    return;
+  }
   float w1_in_table = tbl_[feature][class_id].v1;
   float w2_in_table = tbl_[feature][class_id].v2;
   
@@ -134,6 +175,11 @@ void local_storage_mixture::set2(const string &feature, const string& klass, con
 void local_storage_mixture::set3(const string &feature, const string& klass, const val3_t& w)
 {
   uint64_t class_id = class2id_.get_id(klass);
+  size_t index;
+  if (dense_.find(feature, index)) {
+    set_dense(index, class_id, w.v1);
+    return;
+  }
   val3_t v = tbl_[feature][class_id];
   tbl_diff_[feature][class_id] = w - v;
 }
@@ -142,9 +188,20 @@ void local_storage_mixture::get_status(std::map<std::string,std::string>& status
   status["num_features"] = pfi::lang::lexical_cast<std::string>(tbl_.size());
   status["num_classes"] = pfi::lang::lexical_cast<std::string>(class2id_.size());
   status["diff_size"] = pfi::lang::lexical_cast<std::string>(tbl_diff_.size());
+  status["num_dense_features"] = pfi::lang::lexical_cast<std::string>(dense_.size());
 }
 
 void local_storage_mixture::update(const string &feature, const string& inc_class, const string& dec_class, const val1_t& v) {
+  size_t index;
+  if (dense_.find(feature, index)) {
+    uint64_t inc_id = class2id_.get_id(inc_class);
+    uint64_t dec_id = class2id_.get_id(dec_class);
+    dense_.mutable_row(inc_id)[index] += v;
+    dense_diff_.mutable_row(inc_id)[index] += v;
+    dense_.mutable_row(dec_id)[index] -= v;
+    dense_diff_.mutable_row(dec_id)[index] -= v;
+    return;
+  }
   id_feature_val3_t& feature_row = tbl_diff_[feature];
   feature_row[class2id_.get_id(inc_class)].v1 += v;
   feature_row[class2id_.get_id(dec_class)].v1 -= v;
@@ -169,6 +226,18 @@ void local_storage_mixture::bulk_update(const sfv_t& sfv, float step_width, cons
   }
 }
 
+void local_storage_mixture::bulk_update_dense(const sfv_t& sfv, const vector<float>& dense, float step_width, const string& inc_class, const string& dec_class){
+  bulk_update(sfv, step_width, inc_class, dec_class);
+
+  uint64_t inc_id = class2id_.get_id(inc_class);
+  dense_.add(inc_id, step_width, dense);
+  dense_diff_.add(inc_id, step_width, dense);
+  if (dec_class != ""){
+    uint64_t dec_id = class2id_.get_id(dec_class);
+    dense_.add(dec_id, -step_width, dense);
+    dense_diff_.add(dec_id, -step_width, dense);
+  }
+}
 
 void local_storage_mixture::get_diff(features3_t& ret) const {
   ret.clear();
@@ -180,12 +249,43 @@ void local_storage_mixture::get_diff(features3_t& ret) const {
     }
     ret.push_back(make_pair(it->first, fv3));
   }
+
+  // diff of dense features is mixed as ordinary features
+  const vector<string>& features = dense_diff_.features();
+  for (size_t i = 0; i < features.size() && dense_diff_.num_rows() > 0; ++i) {
+    feature_val3_t fv3;
+    for (size_t c = 0; c < dense_diff_.num_rows(); ++c) {
+      const vector<float>& row = dense_diff_.row(c);
+      if (!row.empty() && row[i] != 0.f) {
+        fv3.push_back(make_pair(class2id_.get_key(c), val3_t(row[i], 0, 0)));
+      }
+    }
+    if (!fv3.empty()) {
+      ret.push_back(make_pair(features[i], fv3));
+    }
+  }
 }
 
 void local_storage_mixture::set_average_and_clear_diff(const features3_t& average){
+  // revert dense weights to the mixed ones before adding the average
+  for (size_t c = 0; c < dense_diff_.num_rows(); ++c) {
+    const vector<float>& row = dense_diff_.row(c);
+    if (!row.empty()) {
+      dense_.add(c, -1.f, row);
+    }
+  }
+  dense_diff_.clear_rows();
+
   for (features3_t::const_iterator it =  average.begin();
        it != average.end(); ++it){
     const feature_val3_t& avg = it->second;
+    size_t index;
+    if (dense_.find(it->first, index)) {
+      for (feature_val3_t::const_iterator it2 = avg.begin(); it2 != avg.end(); ++it2){
+        dense_.mutable_row(class2id_.get_id(it2->first))[index] += it2->second.v1;
+      }
+      continue;
+    }
     id_feature_val3_t& orig = tbl_[it->first];
     for (feature_val3_t::const_iterator it2 = avg.begin(); it2 != avg.end(); ++it2){
       val3_t& triple = orig[class2id_.get_id(it2->first)]; // may create
@@ -195,15 +295,70 @@ void local_storage_mixture::set_average_and_clear_diff(const features3_t& averag
   tbl_diff_.clear();
 }
 
+void local_storage_mixture::set_dense_features(const vector<string>& features) {
+  fold_dense();
+  dense_.set_features(features);
+  dense_diff_.set_features(features);
+  extract_dense();
+}
+
+void local_storage_mixture::fold_dense() {
+  const vector<string>& features = dense_.features();
+  for (size_t c = 0; c < dense_.num_rows(); ++c) {
+    const vector<float>& row = dense_.row(c);
+    const vector<float>& diff = dense_diff_.row(c);
+    for (size_t i = 0; i < row.size(); ++i) {
+      float d = diff.empty() ? 0.f : diff[i];
+      if (row[i] != d) {
+        tbl_[features[i]][c].v1 = row[i] - d;
+      }
+      if (d != 0.f) {
+        tbl_diff_[features[i]][c].v1 = d;
+      }
+    }
+  }
+  dense_.clear_rows();
+  dense_diff_.clear_rows();
+}
+
+void local_storage_mixture::extract_dense() {
+  const vector<string>& features = dense_.features();
+  for (size_t i = 0; i < features.size(); ++i) {
+    id_features3_t::iterator it = tbl_.find(features[i]);
+    if (it != tbl_.end()) {
+      for (id_feature_val3_t::const_iterator it2 = it->second.begin();
+           it2 != it->second.end(); ++it2) {
+        dense_.mutable_row(it2->first)[i] += it2->second.v1;
+      }
+      tbl_.erase(it);
+    }
+
+    id_features3_t::iterator it_diff = tbl_diff_.find(features[i]);
+    if (it_diff != tbl_diff_.end()) {
+      for (id_feature_val3_t::const_iterator it2 = it_diff->second.begin();
+           it2 != it_diff->second.end(); ++it2) {
+        dense_.mutable_row(it2->first)[i] += it2->second.v1;
+        dense_diff_.mutable_row(it2->first)[i] += it2->second.v1;
+      }
+      tbl_diff_.erase(it_diff);
+    }
+  }
+}
+
 bool local_storage_mixture::save(std::ostream& os) {
+  fold_dense();
   pfi::data::serialization::binary_oarchive oa(os);
   oa << *this;
+  extract_dense();
   return true;
 }
 
 bool local_storage_mixture::load(std::istream& is){
   pfi::data::serialization::binary_iarchive ia(is);
   ia >> *this;
+  dense_.clear_rows();
+  dense_diff_.clear_rows();
+  extract_dense();
   return true;
 }
 std::string local_storage_mixture::type()const{
@@ -50,6 +50,10 @@ public:
 
   void bulk_update(const sfv_t& sfv, float step_width, const std::string& inc_class, const std::string& dec_class);
 
+  void set_dense_features(const std::vector<std::string>& features);
+  void inp_dense(const sfv_t& sfv, const std::vector<float>& dense, map_feature_val1_t& ret);
+  void bulk_update_dense(const sfv_t& sfv, const std::vector<float>& dense, float step_width, const std::string& inc_class, const std::string& dec_class);
+
   bool save(std::ostream& os);
   bool load(std::istream& is);
   std::string type()const;
@@ -63,10 +67,22 @@ private:
   }
 
   bool get_internal(const std::string& feature, id_feature_val3_t& ret) const;
+  void inp_by_id(const sfv_t& sfv, std::vector<float>& ret_id) const;
+  void make_inp_result(const std::vector<float>& ret_id, map_feature_val1_t& ret) const;
+  void set_dense(size_t index, uint64_t class_id, float w);
+
+  // dense weights are stored in tbl_ and tbl_diff_ while the storage is
+  // serialized
+  void fold_dense();
+  void extract_dense();
 
   id_features3_t tbl_;
   key_manager class2id_;
   id_features3_t tbl_diff_;
+
+  // current weights (mixed weights + diff) and diff of dense features
+  dense_weights dense_;
+  dense_weights dense_diff_;
 };
 
 }
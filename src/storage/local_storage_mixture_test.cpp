@@ -149,4 +149,59 @@ TEST(local_storage_mixture, get_diff) {
   }
 }
 
+TEST(local_storage_mixture, get_diff_dense) {
+  local_storage_mixture s;
+
+  vector<string> names;
+  names.push_back("d1");
+  names.push_back("d2");
+  s.set_dense_features(names);
+
+  vector<float> dense;
+  dense.push_back(1);
+  dense.push_back(0);
+  s.bulk_update_dense(sfv_t(), dense, 2, "x", "");
+
+  features3_t diff;
+  s.get_diff(diff);
+  ASSERT_EQ(1u, diff.size());
+  EXPECT_EQ("d1", diff[0].first);
+  ASSERT_EQ(1u, diff[0].second.size());
+  EXPECT_EQ("x", diff[0].second[0].first);
+  EXPECT_EQ(2, diff[0].second[0].second.v1);
+
+  // mixed diff from other servers
+  features3_t avg_diff;
+  feature_val3_t d1_diff;
+  d1_diff.push_back(make_pair("x", val3_t(3, 0, 0)));
+  avg_diff.push_back(make_pair("d1", d1_diff));
+  feature_val3_t d2_diff;
+  d2_diff.push_back(make_pair("y", val3_t(5, 0, 0)));
+  avg_diff.push_back(make_pair("d2", d2_diff));
+  s.set_average_and_clear_diff(avg_diff);
+
+  {
+    features3_t diff;
+    s.get_diff(diff);
+    EXPECT_EQ(0u, diff.size());
+  }
+
+  map_feature_val1_t scores;
+  dense[1] = 1;
+  s.inp_dense(sfv_t(), dense, scores);
+  EXPECT_EQ(3, scores["x"]);
+  EXPECT_EQ(5, scores["y"]);
+
+  // weights survive save and load
+  stringstream ss;
+  s.save(ss);
+  local_storage_mixture s2;
+  s2.load(ss);
+  s2.set_dense_features(names);
+  map_feature_val1_t scores2;
+  s2.inp_dense(sfv_t(), dense, scores2);
+  EXPECT_EQ(3, scores2["x"]);
+  EXPECT_EQ(5, scores2["y"]);
+}
+
 }
@@ -0,0 +1,409 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "posting_list.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace jubatus {
+namespace storage {
+
+namespace {
+
+// the update buffer is merged when it has more entries than this or than
+// 1/8 of the entries in the blocks
+const size_t MIN_BUFFER_SIZE = 32;
+
+uint32_t float_bits(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+bool is_byte_value(float f) {
+  if (!(f >= 0.f && f <= 255.f)) {
+    return false;
+  }
+  // compare bits to keep -0.f and fractions as they are
+  return float_bits(static_cast<float>(static_cast<uint8_t>(f))) == float_bits(f);
+}
+
+void write_varint(uint64_t v, vector<uint8_t>& out) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+uint64_t read_varint(const uint8_t*& p) {
+  uint64_t v = 0;
+  int shift = 0;
+  while (*p & 0x80) {
+    v |= static_cast<uint64_t>(*p & 0x7f) << shift;
+    shift += 7;
+    ++p;
+  }
+  v |= static_cast<uint64_t>(*p) << shift;
+  ++p;
+  return v;
+}
+
+bool less_entry_id(const posting_list::entry_t& e, uint64_t id) {
+  return e.first < id;
+}
+
+}
+
+posting_list::posting_list()
+    : num_block_entries_(0), size_(0) {
+}
+
+size_t posting_list::size() const {
+  return size_;
+}
+
+size_t posting_list::find_block(uint64_t id) const {
+  size_t lo = 0, hi = blocks_.size();
+  // find the first block whose first id is greater than the id
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (blocks_[mid].first_id <= id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo == 0 ? 0 : lo - 1;
+}
+
+bool posting_list::find_in_blocks(uint64_t id, float& value) const {
+  if (blocks_.empty()) {
+    return false;
+  }
+  size_t b = find_block(id);
+  const block& blk = blocks_[b];
+  if (id < blk.first_id) {
+    return false;
+  }
+
+  const uint8_t* values = &data_[blk.offset];
+  const size_t n = block_size(b);
+  const uint8_t* p = values;
+  if (blk.encoding == CONSTANT_VALUE) {
+    p += sizeof(float);
+  } else if (blk.encoding == BYTE_VALUE) {
+    p += n;
+  } else {
+    p += n * sizeof(float);
+  }
+
+  uint64_t current = blk.first_id;
+  for (size_t i = 0; i < n; ++i) {
+    if (i > 0) {
+      current += read_varint(p);
+    }
+    if (current > id) {
+      return false;
+    } else if (current == id) {
+      if (blk.encoding == CONSTANT_VALUE) {
+        memcpy(&value, values, sizeof(float));
+      } else if (blk.encoding == BYTE_VALUE) {
+        value = values[i];
+      } else {
+        memcpy(&value, values + i * sizeof(float), sizeof(float));
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void posting_list::decode_block(size_t b, vector<entry_t>& ret) const {
+  const block& blk = blocks_[b];
+  const size_t n = block_size(b);
+  ret.resize(n);
+
+  const uint8_t* p = &data_[blk.offset];
+  if (blk.encoding == CONSTANT_VALUE) {
+    float v;
+    memcpy(&v, p, sizeof(float));
+    p += sizeof(float);
+    for (size_t i = 0; i < n; ++i) {
+      ret[i].second = v;
+    }
+  } else if (blk.encoding == BYTE_VALUE) {
+    for (size_t i = 0; i < n; ++i) {
+      ret[i].second = *p++;
+    }
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      memcpy(&ret[i].second, p, sizeof(float));
+      p += sizeof(float);
+    }
+  }
+
+  uint64_t current = blk.first_id;
+  ret[0].first = current;
+  for (size_t i = 1; i < n; ++i) {
+    current += read_varint(p);
+    ret[i].first = current;
+  }
+}
+
+void posting_list::encode_block(const entry_t* entries, size_t n) {
+  block blk;
+  blk.first_id = entries[0].first;
+  blk.offset = static_cast<uint32_t>(data_.size());
+  blk.size_minus_one = static_cast<uint8_t>(n - 1);
+
+  bool constant = true;
+  bool bytes = true;
+  for (size_t i = 0; i < n; ++i) {
+    constant = constant
+        && float_bits(entries[i].second) == float_bits(entries[0].second);
+    bytes = bytes && is_byte_value(entries[i].second);
+  }
+
+  if (constant) {
+    blk.encoding = CONSTANT_VALUE;
+    uint32_t bits = float_bits(entries[0].second);
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(&bits);
+    data_.insert(data_.end(), b, b + sizeof(bits));
+  } else if (bytes) {
+    blk.encoding = BYTE_VALUE;
+    for (size_t i = 0; i < n; ++i) {
+      data_.push_back(static_cast<uint8_t>(entries[i].second));
+    }
+  } else {
+    blk.encoding = FLOAT_VALUE;
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t bits = float_bits(entries[i].second);
+      const uint8_t* b = reinterpret_cast<const uint8_t*>(&bits);
+      data_.insert(data_.end(), b, b + sizeof(bits));
+    }
+  }
+
+  for (size_t i = 1; i < n; ++i) {
+    write_varint(entries[i].first - entries[i - 1].first, data_);
+  }
+  blocks_.push_back(blk);
+}
+
+void posting_list::encode_blocks(const vector<entry_t>& entries) {
+  blocks_.clear();
+  data_.clear();
+  for (size_t i = 0; i < entries.size(); i += BLOCK_SIZE) {
+    encode_block(&entries[i], min(BLOCK_SIZE, entries.size() - i));
+  }
+  // release the capacity left by growth
+  vector<block>(blocks_).swap(blocks_);
+  vector<uint8_t>(data_).swap(data_);
+  num_block_entries_ = entries.size();
+}
+
+bool posting_list::get(uint64_t id, float& value) const {
+  update key;
+  key.id = id;
+  vector<update>::const_iterator it =
+      lower_bound(buffer_.begin(), buffer_.end(), key);
+  if (it != buffer_.end() && it->id == id) {
+    if (it->removed) {
+      return false;
+    }
+    value = it->value;
+    return true;
+  }
+  return find_in_blocks(id, value);
+}
+
+void posting_list::set(uint64_t id, float value) {
+  float current;
+  if (!get(id, current)) {
+    ++size_;
+  }
+  add_update(id, value, false);
+}
+
+void posting_list::remove(uint64_t id) {
+  float current;
+  if (!get(id, current)) {
+    return;
+  }
+  --size_;
+  if (find_in_blocks(id, current)) {
+    add_update(id, 0.f, true);
+  } else {
+    update key;
+    key.id = id;
+    buffer_.erase(lower_bound(buffer_.begin(), buffer_.end(), key));
+  }
+}
+
+void posting_list::add_update(uint64_t id, float value, bool removed) {
+  update u;
+  u.id = id;
+  u.value = value;
+  u.removed = removed;
+  vector<update>::iterator it = lower_bound(buffer_.begin(), buffer_.end(), u);
+  if (it != buffer_.end() && it->id == id) {
+    *it = u;
+  } else {
+    buffer_.insert(it, u);
+  }
+
+  if (buffer_.size() > max(MIN_BUFFER_SIZE, num_block_entries_ / 8)) {
+    flush();
+  }
+}
+
+void posting_list::flush() {
+  if (buffer_.empty()) {
+    return;
+  }
+  vector<entry_t> entries;
+  get_all(entries);
+  encode_blocks(entries);
+  vector<update>().swap(buffer_);
+}
+
+void posting_list::assign(const vector<entry_t>& sorted_entries) {
+  encode_blocks(sorted_entries);
+  vector<update>().swap(buffer_);
+  size_ = sorted_entries.size();
+}
+
+void posting_list::get_all(vector<entry_t>& ret) const {
+  ret.clear();
+  ret.reserve(size_);
+  for (cursor c(*this); !c.end(); c.next()) {
+    ret.push_back(make_pair(c.id(), c.value()));
+  }
+}
+
+size_t posting_list::memory_size() const {
+  return blocks_.capacity() * sizeof(block)
+      + data_.capacity()
+      + buffer_.capacity() * sizeof(update);
+}
+
+void posting_list::swap(posting_list& list) {
+  blocks_.swap(list.blocks_);
+  data_.swap(list.data_);
+  std::swap(num_block_entries_, list.num_block_entries_);
+  buffer_.swap(list.buffer_);
+  std::swap(size_, list.size_);
+}
+
+posting_list::cursor::cursor(const posting_list& list)
+    : list_(&list), block_(0), block_pos_(0), buffer_pos_(0),
+      end_(false), id_(0), value_(0.f) {
+  load_block(0);
+  settle();
+}
+
+void posting_list::cursor::load_block(size_t block) {
+  block_ = block;
+  block_pos_ = 0;
+  if (block_ < list_->blocks_.size()) {
+    list_->decode_block(block_, decoded_);
+  } else {
+    decoded_.clear();
+  }
+}
+
+void posting_list::cursor::advance_block() {
+  ++block_pos_;
+  if (block_pos_ == decoded_.size() && block_ < list_->blocks_.size()) {
+    load_block(block_ + 1);
+  }
+}
+
+void posting_list::cursor::seek_block(uint64_t id) {
+  if (block_pos_ < decoded_.size() && decoded_.back().first < id) {
+    // skip blocks without decoding them
+    size_t b = list_->find_block(id);
+    if (b > block_) {
+      load_block(b);
+    }
+  }
+  block_pos_ = lower_bound(decoded_.begin() + block_pos_, decoded_.end(),
+                           id, less_entry_id) - decoded_.begin();
+  if (block_pos_ == decoded_.size() && block_ < list_->blocks_.size()) {
+    load_block(block_ + 1);
+  }
+}
+
+void posting_list::cursor::settle() {
+  const vector<update>& buffer = list_->buffer_;
+  while (true) {
+    bool block_end = block_pos_ >= decoded_.size();
+    bool buffer_end = buffer_pos_ >= buffer.size();
+    if (block_end && buffer_end) {
+      end_ = true;
+      return;
+    }
+
+    if (!buffer_end
+        && (block_end || buffer[buffer_pos_].id <= decoded_[block_pos_].first)) {
+      const update& u = buffer[buffer_pos_];
+      if (!block_end && u.id == decoded_[block_pos_].first) {
+        // overridden by the update
+        advance_block();
+      }
+      if (u.removed) {
+        ++buffer_pos_;
+        continue;
+      }
+      id_ = u.id;
+      value_ = u.value;
+      from_buffer_ = true;
+    } else {
+      id_ = decoded_[block_pos_].first;
+      value_ = decoded_[block_pos_].second;
+      from_buffer_ = false;
+    }
+    return;
+  }
+}
+
+void posting_list::cursor::next() {
+  if (from_buffer_) {
+    ++buffer_pos_;
+  } else {
+    advance_block();
+  }
+  settle();
+}
+
+void posting_list::cursor::seek(uint64_t id) {
+  if (end_ || id_ >= id) {
+    return;
+  }
+  seek_block(id);
+  update key;
+  key.id = id;
+  buffer_pos_ = lower_bound(list_->buffer_.begin() + buffer_pos_,
+                            list_->buffer_.end(), key) - list_->buffer_.begin();
+  settle();
+}
+
+}
+}
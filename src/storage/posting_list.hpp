@@ -0,0 +1,153 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace jubatus {
+namespace storage {
+
+// A sorted list of (id, value) compressed in blocks.
+// In each block, ids are stored as varint-encoded deltas, and values are
+// stored losslessly in the smallest of three forms: a single value shared by
+// the block, one byte per value for small non-negative integers, or raw
+// floats. Updates are kept in a small sorted buffer which is merged into the
+// blocks when it grows or when flush() is called.
+class posting_list {
+ public:
+  typedef std::pair<uint64_t, float> entry_t;
+
+  // iterates the entries in the order of ids, merging the update buffer
+  class cursor {
+   public:
+    explicit cursor(const posting_list& list);
+
+    bool end() const {
+      return end_;
+    }
+
+    uint64_t id() const {
+      return id_;
+    }
+
+    float value() const {
+      return value_;
+    }
+
+    void next();
+
+    // moves to the first entry whose id is not less than the given one
+    void seek(uint64_t id);
+
+   private:
+    void load_block(size_t block);
+    void advance_block();
+    void seek_block(uint64_t id);
+    // skips removed entries and sets the current entry
+    void settle();
+
+    const posting_list* list_;
+    size_t block_;
+    size_t block_pos_;
+    std::vector<entry_t> decoded_;
+    size_t buffer_pos_;
+    bool end_;
+    bool from_buffer_;
+    uint64_t id_;
+    float value_;
+  };
+
+  posting_list();
+
+  // number of entries, including ones only in the update buffer
+  size_t size() const;
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  bool get(uint64_t id, float& value) const;
+  void set(uint64_t id, float value);
+  void remove(uint64_t id);
+
+  // merges the update buffer into the blocks
+  void flush();
+
+  // replaces all entries with sorted entries with unique ids
+  void assign(const std::vector<entry_t>& sorted_entries);
+
+  void get_all(std::vector<entry_t>& ret) const;
+
+  // bytes used by the blocks and the buffer
+  size_t memory_size() const;
+
+  void swap(posting_list& list);
+
+  static const size_t BLOCK_SIZE = 128;
+
+ private:
+  friend class cursor;
+
+  enum value_encoding {
+    CONSTANT_VALUE,
+    BYTE_VALUE,
+    FLOAT_VALUE
+  };
+
+  struct block {
+    uint64_t first_id;
+    uint32_t offset;
+    uint8_t size_minus_one;
+    uint8_t encoding;
+  };
+
+  struct update {
+    uint64_t id;
+    float value;
+    bool removed;
+
+    bool operator<(const update& u) const {
+      return id < u.id;
+    }
+  };
+
+  size_t block_size(size_t block) const {
+    return blocks_[block].size_minus_one + 1u;
+  }
+
+  // returns the last block whose first id is not greater than the id,
+  // or 0 if there is no such block
+  size_t find_block(uint64_t id) const;
+  bool find_in_blocks(uint64_t id, float& value) const;
+  void decode_block(size_t block, std::vector<entry_t>& ret) const;
+  void encode_blocks(const std::vector<entry_t>& entries);
+  void encode_block(const entry_t* entries, size_t size);
+  void add_update(uint64_t id, float value, bool removed);
+
+  std::vector<block> blocks_;
+  std::vector<uint8_t> data_;
+  size_t num_block_entries_;
+  std::vector<update> buffer_;  // sorted by id
+  size_t size_;
+};
+
+}
+}
@@ -0,0 +1,159 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2012 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <map>
+#include "posting_list.hpp"
+
+using namespace std;
+
+namespace jubatus {
+namespace storage {
+
+namespace {
+
+void expect_same(const map<uint64_t, float>& expect, const posting_list& list) {
+  ASSERT_EQ(expect.size(), list.size());
+  vector<posting_list::entry_t> all;
+  list.get_all(all);
+  ASSERT_EQ(expect.size(), all.size());
+  size_t i = 0;
+  for (map<uint64_t, float>::const_iterator it = expect.begin();
+       it != expect.end(); ++it, ++i) {
+    EXPECT_EQ(it->first, all[i].first);
+    EXPECT_EQ(it->second, all[i].second);
+
+    float v;
+    ASSERT_TRUE(list.get(it->first, v));
+    EXPECT_EQ(it->second, v);
+  }
+}
+
+}
+
+TEST(posting_list, empty) {
+  posting_list list;
+  EXPECT_TRUE(list.empty());
+  float v;
+  EXPECT_FALSE(list.get(0, v));
+  posting_list::cursor c(list);
+  EXPECT_TRUE(c.end());
+}
+
+TEST(posting_list, trivial) {
+  posting_list list;
+  list.set(10, 1.5f);
+  list.set(3, 2.f);
+  list.set(10, 3.f);
+  EXPECT_EQ(2u, list.size());
+
+  float v;
+  EXPECT_TRUE(list.get(10, v));
+  EXPECT_EQ(3.f, v);
+  EXPECT_FALSE(list.get(4, v));
+
+  list.flush();
+  list.remove(3);
+  list.remove(4);
+  EXPECT_EQ(1u, list.size());
+  EXPECT_FALSE(list.get(3, v));
+
+  posting_list::cursor c(list);
+  ASSERT_FALSE(c.end());
+  EXPECT_EQ(10u, c.id());
+  EXPECT_EQ(3.f, c.value());
+  c.next();
+  EXPECT_TRUE(c.end());
+}
+
+TEST(posting_list, encodings) {
+  const float values[] = {1.f, 255.f, 0.5f, -0.f, 1e10f};
+  for (size_t k = 0; k < sizeof(values) / sizeof(values[0]); ++k) {
+    map<uint64_t, float> expect;
+    posting_list list;
+    for (uint64_t i = 0; i < 1000; ++i) {
+      // constant, small integers, and arbitrary floats
+      float v = (i % 300 < 150) ? values[k] : (i % 7) * values[k];
+      expect[i * i] = v;
+      list.set(i * i, v);
+    }
+    list.flush();
+    expect_same(expect, list);
+  }
+}
+
+TEST(posting_list, random) {
+  srand(1);
+  map<uint64_t, float> expect;
+  posting_list list;
+  for (int i = 0; i < 20000; ++i) {
+    uint64_t id = rand() % 5000;
+    if (rand() % 4 == 0) {
+      expect.erase(id);
+      list.remove(id);
+    } else {
+      float v = rand() % 3 ? rand() % 4 : rand() / 1000.f;
+      expect[id] = v;
+      list.set(id, v);
+    }
+    if (i % 5000 == 0) {
+      expect_same(expect, list);
+    }
+  }
+  expect_same(expect, list);
+
+  // seek from every position
+  for (int n = 0; n < 200; ++n) {
+    uint64_t target = rand() % 5100;
+    posting_list::cursor c(list);
+    c.seek(target);
+    map<uint64_t, float>::const_iterator it = expect.lower_bound(target);
+    for (int j = 0; j < 3 && it != expect.end(); ++j, ++it) {
+      ASSERT_FALSE(c.end());
+      EXPECT_EQ(it->first, c.id());
+      EXPECT_EQ(it->second, c.value());
+      c.next();
+    }
+    if (it == expect.end()) {
+      EXPECT_TRUE(c.end());
+    }
+  }
+
+  list.flush();
+  expect_same(expect, list);
+}
+
+TEST(posting_list, assign) {
+  vector<posting_list::entry_t> entries;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    entries.push_back(make_pair(i * 3, 1.f));
+  }
+  posting_list list;
+  list.assign(entries);
+  EXPECT_EQ(1000u, list.size());
+
+  vector<posting_list::entry_t> all;
+  list.get_all(all);
+  EXPECT_TRUE(entries == all);
+
+  // small deltas and constant values take about a byte per entry
+  EXPECT_GT(1000u * 2, list.memory_size());
+}
+
+}
+}
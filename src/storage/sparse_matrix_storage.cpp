@@ -17,129 +17,341 @@
 
 #include <algorithm>
 #include <cmath>
-#include <pficommon/data/unordered_set.h>
 #include "sparse_matrix_storage.hpp"
+#include "../common/compaction.hpp"
+#include "../common/vector_util.hpp"
 
 using namespace std;
 
 namespace jubatus {
 namespace storage {
 
-sparse_matrix_storage::sparse_matrix_storage() {
+sparse_matrix_storage::sparse_matrix_storage()
+    : delta_size_(0), garbage_size_(0), removed_row_num_(0) {
 }
 
 sparse_matrix_storage::~sparse_matrix_storage(){
 }
 
 sparse_matrix_storage& sparse_matrix_storage::operator = (const sparse_matrix_storage& sms){
-  tbl_ = sms.tbl_;
+  row2id_ = sms.row2id_;
+  rows_ = sms.rows_;
+  column_ids_ = sms.column_ids_;
+  values_ = sms.values_;
+  delta_ = sms.delta_;
+  delta_size_ = sms.delta_size_;
+  garbage_size_ = sms.garbage_size_;
+  removed_row_num_ = sms.removed_row_num_;
   column2id_ = sms.column2id_;
   return *this;
 }
 
 void sparse_matrix_storage::set(const string& row, const string& column, float val){
-  tbl_[row][column2id_.get_id(column)] = val;
+  vector<pair<string, float> > columns(1, make_pair(column, val));
+  set_row(row, columns);
 }
 
 void sparse_matrix_storage::set_row(const string& row, const vector<pair<string, float> >& columns) {
-  row_t& row_v = tbl_[row];
+  uint64_t row_id = row2id_.get_id(row);
+  if (row_id == rows_.size()){
+    rows_.push_back(row_entry());
+  } else if (rows_[row_id].state == ROW_REMOVED){
+    --removed_row_num_;  // reuse a removed row
+  }
+
+  vector<pair<uint64_t, float> > new_columns;
+  new_columns.reserve(columns.size());
   for (size_t i = 0; i < columns.size(); ++i){
-    float & v = row_v[column2id_.get_id(columns[i].first)];
-    //norm_ptr_->notify(row, v, columns[i].second);
-    v = columns[i].second;
+    new_columns.push_back(make_pair(column2id_.get_id(columns[i].first), columns[i].second));
+  }
+
+  row_entry& e = rows_[row_id];
+  if (e.state == ROW_REMOVED){
+    append_row(row_id, new_columns);
+    compact_if_needed();
+    return;
+  }
+
+  if (e.state == ROW_PACKED){
+    // update existing columns in place
+    vector<uint64_t>::iterator begin = column_ids_.begin() + e.offset;
+    vector<uint64_t>::iterator end = begin + e.size;
+    size_t num_new = 0;
+    for (size_t i = 0; i < new_columns.size(); ++i){
+      vector<uint64_t>::iterator it = lower_bound(begin, end, new_columns[i].first);
+      if (it != end && *it == new_columns[i].first){
+        values_[it - column_ids_.begin()] = new_columns[i].second;
+      } else {
+        new_columns[num_new++] = new_columns[i];
+      }
+    }
+    if (num_new == 0){
+      return;
+    }
+    new_columns.resize(num_new);
+    move_to_delta(row_id);
   }
+
+  delta_row& d = delta_[row_id];
+  for (size_t i = 0; i < new_columns.size(); ++i){
+    vector<uint64_t>::iterator it =
+        lower_bound(d.column_ids.begin(), d.column_ids.end(), new_columns[i].first);
+    size_t pos = it - d.column_ids.begin();
+    if (it != d.column_ids.end() && *it == new_columns[i].first){
+      d.values[pos] = new_columns[i].second;
+    } else {
+      d.column_ids.insert(it, new_columns[i].first);
+      d.values.insert(d.values.begin() + pos, new_columns[i].second);
+      ++delta_size_;
+    }
+  }
+  compact_if_needed();
 }
  
 float sparse_matrix_storage::get(const string& row, const string& column) const {
-  tbl_t::const_iterator it = tbl_.find(row);
-  if (it == tbl_.end()){
-    return 0.f;
-  }
-
+  row_view v = get_row_view(row);
   uint64_t id = column2id_.get_id_const(column);
-  if (id == key_manager::NOTFOUND){
+  if (v.size == 0 || id == key_manager::NOTFOUND){
     return 0.f;
   }
 
-  row_t::const_iterator cit = it->second.find(id);
-  if (cit == it->second.end()){
+  const uint64_t* it = lower_bound(v.column_ids, v.column_ids + v.size, id);
+  if (it == v.column_ids + v.size || *it != id){
     return 0.f;
   }
-  return cit->second;
+  return v.values[it - v.column_ids];
 }
 
 void sparse_matrix_storage::get_row(const string& row, vector<pair<string, float> >& columns) const{
   columns.clear();
-  tbl_t::const_iterator it = tbl_.find(row);
-  if (it == tbl_.end()){
-    return;
+  row_view v = get_row_view(row);
+  columns.reserve(v.size);
+  for (size_t i = 0; i < v.size; ++i){
+    columns.push_back(make_pair(column2id_.get_key(v.column_ids[i]), v.values[i]));
   }
-  const row_t& row_v = it->second;
-  for (row_t::const_iterator row_it = row_v.begin(); row_it != row_v.end(); ++row_it){
-    columns.push_back(make_pair(column2id_.get_key(row_it->first), row_it->second));
+}
+
+sparse_matrix_storage::row_view sparse_matrix_storage::get_row_view(const string& row) const{
+  uint64_t row_id = row2id_.get_id_const(row);
+  if (row_id == key_manager::NOTFOUND){
+    return row_view();
   }
+  return get_row_view(row_id);
 }
 
-float sparse_matrix_storage::calc_l2norm(const string& row) const{
+sparse_matrix_storage::row_view sparse_matrix_storage::get_row_view(uint64_t row_id) const{
+  row_view ret;
+  const row_entry& e = rows_[row_id];
+  if (e.state == ROW_PACKED && e.size > 0){
+    ret.column_ids = &column_ids_[e.offset];
+    ret.values = &values_[e.offset];
+    ret.size = e.size;
+  } else if (e.state == ROW_DELTA){
+    delta_t::const_iterator it = delta_.find(row_id);
+    if (it != delta_.end() && !it->second.column_ids.empty()){
+      ret.column_ids = &it->second.column_ids[0];
+      ret.values = &it->second.values[0];
+      ret.size = it->second.column_ids.size();
+    }
+  }
+  return ret;
+}
 
-  tbl_t::const_iterator it = tbl_.find(row);
-  if (it == tbl_.end()){
-    return 0.f;
+bool sparse_matrix_storage::add_scaled_row(const string& row, float ratio,
+                                           vector<pair<uint64_t, float> >& columns) const{
+  row_view v = get_row_view(row);
+  if (v.size == 0){
+    return false;
+  }
+  for (size_t i = 0; i < v.size; ++i){
+    columns.push_back(make_pair(v.column_ids[i], v.values[i] * ratio));
   }
+  return true;
+}
+
+const string& sparse_matrix_storage::get_column_key(uint64_t id) const{
+  return column2id_.get_key(id);
+}
+
+float sparse_matrix_storage::calc_l2norm(const string& row) const{
+  row_view v = get_row_view(row);
   float sq_norm = 0.f;
-  const row_t& row_v = it->second;
-  for (row_t::const_iterator row_it = row_v.begin(); row_it != row_v.end(); ++row_it){
-    sq_norm += row_it->second * row_it->second;
+  for (size_t i = 0; i < v.size; ++i){
+    sq_norm += v.values[i] * v.values[i];
   }
   return sqrt(sq_norm);
 }
 
 void sparse_matrix_storage::remove(const string& row, const string& column){
-  tbl_t::iterator it = tbl_.find(row);
-  if (it == tbl_.end()){
-    return;
-  }
-  
+  uint64_t row_id = row2id_.get_id_const(row);
   uint64_t id = column2id_.get_id_const(column);
-  if (id == key_manager::NOTFOUND){
+  if (row_id == key_manager::NOTFOUND || id == key_manager::NOTFOUND){
     return;
   }
-  
-  row_t::iterator cit = it->second.find(id);
-  if (cit == it->second.end()){
-    return;
+
+  row_entry& e = rows_[row_id];
+  if (e.state == ROW_PACKED){
+    vector<uint64_t>::iterator begin = column_ids_.begin() + e.offset;
+    vector<uint64_t>::iterator end = begin + e.size;
+    vector<uint64_t>::iterator it = lower_bound(begin, end, id);
+    if (it == end || *it != id){
+      return;
+    }
+    // shift the rest of the row, and leave the last column unused
+    vector<float>::iterator vit = values_.begin() + (it - column_ids_.begin());
+    copy(it + 1, end, it);
+    copy(vit + 1, values_.begin() + e.offset + e.size, vit);
+    --e.size;
+    ++garbage_size_;
+  } else if (e.state == ROW_DELTA){
+    delta_row& d = delta_[row_id];
+    vector<uint64_t>::iterator it = lower_bound(d.column_ids.begin(), d.column_ids.end(), id);
+    if (it == d.column_ids.end() || *it != id){
+      return;
+    }
+    d.values.erase(d.values.begin() + (it - d.column_ids.begin()));
+    d.column_ids.erase(it);
+    --delta_size_;
   }
-  //norm_ptr_->notify(row, cit->second, 0.f);
-  it->second.erase(cit);
+  compact_if_needed();
 }
 
 void sparse_matrix_storage::remove_row(const string& row){
-  tbl_t::iterator it = tbl_.find(row);
-  if (it == tbl_.end()){
+  uint64_t row_id = row2id_.get_id_const(row);
+  if (row_id == key_manager::NOTFOUND){
     return;
   }
-
-  /*
-  for (row_t::const_iterator cit = it->second.begin(); cit != it->second.end(); ++cit){
-    norm_ptr_->notify(row, cit->second, 0.f);
+  row_entry& e = rows_[row_id];
+  if (e.state == ROW_REMOVED){
+    return;
   }
-  */
-
-  tbl_.erase(it);
+  if (e.state == ROW_PACKED){
+    garbage_size_ += e.size;
+  } else {
+    delta_t::iterator it = delta_.find(row_id);
+    delta_size_ -= it->second.column_ids.size();
+    delta_.erase(it);
+  }
+  // the removed row itself is counted until it is reused
+  ++removed_row_num_;
+  e = row_entry();
+  compact_if_needed();
 }
 
-
 void sparse_matrix_storage::get_all_row_ids(vector<string>& ids) const{
   ids.clear();
-  for (tbl_t::const_iterator it = tbl_.begin(); it != tbl_.end(); ++it){
-    ids.push_back(it->first);
+  for (uint64_t row_id = 0; row_id < rows_.size(); ++row_id){
+    if (rows_[row_id].state != ROW_REMOVED){
+      ids.push_back(row2id_.get_key(row_id));
+    }
   }
 }
 
 void sparse_matrix_storage::clear() {
+  row2id_.clear();
+  rows_.clear();
+  column_ids_.clear();
+  values_.clear();
+  delta_.clear();
+  delta_size_ = 0;
+  garbage_size_ = 0;
+  removed_row_num_ = 0;
   column2id_.clear();
-  tbl_.clear();
-  //norm_ptr_->clear();
+}
+
+void sparse_matrix_storage::compact() {
+  vector<string> row_keys;
+  vector<row_entry> rows;
+  vector<uint64_t> column_ids;
+  vector<float> values;
+  column_ids.reserve(column_ids_.size() - garbage_size_ + delta_size_);
+  values.reserve(column_ids.capacity());
+  for (uint64_t row_id = 0; row_id < rows_.size(); ++row_id){
+    if (rows_[row_id].state == ROW_REMOVED){
+      continue;
+    }
+    row_view v = get_row_view(row_id);
+    row_entry e;
+    e.state = ROW_PACKED;
+    e.offset = column_ids.size();
+    e.size = v.size;
+    column_ids.insert(column_ids.end(), v.column_ids, v.column_ids + v.size);
+    values.insert(values.end(), v.values, v.values + v.size);
+    rows.push_back(e);
+    row_keys.push_back(row2id_.get_key(row_id));
+  }
+
+  row2id_.init_by_id2key(row_keys);
+  rows_.swap(rows);
+  column_ids_.swap(column_ids);
+  values_.swap(values);
+  delta_.clear();
+  delta_size_ = 0;
+  garbage_size_ = 0;
+  removed_row_num_ = 0;
+}
+
+void sparse_matrix_storage::append_row(uint64_t row_id, vector<pair<uint64_t, float> >& columns){
+  sort_and_keep_last(columns);
+  row_entry& e = rows_[row_id];
+  e.state = ROW_PACKED;
+  e.offset = column_ids_.size();
+  e.size = columns.size();
+  for (size_t i = 0; i < columns.size(); ++i){
+    column_ids_.push_back(columns[i].first);
+    values_.push_back(columns[i].second);
+  }
+}
+
+void sparse_matrix_storage::move_to_delta(uint64_t row_id){
+  row_entry& e = rows_[row_id];
+  delta_row& d = delta_[row_id];
+  d.column_ids.assign(column_ids_.begin() + e.offset, column_ids_.begin() + e.offset + e.size);
+  d.values.assign(values_.begin() + e.offset, values_.begin() + e.offset + e.size);
+  delta_size_ += e.size;
+  garbage_size_ += e.size;
+  e.state = ROW_DELTA;
+  e.offset = 0;
+  e.size = 0;
+}
+
+void sparse_matrix_storage::compact_if_needed(){
+  uint64_t packed_size = column_ids_.size() - garbage_size_;
+  if (needs_compaction(delta_size_ + garbage_size_ + removed_row_num_, packed_size)){
+    compact();
+  }
+}
+
+void sparse_matrix_storage::get_table(tbl_t& tbl) const{
+  tbl.clear();
+  for (uint64_t row_id = 0; row_id < rows_.size(); ++row_id){
+    if (rows_[row_id].state == ROW_REMOVED){
+      continue;
+    }
+    row_t& row = tbl[row2id_.get_key(row_id)];
+    row_view v = get_row_view(row_id);
+    for (size_t i = 0; i < v.size; ++i){
+      row[v.column_ids[i]] = v.values[i];
+    }
+  }
+}
+
+// column2id_ is not changed
+void sparse_matrix_storage::set_table(const tbl_t& tbl){
+  row2id_.clear();
+  rows_.clear();
+  column_ids_.clear();
+  values_.clear();
+  delta_.clear();
+  delta_size_ = 0;
+  garbage_size_ = 0;
+  removed_row_num_ = 0;
+  for (tbl_t::const_iterator it = tbl.begin(); it != tbl.end(); ++it){
+    uint64_t row_id = row2id_.get_id(it->first);
+    rows_.push_back(row_entry());
+    vector<pair<uint64_t, float> > columns(it->second.begin(), it->second.end());
+    append_row(row_id, columns);
+  }
 }
 
 bool sparse_matrix_storage::save(ostream& os) {
@@ -26,8 +26,20 @@
 namespace jubatus {
 namespace storage{
 
+// Rows are packed in CSR layout, where the columns of a row are sorted by
+// column id. A value of an existing column is updated in place, and a row
+// which gets new columns is moved to a delta map. The delta map and the
+// space of removed columns are packed again when they grow large.
 class sparse_matrix_storage {
 public:
+  // A row without copy, which is invalidated by any update of the storage.
+  struct row_view {
+    row_view() : column_ids(NULL), values(NULL), size(0) {}
+    const uint64_t* column_ids;
+    const float* values;
+    size_t size;
+  };
+
   sparse_matrix_storage();
   ~sparse_matrix_storage();
 
@@ -38,6 +50,14 @@ public:
 
   float get(const std::string& row, const std::string& column) const;
   void get_row(const std::string& row, std::vector<std::pair<std::string, float> >& columns) const;
+  // Returns an empty view if the row is not found.
+  row_view get_row_view(const std::string& row) const;
+
+  // Appends the columns of a row by column id, with values multiplied by
+  // ratio. Returns false if the row is not found or empty.
+  bool add_scaled_row(const std::string& row, float ratio,
+                      std::vector<std::pair<uint64_t, float> >& columns) const;
+  const std::string& get_column_key(uint64_t id) const;
 
   float calc_l2norm(const std::string& row) const;
   void remove(const std::string& row, const std::string& column);
@@ -45,6 +65,9 @@ public:
   void get_all_row_ids(std::vector<std::string>& ids) const;
   void clear();
 
+  // Packs the delta map and drops removed rows and columns.
+  void compact();
+
   bool save(std::ostream&);
   bool load(std::istream&);
 
@@ -52,11 +75,53 @@ private:
   friend class pfi::data::serialization::access;
   template <class Ar>
   void serialize(Ar& ar) {
-    ar & MEMBER(tbl_)
+    tbl_t tbl;
+    if (!ar.is_read) {
+      get_table(tbl);
+    }
+    ar & NAMED_MEMBER("tbl_", tbl)
       & MEMBER(column2id_);
+    if (ar.is_read) {
+      set_table(tbl);
+    }
   }
 
-  tbl_t tbl_;
+  enum row_state {
+    ROW_REMOVED,
+    ROW_PACKED,
+    ROW_DELTA
+  };
+
+  struct row_entry {
+    row_entry() : state(ROW_REMOVED), offset(0), size(0) {}
+    row_state state;
+    // range in column_ids_ and values_ of a packed row
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct delta_row {
+    std::vector<uint64_t> column_ids;
+    std::vector<float> values;
+  };
+
+  typedef pfi::data::unordered_map<uint64_t, delta_row> delta_t;
+
+  row_view get_row_view(uint64_t row_id) const;
+  void append_row(uint64_t row_id, std::vector<std::pair<uint64_t, float> >& columns);
+  void move_to_delta(uint64_t row_id);
+  void compact_if_needed();
+  void get_table(tbl_t& tbl) const;
+  void set_table(const tbl_t& tbl);
+
+  key_manager row2id_;
+  std::vector<row_entry> rows_;  // indexed by row id
+  std::vector<uint64_t> column_ids_;
+  std::vector<float> values_;
+  delta_t delta_;
+  uint64_t delta_size_;    // number of columns in delta_
+  uint64_t garbage_size_;  // number of unused columns in column_ids_
+  uint64_t removed_row_num_;  // number of removed rows in rows_
   key_manager column2id_;
 };
 
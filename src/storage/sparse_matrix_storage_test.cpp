@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <pficommon/lang/cast.h>
 #include "sparse_matrix_storage.hpp"
 #include "../fv_converter/test_util.hpp"
 #include "norm.hpp"
@@ -89,6 +90,114 @@ TEST(sparse_matrix_storage, set) {
   EXPECT_EQ(0.0, s.get("r1", "c1"));
 }
 
+TEST(sparse_matrix_storage, add_scaled_row) {
+  sparse_matrix_storage s;
+  s.set("r1", "c1", 1.0);
+  s.set("r1", "c2", 2.0);
+  s.set("r2", "c2", 4.0);
+
+  vector<pair<uint64_t, float> > columns;
+  EXPECT_FALSE(s.add_scaled_row("unknown", 1.0, columns));
+  EXPECT_TRUE(columns.empty());
+
+  EXPECT_TRUE(s.add_scaled_row("r1", 0.5, columns));
+  EXPECT_TRUE(s.add_scaled_row("r2", 0.5, columns));
+  ASSERT_EQ(3u, columns.size());
+  sort(columns.begin(), columns.end());
+  EXPECT_EQ("c1", s.get_column_key(columns[0].first));
+  EXPECT_FLOAT_EQ(0.5, columns[0].second);
+  EXPECT_EQ("c2", s.get_column_key(columns[1].first));
+  EXPECT_FLOAT_EQ(1.0, columns[1].second);
+  EXPECT_EQ("c2", s.get_column_key(columns[2].first));
+  EXPECT_FLOAT_EQ(2.0, columns[2].second);
+}
+
+TEST(sparse_matrix_storage, get_row_view) {
+  sparse_matrix_storage s;
+  EXPECT_EQ(0u, s.get_row_view("r1").size);
+
+  vector<pair<string, float> > r1;
+  r1.push_back(make_pair("c2", 2.0));
+  r1.push_back(make_pair("c1", 1.0));
+  r1.push_back(make_pair("c2", 3.0));
+  s.set_row("r1", r1);
+
+  // columns are sorted by id, and the last value of a column is kept
+  sparse_matrix_storage::row_view v = s.get_row_view("r1");
+  ASSERT_EQ(2u, v.size);
+  EXPECT_EQ("c2", s.get_column_key(v.column_ids[0]));
+  EXPECT_FLOAT_EQ(3.0, v.values[0]);
+  EXPECT_EQ("c1", s.get_column_key(v.column_ids[1]));
+  EXPECT_FLOAT_EQ(1.0, v.values[1]);
+}
+
+TEST(sparse_matrix_storage, update_packed_and_delta_rows) {
+  sparse_matrix_storage s;
+  s.set("r1", "c1", 1.0);
+  s.set("r1", "c2", 2.0);  // moves r1 to the delta map
+  s.set("r2", "c1", 3.0);
+  s.set("r2", "c1", 4.0);  // updated in place
+  s.set("r1", "c3", 5.0);
+
+  EXPECT_EQ(1.0, s.get("r1", "c1"));
+  EXPECT_EQ(2.0, s.get("r1", "c2"));
+  EXPECT_EQ(5.0, s.get("r1", "c3"));
+  EXPECT_EQ(4.0, s.get("r2", "c1"));
+  EXPECT_EQ(0.0, s.get("r2", "c2"));
+
+  s.remove("r1", "c2");
+  s.remove("r2", "c1");
+  EXPECT_EQ(0.0, s.get("r1", "c2"));
+  EXPECT_EQ(5.0, s.get("r1", "c3"));
+  EXPECT_EQ(0.0, s.get("r2", "c1"));
+
+  s.remove_row("r1");
+  s.set("r1", "c4", 6.0);
+  vector<pair<string, float> > p;
+  s.get_row("r1", p);
+  ASSERT_EQ(1u, p.size());
+  EXPECT_EQ("c4", p[0].first);
+  EXPECT_EQ(6.0, p[0].second);
+
+  s.compact();
+  EXPECT_EQ(6.0, s.get("r1", "c4"));
+  vector<string> ids;
+  s.get_all_row_ids(ids);
+  ASSERT_EQ(2u, ids.size());
+  sort(ids.begin(), ids.end());
+  EXPECT_EQ("r1", ids[0]);
+  EXPECT_EQ("r2", ids[1]);
+}
+
+TEST(sparse_matrix_storage, compaction) {
+  sparse_matrix_storage s;
+  // adds columns one by one, which triggers compaction many times
+  for (int i = 0; i < 100; ++i) {
+    for (int j = 0; j < 100; ++j) {
+      s.set("r" + pfi::lang::lexical_cast<string>(j),
+            "c" + pfi::lang::lexical_cast<string>(i), i * j);
+    }
+    if (i % 10 == 0) {
+      s.remove_row("r" + pfi::lang::lexical_cast<string>(i));
+    }
+  }
+
+  vector<string> ids;
+  s.get_all_row_ids(ids);
+  EXPECT_EQ(100u, ids.size());
+  for (int j = 0; j < 100; ++j) {
+    string row = "r" + pfi::lang::lexical_cast<string>(j);
+    // rows removed at the i-th step have columns from i + 1
+    int begin = j % 10 == 0 ? j + 1 : 0;
+    vector<pair<string, float> > p;
+    s.get_row(row, p);
+    ASSERT_EQ(static_cast<size_t>(100 - begin), p.size()) << row;
+    for (int i = begin; i < 100; ++i) {
+      EXPECT_EQ(i * j, s.get(row, "c" + pfi::lang::lexical_cast<string>(i)));
+    }
+  }
+}
+
 TEST(sparse_matrix_storage, calc_l2norm) {
   sparse_matrix_storage s;
   EXPECT_FLOAT_EQ(0.0, s.calc_l2norm("unknown"));
@@ -107,6 +216,12 @@ TEST(sparse_matrix_storage, save_load) {
   sparse_matrix_storage s2;
   s2.load(ss);
   EXPECT_FLOAT_EQ(1.0, s2.get("r1", "c1"));
+
+  s2.set("r1", "c2", 2.0);
+  s2.set("r2", "c2", 3.0);
+  EXPECT_FLOAT_EQ(1.0, s2.get("r1", "c1"));
+  EXPECT_FLOAT_EQ(2.0, s2.get("r1", "c2"));
+  EXPECT_FLOAT_EQ(3.0, s2.get("r2", "c2"));
 }
 
 TEST(sparse_matrix_storage, remove) {
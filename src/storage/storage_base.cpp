@@ -16,6 +16,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "storage_base.hpp"
+#include <algorithm>
 #include <pficommon/text/json.h>
 
 using namespace std; 
@@ -80,5 +81,31 @@ void storage_base::get_diff(features3_t& v) const {
 void storage_base::set_average_and_clear_diff(const features3_t&){
 }
 
+void storage_base::set_dense_features(const vector<string>& features) {
+  dense_features_ = features;
+}
+
+void storage_base::inp_dense(const sfv_t& sfv, const vector<float>& dense, map_feature_val1_t& ret) {
+  sfv_t fv;
+  expand_dense(sfv, dense, fv);
+  inp(fv, ret);
+}
+
+void storage_base::bulk_update_dense(const sfv_t& sfv, const vector<float>& dense, float step_width, const string& inc_class, const string& dec_class) {
+  sfv_t fv;
+  expand_dense(sfv, dense, fv);
+  bulk_update(fv, step_width, inc_class, dec_class);
+}
+
+void storage_base::expand_dense(const sfv_t& sfv, const vector<float>& dense, sfv_t& ret) const {
+  ret = sfv;
+  size_t n = min(dense.size(), dense_features_.size());
+  for (size_t i = 0; i < n; ++i) {
+    if (dense[i] != 0.f) {
+      ret.push_back(make_pair(dense_features_[i], dense[i]));
+    }
+  }
+}
+
 }
 }
@@ -20,6 +20,7 @@
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 #include <stdexcept>
 #include "storage_type.hpp"
 #include "../common/exception.hpp"
@@ -56,8 +57,22 @@ public:
   virtual void get_diff(features3_t&) const ;
   virtual void set_average_and_clear_diff(const features3_t&);
 
+  /// Features whose values are given as a dense vector in the same order.
+  /// Storages may keep their weights in a contiguous segment, and then sfv
+  /// given to inp and bulk_update must not contain them.
+  virtual void set_dense_features(const std::vector<std::string>& features);
+
+  virtual void inp_dense(const sfv_t& sfv, const std::vector<float>& dense, map_feature_val1_t& ret); /// inner product
+
+  virtual void bulk_update_dense(const sfv_t& sfv, const std::vector<float>& dense, float step_width, const std::string& inc_class, const std::string& dec_class);
+
   virtual std::string type() const = 0;
 
+protected:
+  /// appends dense values to sfv as ordinary features
+  void expand_dense(const sfv_t& sfv, const std::vector<float>& dense, sfv_t& ret) const;
+
+  std::vector<std::string> dense_features_;
 };
 
 class storage_exception : public jubatus::exception::jubaexception<storage_exception> {
@@ -466,10 +466,51 @@ TYPED_TEST_P(storage_test, bulk_update_no_decrease) {
   EXPECT_EQ(0.0, v[0].second.v3);
 }
 
+TYPED_TEST_P(storage_test, dense) {
+  TypeParam s;
+  s.set3("feature1", "class1", val3_t(1.0, 0.0, 0.0));
+
+  vector<string> names;
+  names.push_back("dense1");
+  names.push_back("dense2");
+  s.set_dense_features(names);
+
+  sfv_t fv;
+  fv.push_back(make_pair("feature1", 1.0));
+  vector<float> dense;
+  dense.push_back(1.0);
+  dense.push_back(2.0);
+
+  s.bulk_update_dense(fv, dense, 1.5, "class1", "class2");
+
+  map_feature_val1_t scores;
+  s.inp_dense(fv, dense, scores);
+  EXPECT_DOUBLE_EQ(2.5 + 1.5 + 6.0, scores["class1"]);
+  EXPECT_DOUBLE_EQ(-1.5 - 1.5 - 6.0, scores["class2"]);
+
+  feature_val3_t v;
+  s.get3("dense2", v);
+  sort(v.begin(), v.end());
+  ASSERT_EQ(2u, v.size());
+  EXPECT_EQ("class1", v[0].first);
+  EXPECT_EQ(3.0, v[0].second.v1);
+  EXPECT_EQ("class2", v[1].first);
+  EXPECT_EQ(-3.0, v[1].second.v1);
+
+  // weights are kept when the dense features are unset
+  s.set_dense_features(vector<string>());
+  v.clear();
+  s.get3("dense1", v);
+  sort(v.begin(), v.end());
+  ASSERT_EQ(2u, v.size());
+  EXPECT_EQ(1.5, v[0].second.v1);
+  EXPECT_EQ(-1.5, v[1].second.v1);
+}
+
 REGISTER_TYPED_TEST_CASE_P(storage_test,
                            val1d, val2d, val3d,
                            serialize, inp, get_status, update, bulk_update,
-                           bulk_update_no_decrease);
+                           bulk_update_no_decrease, dense);
 
 typedef testing::Types<stub_storage, local_storage, local_storage_mixture> storage_types;
 INSTANTIATE_TYPED_TEST_CASE_P(st, storage_test, storage_types);
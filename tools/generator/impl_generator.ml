@@ -89,6 +89,8 @@ let generate s output strees =
 	  let rec has_cht_ = function
 	    | [] -> false;
 	    | Routing(Cht(_))::_ -> true;
+	    | Routing(Cht_batch(_))::_ -> true;
+	    | Routing(Cht_scatter(_))::_ -> true;
 	    | _::tl -> has_cht_ tl
 	  in
 	  has_cht_ decs
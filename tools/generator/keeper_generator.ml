@@ -38,7 +38,7 @@ let to_keeper_strings = function
 	  Printf.sprintf "    k.register_random<%s >(\"%s\"); //%s %s"
 	    (String.concat ", " (rettype::argv_strs))  name
 	    (Stree.aggtype_to_string agg) (Stree.reqtype_to_string rwtype);
-	| Cht(i) -> (* when needs aggregator *)
+	| Cht(i) | Cht_batch(i) -> (* when needs aggregator *)
 	  let aggfunc =
 	    let tmpl =
 	      (* merge for map, concat for list *)
@@ -51,8 +51,22 @@ let to_keeper_strings = function
 	    Printf.sprintf "pfi::lang::function<%s(%s,%s)>(&%s%s)" rettype rettype rettype
 	      (Stree.aggtype_to_string agg) tmpl
 	  in
-	  Printf.sprintf "    k.register_cht<%d, %s >(\"%s\", %s); //%s" i
-	    (String.concat ", " (rettype::(List.tl argv_strs))) name aggfunc
+	  let register, argv_strs =
+	    match routing, argv_types with
+	      | Cht_batch(_), [List(Tuple([_; t]))] ->
+		"register_cht_batch", [Util.decl_type2string t];
+	      | _ -> "register_cht", List.tl argv_strs
+	  in
+	  Printf.sprintf "    k.%s<%d, %s >(\"%s\", %s); //%s" register i
+	    (String.concat ", " (rettype::argv_strs)) name aggfunc
+	    (Stree.reqtype_to_string rwtype)
+	| Cht_scatter(i) -> (* results are returned in the order of ids *)
+	  let elemtype = match rettype0 with
+	    | List(t) -> Util.decl_type2string t;
+	    | _ -> rettype
+	  in
+	  Printf.sprintf "    k.register_cht_scatter<%d, %s >(\"%s\"); //%s" i
+	    (String.concat ", " (elemtype::(List.tl argv_strs))) name
 	    (Stree.reqtype_to_string rwtype)
 	| Internal -> ""; (* no code generated in keeper *)
 	| _ ->
@@ -30,7 +30,8 @@ type decl_type = Void | Object | Bool
     
 type field_type = Field of int * decl_type * string
 
-type routing_type = Random | Cht of int | Broadcast | Internal
+type routing_type = Random | Cht of int | Cht_batch of int | Cht_scatter of int
+		  | Broadcast | Internal
 type reqtype = Update | Analysis | Nolock
 
 (* known_aggregators =
@@ -74,6 +75,8 @@ let make_decorator = function
   | "#@broadcast" -> Routing(Broadcast);
   | "#@internal"  -> Routing(Internal);
   | "#@cht"       -> Routing(Cht(2));
+  | "#@cht_batch" -> Routing(Cht_batch(2));
+  | "#@cht_scatter" -> Routing(Cht_scatter(1));
 
   | "#@all_and"   -> Aggtype(All_and);
   | "#@all_or"   -> Aggtype(All_or);
@@ -87,11 +90,17 @@ let make_decorator_with_int d i =
   match d with
     | "#@cht" when 0 <= i -> Routing(Cht(i))
     | "#@cht" -> raise (Unknown_type "cht with negative i");
+    | "#@cht_batch" when 0 <= i -> Routing(Cht_batch(i))
+    | "#@cht_batch" -> raise (Unknown_type "cht_batch with negative i");
+    | "#@cht_scatter" when 0 <= i -> Routing(Cht_scatter(i))
+    | "#@cht_scatter" -> raise (Unknown_type "cht_scatter with negative i");
     | other -> raise (Unknown_type other);;
 
 let routing_to_string = function
   | Random -> "random";
   | Cht(i) -> "cht("^(string_of_int i)^")";
+  | Cht_batch(i) -> "cht_batch("^(string_of_int i)^")";
+  | Cht_scatter(i) -> "cht_scatter("^(string_of_int i)^")";
   | Broadcast -> "broadcast";
   | Internal -> "";;
 
@@ -69,6 +69,14 @@ let check_method m =
 
   match routing with
     | Cht(r) -> if gettype (List.nth argv 1) <> String then raise (Bad_cht_argv name);
+    | Cht_batch(r) -> (* rows are a list of (id, value) *)
+      (match List.map gettype argv with
+	| [_; List(Tuple([String; _]))] -> ();
+	| _ -> raise (Bad_cht_argv name));
+    | Cht_scatter(r) -> (* one result for each id *)
+      (match rettype, List.map gettype argv with
+	| List(_), [_; List(String); _] -> ();
+	| _ -> raise (Bad_cht_argv name));
     | _ -> ();;
 
 let check_service methods =